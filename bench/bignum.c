@@ -0,0 +1,101 @@
+// Times the bignum kernels on large factorials and Fibonacci numbers.
+// Build and run with `make bench-bignum`.
+#include "bignum.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RUNS 5
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static bignum_t *factorial(int n) {
+  bignum_t *acc = bignum_from_i64(1);
+  for (int i = 2; i <= n; i++) {
+    bignum_t *k = bignum_from_i64(i);
+    bignum_t *next = bignum_mul(acc, k);
+    bignum_free(k);
+    bignum_free(acc);
+    acc = next;
+  }
+  return acc;
+}
+
+static bignum_t *fibonacci(int n) {
+  bignum_t *a = bignum_from_i64(0);
+  bignum_t *b = bignum_from_i64(1);
+  for (int i = 0; i < n; i++) {
+    bignum_t *next = bignum_add(a, b);
+    bignum_free(a);
+    a = b;
+    b = next;
+  }
+  bignum_free(b);
+  return a;
+}
+
+static size_t digits(const bignum_t *b) {
+  char *s = bignum_to_string(b);
+  size_t n = strlen(s);
+  free(s);
+  return n;
+}
+
+// Runs `body` RUNS times and reports the fastest run.
+#define TIME(label, result, body)                                                                  \
+  do {                                                                                             \
+    double best = 0.0;                                                                             \
+    for (int run_ = 0; run_ < RUNS; run_++) {                                                      \
+      double start_ = now_ms();                                                                    \
+      body;                                                                                        \
+      double ms_ = now_ms() - start_;                                                              \
+      if (run_ == 0 || ms_ < best) best = ms_;                                                     \
+      if (run_ + 1 < RUNS) bignum_free(result);                                                    \
+    }                                                                                              \
+    printf("%-24s %10.3f ms  %8zu digits\n", label, best, digits(result));                         \
+  } while (0)
+
+int main(void) {
+  bignum_t *fact = NULL;
+  bignum_t *fib = NULL;
+  bignum_t *square = NULL;
+  bignum_t *rem = NULL;
+  bignum_t *parsed = NULL;
+
+  TIME("factorial 5000", fact, fact = factorial(5000));
+  TIME("fibonacci 100000", fib, fib = fibonacci(100000));
+  TIME("square (factorial 5000)", square, square = bignum_mul(fact, fact));
+  TIME("fib 100000 * fact 5000", rem, rem = bignum_mul(fib, fact));
+  bignum_free(rem);
+  TIME("mod fib by fact", rem, rem = bignum_mod(fib, fact));
+
+  char *text = NULL;
+  double best = 0.0;
+  for (int run = 0; run < RUNS; run++) {
+    free(text);
+    double start = now_ms();
+    text = bignum_to_string(square);
+    double ms = now_ms() - start;
+    if (run == 0 || ms < best) best = ms;
+  }
+  printf("%-24s %10.3f ms  %8zu digits\n", "to decimal (square)", best, strlen(text));
+  TIME("from decimal (square)", parsed, parsed = bignum_from_string(text));
+
+  int ok = bignum_cmp(parsed, square) == 0;
+  free(text);
+  bignum_free(fact);
+  bignum_free(fib);
+  bignum_free(square);
+  bignum_free(rem);
+  bignum_free(parsed);
+  if (!ok) {
+    fprintf(stderr, "decimal round trip mismatch\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,16 @@
+; Closure-heavy code: counters, adders and function composition.
+(define make-counter (lambda ()
+  (let ((n 0))
+    (lambda () (set n (+ n 1)) n))))
+
+(define make-adder (lambda (k) (lambda (x) (+ x k))))
+
+(define compose (lambda (f g) (lambda (x) (f (g x)))))
+
+(define run (lambda (rounds)
+  (let ((counter (make-counter)))
+    (do ((i 0 (+ i 1))
+         (acc 0 (+ acc ((compose (make-adder i) (make-adder 1)) (counter)))))
+        ((= i rounds) acc)))))
+
+(run 60000)
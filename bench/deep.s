@@ -0,0 +1,9 @@
+; Deep non-tail recursion: long chains of live call frames.
+(define count-down (lambda (n)
+  (if (= n 0) 0 (+ 1 (count-down (- n 1))))))
+
+(define build (lambda (n)
+  (if (= n 0) '() (cons n (build (- n 1))))))
+
+(do ((i 0 (+ i 1)) (sum 0 (+ sum (count-down 5000) (length (build 5000)))))
+    ((= i 30) sum))
@@ -0,0 +1,8 @@
+; GC stress: many short-lived lists while a large structure stays live.
+(define make-list (lambda (n x)
+  (do ((i 0 (+ i 1)) (acc '() (cons x acc))) ((= i n) acc))))
+
+(define keep (make-list 50000 "live"))
+
+(do ((i 0 (+ i 1)) (total 0 (+ total (length (make-list 200 i)))))
+    ((= i 3000) (+ total (length keep))))
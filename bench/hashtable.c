@@ -0,0 +1,177 @@
+// Times hashtable.c on insert, lookup and erase mixes and reports its probe
+// statistics, for tables of 8 entries up to `max` (default 1M; pass 10000000
+// for 10M). Build and run with `make bench-hashtable`, which builds it once
+// with string keys and once with -DHT_POINTER_KEYS.
+//
+// For each size, with keys inserted into a table that starts empty:
+//   insert   inserting every key, growing from the initial capacity
+//   hit      looking up keys that are present, in random order
+//   miss     looking up keys that are absent
+//   mixed    lookups with a 90% hit ratio
+//   churn    erasing a key and inserting a new one
+//   after    lookups with a 90% hit ratio on the churned table
+// Times are nanoseconds per operation. Small tables repeat the work so that
+// every measurement covers at least MIN_OPS operations.
+//
+// The columns after the times are ht_stats of the table after the inserts
+// (load factor, max and mean DIB, resizes) and after the churn (max and mean
+// DIB, resizes).
+#include "hashtable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MIN_OPS 2000000
+#define DEFAULT_MAX 1000000
+
+#if HT_STRING_KEYS
+typedef const char *bench_key;
+#define KEY_MODE "string"
+#else
+typedef const void *bench_key;
+#define KEY_MODE "pointer"
+#endif
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t G_rng = 0x2545f4914f6cdd1dULL;
+
+static uint64_t next_random(void) {
+  G_rng ^= G_rng << 13;
+  G_rng ^= G_rng >> 7;
+  G_rng ^= G_rng << 17;
+  return G_rng;
+}
+
+// `n` distinct keys. String keys look like symbol names; pointer keys are
+// addresses of consecutive heap objects, like lvals.
+static bench_key *make_keys(size_t n, size_t first, void **storage) {
+  bench_key *keys = malloc(n * sizeof *keys);
+#if HT_STRING_KEYS
+  char *names = malloc(n * 16);
+  for (size_t i = 0; i < n; i++) {
+    snprintf(names + i * 16, 16, "sym-%zu", first + i);
+    keys[i] = names + i * 16;
+  }
+  *storage = names;
+#else
+  (void)first;
+  char *objects = malloc(n * 32);
+  for (size_t i = 0; i < n; i++) keys[i] = objects + i * 32;
+  *storage = objects;
+#endif
+  return keys;
+}
+
+static void shuffle(bench_key *keys, size_t n) {
+  for (size_t i = n; i > 1; i--) {
+    size_t j = next_random() % i;
+    bench_key tmp = keys[i - 1];
+    keys[i - 1] = keys[j];
+    keys[j] = tmp;
+  }
+}
+
+static hashtable build(bench_key *keys, size_t n) {
+  hashtable t;
+  ht_error err = { 0 };
+  if (!ht_init(&t, 0, &err)) {
+    fprintf(stderr, "ht_init: %s\n", err.error_message);
+    exit(1);
+  }
+  for (size_t i = 0; i < n; i++) ht_set(&t, keys[i], (void *)keys[i], &err);
+  return t;
+}
+
+// Nanoseconds per lookup of `ops` keys drawn from `hits` with probability
+// `ratio` and from `misses` otherwise.
+static double time_lookups(const hashtable *t, bench_key *hits, bench_key *misses, size_t n,
+                           size_t ops, double ratio, size_t *found) {
+  size_t threshold = (size_t)(ratio * 1000);
+  bench_key *order = malloc(ops * sizeof *order);
+  for (size_t i = 0; i < ops; i++) {
+    bench_key *from = next_random() % 1000 < threshold ? hits : misses;
+    order[i] = from[next_random() % n];
+  }
+  double start = now_ns();
+  for (size_t i = 0; i < ops; i++) {
+    void *v;
+    *found += ht_get(t, order[i], &v);
+  }
+  double ns = (now_ns() - start) / ops;
+  free(order);
+  return ns;
+}
+
+static void run_size(size_t n) {
+  void *key_storage, *miss_storage;
+  bench_key *keys = make_keys(2 * n, 0, &key_storage);
+  bench_key *misses = make_keys(n, 2 * n, &miss_storage);
+  bench_key *spare = keys + n; // inserted by the churn
+  size_t reps = n < MIN_OPS ? MIN_OPS / n : 1;
+  size_t ops = n * reps;
+  size_t found = 0;
+
+  double start = now_ns();
+  for (size_t r = 1; r < reps; r++) {
+    hashtable t = build(keys, n);
+    ht_destroy(&t);
+  }
+  hashtable t = build(keys, n);
+  double insert = (now_ns() - start) / ops;
+  ht_probe_stats built;
+  ht_stats(&t, &built);
+
+  shuffle(keys, n);
+  double hit = time_lookups(&t, keys, misses, n, ops, 1.0, &found);
+  double miss = time_lookups(&t, keys, misses, n, ops, 0.0, &found);
+  double mixed = time_lookups(&t, keys, misses, n, ops, 0.9, &found);
+
+  // Replaces every key in each round, keeping the size fixed.
+  ht_error err = { 0 };
+  bench_key *present = keys, *absent = spare;
+  start = now_ns();
+  for (size_t r = 0; r < reps; r++) {
+    for (size_t i = 0; i < n; i++) {
+      ht_erase(&t, present[i], NULL);
+      ht_set(&t, absent[i], (void *)absent[i], &err);
+    }
+    bench_key *swap = present;
+    present = absent;
+    absent = swap;
+  }
+  double churn = (now_ns() - start) / ops;
+  ht_probe_stats churned;
+  ht_stats(&t, &churned);
+  double after = time_lookups(&t, present, absent, n, ops, 0.9, &found);
+
+  printf("%-7s %9zu %7.1f %6.1f %6.1f %6.1f %6.1f %6.1f   %4.2f %4u %5.2f %4zu   %4u %5.2f %4zu\n",
+         KEY_MODE, n, insert, hit, miss, mixed, churn, after, built.load_factor, built.max_dib,
+         built.mean_dib, built.resizes, churned.max_dib, churned.mean_dib, churned.resizes);
+  if (found == 0) printf("(nothing found)\n");
+
+  ht_destroy(&t);
+  free(keys);
+  free(misses);
+  free(key_storage);
+  free(miss_storage);
+}
+
+int main(int argc, char **argv) {
+  size_t max = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_MAX;
+  if (max < 8) {
+    fprintf(stderr, "Usage: %s [max-size >= 8]\n", argv[0]);
+    return 1;
+  }
+  printf("%-7s %9s %7s %6s %6s %6s %6s %6s   %4s %4s %5s %4s   %4s %5s %4s\n", "keys", "size",
+         "insert", "hit", "miss", "mixed", "churn", "after", "load", "max", "mean", "grow", "max",
+         "mean", "grow");
+  for (size_t n = 8; n < max; n *= 8) run_size(n);
+  run_size(max);
+  return 0;
+}
@@ -0,0 +1,13 @@
+; Macro-heavy code: every iteration expands user macros.
+(defmacro unless (c then else) `(if (not ,c) ,then ,else))
+(defmacro inc (x) `(+ ,x 1))
+(defmacro square (x) `(* ,x ,x))
+(defmacro between (x lo hi) `(and (<= ,lo ,x) (<= ,x ,hi)))
+
+(define classify (lambda (n)
+  (unless (between (mod n 10) 3 6)
+          (square (inc n))
+          (inc (inc n)))))
+
+(do ((i 0 (+ i 1)) (sum 0 (+ sum (classify i))))
+    ((= i 30000) sum))
@@ -0,0 +1,21 @@
+; Counts the solutions of the 8 queens problem by backtracking over lists.
+(define ok? (lambda (row dist placed)
+  (if (null? placed)
+      #t
+      (and (not (= (car placed) (+ row dist)))
+           (not (= (car placed) (- row dist)))
+           (not (= (car placed) row))
+           (ok? row (+ dist 1) (cdr placed))))))
+
+(define try-rows (lambda (row n placed)
+  (if (> row n)
+      0
+      (+ (if (ok? row 1 placed) (queens n (cons row placed)) 0)
+         (try-rows (+ row 1) n placed)))))
+
+(define queens (lambda (n placed)
+  (if (= (length placed) n)
+      1
+      (try-rows 1 n placed))))
+
+(queens 8 '())
@@ -0,0 +1,385 @@
+// Runs the Shrew workloads in bench/ and reports them as JSON, one
+// benchmark per line. Build and run with `make bench`; `make bench-compare`
+// also checks the results against a stored baseline.
+//
+//   bench-run [--shrew PATH] [--runs N] [--out FILE] [--perf-counters]
+//             [--baseline FILE] [--threshold PERCENT] script.s...
+//
+// Each script runs once to warm the caches and then N times, as a child
+// `shrew --stats script`. Wall time is the median of the N runs; peak RSS is
+// the largest seen. A benchmark regresses when its median time or peak RSS
+// is more than the threshold above the baseline's, and then the exit status
+// is 1.
+//
+// With --perf-counters the timed runs are also counted with Linux
+// perf_event_open (user space only, from exec to exit) and the averages per
+// run are reported with IPC and misses per thousand instructions. Counters
+// the machine does not have are reported as null; virtual machines often
+// expose none of the hardware ones.
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#define DEFAULT_RUNS 5
+#define DEFAULT_THRESHOLD 10.0
+#define MAX_RUNS 100
+#define STATS_PREFIX "shrew-stats:"
+
+typedef enum {
+  C_CYCLES,
+  C_INSTRUCTIONS,
+  C_BRANCH_MISSES,
+  C_L1D_MISSES,
+  C_LLC_MISSES,
+  C_DTLB_MISSES,
+  C_PAGE_FAULTS,
+  C_COUNT
+} counter_t;
+
+static const char *k_counter_names[C_COUNT] = {
+  "cycles",      "instructions", "branch_misses", "l1d_misses",
+  "llc_misses", "dtlb_misses",  "page_faults",
+};
+
+typedef struct {
+  char name[64];
+  double median_ms, min_ms, max_ms;
+  size_t collections, allocations;
+  long peak_rss_kb;
+  // Sums over the timed runs; a counter missing from any run is unavailable.
+  double counters[C_COUNT];
+  bool counted[C_COUNT];
+} result_t;
+
+static bool G_perf_counters = false;
+
+#ifdef __linux__
+static uint64_t cache_miss_config(uint64_t cache) {
+  return cache | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+}
+
+// Opens the counters on `pid`, which must not have called exec yet. They
+// start at its exec. Counters that cannot be opened are left at -1.
+static void counters_open(pid_t pid, int fds[C_COUNT]) {
+  static const struct {
+    uint32_t type;
+    uint64_t config;
+  } events[C_COUNT] = {
+    [C_CYCLES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [C_INSTRUCTIONS] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [C_BRANCH_MISSES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    [C_L1D_MISSES] = { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D },
+    [C_LLC_MISSES] = { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL },
+    [C_DTLB_MISSES] = { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB },
+    [C_PAGE_FAULTS] = { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+  };
+  for (int i = 0; i < C_COUNT; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = events[i].type;
+    attr.config = attr.type == PERF_TYPE_HW_CACHE ? cache_miss_config(events[i].config)
+                                                  : events[i].config;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // Scaled below if the kernel had to multiplex the hardware counters.
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds[i] = syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+  }
+}
+
+// Adds the counts to `r` and closes the counters.
+static void counters_close(int fds[C_COUNT], result_t *r) {
+  for (int i = 0; i < C_COUNT; i++) {
+    uint64_t value[3]; // count, time enabled, time running
+    bool ok = fds[i] >= 0 && read(fds[i], value, sizeof value) == sizeof value;
+    if (ok && value[2] > 0) {
+      r->counters[i] += (double)value[0] * value[1] / value[2];
+    } else if (!ok) {
+      r->counted[i] = false;
+    }
+    if (fds[i] >= 0) close(fds[i]);
+  }
+}
+#else
+static void counters_open(pid_t pid, int fds[C_COUNT]) {
+  (void)pid;
+  for (int i = 0; i < C_COUNT; i++) fds[i] = -1;
+}
+
+static void counters_close(int fds[C_COUNT], result_t *r) {
+  (void)fds;
+  for (int i = 0; i < C_COUNT; i++) r->counted[i] = false;
+}
+#endif
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// The script's file name without its directory and extension.
+static void bench_name(const char *path, char *out, size_t size) {
+  const char *base = strrchr(path, '/');
+  base = base ? base + 1 : path;
+  size_t len = strcspn(base, ".");
+  if (len >= size) len = size - 1;
+  memcpy(out, base, len);
+  out[len] = '\0';
+}
+
+// Runs the script once. Its output is discarded apart from the --stats line
+// on stderr, which fills in `r`, and its counters are added to `r` if
+// `count` is set. Returns false if it could not run or failed.
+static bool run_once(const char *shrew, const char *script, bool count, double *ms,
+                     result_t *r) {
+  int err[2], go[2];
+  if (pipe(err) != 0) return false;
+  if (pipe(go) != 0) {
+    close(err[0]);
+    close(err[1]);
+    return false;
+  }
+  double start = now_ms();
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(err[0]);
+    close(err[1]);
+    close(go[0]);
+    close(go[1]);
+    return false;
+  }
+  if (pid == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    dup2(err[1], STDERR_FILENO);
+    close(null);
+    close(err[0]);
+    close(err[1]);
+    // Waits for the counters to be opened.
+    char ready;
+    close(go[1]);
+    if (read(go[0], &ready, 1) != 1) _exit(127);
+    close(go[0]);
+    execl(shrew, shrew, "--stats", script, (char *)NULL);
+    _exit(127);
+  }
+  close(err[1]);
+  close(go[0]);
+  int fds[C_COUNT];
+  if (count) counters_open(pid, fds);
+  if (write(go[1], "g", 1) != 1) perror("bench-run");
+  close(go[1]);
+  FILE *in = fdopen(err[0], "r");
+  char line[512];
+  while (in && fgets(line, sizeof line, in)) {
+    if (strncmp(line, STATS_PREFIX, strlen(STATS_PREFIX)) == 0) {
+      sscanf(line + strlen(STATS_PREFIX), " collections=%zu allocations=%zu", &r->collections,
+             &r->allocations);
+    } else {
+      fputs(line, stderr);
+    }
+  }
+  if (in) fclose(in);
+  int status = 0;
+  struct rusage usage;
+  while (wait4(pid, &status, 0, &usage) < 0) {
+    if (errno != EINTR) return false;
+  }
+  *ms = now_ms() - start;
+  if (count) counters_close(fds, r);
+  if (usage.ru_maxrss > r->peak_rss_kb) r->peak_rss_kb = usage.ru_maxrss;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static bool run_bench(const char *shrew, const char *script, int runs, result_t *r) {
+  double times[MAX_RUNS];
+  double ms;
+  memset(r, 0, sizeof *r);
+  bench_name(script, r->name, sizeof r->name);
+  if (!run_once(shrew, script, false, &ms, r)) return false;
+  r->peak_rss_kb = 0;
+  for (int i = 0; i < C_COUNT; i++) r->counted[i] = true;
+  for (int i = 0; i < runs; i++) {
+    if (!run_once(shrew, script, G_perf_counters, &times[i], r)) return false;
+  }
+  for (int i = 0; i < C_COUNT; i++) r->counters[i] /= runs;
+  qsort(times, runs, sizeof times[0], compare_doubles);
+  r->min_ms = times[0];
+  r->max_ms = times[runs - 1];
+  r->median_ms = runs % 2 ? times[runs / 2] : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+  return true;
+}
+
+// The counter per thousand instructions, or null.
+static void write_mpki(FILE *out, const char *name, const result_t *r, counter_t c) {
+  if (r->counted[c] && r->counted[C_INSTRUCTIONS] && r->counters[C_INSTRUCTIONS] > 0) {
+    fprintf(out, ", \"%s\": %.3f", name, r->counters[c] * 1000 / r->counters[C_INSTRUCTIONS]);
+  } else {
+    fprintf(out, ", \"%s\": null", name);
+  }
+}
+
+static void write_counters(FILE *out, const result_t *r) {
+  fprintf(out, ", \"counters\": {");
+  for (int i = 0; i < C_COUNT; i++) {
+    if (i) fputs(", ", out);
+    if (r->counted[i]) {
+      fprintf(out, "\"%s\": %.0f", k_counter_names[i], r->counters[i]);
+    } else {
+      fprintf(out, "\"%s\": null", k_counter_names[i]);
+    }
+  }
+  fprintf(out, "}");
+  if (r->counted[C_CYCLES] && r->counted[C_INSTRUCTIONS] && r->counters[C_CYCLES] > 0) {
+    fprintf(out, ", \"ipc\": %.3f", r->counters[C_INSTRUCTIONS] / r->counters[C_CYCLES]);
+  } else {
+    fprintf(out, ", \"ipc\": null");
+  }
+  write_mpki(out, "branch_mpki", r, C_BRANCH_MISSES);
+  write_mpki(out, "l1d_mpki", r, C_L1D_MISSES);
+  write_mpki(out, "llc_mpki", r, C_LLC_MISSES);
+  write_mpki(out, "dtlb_mpki", r, C_DTLB_MISSES);
+}
+
+static void write_result(FILE *out, const result_t *r, bool first) {
+  fprintf(out,
+          "%s    {\"name\": \"%s\", \"wall_ms\": {\"median\": %.3f, \"min\": %.3f, \"max\": %.3f}, "
+          "\"gc_collections\": %zu, \"allocations\": %zu, \"peak_rss_kb\": %ld",
+          first ? "" : ",\n", r->name, r->median_ms, r->min_ms, r->max_ms, r->collections,
+          r->allocations, r->peak_rss_kb);
+  if (G_perf_counters) write_counters(out, r);
+  fprintf(out, "}");
+}
+
+// Finds the benchmark called `name` in a file written by write_result.
+static bool read_baseline(const char *path, const char *name, result_t *r) {
+  FILE *in = fopen(path, "r");
+  if (!in) return false;
+  char key[96];
+  snprintf(key, sizeof key, "{\"name\": \"%s\",", name);
+  char line[2048];
+  bool found = false;
+  while (!found && fgets(line, sizeof line, in)) {
+    const char *p = strstr(line, key);
+    const char *median = p ? strstr(p, "\"median\": ") : NULL;
+    const char *rss = p ? strstr(p, "\"peak_rss_kb\": ") : NULL;
+    if (!median || !rss) continue;
+    found = sscanf(median, "\"median\": %lf", &r->median_ms) == 1 &&
+            sscanf(rss, "\"peak_rss_kb\": %ld", &r->peak_rss_kb) == 1;
+  }
+  fclose(in);
+  return found;
+}
+
+// Prints how `now` compares with the baseline and returns whether it
+// regressed.
+static bool compare(const char *baseline, const result_t *now, double threshold) {
+  result_t base;
+  if (!read_baseline(baseline, now->name, &base)) {
+    fprintf(stderr, "%-10s not in %s\n", now->name, baseline);
+    return false;
+  }
+  double time_change = (now->median_ms / base.median_ms - 1) * 100;
+  double rss_change =
+    base.peak_rss_kb ? ((double)now->peak_rss_kb / base.peak_rss_kb - 1) * 100 : 0;
+  bool regressed = time_change > threshold || rss_change > threshold;
+  fprintf(stderr, "%-10s %9.1f ms %+7.1f%%  %8ld KB %+7.1f%%%s\n", now->name, now->median_ms,
+          time_change, now->peak_rss_kb, rss_change, regressed ? "  REGRESSION" : "");
+  return regressed;
+}
+
+static void usage(const char *progname) {
+  fprintf(stderr,
+          "Usage: %s [--shrew PATH] [--runs N] [--out FILE] [--perf-counters]\n"
+          "          [--baseline FILE] [--threshold PERCENT] script.s...\n",
+          progname);
+}
+
+int main(int argc, char *argv[]) {
+  const char *shrew = "bin/shrew";
+  const char *out_path = NULL;
+  const char *baseline = NULL;
+  double threshold = DEFAULT_THRESHOLD;
+  int runs = DEFAULT_RUNS;
+  int first = 1;
+  while (first < argc && strncmp(argv[first], "--", 2) == 0) {
+    const char *opt = argv[first++];
+    if (strcmp(opt, "--perf-counters") == 0) {
+      G_perf_counters = true;
+      continue;
+    }
+    const char *value = first < argc ? argv[first++] : NULL;
+    if (!value) {
+      usage(argv[0]);
+      return 2;
+    } else if (strcmp(opt, "--shrew") == 0) {
+      shrew = value;
+    } else if (strcmp(opt, "--runs") == 0) {
+      runs = atoi(value);
+    } else if (strcmp(opt, "--out") == 0) {
+      out_path = value;
+    } else if (strcmp(opt, "--baseline") == 0) {
+      baseline = value;
+    } else if (strcmp(opt, "--threshold") == 0) {
+      threshold = atof(value);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (first == argc || runs < 1 || runs > MAX_RUNS) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (!out) {
+    perror(out_path);
+    return 2;
+  }
+  fprintf(out, "{\n  \"runs\": %d,\n  \"benchmarks\": [\n", runs);
+  bool failed = false, regressed = false, warned = false;
+  size_t written = 0;
+  for (int i = first; i < argc; i++) {
+    result_t r;
+    if (!run_bench(shrew, argv[i], runs, &r)) {
+      fprintf(stderr, "%s: failed to run\n", argv[i]);
+      failed = true;
+      continue;
+    }
+    if (G_perf_counters && !r.counted[C_INSTRUCTIONS] && !warned) {
+      fprintf(stderr, "bench-run: hardware counters are not available "
+                      "(see /proc/sys/kernel/perf_event_paranoid)\n");
+      warned = true;
+    }
+    write_result(out, &r, written++ == 0);
+    fflush(out);
+    if (baseline) regressed |= compare(baseline, &r, threshold);
+  }
+  fprintf(out, "\n  ]\n}\n");
+  if (out != stdout) fclose(out);
+  if (failed) return 2;
+  return regressed ? 1 : 0;
+}
@@ -0,0 +1,32 @@
+; Merge sort of a pseudo-random list: cons-heavy list building.
+(define next-random (lambda (x) (mod (+ (* x 1103515245) 12345) 2147483648)))
+
+(define random-list (lambda (n seed)
+  (do ((i 0 (+ i 1)) (x seed (next-random x)) (acc '() (cons (mod x 100000) acc)))
+      ((= i n) acc))))
+
+(define take-half (lambda (xs n)
+  (if (= n 0) '() (cons (car xs) (take-half (cdr xs) (- n 1))))))
+
+(define drop (lambda (xs n)
+  (if (= n 0) xs (drop (cdr xs) (- n 1)))))
+
+(define merge (lambda (a b)
+  (cond ((null? a) b
+         (null? b) a
+         (< (car a) (car b)) (cons (car a) (merge (cdr a) b))
+         #t (cons (car b) (merge a (cdr b)))))))
+
+(define sort (lambda (xs)
+  (let ((n (length xs)))
+    (if (< n 2)
+        xs
+        (let ((half (floor (/ n 2))))
+          (merge (sort (take-half xs half)) (sort (drop xs half))))))))
+
+(define sorted? (lambda (xs)
+  (or (null? xs) (null? (cdr xs))
+      (and (<= (car xs) (car (cdr xs))) (sorted? (cdr xs))))))
+
+(do ((round 0 (+ round 1)) (ok #t (and ok (sorted? (sort (random-list 300 round))))))
+    ((= round 10) ok))
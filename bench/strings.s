@@ -0,0 +1,13 @@
+; String building: appends, number formatting and parsing.
+(define build (lambda (n)
+  (do ((i 0 (+ i 1))
+       (s "" (string-append s (number->string (mod i 10)))))
+      ((= i n) s))))
+
+(define checksum (lambda (rounds)
+  (do ((r 0 (+ r 1))
+       (total 0 (+ total (string-length (build 400))
+                   (string->number (number->string r)))))
+      ((= r rounds) total))))
+
+(checksum 300)
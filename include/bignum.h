@@ -0,0 +1,38 @@
+#ifndef BIGNUM_H
+#define BIGNUM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Arbitrary-precision integers in sign-magnitude form. The magnitude is an
+// array of base 2^32 limbs, least significant first, with no leading zero
+// limbs; zero has len 0 and is never negative. Bignums are immutable: every
+// operation returns a new heap value that the caller frees with bignum_free.
+typedef struct bignum {
+  bool negative;
+  size_t len;
+  uint32_t limbs[];
+} bignum_t;
+
+bignum_t *bignum_from_i64(int64_t v);
+// Parses an optionally signed run of decimal digits; NULL if `s` is not one.
+bignum_t *bignum_from_string(const char *s);
+bignum_t *bignum_copy(const bignum_t *b);
+void bignum_free(bignum_t *b);
+
+bignum_t *bignum_add(const bignum_t *a, const bignum_t *b);
+bignum_t *bignum_sub(const bignum_t *a, const bignum_t *b);
+bignum_t *bignum_mul(const bignum_t *a, const bignum_t *b);
+// Remainder of truncating division; it takes the sign of `a`. `b` must not
+// be zero.
+bignum_t *bignum_mod(const bignum_t *a, const bignum_t *b);
+bignum_t *bignum_abs(const bignum_t *b);
+
+int bignum_cmp(const bignum_t *a, const bignum_t *b);
+bool bignum_to_i64(const bignum_t *b, int64_t *out);
+double bignum_to_double(const bignum_t *b);
+// Returns a malloc'd decimal string.
+char *bignum_to_string(const bignum_t *b);
+
+#endif
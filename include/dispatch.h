@@ -0,0 +1,42 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "env.h"
+#include "evaluator.h"
+#include "parser.h"
+
+// The case form:
+//
+//   (case key
+//     ((datum...) expr...)
+//     ...
+//     (else expr...))
+//
+// evaluates `key` and then the expressions of the first clause listing a
+// datum eqv to it, or of the else clause, returning the last one's value
+// (nil when no clause matches). Datums are symbols, integers, doubles and
+// booleans, compared as eqv does: symbols by identity, numbers of the same
+// exactness by value, and never an integer against a double.
+//
+// fold.c replaces each well-formed case form with a dispatch table built
+// from its datums: a jump table indexed by the key when the datums are
+// integers in a small range, and a hash table otherwise. Forms the pass has
+// not seen are dispatched by scanning the clauses in order.
+typedef struct dispatch dispatch_t;
+
+// Builds the table of the case form `list`, or returns NULL if the form is
+// malformed. The table borrows the form, which must outlive it.
+dispatch_t *dispatch_compile(s_expression_t *list);
+void dispatch_free(dispatch_t *table);
+
+// Evaluates the case form `list` through `table`, which must be `list`'s own
+// table or NULL to scan the clauses.
+eval_result_t case_eval(s_expression_t *list, const dispatch_t *table, env_t *env);
+// Evaluates the key of `list` like case_eval and points `body` at the
+// `count` expressions of the clause it selects, leaving `count` 0 when no
+// clause matches. The result is what case_eval returns when `count` is 0.
+eval_result_t case_select(s_expression_t *list, const dispatch_t *table, env_t *env,
+                          s_expression_t ***body, size_t *count);
+eval_result_t dispatch_eval(const dispatch_t *table, env_t *env);
+
+#endif
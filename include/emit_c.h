@@ -0,0 +1,23 @@
+#ifndef EMIT_C_H
+#define EMIT_C_H
+
+#include "parser.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Ahead-of-time compiler. Writes a C translation unit with a main() for the
+// program `forms` to `out`. Linked against the interpreter objects (all but
+// main.o) it runs the program without lexing or parsing anything at startup.
+//
+// A top-level `(define f (lambda ...))` whose name the program never
+// defines again, `set`s or uses for a macro becomes a C function, and calls
+// to it with the right number of arguments are direct C calls. Calls to
+// builtins whose names the program never rebinds go straight to the
+// builtin. Programs that use `eval` or `load` look every callee up at run
+// time instead. Forms the compiler does not handle (lambdas in bodies,
+// macros, quasiquote, ...) are rebuilt as syntax trees at startup and
+// interpreted.
+bool emit_c_program(s_expression_t **forms, size_t count, FILE *out);
+
+#endif
@@ -10,6 +10,8 @@ typedef struct env {
   hashtable *store;   
   size_t refcount;
   bool managed;
+  size_t gc_epoch;
+  struct env *root; // outermost ancestor, the environment itself for roots
 } env_t;
 
 typedef void (*env_mark_fn)(lval_t *v);
@@ -23,6 +25,29 @@ bool env_define(env_t *env, const char *key, lval_t *value);
 bool env_set(env_t *env, const char *key, lval_t *value);
 lval_t *env_get(env_t *env, const char *key);
 lval_t *env_get_ref(env_t *env, const char *key);
+
+// Same as above, but `sym` must already be interned (see symbol.h); these
+// reuse the symbol's cached hash instead of hashing the name again.
+bool env_define_symbol(env_t *env, const char *sym, lval_t *value);
+bool env_set_symbol(env_t *env, const char *sym, lval_t *value);
+lval_t *env_get_symbol(env_t *env, const char *sym);
+
+// The first root environment created keeps its bindings in the symbols'
+// global value cells instead of its hashtable, until it is destroyed.
+bool env_is_global(const env_t *env);
+
+// Bumped whenever a root environment gains, changes or loses a binding.
+size_t env_global_version(void);
+// Bumped whenever a name that has a builtin or that folds rely on
+// (symbol_t.folded) is rebound in a root environment, or such a name or one
+// an inlined body reads (symbol_t.inline_read) is bound in a call frame for
+// the first time. Folds made under an older version are redone
+// (see fold.h).
+size_t env_fold_version(void);
+// env_get_symbol for a call site. Globals that no frame can shadow are
+// remembered in `cache` and reused until env_global_version() moves.
+lval_t *env_get_cached(env_t *env, const char *sym, call_cache_t *cache);
+void env_gc_begin(void);
 void env_gc_mark_all(env_t *env, env_mark_fn mark_fn);
 
 #endif
@@ -9,16 +9,48 @@ typedef enum {
   EVAL_ERR = 1,
 } eval_status_t;
 
+// What an error is about. Errors are made without formatting any text:
+// eval_error_message builds it when it is first asked for.
+typedef enum {
+  EVAL_ERR_MESSAGE, // error_message is the text
+  EVAL_ERR_TYPE,    // an argument of the wrong type: `result`
+  EVAL_ERR_VALUE,   // an argument with a bad value: `result`
+  EVAL_ERR_UNBOUND, // error_message is the unbound (interned) name
+  EVAL_ERR_USER,    // raised by (error x): `result` is x
+  EVAL_ERR_ARITY,   // the wrong number of arguments: error_arg of them, see eval_err_arity
+} eval_error_code_t;
+
 typedef struct {
   eval_status_t status; 
+  unsigned char error_code; // eval_error_code_t
+  bool error_owned;         // error_message was allocated for this error
+  // The 1-based argument a type error is about (0 if not known), or the
+  // number of arguments an arity error got.
+  unsigned short error_arg;
+  // The value, or the value an error is about (NULL if none). An error's
+  // value is only kept alive until the next collection.
   lval_t *result; 
+  // Text of an EVAL_ERR_MESSAGE error, or the static part of other errors.
+  // Use eval_error_message for the full text.
   char *error_message; 
 } eval_result_t;
 
 
 
 eval_result_t eval_ok(lval_t *result);
+// Formats only if `fmt` has conversions; constant messages are not copied.
 eval_result_t eval_errf(const char *fmt, ...);
+// An error about `value`; `what` must be static (or interned for
+// EVAL_ERR_UNBOUND).
+eval_result_t eval_err(eval_error_code_t code, const char *what, lval_t *value);
+// Like eval_err, about the `arg`th (1-based) argument of a call.
+eval_result_t eval_err_at(eval_error_code_t code, const char *what, size_t arg, lval_t *value);
+// A call with `argc` arguments to `fn`, a function with a different number
+// of parameters, or to a builtin when `fn` is NULL and `what` says what it
+// expected.
+eval_result_t eval_err_arity(const char *what, size_t argc, lval_t *fn);
+// The text of the error `r`, formatted on first use and owned by `r`.
+const char *eval_error_message(eval_result_t *r);
 eval_result_t evaluate_single(s_expression_t *expr, env_t *env);
 eval_result_t evaluate_many(s_expression_t **exprs, size_t count, env_t *env);
 eval_result_t evaluate_call(lval_t *fn, size_t argc, lval_t **argv, env_t *env);
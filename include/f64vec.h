@@ -0,0 +1,33 @@
+#ifndef F64VEC_H
+#define F64VEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Kernels over packed arrays of doubles, behind the f64vector builtins.
+// Each has AVX2, SSE2 and scalar versions, and the widest one the CPU
+// supports is picked on first use. The reductions keep 16 interleaved
+// partial results whatever the version, and combine them in the same order,
+// so their results do not depend on the CPU. They do differ in the last bits
+// from a left fold.
+
+// Allocates room for `n` doubles, aligned for the widest loads, or returns
+// NULL if `n` is zero or that much cannot be allocated. Free with free().
+double *f64_alloc(size_t n);
+
+void f64_add(double *out, const double *a, const double *b, size_t n);
+void f64_mul(double *out, const double *a, const double *b, size_t n);
+void f64_scale(double *out, const double *a, double k, size_t n);
+void f64_fill(double *out, double x, size_t n);
+double f64_sum(const double *a, size_t n);
+double f64_dot(const double *a, const double *b, size_t n);
+// `n` must not be zero. A NaN is skipped, unless it is the first element.
+double f64_min(const double *a, size_t n);
+double f64_max(const double *a, size_t n);
+
+// The kernels in use: "avx2", "sse2" or "scalar".
+const char *f64_kernels(void);
+// Switches to the named kernels, if this CPU can run them. For tests.
+bool f64_use_kernels(const char *name);
+
+#endif
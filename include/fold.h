@@ -0,0 +1,59 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "env.h"
+#include "parser.h"
+
+// Constant folding and dead-branch pruning. The pass runs over a lambda's
+// body when the lambda is evaluated and over each top-level form before it
+// runs. It never changes the tree itself: a list node that folds gets a
+// replacement in `data.list.fold`, which evaluate_single evaluates instead.
+//
+//   (* 60 60 24)            -> 86400
+//   (string-append "a" "b") -> "ab"
+//   (if (< 1 2) x y)        -> x
+//   (cond (#f a (= 1 1) b)) -> b
+//   (and (= 1 1) #f x)      -> #f
+//
+// Only calls to pure builtins (arithmetic, comparisons, `not` and a few
+// string and number conversions) whose arguments are all
+// constants are folded, and only while the name is still bound to the
+// builtin and has never been bound in a call frame.
+//
+// Calls to small, non-recursive lambdas defined at top level are inlined:
+// the replacement holds the call's arguments followed by a copy of the
+// lambda's body whose parameter references are ATOM_ARGUMENT atoms. The
+// evaluator runs it without creating a call frame. Bodies that bind or
+// capture anything (define, set, lambda, quasiquote, macros) are not
+// inlined, and neither are bodies that use a name some call frame has
+// bound. Nothing is inlined while the JIT is enabled. The callee and the
+// heads of the body's calls are marked symbol_t.folded, and the variables it
+// reads symbol_t.inline_read.
+//
+// Other calls to arithmetic builtins and comparisons become unboxed
+// regions (see unbox.h), and case forms become dispatch tables (see
+// dispatch.h).
+//
+// A fold is valid for one env_fold_version(). Rebinding a builtin or a
+// folded name invalidates every fold, and nodes are folded again the next
+// time they are evaluated.
+void fold_expression(s_expression_t *expr, env_t *env);
+
+// Frees the replacement the pass allocated for `list`, if any.
+void fold_release(s_expression_t *list);
+
+// Bracket the evaluation of an inlined call or an unboxed region, so that
+// replacements released meanwhile outlive it.
+void fold_hold(void);
+void fold_unhold(void);
+
+// The expression to evaluate in place of `list`, or NULL. Refolds the node
+// if the folds it was given have gone stale.
+static inline s_expression_t *fold_replacement(s_expression_t *list, env_t *env) {
+  fold_info_t *f = &list->data.list.fold;
+  if (!f->version) return NULL;
+  if (f->version != env_fold_version()) fold_expression(list, env);
+  return f->expr;
+}
+
+#endif
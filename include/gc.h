@@ -11,12 +11,25 @@ void gc_init(struct env *global_env);
 void gc_set_global_env(struct env *global_env);
 struct lval *gc_alloc_lval();
 void gc_collect(struct lval *extra_root);
-void gc_maybe_collect(void);
+void gc_maybe_collect(struct lval *extra_root);
 void gc_reset(void);
 
 void gc_root(struct lval **slot);
 void gc_unroot(struct lval **slot);
+// Evaluation value stack. Every slot is a GC root. The stack is made of
+// fixed segments that never move, so the base returned by gc_stack_reserve
+// stays valid until the matching gc_stack_pop. Reservations are LIFO.
+struct lval **gc_stack_reserve(size_t n);
+void gc_stack_pop(size_t n);
+
+// Environments of active calls, marked as roots while they run.
+void gc_push_frame(struct env *env);
+void gc_pop_frame(void);
+
 size_t gc_object_count(void);
+// Collections run and objects allocated since gc_init.
+size_t gc_collection_count(void);
+size_t gc_allocation_count(void);
 void gc_set_trigger(size_t threshold);
 
 #endif
@@ -28,7 +28,7 @@ typedef struct {
   ht_entry *entries;
   size_t capacity;
   size_t size;
-  size_t tombstones;
+  size_t resizes; // since ht_init
 } hashtable;
 
 typedef struct {
@@ -65,10 +65,37 @@ bool ht_erase(hashtable *table,
 #endif
   void **out_old_value);
 
+#if HT_STRING_KEYS
+// Variants for callers that cache the key hash (e.g. interned symbols).
+// `hash` must be ht_hash_key(key).
+uint64_t ht_hash_key(const char *key);
+bool ht_set_hashed(hashtable *table, const char *key, uint64_t hash, void *value, ht_error *err);
+bool ht_get_hashed(const hashtable *table, const char *key, uint64_t hash, void **out_value);
+#ifndef HT_DUP_KEYS
+// ht_erase that also returns the key the table held, for callers that own
+// their keys and must free them.
+bool ht_remove(hashtable *table, const char *key, const char **out_key, void **out_old_value);
+#endif
+#endif
+
 // Introspection
 static inline size_t ht_count(const hashtable *t) { return t->size; }
 static inline size_t ht_capacity(const hashtable *t) { return t->capacity; }
 
+// Probe statistics. The DIB of an entry is its distance from its home
+// slot plus one, i.e. the probes a successful lookup takes.
+typedef struct {
+  size_t size;
+  size_t capacity;
+  size_t resizes;
+  uint32_t max_dib;
+  double mean_dib;    // over live entries, 0 when empty
+  double load_factor; // live entries / capacity
+} ht_probe_stats;
+
+// Walks the whole table, so it costs O(capacity).
+void ht_stats(const hashtable *table, ht_probe_stats *out);
+
 // Iteration
 typedef struct {
     const hashtable *table;
@@ -0,0 +1,30 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "lval.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Interpreted calls a function receives before the JIT tries to compile it.
+#define JIT_HOT_CALLS 16
+
+// Template JIT for small numeric functions (Linux x86-64 only). A function
+// is compiled when its body only uses its parameters, number and boolean
+// literals, `if`, the arithmetic, comparison and boolean builtins, and calls
+// to itself or other compiled functions. The code is specialized on the
+// integer/double types of its arguments; calls with other argument types,
+// and everything else, keep running in the interpreter.
+bool jit_available(void);
+void jit_set_enabled(bool enabled);
+bool jit_enabled(void);
+
+// Runs `fn` natively if it is compiled (compiling it once it is hot) and
+// stores the result in `out`. Returns false when the call must be
+// interpreted instead; the native code has no side effects, so a call that
+// bails out part way can simply be evaluated again.
+bool jit_try_call(lval_t *fn, size_t argc, lval_t **argv, lval_t **out);
+
+size_t jit_compiled_count(void);
+void jit_reset(void);
+
+#endif
@@ -3,17 +3,27 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <parser.h>
+#include "hashtable.h"
 
 typedef enum {
   L_NIL,
   L_BOOL,
   L_NUM,
+  L_INT,
+  L_BIGNUM,
   L_STRING,
   L_SYMBOL,
   L_CONS,
   L_FUNCTION,
-  L_NATIVE
+  L_NATIVE,
+  L_PROMISE,
+  L_ERROR,
+  L_VECTOR,
+  L_HASHTABLE,
+  L_F64VECTOR
 } ltype_t;
 
 typedef struct lval {
@@ -22,38 +32,107 @@ typedef struct lval {
   struct lval *gc_next;
   union {
     double number;
+    int64_t integer;
+    struct bignum *bignum; // owned; never fits in an int64
     bool boolean;
     struct { char *ptr; size_t len; } string;
     struct { const char *name; } symbol;
     struct { struct lval *car; struct lval *cdr; } cons;
     struct {
-      char **params;
+      char **params; // interned symbol names; only the array is owned
       size_t param_count;
       s_expression_t **body;
       size_t body_count;
       struct env *closure;
       bool is_macro;
+      const char *name;     // interned name it was first defined as, NULL if anonymous
+      size_t line;          // source line of its lambda, 0 if unknown
+      unsigned calls;       // interpreted calls, counted by jit.c
+      struct jit_code *jit; // native code, NULL until compiled
     } function;
     struct {
       void *fn; 
       const char *name;
     } native;
+    // A memoized delayed computation: `expr` in `env`, or the builtin `fn`
+    // applied to `args` (for the stream builtins). Both are dropped once
+    // `value` is set.
+    struct {
+      s_expression_t *expr; // borrowed from the tree, like function bodies
+      struct env *env;
+      void *fn;
+      struct lval *args[2];
+      struct lval *value; // NULL until forced
+    } promise;
+    // An error caught by try, with the fields of its eval_result_t.
+    struct {
+      unsigned char code; // eval_error_code_t
+      bool owned;         // `message` is allocated
+      unsigned short arg; // error_arg
+      char *message;
+      struct lval *value;
+    } error;
+    // A fixed-size array of values. Vectors are mutable, so unlike lists
+    // they are shared by lval_copy rather than copied.
+    struct {
+      struct lval **items; // owned, NULL when empty
+      size_t count;
+    } vector;
+    // A mutable table mapping keys to values, shared by lval_copy like
+    // vectors. Each entry's value is the pair (key . value), and its key an
+    // encoding of the Shrew key made by builtin.c: the interned name of a
+    // symbol, or an owned string starting with LVAL_HASH_OWNED_KEY.
+    struct {
+      hashtable *table; // owned
+      bool equal;       // keys match by equal rather than eq
+    } hash;
+    // A fixed-size, mutable array of unboxed doubles, shared by lval_copy
+    // like vectors. The f64vector builtins run the kernels of f64vec.h on it.
+    struct {
+      double *items; // owned, from f64_alloc; NULL when empty
+      size_t count;
+    } f64vector;
   } as;
 } lval_t;
 
 typedef struct { struct lval *car; struct lval *cdr; } lval_cons_t;
 
 lval_t *lval_num(double x);
+lval_t *lval_int(int64_t x);
+// Takes ownership of `b`, returning an L_INT instead when the value fits.
+lval_t *lval_bignum(struct bignum *b);
 lval_t *lval_bool(bool b);
 lval_t *lval_string_copy(const char *s, size_t len);
 lval_t *lval_intern(const char *name);
+lval_t *lval_symbol(const char *interned);
 lval_t *lval_nil(void);
 lval_t *lval_cons(lval_t *car, lval_t *cdr);
 lval_t *lval_function(char **params, size_t param_count, s_expression_t **body, size_t body_count, struct env *closure, bool is_macro);
 lval_t *lval_native(void *fn, const char *name);
+lval_t *lval_promise(s_expression_t *expr, struct env *env);
+lval_t *lval_promise_call(void *fn, lval_t *arg0, lval_t *arg1);
+// Takes ownership of `message` if `owned` is set.
+lval_t *lval_error(unsigned char code, bool owned, unsigned short arg, char *message,
+                   lval_t *value);
+// A vector of `count` slots, each set to `fill`, or NULL if they cannot be
+// allocated.
+lval_t *lval_vector(size_t count, lval_t *fill);
+#define LVAL_HASH_OWNED_KEY '\x01'
+lval_t *lval_hash_table(bool equal);
+// Frees the table and the keys it owns, but not the pairs.
+void lval_hash_table_free(hashtable *table);
+// An f64vector of `count` uninitialized elements, or NULL if they cannot be
+// allocated.
+lval_t *lval_f64vector(size_t count);
 
 const char *lval_type_name(const lval_t *v);
+// Numbers are exact integers (L_INT, or L_BIGNUM beyond int64) or doubles
+// (L_NUM).
+bool lval_is_number(const lval_t *v);
+bool lval_is_integer(const lval_t *v);
+double lval_to_double(const lval_t *v);
 void lval_print(const lval_t *v);
+void lval_fprint(FILE *f, const lval_t *v);
 void lval_free(lval_t *v);
 lval_t *lval_copy(const lval_t *v);
 
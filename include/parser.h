@@ -2,26 +2,53 @@
 #define PARSER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "token.h"
 #include "lexer.h"
 
 typedef enum {
   ATOM_SYMBOL,
   ATOM_NUMBER,
+  ATOM_INTEGER,
+  ATOM_BIGNUM,
   ATOM_STRING,
   ATOM_BOOLEAN, 
+  ATOM_ARGUMENT, // parameter reference in a body inlined by fold.c, never parsed
+  ATOM_UNBOXED,  // numeric region made by fold.c (see unbox.h), never parsed
+  ATOM_DISPATCH, // case table made by fold.c (see dispatch.h), never parsed
 } atom_type_t;
 
 typedef struct atom {
   atom_type_t type;
   union {
-    char *symbol;   
+    const char *symbol;
     double number;  
+    int64_t integer;
+    struct bignum *bignum; // owned by the node
     char *string;   
     bool boolean;   
+    size_t argument; // index into the arguments of the inlined call
+    struct unboxed *unboxed; // owned by the node
+    struct dispatch *dispatch; // owned by the node
   } value;
 } atom_t;
 
+// Lookup cache attached to each list node, used by the evaluator when the
+// node is a call site (see env_get_cached).
+typedef struct call_cache {
+  const void *root; // root environment the binding was found in
+  void *value;      // cached callee
+  size_t version;   // env_global_version() when the entry was filled
+} call_cache_t;
+
+// Constant folding state of a list node (see fold.h).
+typedef struct fold_info {
+  struct s_expression *expr; // evaluated in place of the node, NULL to evaluate it as is
+  size_t version;            // env_fold_version() when folded, 0 if never folded
+  bool owned;                // `expr` was allocated by the pass, not borrowed from the node
+  bool inlined;              // `expr` is an inlined call (see fold.h)
+} fold_info_t;
+
 typedef enum {
   NODE_ATOM,
   NODE_LIST,
@@ -35,6 +62,9 @@ typedef struct s_expression {
       struct s_expression **elements;
       size_t count;
       struct s_expression *tail;
+      size_t line; // source line of the opening parenthesis, 0 if not parsed
+      call_cache_t cache;
+      fold_info_t fold;
     } list;
   } data;
 } s_expression_t; 
@@ -0,0 +1,83 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "lval.h"
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Samples per second of CPU time asked of the timer.
+#define PROFILE_HZ 1000
+// Frames kept per sample. Time spent deeper is counted against the deepest
+// frame kept.
+#define PROFILE_MAX_DEPTH 512
+
+// Profilers behind --profile and --profile-alloc. While either runs,
+// evaluate_call keeps a stack of the Shrew functions being called and
+// evaluate_single records the innermost call it is making. Functions are
+// named after the first define that bound them and located by the line of
+// their lambda. fold.c does not inline calls while they run. Calls that
+// never reach evaluate_call are counted in their caller: named let loops
+// and calls made by JIT-compiled code.
+typedef struct {
+  const char *name; // interned, NULL for an anonymous function
+  size_t line;
+} profile_frame_t;
+
+// A call made by the innermost function: the name of the callee (a builtin
+// or a function) and the line of the call. Unset until it makes one.
+typedef struct {
+  const char *callee;
+  size_t line;
+} profile_call_t;
+
+extern bool profile_active; // calls are being tracked
+extern profile_frame_t profile_stack[PROFILE_MAX_DEPTH];
+extern volatile sig_atomic_t profile_depth;
+extern profile_call_t profile_call;
+// Set by the timer when the sample buffer needs to be drained.
+extern volatile sig_atomic_t profile_pending;
+
+// CPU profiler: a SIGPROF timer copies the call stack into a buffer
+// PROFILE_HZ times per second. `source` names the script in the reports.
+bool profile_start(const char *source);
+// Stops sampling and writes the samples to `folded`, one "f;g;h count" line
+// per distinct stack (the input of flamegraph.pl and similar tools), and a
+// table of the `top` functions with the most self time to `report`. Either
+// may be NULL.
+void profile_stop(FILE *folded, FILE *report, size_t top);
+// Counts the buffered samples, making room for more.
+void profile_drain(void);
+
+// Allocation profiler: every `every`th object made by gc_alloc_lval is
+// attributed to the innermost call and function. Its type and size, and
+// whether it survived, are read at the next collection.
+extern bool profile_alloc_active;
+extern size_t profile_alloc_countdown;
+bool profile_alloc_start(const char *source, size_t every);
+// Writes the `top` allocation sites and the totals by type to `report`,
+// which may be NULL.
+void profile_alloc_stop(FILE *report, size_t top);
+void profile_alloc_sample(lval_t *v);
+// Called by the collector between marking and sweeping.
+void profile_alloc_collect(void);
+
+static inline void profile_enter(const lval_t *fn) {
+  sig_atomic_t depth = profile_depth;
+  if (depth < PROFILE_MAX_DEPTH) {
+    profile_stack[depth].name = fn->as.function.name;
+    profile_stack[depth].line = fn->as.function.line;
+  }
+  // The timer must not see the new depth before the frame.
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+  profile_depth = depth + 1;
+  profile_call = (profile_call_t){ NULL, 0 };
+  if (profile_pending) profile_drain();
+}
+
+static inline void profile_leave(void) {
+  profile_depth = profile_depth - 1;
+}
+
+#endif
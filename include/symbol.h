@@ -1,8 +1,38 @@
 #ifndef SYMBOL_H
 #define SYMBOL_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct lval;
+
+// An interned symbol. The name returned by symbol_intern points at the
+// trailing name buffer, so any interned name can be mapped back to its
+// symbol in O(1) with symbol_of.
+typedef struct symbol {
+  uint64_t hash; // ht_hash_key(name), reused by every table keyed on the symbol
+  size_t id;     // dense, assigned in interning order starting at 0
+  void *special; // special form handler, set by special.c
+  void *builtin; // builtin function, set by builtin.c
+  bool local;    // ever bound in a non-root environment (see env.c)
+  bool folded;   // an inlined call relies on its global binding (see fold.h)
+  bool inline_read; // read by an inlined body (see fold.h)
+  struct lval *global; // value cell in the global environment, NULL if unbound
+  char name[];
+} symbol_t;
+
 void symbol_intern_init(void);
 const char *symbol_intern(const char *name);
 void symbol_intern_free_all(void);
+size_t symbol_table_generation(void);
+// Interned symbols by id, for walking every symbol (e.g. the global cells).
+size_t symbol_count(void);
+symbol_t *symbol_at(size_t id);
+
+// Only valid for names returned by symbol_intern.
+static inline symbol_t *symbol_of(const char *interned) {
+  return (symbol_t *)(interned - offsetof(symbol_t, name));
+}
 
 #endif
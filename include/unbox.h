@@ -0,0 +1,33 @@
+#ifndef UNBOX_H
+#define UNBOX_H
+
+#include "env.h"
+#include "evaluator.h"
+#include "parser.h"
+
+// Unboxed evaluation of numeric expressions. A call to `+`, `-`, `*` or `/`
+// always yields a number (or fails), so a tree of such calls, optionally
+// under a comparison, is a region whose intermediate results the pass
+// proves numeric:
+//
+//   (< (+ (* x x) (* y y)) 4)
+//
+// The region is evaluated on raw int64 and double values and only its
+// result is boxed; the operands it cannot see into (variables and any other
+// expression) are read once and unboxed. Operands that turn out not to be
+// int or double, and int64 overflow, hand the operation to the builtin
+// itself, so results and errors are exactly those of the boxed calls.
+// Regions that evaluate other expressions are only made when they save
+// boxing at least one intermediate result.
+//
+// Regions are made by fold.c as the replacement of the call at their root
+// and share the validity of its folds: the operators must be bound to their
+// builtins and never bound in a call frame.
+typedef struct unboxed unboxed_t;
+
+// Compiles the region rooted at `call`, or returns NULL if it has none.
+unboxed_t *unbox_compile(const s_expression_t *call, env_t *env);
+eval_result_t unbox_eval(const unboxed_t *code, env_t *env);
+void unbox_free(unboxed_t *code);
+
+#endif
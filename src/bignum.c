@@ -0,0 +1,386 @@
+#include "bignum.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Operands shorter than this many limbs are multiplied by the schoolbook
+// method; below it Karatsuba's extra additions cost more than they save.
+#define KARATSUBA_THRESHOLD 32
+
+// Largest power of ten that fits in a limb, used to convert nine decimal
+// digits at a time.
+#define DECIMAL_BASE 1000000000u
+#define DECIMAL_DIGITS 9
+
+static void *xmalloc(size_t size) {
+  void *p = malloc(size ? size : 1);
+  if (!p) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+static uint32_t *limbs_alloc(size_t n) {
+  return xmalloc(n * sizeof(uint32_t));
+}
+
+static bignum_t *bignum_alloc(size_t len) {
+  bignum_t *b = xmalloc(sizeof *b + (len ? len : 1) * sizeof(uint32_t));
+  b->negative = false;
+  b->len = len;
+  return b;
+}
+
+static size_t mag_len(const uint32_t *a, size_t n) {
+  while (n && a[n - 1] == 0)
+    n--;
+  return n;
+}
+
+static bignum_t *bignum_trim(bignum_t *b) {
+  b->len = mag_len(b->limbs, b->len);
+  if (!b->len) b->negative = false;
+  return b;
+}
+
+static int mag_cmp(const uint32_t *a, size_t an, const uint32_t *b, size_t bn) {
+  if (an != bn) return an < bn ? -1 : 1;
+  for (size_t i = an; i-- > 0;) {
+    if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+  }
+  return 0;
+}
+
+// out[0, an] = a + b, for an >= bn.
+static void mag_add(const uint32_t *a, size_t an, const uint32_t *b, size_t bn, uint32_t *out) {
+  uint64_t carry = 0;
+  for (size_t i = 0; i < an; i++) {
+    carry += (uint64_t)a[i] + (i < bn ? b[i] : 0);
+    out[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  out[an] = (uint32_t)carry;
+}
+
+// out[0, an) = a - b, for a >= b and an >= bn. `out` may alias `a`.
+static void mag_sub(const uint32_t *a, size_t an, const uint32_t *b, size_t bn, uint32_t *out) {
+  int64_t borrow = 0;
+  for (size_t i = 0; i < an; i++) {
+    int64_t d = (int64_t)a[i] - (i < bn ? b[i] : 0) - borrow;
+    borrow = d < 0;
+    out[i] = (uint32_t)d;
+  }
+}
+
+// dst[0, dn) += src[0, sn), for a sum that fits in dn limbs.
+static void mag_add_into(uint32_t *dst, size_t dn, const uint32_t *src, size_t sn) {
+  uint64_t carry = 0;
+  size_t i = 0;
+  for (; i < sn; i++) {
+    carry += (uint64_t)dst[i] + src[i];
+    dst[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  for (; carry && i < dn; i++) {
+    carry += dst[i];
+    dst[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+}
+
+static void mag_mul_schoolbook(const uint32_t *a, size_t an, const uint32_t *b, size_t bn,
+                               uint32_t *out) {
+  memset(out, 0, (an + bn) * sizeof *out);
+  for (size_t i = 0; i < an; i++) {
+    uint64_t carry = 0;
+    for (size_t j = 0; j < bn; j++) {
+      carry += (uint64_t)a[i] * b[j] + out[i + j];
+      out[i + j] = (uint32_t)carry;
+      carry >>= 32;
+    }
+    out[i + bn] = (uint32_t)carry;
+  }
+}
+
+// out[0, an + bn) = a * b. With a = a1·B^m + a0 and b = b1·B^m + b0,
+// Karatsuba computes a·b from the three products a0·b0, a1·b1 and
+// (a0 + a1)(b0 + b1) instead of four.
+static void mag_mul(const uint32_t *a, size_t an, const uint32_t *b, size_t bn, uint32_t *out) {
+  if (an < bn) {
+    const uint32_t *t = a;
+    a = b;
+    b = t;
+    size_t tn = an;
+    an = bn;
+    bn = tn;
+  }
+  if (bn < KARATSUBA_THRESHOLD) {
+    mag_mul_schoolbook(a, an, b, bn, out);
+    return;
+  }
+
+  size_t m = an / 2;
+  if (bn <= m) {
+    // Lopsided operands: split only `a` and multiply both halves by `b`.
+    uint32_t *hi = limbs_alloc(an - m + bn);
+    mag_mul(a, m, b, bn, out);
+    memset(out + m + bn, 0, (an - m) * sizeof *out);
+    mag_mul(a + m, an - m, b, bn, hi);
+    mag_add_into(out + m, an + bn - m, hi, an - m + bn);
+    free(hi);
+    return;
+  }
+
+  size_t a1n = an - m;
+  size_t b1n = bn - m;
+  mag_mul(a, m, b, m, out);                   // a0·b0 in out[0, 2m)
+  mag_mul(a + m, a1n, b + m, b1n, out + 2 * m); // a1·b1 in out[2m, an + bn)
+
+  size_t sn = a1n + 1;
+  size_t tn = (b1n > m ? b1n : m) + 1;
+  uint32_t *sa = limbs_alloc(sn);
+  uint32_t *sb = limbs_alloc(tn);
+  uint32_t *mid = limbs_alloc(sn + tn);
+  mag_add(a + m, a1n, a, m, sa);
+  if (b1n >= m)
+    mag_add(b + m, b1n, b, m, sb);
+  else
+    mag_add(b, m, b + m, b1n, sb);
+  mag_mul(sa, sn, sb, tn, mid);
+  mag_sub(mid, sn + tn, out, 2 * m, mid);
+  mag_sub(mid, sn + tn, out + 2 * m, a1n + b1n, mid);
+  mag_add_into(out + m, an + bn - m, mid, mag_len(mid, sn + tn));
+  free(sa);
+  free(sb);
+  free(mid);
+}
+
+// r[0, n) = u mod v for u of m limbs and v of n >= 1 limbs, m >= n
+// (Knuth's algorithm D, keeping only the remainder).
+static void mag_mod(const uint32_t *u, size_t m, const uint32_t *v, size_t n, uint32_t *r) {
+  if (n == 1) {
+    uint64_t rem = 0;
+    for (size_t i = m; i-- > 0;)
+      rem = ((rem << 32) | u[i]) % v[0];
+    r[0] = (uint32_t)rem;
+    return;
+  }
+
+  // Normalize so the top limb of the divisor has its high bit set, which
+  // keeps each quotient digit estimate at most two too large.
+  int s = __builtin_clz(v[n - 1]);
+  uint32_t *vn = limbs_alloc(n);
+  uint32_t *un = limbs_alloc(m + 1);
+  for (size_t i = n - 1; i > 0; i--)
+    vn[i] = (v[i] << s) | (uint32_t)((uint64_t)v[i - 1] >> (32 - s));
+  vn[0] = v[0] << s;
+  un[m] = (uint32_t)((uint64_t)u[m - 1] >> (32 - s));
+  for (size_t i = m - 1; i > 0; i--)
+    un[i] = (u[i] << s) | (uint32_t)((uint64_t)u[i - 1] >> (32 - s));
+  un[0] = u[0] << s;
+
+  const uint64_t base = (uint64_t)1 << 32;
+  for (size_t j = m - n + 1; j-- > 0;) {
+    uint64_t num = ((uint64_t)un[j + n] << 32) | un[j + n - 1];
+    uint64_t qhat = num / vn[n - 1];
+    uint64_t rhat = num % vn[n - 1];
+    while (qhat >= base || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2])) {
+      qhat--;
+      rhat += vn[n - 1];
+      if (rhat >= base) break;
+    }
+
+    int64_t k = 0;
+    int64_t t;
+    for (size_t i = 0; i < n; i++) {
+      uint64_t p = qhat * vn[i];
+      t = (int64_t)un[i + j] - k - (int64_t)(p & 0xFFFFFFFFu);
+      un[i + j] = (uint32_t)t;
+      k = (int64_t)(p >> 32) - (t >> 32);
+    }
+    t = (int64_t)un[j + n] - k;
+    un[j + n] = (uint32_t)t;
+    if (t < 0) {
+      // The estimate was one too large: add the divisor back.
+      uint64_t carry = 0;
+      for (size_t i = 0; i < n; i++) {
+        carry += (uint64_t)un[i + j] + vn[i];
+        un[i + j] = (uint32_t)carry;
+        carry >>= 32;
+      }
+      un[j + n] += (uint32_t)carry;
+    }
+  }
+
+  for (size_t i = 0; i < n; i++)
+    r[i] = (un[i] >> s) | (uint32_t)((uint64_t)un[i + 1] << (32 - s));
+  free(vn);
+  free(un);
+}
+
+bignum_t *bignum_from_i64(int64_t v) {
+  bignum_t *b = bignum_alloc(2);
+  uint64_t mag = v < 0 ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+  b->negative = v < 0;
+  b->limbs[0] = (uint32_t)mag;
+  b->limbs[1] = (uint32_t)(mag >> 32);
+  return bignum_trim(b);
+}
+
+bignum_t *bignum_from_string(const char *s) {
+  bool negative = false;
+  if (*s == '-' || *s == '+') negative = *s++ == '-';
+  size_t digits = strlen(s);
+  if (digits == 0) return NULL;
+  for (size_t i = 0; i < digits; i++) {
+    if (!isdigit((unsigned char)s[i])) return NULL;
+  }
+
+  bignum_t *b = bignum_alloc(digits / DECIMAL_DIGITS + 2);
+  b->len = 0;
+  size_t pos = 0;
+  size_t chunk_len = digits % DECIMAL_DIGITS ? digits % DECIMAL_DIGITS : DECIMAL_DIGITS;
+  while (pos < digits) {
+    uint32_t chunk = 0;
+    uint32_t scale = 1;
+    for (size_t i = 0; i < chunk_len; i++) {
+      chunk = chunk * 10 + (uint32_t)(s[pos++] - '0');
+      scale *= 10;
+    }
+    uint64_t carry = chunk;
+    for (size_t i = 0; i < b->len; i++) {
+      carry += (uint64_t)b->limbs[i] * scale;
+      b->limbs[i] = (uint32_t)carry;
+      carry >>= 32;
+    }
+    if (carry) b->limbs[b->len++] = (uint32_t)carry;
+    chunk_len = DECIMAL_DIGITS;
+  }
+  b->negative = negative;
+  return bignum_trim(b);
+}
+
+bignum_t *bignum_copy(const bignum_t *b) {
+  bignum_t *c = bignum_alloc(b->len);
+  c->negative = b->negative;
+  memcpy(c->limbs, b->limbs, b->len * sizeof *b->limbs);
+  return c;
+}
+
+void bignum_free(bignum_t *b) {
+  free(b);
+}
+
+// a + b when `b_negative` is b's sign, a - b when it is the opposite.
+static bignum_t *add_signed(const bignum_t *a, const bignum_t *b, bool b_negative) {
+  if (a->negative == b_negative) {
+    const bignum_t *x = a->len >= b->len ? a : b;
+    const bignum_t *y = x == a ? b : a;
+    bignum_t *r = bignum_alloc(x->len + 1);
+    mag_add(x->limbs, x->len, y->limbs, y->len, r->limbs);
+    r->negative = a->negative;
+    return bignum_trim(r);
+  }
+  int c = mag_cmp(a->limbs, a->len, b->limbs, b->len);
+  if (c == 0) return bignum_alloc(0);
+  const bignum_t *x = c > 0 ? a : b;
+  const bignum_t *y = c > 0 ? b : a;
+  bignum_t *r = bignum_alloc(x->len);
+  mag_sub(x->limbs, x->len, y->limbs, y->len, r->limbs);
+  r->negative = c > 0 ? a->negative : b_negative;
+  return bignum_trim(r);
+}
+
+bignum_t *bignum_add(const bignum_t *a, const bignum_t *b) {
+  return add_signed(a, b, b->negative);
+}
+
+bignum_t *bignum_sub(const bignum_t *a, const bignum_t *b) {
+  return add_signed(a, b, !b->negative);
+}
+
+bignum_t *bignum_mul(const bignum_t *a, const bignum_t *b) {
+  if (!a->len || !b->len) return bignum_alloc(0);
+  bignum_t *r = bignum_alloc(a->len + b->len);
+  mag_mul(a->limbs, a->len, b->limbs, b->len, r->limbs);
+  r->negative = a->negative != b->negative;
+  return bignum_trim(r);
+}
+
+bignum_t *bignum_mod(const bignum_t *a, const bignum_t *b) {
+  if (mag_cmp(a->limbs, a->len, b->limbs, b->len) < 0) return bignum_copy(a);
+  bignum_t *r = bignum_alloc(b->len);
+  mag_mod(a->limbs, a->len, b->limbs, b->len, r->limbs);
+  r->negative = a->negative;
+  return bignum_trim(r);
+}
+
+bignum_t *bignum_abs(const bignum_t *b) {
+  bignum_t *r = bignum_copy(b);
+  r->negative = false;
+  return r;
+}
+
+int bignum_cmp(const bignum_t *a, const bignum_t *b) {
+  if (a->negative != b->negative) return a->negative ? -1 : 1;
+  int c = mag_cmp(a->limbs, a->len, b->limbs, b->len);
+  return a->negative ? -c : c;
+}
+
+bool bignum_to_i64(const bignum_t *b, int64_t *out) {
+  if (b->len > 2) return false;
+  uint64_t mag = 0;
+  for (size_t i = b->len; i-- > 0;)
+    mag = (mag << 32) | b->limbs[i];
+  if (b->negative) {
+    if (mag > (uint64_t)INT64_MAX + 1) return false;
+    *out = (int64_t)((uint64_t)0 - mag);
+  } else {
+    if (mag > (uint64_t)INT64_MAX) return false;
+    *out = (int64_t)mag;
+  }
+  return true;
+}
+
+double bignum_to_double(const bignum_t *b) {
+  double d = 0.0;
+  for (size_t i = b->len; i-- > 0;)
+    d = d * 4294967296.0 + b->limbs[i];
+  return b->negative ? -d : d;
+}
+
+char *bignum_to_string(const bignum_t *b) {
+  // Each pass divides the whole number by 10^9 with one 64/32-bit division
+  // per limb, peeling off nine decimal digits at a time instead of one.
+  size_t n = b->len;
+  uint32_t *t = limbs_alloc(n);
+  memcpy(t, b->limbs, n * sizeof *t);
+  uint32_t *chunks = limbs_alloc(n * 32 / 29 + 1);
+  size_t count = 0;
+  while (n) {
+    uint64_t rem = 0;
+    for (size_t i = n; i-- > 0;) {
+      uint64_t cur = (rem << 32) | t[i];
+      t[i] = (uint32_t)(cur / DECIMAL_BASE);
+      rem = cur % DECIMAL_BASE;
+    }
+    chunks[count++] = (uint32_t)rem;
+    n = mag_len(t, n);
+  }
+  free(t);
+
+  char *out = xmalloc(count * DECIMAL_DIGITS + 3);
+  char *p = out;
+  if (b->negative) *p++ = '-';
+  if (count == 0) {
+    strcpy(p, "0");
+  } else {
+    p += sprintf(p, "%u", chunks[count - 1]);
+    for (size_t i = count - 1; i-- > 0;)
+      p += sprintf(p, "%09u", chunks[i]);
+  }
+  free(chunks);
+  return out;
+}
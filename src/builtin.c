@@ -1,53 +1,152 @@
 #include "builtin.h"
+#include "bignum.h"
+#include "f64vec.h"
+#include "fold.h"
 #include "gc.h"
 #include "lexer.h"
 #include "symbol.h"
 #include <ctype.h>
 #include <errno.h>
 #include <float.h>
+#include <inttypes.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 static int gensym_counter = 0;
 
+// Integer arithmetic stays exact while every argument is an integer: it runs
+// on int64 until an intermediate result overflows, and the whole fold is
+// then redone with bignums. A double argument makes it a double fold.
+static bool all_integers(size_t argc, lval_t **argv) {
+  for (size_t i = 0; i < argc; i++) {
+    if (!lval_is_integer(argv[i])) return false;
+  }
+  return true;
+}
+
+static bignum_t *to_bignum(const lval_t *v) {
+  return v->type == L_BIGNUM ? bignum_copy(v->as.bignum) : bignum_from_i64(v->as.integer);
+}
+
+typedef bignum_t *(*bignum_op_t)(const bignum_t *, const bignum_t *);
+
+// Folds `op` over the arguments starting from `unit`, or from the first
+// argument when `from_first` is set, as subtraction does.
+static lval_t *bignum_fold(size_t argc, lval_t **argv, int64_t unit, bool from_first,
+                           bignum_op_t op) {
+  size_t i = 0;
+  bignum_t *acc = from_first && argc ? to_bignum(argv[i++]) : bignum_from_i64(unit);
+  for (; i < argc; i++) {
+    bignum_t *x = to_bignum(argv[i]);
+    bignum_t *next = op(acc, x);
+    bignum_free(x);
+    bignum_free(acc);
+    acc = next;
+  }
+  return lval_bignum(acc);
+}
+
+// Comparisons are exact between two integers; any double makes them compare
+// as doubles.
+static int integer_cmp(const lval_t *a, const lval_t *b) {
+  if (a->type == L_INT && b->type == L_INT) {
+    return (a->as.integer > b->as.integer) - (a->as.integer < b->as.integer);
+  }
+  bignum_t *x = to_bignum(a);
+  bignum_t *y = to_bignum(b);
+  int c = bignum_cmp(x, y);
+  bignum_free(x);
+  bignum_free(y);
+  return c;
+}
+
+static bool num_eq(const lval_t *a, const lval_t *b) {
+  if (lval_is_integer(a) && lval_is_integer(b)) return integer_cmp(a, b) == 0;
+  return lval_to_double(a) == lval_to_double(b);
+}
+
+static bool num_lt(const lval_t *a, const lval_t *b) {
+  if (lval_is_integer(a) && lval_is_integer(b)) return integer_cmp(a, b) < 0;
+  return lval_to_double(a) < lval_to_double(b);
+}
+
+static bool num_le(const lval_t *a, const lval_t *b) {
+  if (lval_is_integer(a) && lval_is_integer(b)) return integer_cmp(a, b) <= 0;
+  return lval_to_double(a) <= lval_to_double(b);
+}
+
 static eval_result_t builtin_add(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
-  double s = 0.0;
   for (size_t i = 0; i < argc; i++) {
-    if (argv[i]->type != L_NUM) {
-      return eval_errf("+: expected number at arg %zu", i + 1);
+    if (!lval_is_number(argv[i])) {
+      return eval_err_at(EVAL_ERR_TYPE, "+: expected number", i + 1, argv[i]);
     }
-    s += argv[i]->as.number;
+  }
+  int64_t n = 0;
+  size_t i = 0;
+  for (; i < argc && argv[i]->type == L_INT; i++) {
+    if (__builtin_add_overflow(n, argv[i]->as.integer, &n)) break;
+  }
+  if (i == argc) return eval_ok(lval_int(n));
+  if (all_integers(argc, argv)) return eval_ok(bignum_fold(argc, argv, 0, false, bignum_add));
+
+  double s = 0.0;
+  for (i = 0; i < argc; i++) {
+    s += lval_to_double(argv[i]);
   }
   return eval_ok(lval_num(s));
 }
 
 static eval_result_t builtin_sub(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
-  double s = 0.0;
-
   for (size_t i = 0; i < argc; i++) {
-    if (argv[i]->type != L_NUM) {
-      return eval_errf("+: expected number at arg %zu", i + 1);
+    if (!lval_is_number(argv[i])) {
+      return eval_err_at(EVAL_ERR_TYPE, "-: expected number", i + 1, argv[i]);
+    }
+  }
+  int64_t n = 0;
+  size_t i = 0;
+  for (; i < argc && argv[i]->type == L_INT; i++) {
+    if (i == 0) {
+      n = argv[i]->as.integer;
+    } else if (__builtin_sub_overflow(n, argv[i]->as.integer, &n)) {
+      break;
     }
+  }
+  if (i == argc) return eval_ok(lval_int(n));
+  if (all_integers(argc, argv)) return eval_ok(bignum_fold(argc, argv, 0, true, bignum_sub));
+
+  double s = 0.0;
+  for (i = 0; i < argc; i++) {
     if (i == 0) {
-      s = argv[i]->as.number;
+      s = lval_to_double(argv[i]);
       continue;
     }
-    s -= argv[i]->as.number;
+    s -= lval_to_double(argv[i]);
   }
   return eval_ok(lval_num(s));
 }
 
 static eval_result_t builtin_mul(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
-  double s = 1.0;
   for (size_t i = 0; i < argc; i++) {
-    if (argv[i]->type != L_NUM) {
-      return eval_errf("+: expected number at arg %zu", i + 1);
+    if (!lval_is_number(argv[i])) {
+      return eval_err_at(EVAL_ERR_TYPE, "*: expected number", i + 1, argv[i]);
     }
-    s *= argv[i]->as.number;
+  }
+  int64_t n = 1;
+  size_t i = 0;
+  for (; i < argc && argv[i]->type == L_INT; i++) {
+    if (__builtin_mul_overflow(n, argv[i]->as.integer, &n)) break;
+  }
+  if (i == argc) return eval_ok(lval_int(n));
+  if (all_integers(argc, argv)) return eval_ok(bignum_fold(argc, argv, 1, false, bignum_mul));
+
+  double s = 1.0;
+  for (i = 0; i < argc; i++) {
+    s *= lval_to_double(argv[i]);
   }
   return eval_ok(lval_num(s));
 }
@@ -56,14 +155,14 @@ static eval_result_t builtin_div(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   double s = 0.0;
   for (size_t i = 0; i < argc; i++) {
-    if (argv[i]->type != L_NUM) {
-      return eval_errf("+: expected number at arg %zu", i + 1);
+    if (!lval_is_number(argv[i])) {
+      return eval_err_at(EVAL_ERR_TYPE, "/: expected number", i + 1, argv[i]);
     }
     if (i == 0) {
-      s = argv[i]->as.number;
+      s = lval_to_double(argv[i]);
       continue;
     }
-    s /= argv[i]->as.number;
+    s /= lval_to_double(argv[i]);
   }
   return eval_ok(lval_num(s));
 }
@@ -71,74 +170,105 @@ static eval_result_t builtin_div(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_mod(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 2) {
-    return eval_errf("mod: expected exactly 2 arguments, got %zu", argc);
+    return eval_err_arity("mod: expected exactly 2 arguments", argc, NULL);
   }
-  if (argv[0]->type != L_NUM || argv[1]->type != L_NUM) {
+  if (!lval_is_number(argv[0]) || !lval_is_number(argv[1])) {
     return eval_errf("mod: expected both arguments to be numbers");
   }
-  if (argv[1]->as.number == 0.0) {
+  if (argv[0]->type == L_INT && argv[1]->type == L_INT) {
+    int64_t a = argv[0]->as.integer;
+    int64_t b = argv[1]->as.integer;
+    if (b == 0) {
+      return eval_errf("mod: division by zero");
+    }
+    // INT64_MIN % -1 traps on x86; the remainder is 0 for any a.
+    return eval_ok(lval_int(b == -1 ? 0 : a % b));
+  }
+  if (lval_is_integer(argv[0]) && lval_is_integer(argv[1])) {
+    // A bignum is never zero, and |b| > |a| leaves a as the remainder.
+    bignum_t *a = to_bignum(argv[0]);
+    bignum_t *b = to_bignum(argv[1]);
+    bignum_t *r = bignum_mod(a, b);
+    bignum_free(a);
+    bignum_free(b);
+    return eval_ok(lval_bignum(r));
+  }
+  if (lval_to_double(argv[1]) == 0.0) {
     return eval_errf("mod: division by zero");
   }
-  double result = fmod(argv[0]->as.number, argv[1]->as.number);
+  double result = fmod(lval_to_double(argv[0]), lval_to_double(argv[1]));
   return eval_ok(lval_num(result));
 }
 
 static eval_result_t builtin_abs(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("abs: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("abs: expected exactly 1 argument", argc, NULL);
   }
-  if (argv[0]->type != L_NUM) {
+  if (!lval_is_number(argv[0])) {
     return eval_errf("abs: expected a number argument");
   }
-  double result = fabs(argv[0]->as.number);
+  if (argv[0]->type == L_INT && argv[0]->as.integer != INT64_MIN) {
+    int64_t n = argv[0]->as.integer;
+    return eval_ok(lval_int(n < 0 ? -n : n));
+  }
+  if (lval_is_integer(argv[0])) {
+    bignum_t *b = to_bignum(argv[0]);
+    lval_t *result = lval_bignum(bignum_abs(b));
+    bignum_free(b);
+    return eval_ok(result);
+  }
+  double result = fabs(lval_to_double(argv[0]));
   return eval_ok(lval_num(result));
 }
 
 static eval_result_t builtin_min(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc == 0) {
-    return eval_errf("min: expected at least 1 argument, got %zu", argc);
+    return eval_err_arity("min: expected at least 1 argument", argc, NULL);
   }
-  double min = DBL_MAX;
+  lval_t *min = NULL;
   for (size_t i = 0; i < argc; i++) {
     lval_t *arg = argv[i];
-    if (arg->type != L_NUM) {
+    if (!lval_is_number(arg)) {
       return eval_errf("min: min on non-number type");
     }
-    if (arg->as.number <= min) {
-      min = arg->as.number;
+    if (!min || num_le(arg, min)) {
+      min = arg;
     }
   }
-  return eval_ok(lval_num(min));
+  return eval_ok(min);
 }
 
 static eval_result_t builtin_max(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc == 0) {
-    return eval_errf("max: expected at least 1 argument, got %zu", argc);
+    return eval_err_arity("max: expected at least 1 argument", argc, NULL);
   }
-  double max = -DBL_MAX;
+  lval_t *max = NULL;
   for (size_t i = 0; i < argc; i++) {
     lval_t *arg = argv[i];
-    if (arg->type != L_NUM) {
+    if (!lval_is_number(arg)) {
       return eval_errf("min: min on non-number type");
     }
-    if (arg->as.number >= max) {
-      max = arg->as.number;
+    if (!max || num_le(max, arg)) {
+      max = arg;
     }
   }
-  return eval_ok(lval_num(max));
+  return eval_ok(max);
 }
 
 static eval_result_t builtin_floor(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("floor: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("floor: expected exactly 1 argument", argc, NULL);
   }
-  if (argv[0]->type != L_NUM) {
+  if (!lval_is_number(argv[0])) {
     return eval_errf("floor: expected a number argument");
   }
+  if (lval_is_integer(argv[0])) {
+    return eval_ok(argv[0]);
+  }
   double result = floor(argv[0]->as.number);
   return eval_ok(lval_num(result));
 }
@@ -146,11 +276,14 @@ static eval_result_t builtin_floor(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_ceil(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("ceil: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("ceil: expected exactly 1 argument", argc, NULL);
   }
-  if (argv[0]->type != L_NUM) {
+  if (!lval_is_number(argv[0])) {
     return eval_errf("ceil: expected a number argument");
   }
+  if (lval_is_integer(argv[0])) {
+    return eval_ok(argv[0]);
+  }
   double result = ceil(argv[0]->as.number);
   return eval_ok(lval_num(result));
 }
@@ -158,11 +291,14 @@ static eval_result_t builtin_ceil(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_round(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("round: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("round: expected exactly 1 argument", argc, NULL);
   }
-  if (argv[0]->type != L_NUM) {
+  if (!lval_is_number(argv[0])) {
     return eval_errf("round: expected a number argument");
   }
+  if (lval_is_integer(argv[0])) {
+    return eval_ok(argv[0]);
+  }
   double result = round(argv[0]->as.number);
   return eval_ok(lval_num(result));
 }
@@ -170,11 +306,14 @@ static eval_result_t builtin_round(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_trunc(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("trunc: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("trunc: expected exactly 1 argument", argc, NULL);
   }
-  if (argv[0]->type != L_NUM) {
+  if (!lval_is_number(argv[0])) {
     return eval_errf("trunc: expected a number argument");
   }
+  if (lval_is_integer(argv[0])) {
+    return eval_ok(argv[0]);
+  }
   double result = trunc(argv[0]->as.number);
   return eval_ok(lval_num(result));
 }
@@ -182,61 +321,61 @@ static eval_result_t builtin_trunc(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_sqrt(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("sqrt: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("sqrt: expected exactly 1 argument", argc, NULL);
   }
-  if (argv[0]->type != L_NUM) {
+  if (!lval_is_number(argv[0])) {
     return eval_errf("sqrt: expected a number argument");
   }
-  if (argv[0]->as.number < 0.0) {
+  if (lval_to_double(argv[0]) < 0.0) {
     return eval_errf("sqrt: cannot take square root of negative number");
   }
-  double result = sqrt(argv[0]->as.number);
+  double result = sqrt(lval_to_double(argv[0]));
   return eval_ok(lval_num(result));
 }
 
 static eval_result_t builtin_exp(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("exp: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("exp: expected exactly 1 argument", argc, NULL);
   }
-  if (argv[0]->type != L_NUM) {
+  if (!lval_is_number(argv[0])) {
     return eval_errf("exp: expected a number argument");
   }
-  double result = exp(argv[0]->as.number);
+  double result = exp(lval_to_double(argv[0]));
   return eval_ok(lval_num(result));
 }
 
 static eval_result_t builtin_log(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("log: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("log: expected exactly 1 argument", argc, NULL);
   }
-  if (argv[0]->type != L_NUM) {
+  if (!lval_is_number(argv[0])) {
     return eval_errf("log: expected a number argument");
   }
-  if (argv[0]->as.number <= 0.0) {
+  if (lval_to_double(argv[0]) <= 0.0) {
     return eval_errf("log: cannot take logarithm of non-positive number");
   }
-  double result = log(argv[0]->as.number);
+  double result = log(lval_to_double(argv[0]));
   return eval_ok(lval_num(result));
 }
 
 static eval_result_t builtin_eq(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc < 2) {
-    return eval_errf("=: expected at least 2 arguments, got %zu", argc);
+    return eval_err_arity("=: expected at least 2 arguments", argc, NULL);
   }
 
   lval_t *first = argv[0];
-  if (first->type != L_NUM) {
-    return eval_errf("=: expected number at arg 1");
+  if (!lval_is_number(first)) {
+    return eval_err_at(EVAL_ERR_TYPE, "=: expected number", 1, first);
   }
   for (size_t i = 1; i < argc; i++) {
     lval_t *arg = argv[i];
-    if (arg->type != L_NUM) {
-      return eval_errf("=: expected number at arg %zu", i + 1);
+    if (!lval_is_number(arg)) {
+      return eval_err_at(EVAL_ERR_TYPE, "=: expected number", i + 1, arg);
     }
-    if (arg->as.number != first->as.number) {
+    if (!num_eq(arg, first)) {
       return eval_ok(lval_bool(false));
     }
   }
@@ -246,15 +385,15 @@ static eval_result_t builtin_eq(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_lt(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc < 2) {
-    return eval_errf("<: expected at least 2 arguments, got %zu", argc);
+    return eval_err_arity("<: expected at least 2 arguments", argc, NULL);
   }
   for (size_t i = 0; i < argc; i++) {
-    if (argv[i]->type != L_NUM) {
-      return eval_errf("<: expected number arguments");
+    if (!lval_is_number(argv[i])) {
+      return eval_err_at(EVAL_ERR_TYPE, "<: expected number", i + 1, argv[i]);
     }
   }
   for (size_t i = 0; i < argc - 1; i++) {
-    if (!(argv[i]->as.number < argv[i + 1]->as.number)) {
+    if (!(num_lt(argv[i], argv[i + 1]))) {
       return eval_ok(lval_bool(false));
     }
   }
@@ -264,15 +403,15 @@ static eval_result_t builtin_lt(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_gt(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc < 2) {
-    return eval_errf(">: expected at least 2 arguments, got %zu", argc);
+    return eval_err_arity(">: expected at least 2 arguments", argc, NULL);
   }
   for (size_t i = 0; i < argc; i++) {
-    if (argv[i]->type != L_NUM) {
-      return eval_errf(">: expected number arguments");
+    if (!lval_is_number(argv[i])) {
+      return eval_err_at(EVAL_ERR_TYPE, ">: expected number", i + 1, argv[i]);
     }
   }
   for (size_t i = 0; i < argc - 1; i++) {
-    if (!(argv[i]->as.number > argv[i + 1]->as.number)) {
+    if (!(num_lt(argv[i + 1], argv[i]))) {
       return eval_ok(lval_bool(false));
     }
   }
@@ -282,15 +421,15 @@ static eval_result_t builtin_gt(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_le(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc < 2) {
-    return eval_errf("<=: expected at least 2 arguments, got %zu", argc);
+    return eval_err_arity("<=: expected at least 2 arguments", argc, NULL);
   }
   for (size_t i = 0; i < argc; i++) {
-    if (argv[i]->type != L_NUM) {
-      return eval_errf("<=: expected number arguments");
+    if (!lval_is_number(argv[i])) {
+      return eval_err_at(EVAL_ERR_TYPE, "<=: expected number", i + 1, argv[i]);
     }
   }
   for (size_t i = 0; i < argc - 1; i++) {
-    if (!(argv[i]->as.number <= argv[i + 1]->as.number)) {
+    if (!(num_le(argv[i], argv[i + 1]))) {
       return eval_ok(lval_bool(false));
     }
   }
@@ -300,15 +439,15 @@ static eval_result_t builtin_le(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_ge(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc < 2) {
-    return eval_errf(">=: expected at least 2 arguments, got %zu", argc);
+    return eval_err_arity(">=: expected at least 2 arguments", argc, NULL);
   }
   for (size_t i = 0; i < argc; i++) {
-    if (argv[i]->type != L_NUM) {
-      return eval_errf(">=: expected number arguments");
+    if (!lval_is_number(argv[i])) {
+      return eval_err_at(EVAL_ERR_TYPE, ">=: expected number", i + 1, argv[i]);
     }
   }
   for (size_t i = 0; i < argc - 1; i++) {
-    if (!(argv[i]->as.number >= argv[i + 1]->as.number)) {
+    if (!(num_le(argv[i + 1], argv[i]))) {
       return eval_ok(lval_bool(false));
     }
   }
@@ -318,7 +457,7 @@ static eval_result_t builtin_ge(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_identity_eq(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 2) {
-    return eval_errf("eq?: expected exactly 2 arguments, got %zu", argc);
+    return eval_err_arity("eq?: expected exactly 2 arguments", argc, NULL);
   }
 
   lval_t *a = argv[0];
@@ -336,6 +475,12 @@ static eval_result_t builtin_identity_eq(size_t argc, lval_t **argv, env_t *env)
   case L_NUM:
     identical = (a->as.number == b->as.number);
     break;
+  case L_INT:
+    identical = (a->as.integer == b->as.integer);
+    break;
+  case L_BIGNUM:
+    identical = bignum_cmp(a->as.bignum, b->as.bignum) == 0;
+    break;
 
   case L_BOOL:
     identical = (a->as.boolean == b->as.boolean);
@@ -350,6 +495,9 @@ static eval_result_t builtin_identity_eq(size_t argc, lval_t **argv, env_t *env)
     break;
 
   case L_CONS:
+  case L_VECTOR:
+  case L_HASHTABLE:
+  case L_F64VECTOR:
     identical = (a == b);
     break;
 
@@ -372,6 +520,10 @@ static bool deep_eq_helper(lval_t *a, lval_t *b) {
     return true;
   case L_NUM:
     return (a->as.number == b->as.number);
+  case L_INT:
+    return (a->as.integer == b->as.integer);
+  case L_BIGNUM:
+    return bignum_cmp(a->as.bignum, b->as.bignum) == 0;
   case L_BOOL:
     return (a->as.boolean == b->as.boolean);
   case L_SYMBOL:
@@ -384,6 +536,18 @@ static bool deep_eq_helper(lval_t *a, lval_t *b) {
   case L_CONS:
     return deep_eq_helper(a->as.cons.car, b->as.cons.car) &&
            deep_eq_helper(a->as.cons.cdr, b->as.cons.cdr);
+  case L_VECTOR:
+    if (a->as.vector.count != b->as.vector.count) return false;
+    for (size_t i = 0; i < a->as.vector.count; i++) {
+      if (!deep_eq_helper(a->as.vector.items[i], b->as.vector.items[i])) return false;
+    }
+    return true;
+  case L_F64VECTOR:
+    if (a->as.f64vector.count != b->as.f64vector.count) return false;
+    for (size_t i = 0; i < a->as.f64vector.count; i++) {
+      if (a->as.f64vector.items[i] != b->as.f64vector.items[i]) return false;
+    }
+    return true;
   case L_NATIVE:
     return (strcmp(a->as.native.name, b->as.native.name) == 0);
   case L_FUNCTION:
@@ -396,7 +560,7 @@ static bool deep_eq_helper(lval_t *a, lval_t *b) {
 static eval_result_t builtin_deep_eq(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 2) {
-    return eval_errf("equal: expected exactly 2 arguments, got %zu", argc);
+    return eval_err_arity("equal: expected exactly 2 arguments", argc, NULL);
   }
 
   bool equal = deep_eq_helper(argv[0], argv[1]);
@@ -406,7 +570,7 @@ static eval_result_t builtin_deep_eq(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_not(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("not: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("not: expected exactly 1 argument", argc, NULL);
   }
   if (argv[0]->type != L_BOOL) {
     return eval_errf("not: expected a boolean argument");
@@ -418,7 +582,7 @@ static eval_result_t builtin_not(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_and(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc == 0) {
-    return eval_errf("and: expected at least 1 argument, got %zu", argc);
+    return eval_err_arity("and: expected at least 1 argument", argc, NULL);
   }
 
   for (size_t i = 0; i < argc; i++) {
@@ -435,7 +599,7 @@ static eval_result_t builtin_and(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_or(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc == 0) {
-    return eval_errf("or: expected at least 1 argument, got %zu", argc);
+    return eval_err_arity("or: expected at least 1 argument", argc, NULL);
   }
   for (size_t i = 0; i < argc; i++) {
     if (argv[i]->type != L_BOOL) {
@@ -451,7 +615,7 @@ static eval_result_t builtin_or(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_cons(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 2) {
-    return eval_errf("cons: expected exactly 2 arguments, got %zu", argc);
+    return eval_err_arity("cons: expected exactly 2 arguments", argc, NULL);
   }
   lval_t *cons_cell = lval_cons(argv[0], argv[1]);
   return eval_ok(cons_cell);
@@ -460,10 +624,10 @@ static eval_result_t builtin_cons(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_car(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("car: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("car: expected exactly 1 argument", argc, NULL);
   }
   if (argv[0]->type != L_CONS) {
-    return eval_errf("car: expected a cons cell");
+    return eval_err(EVAL_ERR_TYPE, "car: expected a cons cell", argv[0]);
   }
   if (argv[0]->as.cons.car == NULL) {
     return eval_errf("car: cons cell is empty");
@@ -475,10 +639,10 @@ static eval_result_t builtin_car(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_cdr(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("cdr: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("cdr: expected exactly 1 argument", argc, NULL);
   }
   if (argv[0]->type != L_CONS) {
-    return eval_errf("cdr: expected a cons cell");
+    return eval_err(EVAL_ERR_TYPE, "cdr: expected a cons cell", argv[0]);
   }
   if (argv[0]->as.cons.cdr == NULL) {
     return eval_errf("cdr: cons cell is empty");
@@ -504,10 +668,10 @@ static eval_result_t builtin_list(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_length(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("length: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("length: expected exactly 1 argument", argc, NULL);
   }
   if (argv[0]->type == L_NIL) {
-    return eval_ok(lval_num(0.0)); // Length of nil is 0
+    return eval_ok(lval_int(0)); // Length of nil is 0
   }
 
   if (argv[0]->type != L_CONS) {
@@ -521,13 +685,13 @@ static eval_result_t builtin_length(size_t argc, lval_t **argv, env_t *env) {
     if (current == NULL) break; // Reached the end of the list
   }
 
-  return eval_ok(lval_num((double)length));
+  return eval_ok(lval_int((int64_t)length));
 }
 
 static eval_result_t builtin_append(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc < 2) {
-    return eval_errf("append: expected at least 2 arguments, got %zu", argc);
+    return eval_err_arity("append: expected at least 2 arguments", argc, NULL);
   }
 
   lval_t *result = lval_nil();
@@ -548,7 +712,7 @@ static eval_result_t builtin_append(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_reverse(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("reverse: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("reverse: expected exactly 1 argument", argc, NULL);
   }
 
   if (argv[0]->type == L_NIL) {
@@ -573,7 +737,7 @@ static eval_result_t builtin_reverse(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_is_null(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("null?: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("null?: expected exactly 1 argument", argc, NULL);
   }
   return eval_ok(lval_bool(argv[0]->type == L_NIL));
 }
@@ -581,7 +745,7 @@ static eval_result_t builtin_is_null(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_is_pair(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("pair?: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("pair?: expected exactly 1 argument", argc, NULL);
   }
   if (argv[0]->type != L_CONS) {
     return eval_ok(lval_bool(false));
@@ -592,7 +756,7 @@ static eval_result_t builtin_is_pair(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_is_atom(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("atom?: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("atom?: expected exactly 1 argument", argc, NULL);
   }
   return eval_ok(lval_bool(argv[0]->type != L_CONS && argv[0]->type != L_NIL));
 }
@@ -600,15 +764,15 @@ static eval_result_t builtin_is_atom(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_is_number(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("number?: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("number?: expected exactly 1 argument", argc, NULL);
   }
-  return eval_ok(lval_bool(argv[0]->type == L_NUM));
+  return eval_ok(lval_bool(lval_is_number(argv[0])));
 }
 
 static eval_result_t builtin_is_symbol(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("symbol?: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("symbol?: expected exactly 1 argument", argc, NULL);
   }
   return eval_ok(lval_bool(argv[0]->type == L_SYMBOL));
 }
@@ -616,14 +780,14 @@ static eval_result_t builtin_is_symbol(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_is_string(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("string?: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("string?: expected exactly 1 argument", argc, NULL);
   }
   return eval_ok(lval_bool(argv[0]->type == L_STRING));
 }
 
 static eval_result_t builtin_is_function(size_t argc, lval_t **argv, env_t *env) {
   if (argc != 1) {
-    return eval_errf("function?: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("function?: expected exactly 1 argument", argc, NULL);
   }
 
   bool is_function = false;
@@ -632,7 +796,7 @@ static eval_result_t builtin_is_function(size_t argc, lval_t **argv, env_t *env)
     builtin_fn fn = lookup_builtin(argv[0]->as.symbol.name);
     is_function = (fn != NULL);
     if (!is_function) {
-      lval_t *binding = env_get_ref(env, argv[0]->as.symbol.name);
+      lval_t *binding = env_get_symbol(env, argv[0]->as.symbol.name);
       is_function = (binding != NULL && binding->type == L_FUNCTION);
     }
   }
@@ -643,7 +807,7 @@ static eval_result_t builtin_is_function(size_t argc, lval_t **argv, env_t *env)
 static eval_result_t builtin_is_list(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("list?: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("list?: expected exactly 1 argument", argc, NULL);
   }
   return eval_ok(lval_bool(argv[0]->type == L_CONS || argv[0]->type == L_NIL));
 }
@@ -651,14 +815,14 @@ static eval_result_t builtin_is_list(size_t argc, lval_t **argv, env_t *env) {
 static eval_result_t builtin_str_len(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("string-length: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("string-length: expected exactly 1 argument", argc, NULL);
   }
 
   if (argv[0]->type != L_STRING) {
     return eval_errf("string-length: expected argument of type string", argc);
   }
 
-  return eval_ok(lval_num((double)argv[0]->as.string.len));
+  return eval_ok(lval_int((int64_t)argv[0]->as.string.len));
 }
 
 static eval_result_t builtin_str_append(size_t argc, lval_t **argv, env_t *env) {
@@ -694,7 +858,7 @@ static eval_result_t builtin_str_append(size_t argc, lval_t **argv, env_t *env)
 static eval_result_t builtin_str_to_num(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("string->number: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("string->number: expected exactly 1 argument", argc, NULL);
   }
   if (argv[0]->type != L_STRING) {
     return eval_errf("string->number: expected argument of type string");
@@ -710,19 +874,36 @@ static eval_result_t builtin_str_to_num(size_t argc, lval_t **argv, env_t *env)
   memcpy(tmp, s, len);
   tmp[len] = '\0';
 
+  // Strings without a fraction or exponent read as exact integers when they fit.
+  if (!strpbrk(tmp, ".eE")) {
+    char *end;
+    errno = 0;
+    long long n = strtoll(tmp, &end, 10);
+    while (end != tmp && isspace((unsigned char)*end))
+      end++;
+    if (end != tmp && *end == '\0' && errno != ERANGE) {
+      free(tmp);
+      return eval_ok(lval_int((int64_t)n));
+    }
+    bignum_t *big = bignum_from_string(tmp);
+    if (big) {
+      free(tmp);
+      return eval_ok(lval_bignum(big));
+    }
+  }
+
   double val = 0.0;
   int consumed = 0;
   int got = sscanf(tmp, " %lf %n", &val, &consumed);
 
   if (got != 1) {
-    eval_result_t err = eval_errf("string->number: invalid number string '%s'", tmp);
     free(tmp);
-    return err;
+    return eval_err(EVAL_ERR_VALUE, "string->number: invalid number string", argv[0]);
   }
   for (const char *p = tmp + consumed; *p; ++p) {
     if (!isspace((unsigned char)*p)) {
       free(tmp);
-      return eval_errf("string->number: trailing characters in '%s'", tmp);
+      return eval_err(EVAL_ERR_VALUE, "string->number: trailing characters", argv[0]);
     }
   }
 
@@ -733,11 +914,22 @@ static eval_result_t builtin_str_to_num(size_t argc, lval_t **argv, env_t *env)
 static eval_result_t builtin_num_to_str(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("number->string: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("number->string: expected exactly 1 argument", argc, NULL);
   }
-  if (argv[0]->type != L_NUM) {
+  if (!lval_is_number(argv[0])) {
     return eval_errf("number->string: expected argument of type number");
   }
+  if (argv[0]->type == L_INT) {
+    char digits[24];
+    int len = snprintf(digits, sizeof digits, "%" PRId64, argv[0]->as.integer);
+    return eval_ok(lval_string_copy(digits, (size_t)len));
+  }
+  if (argv[0]->type == L_BIGNUM) {
+    char *digits = bignum_to_string(argv[0]->as.bignum);
+    eval_result_t out = eval_ok(lval_string_copy(digits, strlen(digits)));
+    free(digits);
+    return out;
+  }
   int need = snprintf(NULL, 0, "%.*g", DBL_DECIMAL_DIG, argv[0]->as.number);
   if (need < 0) {
     return eval_errf("number->string: formatting failed");
@@ -759,7 +951,7 @@ static eval_result_t builtin_num_to_str(size_t argc, lval_t **argv, env_t *env)
 static eval_result_t builtin_symbol_to_str(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("symbol->string: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("symbol->string: expected exactly 1 argument", argc, NULL);
   }
 
   if (argv[0]->type != L_SYMBOL) {
@@ -772,7 +964,7 @@ static eval_result_t builtin_symbol_to_str(size_t argc, lval_t **argv, env_t *en
 static eval_result_t builtin_str_to_symbol(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("string->symbol: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("string->symbol: expected exactly 1 argument", argc, NULL);
   }
 
   if (argv[0]->type != L_STRING) {
@@ -787,12 +979,12 @@ static eval_result_t builtin_str_to_symbol(size_t argc, lval_t **argv, env_t *en
     return eval_errf("string->symbol: failed to intern symbol '%.*s'", (int)len, s);
   }
 
-  return eval_ok(lval_intern(interned));
+  return eval_ok(lval_symbol(interned));
 }
 
 static eval_result_t builtin_apply(size_t argc, lval_t **argv, env_t *env) {
   if (argc < 2) {
-    return eval_errf("apply: expected at least 2 arguments, got %zu", argc);
+    return eval_err_arity("apply: expected at least 2 arguments", argc, NULL);
   }
 
   lval_t *fn = argv[0];
@@ -801,7 +993,7 @@ static eval_result_t builtin_apply(size_t argc, lval_t **argv, env_t *env) {
   }
 
   if (fn->type == L_SYMBOL) {
-    lval_t *binding = env_get_ref(env, fn->as.symbol.name);
+    lval_t *binding = env_get_symbol(env, fn->as.symbol.name);
     if (!binding || (binding->type != L_FUNCTION && binding->type != L_NATIVE)) {
       return eval_errf("apply: symbol '%s' is not bound to a function", fn->as.symbol.name);
     }
@@ -819,29 +1011,22 @@ static eval_result_t builtin_apply(size_t argc, lval_t **argv, env_t *env) {
     total++;
   }
 
-  lval_t **flat = malloc(sizeof(lval_t *) * total);
-  if (!flat) return eval_errf("apply: out of memory");
-
+  lval_t **flat = gc_stack_reserve(total);
   size_t idx = 0;
   for (size_t i = 1; i < argc - 1; i++) {
-    flat[idx++] = lval_copy(argv[i]);
+    flat[idx++] = argv[i];
   }
   for (lval_t *cur = last; cur->type == L_CONS; cur = cur->as.cons.cdr) {
-    flat[idx++] = lval_copy(cur->as.cons.car);
+    flat[idx++] = cur->as.cons.car;
   }
 
   eval_result_t result = evaluate_call(fn, total, flat, env);
-
-  // for (size_t i = 0; i < total; i++) {
-  //   lval_free(flat[i]);
-  // }
-  free(flat);
-
+  gc_stack_pop(total);
   return result;
 }
 
 static eval_result_t builtin_map(size_t argc, lval_t **argv, env_t *env) {
-  if (argc != 2) return eval_errf("map: expected at 2 arguments, got %zu", argc);
+  if (argc != 2) return eval_err_arity("map: expected at 2 arguments", argc, NULL);
 
   lval_t *fn = argv[0];
   lval_t *list = argv[1];
@@ -854,7 +1039,7 @@ static eval_result_t builtin_map(size_t argc, lval_t **argv, env_t *env) {
   }
 
   if (fn->type == L_SYMBOL) {
-    lval_t *binding = env_get_ref(env, fn->as.symbol.name);
+    lval_t *binding = env_get_symbol(env, fn->as.symbol.name);
     if (!binding || (binding->type != L_FUNCTION && binding->type != L_NATIVE)) {
       return eval_errf("map: symbol '%s' is not bound to a function", fn->as.symbol.name);
     }
@@ -864,7 +1049,8 @@ static eval_result_t builtin_map(size_t argc, lval_t **argv, env_t *env) {
     return eval_ok(lval_nil());
   }
 
-  lval_t *head = NULL;
+  // The partial result is rooted in a value stack slot across calls.
+  lval_t **head = gc_stack_reserve(1);
   lval_t *tail = NULL;
   lval_t *cur = list;
   for (; cur->type == L_CONS; cur = cur->as.cons.cdr) {
@@ -872,30 +1058,33 @@ static eval_result_t builtin_map(size_t argc, lval_t **argv, env_t *env) {
     lval_t *call_argv[1] = { arg0 };
     eval_result_t call_res = evaluate_call(fn, 1, call_argv, env);
     if (call_res.status != EVAL_OK) {
-      // if (head) lval_free(head);
+      gc_stack_pop(1);
       return call_res;
     }
 
     lval_t *node = lval_cons(call_res.result, NULL);
-    if (!head) {
-      head = tail = node;
+    if (!*head) {
+      *head = tail = node;
     } else {
       tail->as.cons.cdr = node;
       tail = node;
     }
   }
 
+  lval_t *out = *head;
+  gc_stack_pop(1);
   if (cur->type != L_NIL) {
-    // if (head) lval_free(head);
     return eval_errf("map: improper list");
   }
 
   tail->as.cons.cdr = lval_nil();
-  return eval_ok(head);
+  return eval_ok(out);
 }
 
 static eval_result_t builtin_reduce(size_t argc, lval_t **argv, env_t *env) {
-  if (argc != 2 && argc != 3) return eval_errf("reduce: expected 2 or 3 arguments, got %zu", argc);
+  if (argc != 2 && argc != 3) {
+    return eval_err_arity("reduce: expected 2 or 3 arguments", argc, NULL);
+  }
   lval_t *fn = argv[0];
   bool has_init = (argc == 3);
   lval_t *init = has_init ? argv[1] : NULL;
@@ -905,7 +1094,7 @@ static eval_result_t builtin_reduce(size_t argc, lval_t **argv, env_t *env) {
   if (list->type != L_CONS && list->type != L_NIL)
     return eval_errf("reduce: list argument must be a list, got %s", lval_type_name(list));
   if (fn->type == L_SYMBOL) {
-    lval_t *binding = env_get_ref(env, fn->as.symbol.name);
+    lval_t *binding = env_get_symbol(env, fn->as.symbol.name);
     if (!binding || (binding->type != L_FUNCTION && binding->type != L_NATIVE))
       return eval_errf("reduce: symbol '%s' is not bound to a function", fn->as.symbol.name);
     fn = binding;
@@ -914,25 +1103,27 @@ static eval_result_t builtin_reduce(size_t argc, lval_t **argv, env_t *env) {
     if (has_init) return eval_ok(lval_copy(init));
     return eval_errf("reduce: empty list with no initial value");
   }
-  lval_t *acc = has_init ? init : list->as.cons.car;
+  lval_t **acc = gc_stack_reserve(1);
+  *acc = has_init ? init : list->as.cons.car;
   bool acc_owned = false;
   lval_t *cur = has_init ? list : list->as.cons.cdr;
   for (; cur->type == L_CONS; cur = cur->as.cons.cdr) {
-    lval_t *call_argv[2] = { acc, cur->as.cons.car };
+    lval_t *call_argv[2] = { *acc, cur->as.cons.car };
     eval_result_t rr = evaluate_call(fn, 2, call_argv, env);
     if (rr.status != EVAL_OK) {
-      // if (acc_owned) lval_free(acc);
+      gc_stack_pop(1);
       return rr;
     }
-    acc = rr.result;
+    *acc = rr.result;
     acc_owned = true;
   }
+  lval_t *out = *acc;
+  gc_stack_pop(1);
   if (cur->type != L_NIL) {
-    // if (acc_owned) lval_free(acc);
     return eval_errf("reduce: improper list");
   }
-  if (acc_owned) return eval_ok(acc);
-  return eval_ok(lval_copy(acc));
+  if (acc_owned) return eval_ok(out);
+  return eval_ok(lval_copy(out));
 }
 
 static eval_result_t builtin_foldl(size_t argc, lval_t **argv, env_t *env) {
@@ -940,7 +1131,7 @@ static eval_result_t builtin_foldl(size_t argc, lval_t **argv, env_t *env) {
 }
 
 static eval_result_t builtin_foldr(size_t argc, lval_t **argv, env_t *env) {
-  if (argc != 2 && argc != 3) return eval_errf("foldr: expected 2 or 3 arguments, got %zu", argc);
+  if (argc != 2 && argc != 3) return eval_err_arity("foldr: expected 2 or 3 arguments", argc, NULL);
   lval_t *fn = argv[0];
   bool has_init = (argc == 3);
   lval_t *init = has_init ? argv[1] : NULL;
@@ -950,7 +1141,7 @@ static eval_result_t builtin_foldr(size_t argc, lval_t **argv, env_t *env) {
   if (list->type != L_CONS && list->type != L_NIL)
     return eval_errf("foldr: list argument must be a list, got %s", lval_type_name(list));
   if (fn->type == L_SYMBOL) {
-    lval_t *binding = env_get_ref(env, fn->as.symbol.name);
+    lval_t *binding = env_get_symbol(env, fn->as.symbol.name);
     if (!binding || (binding->type != L_FUNCTION && binding->type != L_NATIVE))
       return eval_errf("foldr: symbol '%s' is not bound to a function", fn->as.symbol.name);
     fn = binding;
@@ -971,31 +1162,33 @@ static eval_result_t builtin_foldr(size_t argc, lval_t **argv, env_t *env) {
   for (cur = list; cur->type == L_CONS; cur = cur->as.cons.cdr)
     elems[k++] = cur->as.cons.car;
 
-  lval_t *acc;
+  lval_t **acc = gc_stack_reserve(1);
   bool acc_owned = false;
   ssize_t i = (ssize_t)n - 1;
   if (has_init)
-    acc = init;
+    *acc = init;
   else
-    acc = elems[i--];
+    *acc = elems[i--];
   for (; i >= 0; i--) {
-    lval_t *call_argv[2] = { elems[i], acc };
+    lval_t *call_argv[2] = { elems[i], *acc };
     eval_result_t rr = evaluate_call(fn, 2, call_argv, env);
     if (rr.status != EVAL_OK) {
-      // if (acc_owned) lval_free(acc);
+      gc_stack_pop(1);
       free(elems);
       return rr;
     }
-    acc = rr.result;
+    *acc = rr.result;
     acc_owned = true;
   }
+  lval_t *out = *acc;
+  gc_stack_pop(1);
   free(elems);
-  if (acc_owned) return eval_ok(acc);
-  return eval_ok(lval_copy(acc));
+  if (acc_owned) return eval_ok(out);
+  return eval_ok(lval_copy(out));
 }
 
 static eval_result_t builtin_filter(size_t argc, lval_t **argv, env_t *env) {
-  if (argc != 2) return eval_errf("filter: expected 2 arguments, got %zu", argc);
+  if (argc != 2) return eval_err_arity("filter: expected 2 arguments", argc, NULL);
   lval_t *fn = argv[0];
   lval_t *list = argv[1];
   if (fn->type != L_FUNCTION && fn->type != L_SYMBOL && fn->type != L_NATIVE)
@@ -1003,7 +1196,7 @@ static eval_result_t builtin_filter(size_t argc, lval_t **argv, env_t *env) {
   if (list->type != L_CONS && list->type != L_NIL)
     return eval_errf("filter: second argument must be a list, got %s", lval_type_name(list));
   if (fn->type == L_SYMBOL) {
-    lval_t *binding = env_get_ref(env, fn->as.symbol.name);
+    lval_t *binding = env_get_symbol(env, fn->as.symbol.name);
     if (!binding || (binding->type != L_FUNCTION && binding->type != L_NATIVE))
       return eval_errf("filter: symbol '%s' is not bound to a function", fn->as.symbol.name);
     fn = binding;
@@ -1013,7 +1206,7 @@ static eval_result_t builtin_filter(size_t argc, lval_t **argv, env_t *env) {
     return eval_ok(lval_nil());
   }
 
-  lval_t *head = NULL;
+  lval_t **head = gc_stack_reserve(1);
   lval_t *tail = NULL;
   lval_t *cur = list;
   for (; cur->type == L_CONS; cur = cur->as.cons.cdr) {
@@ -1021,49 +1214,1126 @@ static eval_result_t builtin_filter(size_t argc, lval_t **argv, env_t *env) {
     lval_t *call_argv[1] = { arg0 };
     eval_result_t call_res = evaluate_call(fn, 1, call_argv, env);
     if (call_res.status != EVAL_OK) {
-      // if (head) lval_free(head);
+      gc_stack_pop(1);
       return call_res;
     }
     if (call_res.result->type != L_BOOL) {
-      // if (head) lval_free(head);
-      // lval_free(call_res.result);
+      gc_stack_pop(1);
       return eval_errf("filter: predicate must return a boolean");
     }
 
     if (call_res.result->as.boolean) {
       lval_t *node = lval_cons(lval_copy(arg0), NULL);
-      if (!head) {
-        head = tail = node;
+      if (!*head) {
+        *head = tail = node;
       } else {
         tail->as.cons.cdr = node;
         tail = node;
       }
     }
-    // lval_free(call_res.result);
   }
+  lval_t *out = *head;
+  gc_stack_pop(1);
   if (cur->type != L_NIL) {
-    // if (head) lval_free(head);
     return eval_errf("filter: improper list");
   }
   if (tail) tail->as.cons.cdr = lval_nil();
-  return eval_ok(head ? head : lval_nil());
+  return eval_ok(out ? out : lval_nil());
+}
+
+// Promises and streams. A stream is nil or a pair whose cdr is a promise of
+// the rest of the stream; a promise of a stream stands for the stream, and
+// plain lists work too. The stream builtins return their first element at
+// once and a promise that calls the builtin again on the rest, so a
+// pipeline only holds the elements in flight.
+
+// The value of `p`: its memoized value if it is a promise, `p` itself
+// otherwise.
+static eval_result_t force(lval_t *p, env_t *env) {
+  if (p->type != L_PROMISE) return eval_ok(p);
+  if (p->as.promise.value) return eval_ok(p->as.promise.value);
+  // A recursive force may memoize the promise and drop what it holds while
+  // this one still runs, so the call gets copies.
+  lval_t **slots = gc_stack_reserve(3);
+  slots[0] = p;
+  eval_result_t r;
+  if (p->as.promise.fn) {
+    slots[1] = p->as.promise.args[0];
+    slots[2] = p->as.promise.args[1];
+    r = ((builtin_fn)p->as.promise.fn)(2, slots + 1, env);
+  } else {
+    env_t *frame = p->as.promise.env;
+    env_retain(frame);
+    gc_push_frame(frame);
+    r = evaluate_single(p->as.promise.expr, frame);
+    gc_pop_frame();
+    env_release(frame);
+  }
+  gc_stack_pop(3);
+  if (r.status != EVAL_OK) return r;
+  if (!p->as.promise.value) {
+    p->as.promise.value = r.result;
+    if (p->as.promise.env) env_release(p->as.promise.env);
+    p->as.promise.expr = NULL;
+    p->as.promise.env = NULL;
+    p->as.promise.fn = NULL;
+    p->as.promise.args[0] = p->as.promise.args[1] = NULL;
+  }
+  return eval_ok(p->as.promise.value);
+}
+
+static eval_result_t builtin_force(size_t argc, lval_t **argv, env_t *env) {
+  if (argc != 1) return eval_err_arity("force: expected exactly 1 argument", argc, NULL);
+  return force(argv[0], env);
+}
+
+static eval_result_t builtin_is_promise(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("promise?: expected exactly 1 argument", argc, NULL);
+  return eval_ok(lval_bool(argv[0]->type == L_PROMISE));
+}
+
+// Forces the stream in `*slot` in place.
+static eval_result_t stream_force(const char *who, lval_t **slot, env_t *env) {
+  eval_result_t r = force(*slot, env);
+  if (r.status != EVAL_OK) return r;
+  if (r.result->type != L_CONS && r.result->type != L_NIL) {
+    return eval_errf("%s: expected a stream, got %s", who, lval_type_name(r.result));
+  }
+  *slot = r.result;
+  return r;
+}
+
+// Resolves `fn`, the `pos`th (1-based, at most 3) argument of `who`, to the
+// function it names.
+static eval_result_t function_arg(const char *who, size_t pos, lval_t *fn, env_t *env) {
+  static const char *const k_ordinals[] = { "first", "second", "third" };
+  if (fn->type != L_FUNCTION && fn->type != L_SYMBOL && fn->type != L_NATIVE) {
+    return eval_errf("%s: %s argument must be a function or symbol", who, k_ordinals[pos - 1]);
+  }
+  if (fn->type == L_SYMBOL) {
+    lval_t *binding = env_get_symbol(env, fn->as.symbol.name);
+    if (!binding || (binding->type != L_FUNCTION && binding->type != L_NATIVE)) {
+      return eval_errf("%s: symbol '%s' is not bound to a function", who, fn->as.symbol.name);
+    }
+    fn = binding;
+  }
+  return eval_ok(fn);
+}
+
+static eval_result_t builtin_stream_car(size_t argc, lval_t **argv, env_t *env) {
+  if (argc != 1) return eval_err_arity("stream-car: expected exactly 1 argument", argc, NULL);
+  lval_t **s = gc_stack_reserve(1);
+  *s = argv[0];
+  eval_result_t r = stream_force("stream-car", s, env);
+  gc_stack_pop(1);
+  if (r.status != EVAL_OK) return r;
+  if (r.result->type != L_CONS) return eval_errf("stream-car: empty stream");
+  return eval_ok(r.result->as.cons.car);
+}
+
+static eval_result_t builtin_stream_cdr(size_t argc, lval_t **argv, env_t *env) {
+  if (argc != 1) return eval_err_arity("stream-cdr: expected exactly 1 argument", argc, NULL);
+  lval_t **s = gc_stack_reserve(1);
+  *s = argv[0];
+  eval_result_t r = stream_force("stream-cdr", s, env);
+  if (r.status == EVAL_OK) {
+    if (r.result->type != L_CONS) {
+      gc_stack_pop(1);
+      return eval_errf("stream-cdr: empty stream");
+    }
+    *s = r.result->as.cons.cdr;
+    r = stream_force("stream-cdr", s, env);
+  }
+  gc_stack_pop(1);
+  return r;
+}
+
+static eval_result_t builtin_stream_map(size_t argc, lval_t **argv, env_t *env) {
+  if (argc != 2) return eval_err_arity("stream-map: expected 2 arguments", argc, NULL);
+  eval_result_t r = function_arg("stream-map", 1, argv[0], env);
+  if (r.status != EVAL_OK) return r;
+  lval_t **slots = gc_stack_reserve(2);
+  slots[0] = r.result;
+  slots[1] = argv[1];
+  r = stream_force("stream-map", &slots[1], env);
+  if (r.status == EVAL_OK && slots[1]->type == L_CONS) {
+    lval_t *s = slots[1];
+    r = evaluate_call(slots[0], 1, &s->as.cons.car, env);
+    if (r.status == EVAL_OK) {
+      lval_t *rest = lval_promise_call((void *)builtin_stream_map, slots[0], s->as.cons.cdr);
+      r = eval_ok(lval_cons(r.result, rest));
+    }
+  }
+  gc_stack_pop(2);
+  return r;
+}
+
+static eval_result_t builtin_stream_filter(size_t argc, lval_t **argv, env_t *env) {
+  if (argc != 2) return eval_err_arity("stream-filter: expected 2 arguments", argc, NULL);
+  eval_result_t r = function_arg("stream-filter", 1, argv[0], env);
+  if (r.status != EVAL_OK) return r;
+  lval_t **slots = gc_stack_reserve(2);
+  slots[0] = r.result;
+  slots[1] = argv[1];
+  for (;;) {
+    r = stream_force("stream-filter", &slots[1], env);
+    if (r.status != EVAL_OK || slots[1]->type != L_CONS) break;
+    lval_t *s = slots[1];
+    r = evaluate_call(slots[0], 1, &s->as.cons.car, env);
+    if (r.status != EVAL_OK) break;
+    if (r.result->type != L_BOOL) {
+      r = eval_errf("stream-filter: predicate must return a boolean");
+      break;
+    }
+    if (r.result->as.boolean) {
+      lval_t *rest = lval_promise_call((void *)builtin_stream_filter, slots[0], s->as.cons.cdr);
+      r = eval_ok(lval_cons(s->as.cons.car, rest));
+      break;
+    }
+    slots[1] = s->as.cons.cdr;
+  }
+  gc_stack_pop(2);
+  return r;
+}
+
+static eval_result_t builtin_stream_take(size_t argc, lval_t **argv, env_t *env) {
+  if (argc != 2) return eval_err_arity("stream-take: expected 2 arguments", argc, NULL);
+  if (argv[0]->type != L_INT) return eval_errf("stream-take: count must be an integer");
+  if (argv[0]->as.integer <= 0) return eval_ok(lval_nil());
+  lval_t **s = gc_stack_reserve(1);
+  *s = argv[1];
+  eval_result_t r = stream_force("stream-take", s, env);
+  if (r.status == EVAL_OK && (*s)->type == L_CONS) {
+    lval_t *rest = lval_promise_call((void *)builtin_stream_take,
+                                     lval_int(argv[0]->as.integer - 1), (*s)->as.cons.cdr);
+    r = eval_ok(lval_cons((*s)->as.cons.car, rest));
+  }
+  gc_stack_pop(1);
+  return r;
+}
+
+// (stream->list s [n]): the first `n` elements of `s`, or all of them.
+static eval_result_t builtin_stream_to_list(size_t argc, lval_t **argv, env_t *env) {
+  if (argc != 1 && argc != 2) {
+    return eval_err_arity("stream->list: expected 1 or 2 arguments", argc, NULL);
+  }
+  if (argc == 2 && argv[1]->type != L_INT) {
+    return eval_errf("stream->list: count must be an integer");
+  }
+  int64_t limit = argc == 2 ? argv[1]->as.integer : INT64_MAX;
+  lval_t **slots = gc_stack_reserve(2); // the stream and the list built so far
+  slots[0] = argv[0];
+  // The caller's slot would keep every forced element reachable.
+  argv[0] = NULL;
+  lval_t *tail = NULL;
+  eval_result_t r = eval_ok(NULL);
+  for (int64_t i = 0; i < limit; i++) {
+    r = stream_force("stream->list", &slots[0], env);
+    if (r.status != EVAL_OK || slots[0]->type != L_CONS) break;
+    lval_t *node = lval_cons(slots[0]->as.cons.car, NULL);
+    if (tail) {
+      tail->as.cons.cdr = node;
+    } else {
+      slots[1] = node;
+    }
+    tail = node;
+    slots[0] = slots[0]->as.cons.cdr;
+  }
+  lval_t *out = slots[1];
+  gc_stack_pop(2);
+  if (r.status != EVAL_OK) return r;
+  if (!tail) return eval_ok(lval_nil());
+  tail->as.cons.cdr = lval_nil();
+  return eval_ok(out);
+}
+
+// (stream-fold f init s): calls (f acc x) on each element in order.
+static eval_result_t builtin_stream_fold(size_t argc, lval_t **argv, env_t *env) {
+  if (argc != 3) return eval_err_arity("stream-fold: expected 3 arguments", argc, NULL);
+  eval_result_t r = function_arg("stream-fold", 1, argv[0], env);
+  if (r.status != EVAL_OK) return r;
+  lval_t **slots = gc_stack_reserve(4); // f, the stream, then the call's arguments
+  slots[0] = r.result;
+  slots[1] = argv[2];
+  slots[2] = argv[1];
+  // The caller's slot would keep every forced element reachable.
+  argv[2] = NULL;
+  for (;;) {
+    r = stream_force("stream-fold", &slots[1], env);
+    if (r.status != EVAL_OK) break;
+    if (slots[1]->type != L_CONS) {
+      r = eval_ok(slots[2]);
+      break;
+    }
+    slots[3] = slots[1]->as.cons.car;
+    slots[1] = slots[1]->as.cons.cdr;
+    r = evaluate_call(slots[0], 2, &slots[2], env);
+    if (r.status != EVAL_OK) break;
+    slots[2] = r.result;
+  }
+  gc_stack_pop(4);
+  return r;
+}
+
+// Vectors: fixed-size, mutable arrays of values with O(1) indexing.
+
+// Error texts of one vector builtin. eval_err keeps them unformatted, so
+// each builtin has its own.
+typedef struct {
+  ltype_t type; // L_VECTOR or L_F64VECTOR
+  const char *not_vector, *not_index, *out_of_range;
+} vector_errors_t;
+
+#define VECTOR_ERRORS(who)                                                                         \
+  { L_VECTOR, who ": expected a vector", who ": expected an integer index",                        \
+    who ": index out of range" }
+
+// Checks that `vec` has the type of `errors` and that `index` is in range.
+static eval_result_t vector_slot(const vector_errors_t *errors, lval_t *vec, lval_t *index,
+                                 size_t *out) {
+  if (vec->type != errors->type) return eval_err(EVAL_ERR_TYPE, errors->not_vector, vec);
+  if (index->type != L_INT) return eval_err(EVAL_ERR_TYPE, errors->not_index, index);
+  size_t count = vec->type == L_VECTOR ? vec->as.vector.count : vec->as.f64vector.count;
+  if (index->as.integer < 0 || (uint64_t)index->as.integer >= count) {
+    return eval_err(EVAL_ERR_VALUE, errors->out_of_range, index);
+  }
+  *out = (size_t)index->as.integer;
+  return eval_ok(vec);
+}
+
+static eval_result_t builtin_is_vector(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("vector?: expected exactly 1 argument", argc, NULL);
+  return eval_ok(lval_bool(argv[0]->type == L_VECTOR));
+}
+
+// (make-vector n [fill]): n slots holding `fill`, or nil.
+static eval_result_t builtin_make_vector(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1 && argc != 2) {
+    return eval_err_arity("make-vector: expected 1 or 2 arguments", argc, NULL);
+  }
+  if (argv[0]->type != L_INT) {
+    return eval_err(EVAL_ERR_TYPE, "make-vector: expected an integer size", argv[0]);
+  }
+  if (argv[0]->as.integer < 0) {
+    return eval_err(EVAL_ERR_VALUE, "make-vector: negative size", argv[0]);
+  }
+  lval_t *vec = lval_vector((size_t)argv[0]->as.integer, argc == 2 ? argv[1] : lval_nil());
+  if (!vec) {
+    return eval_err(EVAL_ERR_VALUE, "make-vector: cannot allocate a vector of size", argv[0]);
+  }
+  return eval_ok(vec);
+}
+
+static eval_result_t builtin_vector(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  lval_t *vec = lval_vector(argc, NULL);
+  if (!vec) return eval_errf("vector: allocation failed");
+  if (argc) memcpy(vec->as.vector.items, argv, argc * sizeof *argv);
+  return eval_ok(vec);
+}
+
+static eval_result_t builtin_vector_length(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("vector-length: expected exactly 1 argument", argc, NULL);
+  if (argv[0]->type != L_VECTOR) {
+    return eval_err(EVAL_ERR_TYPE, "vector-length: expected a vector", argv[0]);
+  }
+  return eval_ok(lval_int((int64_t)argv[0]->as.vector.count));
+}
+
+static eval_result_t builtin_vector_ref(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  static const vector_errors_t errors = VECTOR_ERRORS("vector-ref");
+  if (argc != 2) return eval_err_arity("vector-ref: expected exactly 2 arguments", argc, NULL);
+  size_t i;
+  eval_result_t r = vector_slot(&errors, argv[0], argv[1], &i);
+  if (r.status != EVAL_OK) return r;
+  return eval_ok(argv[0]->as.vector.items[i]);
+}
+
+// (vector-set! vec i x): stores x in slot i and returns the vector.
+static eval_result_t builtin_vector_set(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  static const vector_errors_t errors = VECTOR_ERRORS("vector-set!");
+  if (argc != 3) return eval_err_arity("vector-set!: expected exactly 3 arguments", argc, NULL);
+  size_t i;
+  eval_result_t r = vector_slot(&errors, argv[0], argv[1], &i);
+  if (r.status != EVAL_OK) return r;
+  argv[0]->as.vector.items[i] = argv[2];
+  return r;
+}
+
+// (vector-fill! vec x): stores x in every slot and returns the vector.
+static eval_result_t builtin_vector_fill(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 2) return eval_err_arity("vector-fill!: expected exactly 2 arguments", argc, NULL);
+  lval_t *vec = argv[0];
+  if (vec->type != L_VECTOR) return eval_err(EVAL_ERR_TYPE, "vector-fill!: expected a vector", vec);
+  for (size_t i = 0; i < vec->as.vector.count; i++) vec->as.vector.items[i] = argv[1];
+  return eval_ok(vec);
+}
+
+static eval_result_t builtin_list_to_vector(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("list->vector: expected exactly 1 argument", argc, NULL);
+  size_t n = 0;
+  lval_t *cur = argv[0];
+  for (; cur->type == L_CONS; cur = cur->as.cons.cdr) n++;
+  if (cur->type != L_NIL) {
+    return eval_err(EVAL_ERR_TYPE, "list->vector: expected a proper list", argv[0]);
+  }
+  lval_t *vec = lval_vector(n, NULL);
+  if (!vec) return eval_errf("list->vector: allocation failed");
+  cur = argv[0];
+  for (size_t i = 0; i < n; i++, cur = cur->as.cons.cdr) vec->as.vector.items[i] = cur->as.cons.car;
+  return eval_ok(vec);
+}
+
+static eval_result_t builtin_vector_to_list(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("vector->list: expected exactly 1 argument", argc, NULL);
+  lval_t *vec = argv[0];
+  if (vec->type != L_VECTOR) return eval_err(EVAL_ERR_TYPE, "vector->list: expected a vector", vec);
+  lval_t *list = lval_nil();
+  for (size_t i = vec->as.vector.count; i > 0; i--) {
+    list = lval_cons(vec->as.vector.items[i - 1], list);
+  }
+  return eval_ok(list);
+}
+
+// (vector-map fn vec): a new vector of fn applied to each slot.
+static eval_result_t builtin_vector_map(size_t argc, lval_t **argv, env_t *env) {
+  if (argc != 2) return eval_err_arity("vector-map: expected exactly 2 arguments", argc, NULL);
+  eval_result_t r = function_arg("vector-map", 1, argv[0], env);
+  if (r.status != EVAL_OK) return r;
+  lval_t *fn = r.result;
+  lval_t *vec = argv[1];
+  if (vec->type != L_VECTOR) return eval_err(EVAL_ERR_TYPE, "vector-map: expected a vector", vec);
+  lval_t *mapped = lval_vector(vec->as.vector.count, lval_nil());
+  if (!mapped) return eval_errf("vector-map: allocation failed");
+  // The result is rooted in a value stack slot across calls.
+  lval_t **out = gc_stack_reserve(1);
+  *out = mapped;
+  for (size_t i = 0; i < vec->as.vector.count; i++) {
+    lval_t *arg = vec->as.vector.items[i];
+    r = evaluate_call(fn, 1, &arg, env);
+    if (r.status != EVAL_OK) {
+      gc_stack_pop(1);
+      return r;
+    }
+    (*out)->as.vector.items[i] = r.result;
+  }
+  lval_t *result = *out;
+  gc_stack_pop(1);
+  return eval_ok(result);
+}
+
+// Hash tables. hashtable.c compares keys with strcmp, so a key is stored as
+// a string encoding it, and keys that should match encode the same. A symbol
+// key is its interned name, which needs no copy and whose hash is cached.
+// Every other encoding starts with LVAL_HASH_OWNED_KEY and is copied into
+// the table. In an equal table strings, lists and both kinds of vector
+// encode their contents; in an eq table they encode their address, as do functions and
+// other values without a printed form in either.
+typedef struct {
+  char *ptr; // `small` until the encoding outgrows it
+  size_t len, cap;
+  char small[128];
+} hash_key_t;
+
+static void key_put(hash_key_t *k, const char *s, size_t n) {
+  if (k->len + n + 1 > k->cap) {
+    size_t cap = k->cap * 2;
+    while (cap < k->len + n + 1) cap *= 2;
+    char *p = k->ptr == k->small ? malloc(cap) : realloc(k->ptr, cap);
+    if (!p) {
+      perror("malloc");
+      exit(EXIT_FAILURE);
+    }
+    if (k->ptr == k->small) memcpy(p, k->small, k->len);
+    k->ptr = p;
+    k->cap = cap;
+  }
+  memcpy(k->ptr + k->len, s, n);
+  k->len += n;
+  k->ptr[k->len] = '\0';
+}
+
+// `n` bytes after a tag and their length. NUL would end the key early, so it
+// is written as \x02 '0', and \x02 itself as \x02 '2'.
+static void key_put_bytes(hash_key_t *k, char tag, const char *s, size_t n) {
+  char head[32];
+  key_put(k, head, (size_t)snprintf(head, sizeof head, "%c%zu:", tag, n));
+  size_t run = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (s[i] != '\0' && s[i] != '\x02') continue;
+    key_put(k, s + run, i - run);
+    key_put(k, s[i] ? "\x02" "2" : "\x02" "0", 2);
+    run = i + 1;
+  }
+  key_put(k, s + run, n - run);
+}
+
+static void key_encode(hash_key_t *k, const lval_t *v, bool equal) {
+  char buf[64];
+  switch (v->type) {
+  case L_NIL:
+    key_put(k, "n", 1);
+    return;
+  case L_BOOL:
+    key_put(k, v->as.boolean ? "t" : "f", 1);
+    return;
+  case L_INT:
+    key_put(k, buf, (size_t)snprintf(buf, sizeof buf, "i%" PRId64 ";", v->as.integer));
+    return;
+  case L_NUM: {
+    double d = v->as.number == 0 ? 0.0 : v->as.number; // -0.0 matches 0.0
+    key_put(k, buf, (size_t)snprintf(buf, sizeof buf, "d%a;", d));
+    return;
+  }
+  case L_BIGNUM: {
+    char *digits = bignum_to_string(v->as.bignum);
+    key_put_bytes(k, 'b', digits, strlen(digits));
+    free(digits);
+    return;
+  }
+  case L_SYMBOL:
+    key_put_bytes(k, 'y', v->as.symbol.name, strlen(v->as.symbol.name));
+    return;
+  case L_STRING:
+    if (!equal) {
+      key_put(k, buf, (size_t)snprintf(buf, sizeof buf, "p%p;", (void *)v->as.string.ptr));
+      return;
+    }
+    key_put_bytes(k, 's', v->as.string.ptr, v->as.string.len);
+    return;
+  case L_CONS:
+    if (!equal) break;
+    key_put(k, "(", 1);
+    for (; v->type == L_CONS; v = v->as.cons.cdr) key_encode(k, v->as.cons.car, true);
+    if (v->type != L_NIL) {
+      key_put(k, ".", 1);
+      key_encode(k, v, true);
+    }
+    key_put(k, ")", 1);
+    return;
+  case L_VECTOR:
+    if (!equal) break;
+    key_put(k, "#(", 2);
+    for (size_t i = 0; i < v->as.vector.count; i++) key_encode(k, v->as.vector.items[i], true);
+    key_put(k, ")", 1);
+    return;
+  case L_F64VECTOR:
+    if (!equal) break;
+    key_put(k, "#f64(", 5);
+    for (size_t i = 0; i < v->as.f64vector.count; i++) {
+      double d = v->as.f64vector.items[i] == 0 ? 0.0 : v->as.f64vector.items[i];
+      key_put(k, buf, (size_t)snprintf(buf, sizeof buf, "%a;", d));
+    }
+    key_put(k, ")", 1);
+    return;
+  case L_NATIVE:
+    if (!equal || !v->as.native.name) break;
+    key_put_bytes(k, 'N', v->as.native.name, strlen(v->as.native.name));
+    return;
+  default:
+    break;
+  }
+  key_put(k, buf, (size_t)snprintf(buf, sizeof buf, "p%p;", (const void *)v));
+}
+
+// Encodes `key` for `table`, setting `hash` to its ht_hash_key. The result
+// lives until hash_key_free, and must be copied to be stored if owned.
+static const char *hash_key(hash_key_t *k, const lval_t *table, const lval_t *key,
+                            uint64_t *hash) {
+  k->ptr = k->small;
+  k->len = 0;
+  k->cap = sizeof k->small;
+  if (key->type == L_SYMBOL && key->as.symbol.name[0] != LVAL_HASH_OWNED_KEY) {
+    *hash = symbol_of(key->as.symbol.name)->hash;
+    return key->as.symbol.name;
+  }
+  key_put(k, (char[]){ LVAL_HASH_OWNED_KEY }, 1);
+  key_encode(k, key, table->as.hash.equal);
+  *hash = ht_hash_key(k->ptr);
+  return k->ptr;
+}
+
+static void hash_key_free(hash_key_t *k) {
+  if (k->ptr != k->small) free(k->ptr);
+}
+
+// The (key . value) pair stored for `key`, or NULL.
+static lval_t *hash_pair(const lval_t *table, const lval_t *key) {
+  hash_key_t k;
+  uint64_t hash;
+  const char *encoded = hash_key(&k, table, key, &hash);
+  void *pair = NULL;
+  ht_get_hashed(table->as.hash.table, encoded, hash, &pair);
+  hash_key_free(&k);
+  return pair;
+}
+
+static eval_result_t builtin_is_hash_table(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("hash-table?: expected exactly 1 argument", argc, NULL);
+  return eval_ok(lval_bool(argv[0]->type == L_HASHTABLE));
+}
+
+// (make-hash-table ['equal|'eq]): keys match by equal unless 'eq is given.
+static eval_result_t builtin_make_hash_table(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc > 1) return eval_err_arity("make-hash-table: expected at most 1 argument", argc, NULL);
+  bool equal = true;
+  if (argc == 1) {
+    lval_t *mode = argv[0];
+    if (mode->type != L_SYMBOL ||
+        (strcmp(mode->as.symbol.name, "equal") && strcmp(mode->as.symbol.name, "eq"))) {
+      return eval_err(EVAL_ERR_VALUE, "make-hash-table: expected 'equal or 'eq", mode);
+    }
+    equal = strcmp(mode->as.symbol.name, "equal") == 0;
+  }
+  return eval_ok(lval_hash_table(equal));
+}
+
+// (hash-ref table key [default]): the value of key, or default when it is
+// absent. Without a default an absent key is an error.
+static eval_result_t builtin_hash_ref(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 2 && argc != 3) {
+    return eval_err_arity("hash-ref: expected 2 or 3 arguments", argc, NULL);
+  }
+  if (argv[0]->type != L_HASHTABLE) {
+    return eval_err(EVAL_ERR_TYPE, "hash-ref: expected a hash table", argv[0]);
+  }
+  lval_t *pair = hash_pair(argv[0], argv[1]);
+  if (pair) return eval_ok(pair->as.cons.cdr);
+  if (argc == 3) return eval_ok(argv[2]);
+  return eval_err(EVAL_ERR_VALUE, "hash-ref: key not found", argv[1]);
+}
+
+// (hash-set! table key value): binds key to value and returns the table.
+static eval_result_t builtin_hash_set(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 3) return eval_err_arity("hash-set!: expected exactly 3 arguments", argc, NULL);
+  lval_t *table = argv[0];
+  if (table->type != L_HASHTABLE) {
+    return eval_err(EVAL_ERR_TYPE, "hash-set!: expected a hash table", table);
+  }
+  hash_key_t k;
+  uint64_t hash;
+  const char *encoded = hash_key(&k, table, argv[1], &hash);
+  void *pair = NULL;
+  if (ht_get_hashed(table->as.hash.table, encoded, hash, &pair)) {
+    ((lval_t *)pair)->as.cons.cdr = argv[2];
+  } else {
+    if (encoded[0] == LVAL_HASH_OWNED_KEY) {
+      encoded = strdup(encoded);
+      if (!encoded) {
+        perror("strdup");
+        exit(EXIT_FAILURE);
+      }
+    }
+    ht_error err = { 0 };
+    if (!ht_set_hashed(table->as.hash.table, encoded, hash, lval_cons(argv[1], argv[2]), &err)) {
+      fprintf(stderr, "hash-set!: %s\n", err.error_message ? err.error_message : "(unknown)");
+      exit(EXIT_FAILURE);
+    }
+  }
+  hash_key_free(&k);
+  return eval_ok(table);
+}
+
+// (hash-remove! table key): unbinds key if bound and returns the table.
+static eval_result_t builtin_hash_remove(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 2) return eval_err_arity("hash-remove!: expected exactly 2 arguments", argc, NULL);
+  lval_t *table = argv[0];
+  if (table->type != L_HASHTABLE) {
+    return eval_err(EVAL_ERR_TYPE, "hash-remove!: expected a hash table", table);
+  }
+  hash_key_t k;
+  uint64_t hash;
+  const char *encoded = hash_key(&k, table, argv[1], &hash);
+  const char *stored;
+  if (ht_remove(table->as.hash.table, encoded, &stored, NULL) &&
+      stored[0] == LVAL_HASH_OWNED_KEY) {
+    free((char *)stored);
+  }
+  hash_key_free(&k);
+  return eval_ok(table);
+}
+
+static eval_result_t builtin_hash_count(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("hash-count: expected exactly 1 argument", argc, NULL);
+  if (argv[0]->type != L_HASHTABLE) {
+    return eval_err(EVAL_ERR_TYPE, "hash-count: expected a hash table", argv[0]);
+  }
+  return eval_ok(lval_int((int64_t)argv[0]->as.hash.table->size));
+}
+
+// The (key . value) pairs of `table` as a list, in no particular order.
+static lval_t *hash_pairs(const lval_t *table) {
+  lval_t *list = lval_nil();
+  ht_iter it;
+  ht_iter_begin(table->as.hash.table, &it);
+  const char *key;
+  void *pair;
+  while (ht_iter_next(&it, &key, &pair)) list = lval_cons(pair, list);
+  return list;
+}
+
+// (hash-keys table): the keys, in no particular order.
+static eval_result_t builtin_hash_keys(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("hash-keys: expected exactly 1 argument", argc, NULL);
+  if (argv[0]->type != L_HASHTABLE) {
+    return eval_err(EVAL_ERR_TYPE, "hash-keys: expected a hash table", argv[0]);
+  }
+  lval_t *keys = lval_nil();
+  ht_iter it;
+  ht_iter_begin(argv[0]->as.hash.table, &it);
+  const char *key;
+  void *pair;
+  while (ht_iter_next(&it, &key, &pair)) keys = lval_cons(((lval_t *)pair)->as.cons.car, keys);
+  return eval_ok(keys);
+}
+
+// (hash-for-each table fn): calls (fn key value) for each entry present when
+// it starts, and returns nil. fn may change the table.
+static eval_result_t builtin_hash_for_each(size_t argc, lval_t **argv, env_t *env) {
+  if (argc != 2) return eval_err_arity("hash-for-each: expected exactly 2 arguments", argc, NULL);
+  if (argv[0]->type != L_HASHTABLE) {
+    return eval_err(EVAL_ERR_TYPE, "hash-for-each: expected a hash table", argv[0]);
+  }
+  eval_result_t r = function_arg("hash-for-each", 2, argv[1], env);
+  if (r.status != EVAL_OK) return r;
+  lval_t *fn = r.result;
+  // The pairs are rooted in a value stack slot across calls.
+  lval_t **pairs = gc_stack_reserve(1);
+  *pairs = hash_pairs(argv[0]);
+  for (lval_t *cur = *pairs; cur->type == L_CONS; cur = cur->as.cons.cdr) {
+    lval_t *pair = cur->as.cons.car;
+    lval_t *args[2] = { pair->as.cons.car, pair->as.cons.cdr };
+    r = evaluate_call(fn, 2, args, env);
+    if (r.status != EVAL_OK) {
+      gc_stack_pop(1);
+      return r;
+    }
+  }
+  gc_stack_pop(1);
+  return eval_ok(lval_nil());
+}
+
+// f64vectors: packed arrays of doubles. The arithmetic and reductions run
+// the SIMD kernels of f64vec.h; only f64vector-map calls back into Shrew.
+
+#define F64VECTOR_ERRORS(who)                                                                      \
+  { L_F64VECTOR, who ": expected an f64vector", who ": expected an integer index",                \
+    who ": index out of range" }
+
+// The f64vector argument `v` of `who`, or a type error.
+#define F64VECTOR_ARG(who, v)                                                                      \
+  do {                                                                                             \
+    if ((v)->type != L_F64VECTOR) {                                                                \
+      return eval_err(EVAL_ERR_TYPE, who ": expected an f64vector", (v));                          \
+    }                                                                                              \
+  } while (0)
+
+static eval_result_t builtin_is_f64vector(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("f64vector?: expected exactly 1 argument", argc, NULL);
+  return eval_ok(lval_bool(argv[0]->type == L_F64VECTOR));
+}
+
+// (make-f64vector n [fill]): n elements holding `fill`, or 0.
+static eval_result_t builtin_make_f64vector(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1 && argc != 2) {
+    return eval_err_arity("make-f64vector: expected 1 or 2 arguments", argc, NULL);
+  }
+  if (argv[0]->type != L_INT) {
+    return eval_err(EVAL_ERR_TYPE, "make-f64vector: expected an integer size", argv[0]);
+  }
+  if (argv[0]->as.integer < 0) {
+    return eval_err(EVAL_ERR_VALUE, "make-f64vector: negative size", argv[0]);
+  }
+  if (argc == 2 && !lval_is_number(argv[1])) {
+    return eval_err(EVAL_ERR_TYPE, "make-f64vector: expected a number to fill with", argv[1]);
+  }
+  lval_t *vec = lval_f64vector((size_t)argv[0]->as.integer);
+  if (!vec) {
+    return eval_err(EVAL_ERR_VALUE, "make-f64vector: cannot allocate a vector of size", argv[0]);
+  }
+  f64_fill(vec->as.f64vector.items, argc == 2 ? lval_to_double(argv[1]) : 0.0,
+           vec->as.f64vector.count);
+  return eval_ok(vec);
+}
+
+// Copies the numbers `items` into a new f64vector for `who`, or fails naming
+// the first element that is not one.
+static eval_result_t f64vector_of(const char *who, const char *not_number, lval_t **items,
+                                  size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (!lval_is_number(items[i])) return eval_err(EVAL_ERR_TYPE, not_number, items[i]);
+  }
+  lval_t *vec = lval_f64vector(count);
+  if (!vec) return eval_errf("%s: allocation failed", who);
+  for (size_t i = 0; i < count; i++) vec->as.f64vector.items[i] = lval_to_double(items[i]);
+  return eval_ok(vec);
+}
+
+static eval_result_t builtin_f64vector(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  return f64vector_of("f64vector", "f64vector: expected numbers", argv, argc);
+}
+
+static eval_result_t builtin_f64vector_length(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("f64vector-length: expected exactly 1 argument", argc, NULL);
+  F64VECTOR_ARG("f64vector-length", argv[0]);
+  return eval_ok(lval_int((int64_t)argv[0]->as.f64vector.count));
+}
+
+static eval_result_t builtin_f64vector_ref(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  static const vector_errors_t errors = F64VECTOR_ERRORS("f64vector-ref");
+  if (argc != 2) return eval_err_arity("f64vector-ref: expected exactly 2 arguments", argc, NULL);
+  size_t i;
+  eval_result_t r = vector_slot(&errors, argv[0], argv[1], &i);
+  if (r.status != EVAL_OK) return r;
+  return eval_ok(lval_num(argv[0]->as.f64vector.items[i]));
+}
+
+// (f64vector-set! vec i x): stores x in element i and returns the vector.
+static eval_result_t builtin_f64vector_set(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  static const vector_errors_t errors = F64VECTOR_ERRORS("f64vector-set!");
+  if (argc != 3) return eval_err_arity("f64vector-set!: expected exactly 3 arguments", argc, NULL);
+  size_t i;
+  eval_result_t r = vector_slot(&errors, argv[0], argv[1], &i);
+  if (r.status != EVAL_OK) return r;
+  if (!lval_is_number(argv[2])) {
+    return eval_err(EVAL_ERR_TYPE, "f64vector-set!: expected a number", argv[2]);
+  }
+  argv[0]->as.f64vector.items[i] = lval_to_double(argv[2]);
+  return eval_ok(argv[0]);
+}
+
+// (f64vector-fill! vec x): stores x in every element and returns the vector.
+static eval_result_t builtin_f64vector_fill(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 2) return eval_err_arity("f64vector-fill!: expected exactly 2 arguments", argc, NULL);
+  F64VECTOR_ARG("f64vector-fill!", argv[0]);
+  if (!lval_is_number(argv[1])) {
+    return eval_err(EVAL_ERR_TYPE, "f64vector-fill!: expected a number", argv[1]);
+  }
+  f64_fill(argv[0]->as.f64vector.items, lval_to_double(argv[1]), argv[0]->as.f64vector.count);
+  return eval_ok(argv[0]);
+}
+
+static eval_result_t builtin_list_to_f64vector(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("list->f64vector: expected exactly 1 argument", argc, NULL);
+  size_t n = 0;
+  lval_t *cur = argv[0];
+  for (; cur->type == L_CONS; cur = cur->as.cons.cdr) n++;
+  if (cur->type != L_NIL) {
+    return eval_err(EVAL_ERR_TYPE, "list->f64vector: expected a proper list", argv[0]);
+  }
+  lval_t *vec = lval_f64vector(n);
+  if (!vec) return eval_errf("list->f64vector: allocation failed");
+  cur = argv[0];
+  for (size_t i = 0; i < n; i++, cur = cur->as.cons.cdr) {
+    if (!lval_is_number(cur->as.cons.car)) {
+      return eval_err(EVAL_ERR_TYPE, "list->f64vector: expected numbers", cur->as.cons.car);
+    }
+    vec->as.f64vector.items[i] = lval_to_double(cur->as.cons.car);
+  }
+  return eval_ok(vec);
+}
+
+static eval_result_t builtin_f64vector_to_list(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("f64vector->list: expected exactly 1 argument", argc, NULL);
+  F64VECTOR_ARG("f64vector->list", argv[0]);
+  lval_t *list = lval_nil();
+  for (size_t i = argv[0]->as.f64vector.count; i > 0; i--) {
+    list = lval_cons(lval_num(argv[0]->as.f64vector.items[i - 1]), list);
+  }
+  return eval_ok(list);
+}
+
+static eval_result_t builtin_vector_to_f64vector(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) {
+    return eval_err_arity("vector->f64vector: expected exactly 1 argument", argc, NULL);
+  }
+  if (argv[0]->type != L_VECTOR) {
+    return eval_err(EVAL_ERR_TYPE, "vector->f64vector: expected a vector", argv[0]);
+  }
+  return f64vector_of("vector->f64vector", "vector->f64vector: expected numbers",
+                      argv[0]->as.vector.items, argv[0]->as.vector.count);
+}
+
+static eval_result_t builtin_f64vector_to_vector(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) {
+    return eval_err_arity("f64vector->vector: expected exactly 1 argument", argc, NULL);
+  }
+  F64VECTOR_ARG("f64vector->vector", argv[0]);
+  size_t n = argv[0]->as.f64vector.count;
+  lval_t *vec = lval_vector(n, NULL);
+  if (!vec) return eval_errf("f64vector->vector: allocation failed");
+  for (size_t i = 0; i < n; i++) vec->as.vector.items[i] = lval_num(argv[0]->as.f64vector.items[i]);
+  return eval_ok(vec);
+}
+
+// Checks the two f64vector arguments of an elementwise or dot builtin.
+#define F64VECTOR_PAIR(who, argc, argv)                                                            \
+  do {                                                                                             \
+    if ((argc) != 2) return eval_err_arity(who ": expected exactly 2 arguments", (argc), NULL);    \
+    F64VECTOR_ARG(who, (argv)[0]);                                                                 \
+    F64VECTOR_ARG(who, (argv)[1]);                                                                 \
+    if ((argv)[0]->as.f64vector.count != (argv)[1]->as.f64vector.count) {                         \
+      return eval_errf(who ": lengths differ: %zu and %zu", (argv)[0]->as.f64vector.count,         \
+                       (argv)[1]->as.f64vector.count);                                             \
+    }                                                                                              \
+  } while (0)
+
+// (f64vector-add a b): a new vector of the elementwise sums.
+static eval_result_t builtin_f64vector_add(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  F64VECTOR_PAIR("f64vector-add", argc, argv);
+  lval_t *out = lval_f64vector(argv[0]->as.f64vector.count);
+  if (!out) return eval_errf("f64vector-add: allocation failed");
+  f64_add(out->as.f64vector.items, argv[0]->as.f64vector.items, argv[1]->as.f64vector.items,
+          out->as.f64vector.count);
+  return eval_ok(out);
+}
+
+// (f64vector-mul a b): a new vector of the elementwise products.
+static eval_result_t builtin_f64vector_mul(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  F64VECTOR_PAIR("f64vector-mul", argc, argv);
+  lval_t *out = lval_f64vector(argv[0]->as.f64vector.count);
+  if (!out) return eval_errf("f64vector-mul: allocation failed");
+  f64_mul(out->as.f64vector.items, argv[0]->as.f64vector.items, argv[1]->as.f64vector.items,
+          out->as.f64vector.count);
+  return eval_ok(out);
+}
+
+// (f64vector-scale a k): a new vector of the elements times k.
+static eval_result_t builtin_f64vector_scale(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 2) return eval_err_arity("f64vector-scale: expected exactly 2 arguments", argc, NULL);
+  F64VECTOR_ARG("f64vector-scale", argv[0]);
+  if (!lval_is_number(argv[1])) {
+    return eval_err(EVAL_ERR_TYPE, "f64vector-scale: expected a number", argv[1]);
+  }
+  lval_t *out = lval_f64vector(argv[0]->as.f64vector.count);
+  if (!out) return eval_errf("f64vector-scale: allocation failed");
+  f64_scale(out->as.f64vector.items, argv[0]->as.f64vector.items, lval_to_double(argv[1]),
+            out->as.f64vector.count);
+  return eval_ok(out);
+}
+
+static eval_result_t builtin_f64vector_dot(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  F64VECTOR_PAIR("f64vector-dot", argc, argv);
+  return eval_ok(lval_num(f64_dot(argv[0]->as.f64vector.items, argv[1]->as.f64vector.items,
+                                  argv[0]->as.f64vector.count)));
+}
+
+static eval_result_t builtin_f64vector_sum(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("f64vector-sum: expected exactly 1 argument", argc, NULL);
+  F64VECTOR_ARG("f64vector-sum", argv[0]);
+  return eval_ok(lval_num(f64_sum(argv[0]->as.f64vector.items, argv[0]->as.f64vector.count)));
+}
+
+static eval_result_t builtin_f64vector_min(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("f64vector-min: expected exactly 1 argument", argc, NULL);
+  F64VECTOR_ARG("f64vector-min", argv[0]);
+  if (argv[0]->as.f64vector.count == 0) return eval_errf("f64vector-min: empty f64vector");
+  return eval_ok(lval_num(f64_min(argv[0]->as.f64vector.items, argv[0]->as.f64vector.count)));
+}
+
+static eval_result_t builtin_f64vector_max(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("f64vector-max: expected exactly 1 argument", argc, NULL);
+  F64VECTOR_ARG("f64vector-max", argv[0]);
+  if (argv[0]->as.f64vector.count == 0) return eval_errf("f64vector-max: empty f64vector");
+  return eval_ok(lval_num(f64_max(argv[0]->as.f64vector.items, argv[0]->as.f64vector.count)));
+}
+
+// (f64vector-map fn vec): a new f64vector of fn applied to each element. fn
+// must return numbers.
+static eval_result_t builtin_f64vector_map(size_t argc, lval_t **argv, env_t *env) {
+  if (argc != 2) return eval_err_arity("f64vector-map: expected exactly 2 arguments", argc, NULL);
+  eval_result_t r = function_arg("f64vector-map", 1, argv[0], env);
+  if (r.status != EVAL_OK) return r;
+  lval_t *fn = r.result;
+  lval_t *vec = argv[1];
+  F64VECTOR_ARG("f64vector-map", vec);
+  lval_t *mapped = lval_f64vector(vec->as.f64vector.count);
+  if (!mapped) return eval_errf("f64vector-map: allocation failed");
+  // The result is rooted in a value stack slot across calls.
+  lval_t **out = gc_stack_reserve(1);
+  *out = mapped;
+  for (size_t i = 0; i < vec->as.f64vector.count; i++) {
+    lval_t *arg = lval_num(vec->as.f64vector.items[i]);
+    r = evaluate_call(fn, 1, &arg, env);
+    if (r.status == EVAL_OK && !lval_is_number(r.result)) {
+      r = eval_err(EVAL_ERR_TYPE, "f64vector-map: expected the function to return a number",
+                   r.result);
+    }
+    if (r.status != EVAL_OK) {
+      gc_stack_pop(1);
+      return r;
+    }
+    (*out)->as.f64vector.items[i] = lval_to_double(r.result);
+  }
+  lval_t *result = *out;
+  gc_stack_pop(1);
+  return eval_ok(result);
+}
+
+// (f64vector-kernels): the kernels picked for this CPU, "avx2", "sse2" or
+// "scalar".
+static eval_result_t builtin_f64vector_kernels(size_t argc, lval_t **argv, env_t *env) {
+  (void)argv;
+  (void)env;
+  if (argc != 0) return eval_err_arity("f64vector-kernels: expected no arguments", argc, NULL);
+  const char *name = f64_kernels();
+  return eval_ok(lval_string_copy(name, strlen(name)));
 }
 
 static eval_result_t builtin_error(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 1) {
-    return eval_errf("error: expected exactly 1 argument, got %zu", argc);
+    return eval_err_arity("error: expected exactly 1 argument", argc, NULL);
   }
-  if (argv[0]->type != L_STRING) {
-    return eval_errf("error: expected argument of type string");
+  return eval_err(EVAL_ERR_USER, "error", argv[0]);
+}
+
+// Caught errors (see the try special form).
+static eval_result_t builtin_is_error(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("error?: expected exactly 1 argument", argc, NULL);
+  return eval_ok(lval_bool(argv[0]->type == L_ERROR));
+}
+
+static eval_result_t builtin_error_message(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("error-message: expected exactly 1 argument", argc, NULL);
+  if (argv[0]->type != L_ERROR) {
+    return eval_err(EVAL_ERR_TYPE, "error-message: expected an error", argv[0]);
+  }
+  lval_t *e = argv[0];
+  eval_result_t r = { .status = EVAL_ERR,
+                      .error_code = e->as.error.code,
+                      .error_owned = e->as.error.owned,
+                      .error_arg = e->as.error.arg,
+                      .result = e->as.error.value,
+                      .error_message = e->as.error.message };
+  const char *text = eval_error_message(&r);
+  e->as.error.message = r.error_message;
+  e->as.error.owned = r.error_owned;
+  return eval_ok(lval_string_copy(text, strlen(text)));
+}
+
+static eval_result_t builtin_error_value(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("error-value: expected exactly 1 argument", argc, NULL);
+  if (argv[0]->type != L_ERROR) {
+    return eval_err(EVAL_ERR_TYPE, "error-value: expected an error", argv[0]);
+  }
+  const lval_t *e = argv[0];
+  if (e->as.error.value) return eval_ok(e->as.error.value);
+  if (e->as.error.code == EVAL_ERR_UNBOUND && !e->as.error.owned) {
+    return eval_ok(lval_symbol(e->as.error.message));
+  }
+  return eval_ok(lval_nil());
+}
+
+static eval_result_t builtin_error_kind(size_t argc, lval_t **argv, env_t *env) {
+  (void)env;
+  if (argc != 1) return eval_err_arity("error-kind: expected exactly 1 argument", argc, NULL);
+  if (argv[0]->type != L_ERROR) {
+    return eval_err(EVAL_ERR_TYPE, "error-kind: expected an error", argv[0]);
+  }
+  static const char *const k_kinds[] = {
+    [EVAL_ERR_MESSAGE] = "message", [EVAL_ERR_TYPE] = "type",  [EVAL_ERR_VALUE] = "value",
+    [EVAL_ERR_UNBOUND] = "unbound", [EVAL_ERR_ARITY] = "arity", [EVAL_ERR_USER] = "user",
+  };
+  return eval_ok(lval_intern(k_kinds[argv[0]->as.error.code]));
+}
+
+static double monotonic_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// (bench thunk n): calls the thunk n / 10 + 1 times to warm up and then n
+// times, timing each call. Returns (min t median t p99 t allocations k) with
+// the times in milliseconds and k the mean objects allocated per call.
+static eval_result_t builtin_bench(size_t argc, lval_t **argv, env_t *env) {
+  if (argc != 2) return eval_err_arity("bench: expected exactly 2 arguments", argc, NULL);
+  lval_t *fn = argv[0];
+  if (fn->type != L_FUNCTION && fn->type != L_NATIVE) {
+    return eval_err(EVAL_ERR_TYPE, "bench: expected a function", fn);
+  }
+  if (argv[1]->type != L_INT || argv[1]->as.integer < 1) {
+    return eval_err(EVAL_ERR_VALUE, "bench: expected a positive count", argv[1]);
+  }
+  size_t n = (size_t)argv[1]->as.integer;
+  double *times = malloc(n * sizeof *times);
+  if (!times) return eval_errf("bench: memory allocation failed");
+  size_t warmup = n / 10 + 1;
+  size_t allocations = 0;
+  for (size_t i = 0; i < warmup + n; i++) {
+    size_t allocated = gc_allocation_count();
+    double start = monotonic_ms();
+    eval_result_t r = evaluate_call(fn, 0, NULL, env);
+    double elapsed = monotonic_ms() - start;
+    if (r.status != EVAL_OK) {
+      free(times);
+      return r;
+    }
+    if (i < warmup) continue;
+    times[i - warmup] = elapsed;
+    allocations += gc_allocation_count() - allocated;
+  }
+  qsort(times, n, sizeof *times, compare_doubles);
+  double median = n % 2 ? times[n / 2] : (times[n / 2 - 1] + times[n / 2]) / 2;
+  // Nearest rank: the smallest time at least 99% of the calls did not exceed.
+  double p99 = times[(n * 99 + 99) / 100 - 1];
+  const char *const keys[] = { "min", "median", "p99", "allocations" };
+  double values[] = { times[0], median, p99, (double)allocations / n };
+  free(times);
+  lval_t *out = lval_nil();
+  for (size_t i = sizeof keys / sizeof keys[0]; i-- > 0;) {
+    out = lval_cons(lval_intern(keys[i]), lval_cons(lval_num(values[i]), out));
   }
-  return eval_errf("error: %.*s", (int)argv[0]->as.string.len, argv[0]->as.string.ptr);
+  return eval_ok(out);
 }
 
 static eval_result_t builtin_gensym(size_t argc, lval_t **argv, env_t *env) {
   (void)env;
   if (argc != 0 && argc != 1) {
-    return eval_errf("gensym: expected 0 or 1 arguments, got %zu", argc);
+    return eval_err_arity("gensym: expected 0 or 1 arguments", argc, NULL);
   }
 
   if (argc == 1 && argv[0]->type != L_STRING) {
@@ -1091,7 +2361,7 @@ static eval_result_t builtin_gensym(size_t argc, lval_t **argv, env_t *env) {
   if (!interned) {
     return eval_errf("gensym: failed to intern symbol");
   }
-  return eval_ok(lval_intern(interned));
+  return eval_ok(lval_symbol(interned));
 }
 
 static s_expression_t *sexp_from_lval(const lval_t *v) {
@@ -1104,6 +2374,9 @@ static s_expression_t *sexp_from_lval(const lval_t *v) {
     e->data.list.count = 0;
     e->data.list.elements = NULL;
     e->data.list.tail = NULL;
+    e->data.list.line = 0;
+    e->data.list.cache = (call_cache_t){ 0 };
+    e->data.list.fold = (fold_info_t){ 0 };
   } break;
   case L_BOOL: {
     e = malloc(sizeof *e);
@@ -1117,6 +2390,18 @@ static s_expression_t *sexp_from_lval(const lval_t *v) {
     e->data.atom.type = ATOM_NUMBER;
     e->data.atom.value.number = v->as.number;
   } break;
+  case L_INT: {
+    e = malloc(sizeof *e);
+    e->type = NODE_ATOM;
+    e->data.atom.type = ATOM_INTEGER;
+    e->data.atom.value.integer = v->as.integer;
+  } break;
+  case L_BIGNUM: {
+    e = malloc(sizeof *e);
+    e->type = NODE_ATOM;
+    e->data.atom.type = ATOM_BIGNUM;
+    e->data.atom.value.bignum = bignum_copy(v->as.bignum);
+  } break;
   case L_STRING: {
     e = malloc(sizeof *e);
     e->type = NODE_ATOM;
@@ -1135,7 +2420,7 @@ static s_expression_t *sexp_from_lval(const lval_t *v) {
     e = malloc(sizeof *e);
     e->type = NODE_ATOM;
     e->data.atom.type = ATOM_SYMBOL;
-    e->data.atom.value.string = (char *)v->as.symbol.name;
+    e->data.atom.value.symbol = v->as.symbol.name;
   } break;
   case L_CONS: {
     size_t n = 0;
@@ -1150,6 +2435,9 @@ static s_expression_t *sexp_from_lval(const lval_t *v) {
     e->data.list.count = n;
     e->data.list.elements = calloc(n, sizeof(s_expression_t *));
     e->data.list.tail = NULL;
+    e->data.list.line = 0;
+    e->data.list.cache = (call_cache_t){ 0 };
+    e->data.list.fold = (fold_info_t){ 0 };
     const lval_t *run = v;
     for (size_t i = 0; i < n; i++) {
       e->data.list.elements[i] = sexp_from_lval(run->as.cons.car);
@@ -1174,10 +2462,12 @@ static void sexp_free_owned(s_expression_t *sexp) {
     if (sexp->data.atom.type == ATOM_STRING && sexp->data.atom.value.string) {
       free(sexp->data.atom.value.string);
     }
+    if (sexp->data.atom.type == ATOM_BIGNUM) bignum_free(sexp->data.atom.value.bignum);
     free(sexp);
     return;
   }
   if (sexp->type == NODE_LIST) {
+    fold_release(sexp);
     for (size_t i = 0; i < sexp->data.list.count; i++) {
       sexp_free_owned(sexp->data.list.elements[i]);
     }
@@ -1190,7 +2480,7 @@ static void sexp_free_owned(s_expression_t *sexp) {
 }
 
 static eval_result_t builtin_eval(size_t argc, lval_t **argv, env_t *env) {
-  if (argc != 1) return eval_errf("eval: expected exactly 1 argument, got %zu", argc);
+  if (argc != 1) return eval_err_arity("eval: expected exactly 1 argument", argc, NULL);
   s_expression_t *form = sexp_from_lval(argv[0]);
   if (!form) return eval_errf("eval: cannot convert value to s-expression");
   eval_result_t res = evaluate_single(form, env);
@@ -1211,7 +2501,7 @@ static int parse_string_for_load(const char *src, parse_result_t *out) {
 }
 
 static eval_result_t builtin_load(size_t argc, lval_t **argv, env_t *env) {
-  if (argc != 1) return eval_errf("load: expected exactly 1 argument, got %zu", argc);
+  if (argc != 1) return eval_err_arity("load: expected exactly 1 argument", argc, NULL);
   if (argv[0]->type != L_STRING) return eval_errf("load: expected argument of type string");
   const char *path = argv[0]->as.string.ptr;
 
@@ -1344,8 +2634,64 @@ static const builtin_entry_t k_builtins[] = {
   { "foldl", builtin_foldl },
   { "foldr", builtin_foldr },
   { "filter", builtin_filter },
+  // promises and streams
+  { "force", builtin_force },
+  { "promise?", builtin_is_promise },
+  { "stream-car", builtin_stream_car },
+  { "stream-cdr", builtin_stream_cdr },
+  { "stream-map", builtin_stream_map },
+  { "stream-filter", builtin_stream_filter },
+  { "stream-take", builtin_stream_take },
+  { "stream->list", builtin_stream_to_list },
+  { "stream-fold", builtin_stream_fold },
+  // vectors
+  { "vector?", builtin_is_vector },
+  { "make-vector", builtin_make_vector },
+  { "vector", builtin_vector },
+  { "vector-length", builtin_vector_length },
+  { "vector-ref", builtin_vector_ref },
+  { "vector-set!", builtin_vector_set },
+  { "vector-fill!", builtin_vector_fill },
+  { "list->vector", builtin_list_to_vector },
+  { "vector->list", builtin_vector_to_list },
+  { "vector-map", builtin_vector_map },
+  // hash tables
+  { "hash-table?", builtin_is_hash_table },
+  { "make-hash-table", builtin_make_hash_table },
+  { "hash-ref", builtin_hash_ref },
+  { "hash-set!", builtin_hash_set },
+  { "hash-remove!", builtin_hash_remove },
+  { "hash-count", builtin_hash_count },
+  { "hash-keys", builtin_hash_keys },
+  { "hash-for-each", builtin_hash_for_each },
+  // f64vectors
+  { "f64vector?", builtin_is_f64vector },
+  { "make-f64vector", builtin_make_f64vector },
+  { "f64vector", builtin_f64vector },
+  { "f64vector-length", builtin_f64vector_length },
+  { "f64vector-ref", builtin_f64vector_ref },
+  { "f64vector-set!", builtin_f64vector_set },
+  { "f64vector-fill!", builtin_f64vector_fill },
+  { "list->f64vector", builtin_list_to_f64vector },
+  { "f64vector->list", builtin_f64vector_to_list },
+  { "vector->f64vector", builtin_vector_to_f64vector },
+  { "f64vector->vector", builtin_f64vector_to_vector },
+  { "f64vector-add", builtin_f64vector_add },
+  { "f64vector-mul", builtin_f64vector_mul },
+  { "f64vector-scale", builtin_f64vector_scale },
+  { "f64vector-dot", builtin_f64vector_dot },
+  { "f64vector-sum", builtin_f64vector_sum },
+  { "f64vector-min", builtin_f64vector_min },
+  { "f64vector-max", builtin_f64vector_max },
+  { "f64vector-map", builtin_f64vector_map },
+  { "f64vector-kernels", builtin_f64vector_kernels },
   { "error", builtin_error },
+  { "error?", builtin_is_error },
+  { "error-message", builtin_error_message },
+  { "error-value", builtin_error_value },
+  { "error-kind", builtin_error_kind },
   { "gensym", builtin_gensym },
+  { "bench", builtin_bench },
   { "eval", builtin_eval },
   { "load", builtin_load },
   
@@ -1356,11 +2702,20 @@ static const builtin_entry_t k_builtins[] = {
 };
 // clang-format on
 
-builtin_fn lookup_builtin(const char *name) {
+static size_t k_builtins_generation = 0;
+
+static void register_builtin_symbols(void) {
   for (size_t i = 0; i < sizeof k_builtins / sizeof k_builtins[0]; i++) {
-    if (strcmp(name, k_builtins[i].name) == 0) return k_builtins[i].fn;
+    symbol_of(symbol_intern(k_builtins[i].name))->builtin = (void *)k_builtins[i].fn;
   }
-  return NULL;
+  k_builtins_generation = symbol_table_generation();
+}
+
+builtin_fn lookup_builtin(const char *name) {
+  const char *sym = symbol_intern(name);
+  if (!sym) return NULL;
+  if (k_builtins_generation != symbol_table_generation()) register_builtin_symbols();
+  return (builtin_fn)symbol_of(sym)->builtin;
 }
 
 void env_add_builtins(env_t *env) {
@@ -0,0 +1,283 @@
+#include "dispatch.h"
+#include "fold.h"
+#include "lval.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_CLAUSE SIZE_MAX
+
+// Integer datums spanning at most this many values per datum (plus a little
+// slack) get a jump table; others are hashed.
+#define JUMP_DENSITY 4
+#define JUMP_SLACK 16
+
+// What eqv compares: the kind of a datum or key and its bits. Keys of any
+// other type never match.
+typedef enum { K_NONE, K_SYMBOL, K_INT, K_DOUBLE, K_BOOL } key_kind_t;
+
+typedef struct {
+  key_kind_t kind;
+  uint64_t bits;
+} case_key_t;
+
+typedef struct {
+  case_key_t key; // K_NONE for an empty slot
+  size_t clause;
+} slot_t;
+
+struct dispatch {
+  s_expression_t *list; // the case form, borrowed
+  size_t fallback;      // index of the else clause, or NO_CLAUSE
+  int64_t base;         // jump[k - base] is the clause of integer k, plus one
+  size_t span;
+  size_t *jump; // NULL when the datums are hashed
+  slot_t *slots;
+  unsigned shift; // 64 - log2 of the number of slots
+};
+
+static case_key_t datum_key(const s_expression_t *d) {
+  case_key_t k = { K_NONE, 0 };
+  if (d->type != NODE_ATOM) return k;
+  const atom_t *a = &d->data.atom;
+  switch (a->type) {
+  case ATOM_SYMBOL:
+    k.kind = K_SYMBOL;
+    k.bits = (uint64_t)(uintptr_t)a->value.symbol;
+    break;
+  case ATOM_INTEGER:
+    k.kind = K_INT;
+    k.bits = (uint64_t)a->value.integer;
+    break;
+  case ATOM_NUMBER:
+    k.kind = K_DOUBLE;
+    memcpy(&k.bits, &a->value.number, sizeof k.bits);
+    break;
+  case ATOM_BOOLEAN:
+    k.kind = K_BOOL;
+    k.bits = a->value.boolean;
+    break;
+  default:
+    break;
+  }
+  return k;
+}
+
+static case_key_t value_key(const lval_t *v) {
+  case_key_t k = { K_NONE, 0 };
+  switch (v->type) {
+  case L_SYMBOL:
+    k.kind = K_SYMBOL;
+    k.bits = (uint64_t)(uintptr_t)v->as.symbol.name;
+    break;
+  case L_INT:
+    k.kind = K_INT;
+    k.bits = (uint64_t)v->as.integer;
+    break;
+  case L_NUM:
+    k.kind = K_DOUBLE;
+    memcpy(&k.bits, &v->as.number, sizeof k.bits);
+    break;
+  case L_BOOL:
+    k.kind = K_BOOL;
+    k.bits = v->as.boolean;
+    break;
+  default:
+    break;
+  }
+  return k;
+}
+
+static bool key_eq(case_key_t a, case_key_t b) {
+  return a.kind == b.kind && a.bits == b.bits;
+}
+
+static s_expression_t **clause_at(const s_expression_t *list, size_t i) {
+  return list->data.list.elements[i + 2]->data.list.elements;
+}
+
+static size_t clause_count(const s_expression_t *list) {
+  return list->data.list.count - 2;
+}
+
+static bool is_else(const s_expression_t *list, size_t i) {
+  return sexp_is_symbol_name(clause_at(list, i)[0], "else");
+}
+
+static eval_result_t check(const s_expression_t *list) {
+  if (list->data.list.tail != NULL) return eval_errf("case: cannot have dotted arguments");
+  if (list->data.list.count < 2) return eval_errf("case requires a key");
+  for (size_t i = 0; i < clause_count(list); i++) {
+    const s_expression_t *c = list->data.list.elements[i + 2];
+    if (c->type != NODE_LIST || c->data.list.tail || c->data.list.count < 2) {
+      return eval_errf("case: clause %zu must be ((datum...) expr...)", i + 1);
+    }
+    if (is_else(list, i)) {
+      if (i + 1 != clause_count(list)) return eval_errf("case: else must be the last clause");
+      continue;
+    }
+    const s_expression_t *datums = c->data.list.elements[0];
+    if (datums->type != NODE_LIST || datums->data.list.tail) {
+      return eval_errf("case: clause %zu must be ((datum...) expr...)", i + 1);
+    }
+    for (size_t j = 0; j < datums->data.list.count; j++) {
+      if (datum_key(datums->data.list.elements[j]).kind == K_NONE) {
+        return eval_errf("case: datums must be symbols, integers, doubles or booleans");
+      }
+    }
+  }
+  return eval_ok(NULL);
+}
+
+static size_t scan(const s_expression_t *list, case_key_t key) {
+  for (size_t i = 0; i < clause_count(list); i++) {
+    if (is_else(list, i)) return i;
+    const s_expression_t *datums = clause_at(list, i)[0];
+    for (size_t j = 0; j < datums->data.list.count; j++) {
+      if (key_eq(datum_key(datums->data.list.elements[j]), key)) return i;
+    }
+  }
+  return NO_CLAUSE;
+}
+
+static uint64_t key_hash(case_key_t k) {
+  return (k.bits ^ ((uint64_t)k.kind << 61)) * 0x9E3779B97F4A7C15ull;
+}
+
+static size_t lookup(const dispatch_t *t, case_key_t key) {
+  if (t->jump) {
+    if (key.kind != K_INT) return t->fallback;
+    uint64_t at = key.bits - (uint64_t)t->base;
+    if (at >= t->span || !t->jump[at]) return t->fallback;
+    return t->jump[at] - 1;
+  }
+  if (key.kind == K_NONE) return t->fallback;
+  size_t mask = ((size_t)1 << (64 - t->shift)) - 1;
+  for (size_t at = key_hash(key) >> t->shift;; at = (at + 1) & mask) {
+    const slot_t *s = &t->slots[at];
+    if (s->key.kind == K_NONE) return t->fallback;
+    if (key_eq(s->key, key)) return s->clause;
+  }
+}
+
+// Adds `key` unless an earlier clause already lists it.
+static void insert(dispatch_t *t, case_key_t key, size_t clause) {
+  if (t->jump) {
+    size_t *slot = &t->jump[key.bits - (uint64_t)t->base];
+    if (!*slot) *slot = clause + 1;
+    return;
+  }
+  size_t mask = ((size_t)1 << (64 - t->shift)) - 1;
+  for (size_t at = key_hash(key) >> t->shift;; at = (at + 1) & mask) {
+    slot_t *s = &t->slots[at];
+    if (key_eq(s->key, key)) return;
+    if (s->key.kind == K_NONE) {
+      *s = (slot_t){ key, clause };
+      return;
+    }
+  }
+}
+
+dispatch_t *dispatch_compile(s_expression_t *list) {
+  eval_result_t ok = check(list);
+  if (ok.status != EVAL_OK) {
+    evaluator_result_free(&ok);
+    return NULL;
+  }
+  dispatch_t *t = calloc(1, sizeof *t);
+  if (!t) return NULL;
+  t->list = list;
+  t->fallback = NO_CLAUSE;
+
+  size_t count = 0;
+  bool integers = true;
+  int64_t lo = INT64_MAX, hi = INT64_MIN;
+  for (size_t i = 0; i < clause_count(list); i++) {
+    if (is_else(list, i)) {
+      t->fallback = i;
+      continue;
+    }
+    const s_expression_t *datums = clause_at(list, i)[0];
+    for (size_t j = 0; j < datums->data.list.count; j++) {
+      case_key_t k = datum_key(datums->data.list.elements[j]);
+      count++;
+      if (k.kind != K_INT) {
+        integers = false;
+        continue;
+      }
+      int64_t v = (int64_t)k.bits;
+      if (v < lo) lo = v;
+      if (v > hi) hi = v;
+    }
+  }
+
+  if (count && integers && (uint64_t)hi - (uint64_t)lo < count * JUMP_DENSITY + JUMP_SLACK) {
+    t->base = lo;
+    t->span = (size_t)((uint64_t)hi - (uint64_t)lo) + 1;
+    t->jump = calloc(t->span, sizeof *t->jump);
+    if (!t->jump) goto fail;
+  } else {
+    unsigned bits = 3;
+    while (((size_t)1 << bits) < count * 2) bits++;
+    t->shift = 64 - bits;
+    t->slots = calloc((size_t)1 << bits, sizeof *t->slots);
+    if (!t->slots) goto fail;
+  }
+  for (size_t i = 0; i < clause_count(list); i++) {
+    if (is_else(list, i)) continue;
+    const s_expression_t *datums = clause_at(list, i)[0];
+    for (size_t j = 0; j < datums->data.list.count; j++) {
+      insert(t, datum_key(datums->data.list.elements[j]), i);
+    }
+  }
+  return t;
+
+fail:
+  dispatch_free(t);
+  return NULL;
+}
+
+void dispatch_free(dispatch_t *table) {
+  if (!table) return;
+  free(table->jump);
+  free(table->slots);
+  free(table);
+}
+
+eval_result_t case_select(s_expression_t *list, const dispatch_t *table, env_t *env,
+                          s_expression_t ***body, size_t *count) {
+  *body = NULL;
+  *count = 0;
+  if (!table) {
+    eval_result_t ok = check(list);
+    if (ok.status != EVAL_OK) return ok;
+  }
+  // The key may refold the form and release the table it came from.
+  if (table) fold_hold();
+  eval_result_t r = evaluate_single(list->data.list.elements[1], env);
+  size_t clause = NO_CLAUSE;
+  if (r.status == EVAL_OK) {
+    case_key_t key = value_key(r.result);
+    clause = table ? lookup(table, key) : scan(list, key);
+  }
+  if (table) fold_unhold();
+  if (r.status != EVAL_OK) return r;
+  if (clause == NO_CLAUSE) return eval_ok(lval_nil());
+
+  s_expression_t *c = list->data.list.elements[clause + 2];
+  *body = c->data.list.elements + 1;
+  *count = c->data.list.count - 1;
+  return r;
+}
+
+eval_result_t case_eval(s_expression_t *list, const dispatch_t *table, env_t *env) {
+  s_expression_t **body;
+  size_t count;
+  eval_result_t r = case_select(list, table, env, &body, &count);
+  for (size_t i = 0; r.status == EVAL_OK && i < count; i++) r = evaluate_single(body[i], env);
+  return r;
+}
+
+eval_result_t dispatch_eval(const dispatch_t *table, env_t *env) {
+  return case_eval(table->list, table, env);
+}
@@ -0,0 +1,896 @@
+#include "emit_c.h"
+#include "bignum.h"
+#include "builtin.h"
+#include "special.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+// What the program does with a global name anywhere in its source.
+typedef struct {
+  const char *name; // interned
+  size_t defines;
+  size_t sets;
+  bool macro;
+} name_use_t;
+
+// A top-level (define name (lambda ...)) compiled to fn_<index>.
+typedef struct {
+  const char *name;
+  const s_expression_t *lambda;
+  size_t form; // index of the defining top-level form
+  size_t arity;
+} aot_fn_t;
+
+// Interned names, emitted as the sym[] and bi[] tables.
+typedef struct {
+  const char **items;
+  size_t count;
+  size_t capacity;
+} name_table_t;
+
+typedef struct {
+  FILE *f;
+  char *buf;
+  size_t len;
+} buffer_t;
+
+typedef struct {
+  name_use_t *uses;
+  size_t use_count;
+  size_t use_capacity;
+  aot_fn_t *fns;
+  size_t fn_count;
+  size_t fn_capacity;
+  name_table_t syms;
+  name_table_t builtins;
+  buffer_t asts; // statements of init() building ast[]
+  size_t ast_count;
+  bool dynamic; // the program calls eval or load, so any binding may change
+} emitter_t;
+
+// A C function being written. Every intermediate value lives in a slot of
+// `t`, a gc_stack_reserve'd array, so the collector sees all of them.
+typedef struct {
+  FILE *out;
+  int indent;
+  size_t slot; // next free slot
+  size_t max_slot;
+  bool jumps;        // the function has a `goto out`
+  const aot_fn_t *fn; // NULL in run()
+  size_t form;        // top-level form being compiled in run()
+} frame_t;
+
+static void *grow(void *items, size_t *capacity, size_t count, size_t size) {
+  if (count < *capacity) return items;
+  size_t new_cap = *capacity ? *capacity * 2 : 8;
+  void *p = realloc(items, new_cap * size);
+  if (!p) {
+    perror("realloc");
+    exit(EXIT_FAILURE);
+  }
+  *capacity = new_cap;
+  return p;
+}
+
+static size_t name_ref(name_table_t *t, const char *name) {
+  for (size_t i = 0; i < t->count; i++) {
+    if (t->items[i] == name) return i;
+  }
+  t->items = grow(t->items, &t->capacity, t->count, sizeof(*t->items));
+  t->items[t->count] = name;
+  return t->count++;
+}
+
+static bool buffer_open(buffer_t *b) {
+  b->buf = NULL;
+  b->len = 0;
+  b->f = open_memstream(&b->buf, &b->len);
+  return b->f != NULL;
+}
+
+// Closes the buffer and appends its contents to `out`.
+static bool buffer_flush(buffer_t *b, FILE *out) {
+  bool ok = fclose(b->f) == 0;
+  b->f = NULL;
+  if (ok && b->len) ok = fwrite(b->buf, 1, b->len, out) == b->len;
+  free(b->buf);
+  b->buf = NULL;
+  return ok;
+}
+
+static bool is_named(const s_expression_t *e, const char *name) {
+  return sexp_is_symbol_name(e, name);
+}
+
+// ---- Program analysis ----
+
+static name_use_t *find_use(const emitter_t *em, const char *name) {
+  for (size_t i = 0; i < em->use_count; i++) {
+    if (em->uses[i].name == name) return &em->uses[i];
+  }
+  return NULL;
+}
+
+static name_use_t *use_of(emitter_t *em, const char *name) {
+  name_use_t *u = find_use(em, name);
+  if (u) return u;
+  em->uses = grow(em->uses, &em->use_capacity, em->use_count, sizeof(*em->uses));
+  u = &em->uses[em->use_count++];
+  *u = (name_use_t){ .name = name };
+  return u;
+}
+
+// Records every name the program binds, wherever the binding form appears.
+// Quoted data is scanned too, which only makes the compiler more cautious.
+static void scan_names(emitter_t *em, const s_expression_t *e) {
+  if (e->type != NODE_LIST) {
+    if (is_named(e, "eval") || is_named(e, "load")) em->dynamic = true;
+    return;
+  }
+  s_expression_t **el = e->data.list.elements;
+  const char *target = NULL;
+  if (e->data.list.count >= 2 && sexp_is_symbol(el[1], &target)) {
+    if (is_named(el[0], "define")) use_of(em, target)->defines++;
+    if (is_named(el[0], "set")) use_of(em, target)->sets++;
+    if (is_named(el[0], "defmacro")) use_of(em, target)->macro = true;
+  }
+  for (size_t i = 0; i < e->data.list.count; i++) scan_names(em, el[i]);
+  if (e->data.list.tail) scan_names(em, e->data.list.tail);
+}
+
+static const aot_fn_t *find_fn(const emitter_t *em, const char *name) {
+  for (size_t i = 0; i < em->fn_count; i++) {
+    if (em->fns[i].name == name) return &em->fns[i];
+  }
+  return NULL;
+}
+
+static long param_index(const aot_fn_t *fn, const char *name) {
+  if (!fn) return -1;
+  const s_expression_t *params = fn->lambda->data.list.elements[1];
+  for (size_t i = 0; i < params->data.list.count; i++) {
+    if (params->data.list.elements[i]->data.atom.value.symbol == name) return (long)i;
+  }
+  return -1;
+}
+
+static bool compilable(const emitter_t *em, const s_expression_t *e, const aot_fn_t *fn);
+
+static bool all_compilable(const emitter_t *em, s_expression_t **el, size_t n,
+                           const aot_fn_t *fn) {
+  for (size_t i = 0; i < n; i++) {
+    if (!compilable(em, el[i], fn)) return false;
+  }
+  return true;
+}
+
+// Whether `e` can be compiled in the body of `fn` (or at top level when
+// `fn` is NULL) with the same meaning as in the interpreter.
+static bool compilable(const emitter_t *em, const s_expression_t *e, const aot_fn_t *fn) {
+  if (e->type == NODE_ATOM) return true;
+  if (e->data.list.tail) return false;
+  size_t n = e->data.list.count;
+  if (n == 0) return true;
+  s_expression_t **el = e->data.list.elements;
+  const char *head = NULL;
+  size_t first = 1;
+  if (sexp_is_symbol(el[0], &head)) {
+    if (lookup_special_form(head)) {
+      if (strcmp(head, "quote") == 0) return n == 2;
+      if (strcmp(head, "if") == 0) {
+        if (n < 3 || n > 4) return false;
+      } else if (strcmp(head, "cond") == 0) {
+        if (n != 2) return false;
+        const s_expression_t *pairs = el[1];
+        if (pairs->type != NODE_LIST || pairs->data.list.tail ||
+            pairs->data.list.count % 2 != 0)
+          return false;
+        return all_compilable(em, pairs->data.list.elements, pairs->data.list.count, fn);
+      } else if (strcmp(head, "set") == 0) {
+        if (n != 3 || !sexp_is_symbol(el[1], NULL)) return false;
+        first = 2;
+      } else if (strcmp(head, "and") == 0 || strcmp(head, "or") == 0) {
+        if (n < 2) return false;
+      } else if (strcmp(head, "begin") != 0) {
+        return false;
+      }
+    } else if (param_index(fn, head) < 0) {
+      const name_use_t *u = find_use(em, head);
+      if (u && u->macro) return false;
+      // eval sees the caller's bindings, which compiled bodies do not have.
+      if (fn && strcmp(head, "eval") == 0) return false;
+    }
+  } else if (!compilable(em, el[0], fn)) {
+    return false;
+  }
+  return all_compilable(em, el + first, n - first, fn);
+}
+
+static bool lambda_params_ok(const s_expression_t *lambda) {
+  if (lambda->type != NODE_LIST || lambda->data.list.tail || lambda->data.list.count < 3)
+    return false;
+  if (!is_named(lambda->data.list.elements[0], "lambda")) return false;
+  const s_expression_t *params = lambda->data.list.elements[1];
+  if (params->type != NODE_LIST || params->data.list.tail) return false;
+  for (size_t i = 0; i < params->data.list.count; i++) {
+    const char *p = NULL;
+    if (!sexp_is_symbol(params->data.list.elements[i], &p)) return false;
+    for (size_t j = 0; j < i; j++) {
+      if (params->data.list.elements[j]->data.atom.value.symbol == p) return false;
+    }
+  }
+  return true;
+}
+
+// Picks the top-level lambdas that become C functions.
+static void collect_fns(emitter_t *em, s_expression_t **forms, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const s_expression_t *e = forms[i];
+    const char *name = NULL;
+    if (e->type != NODE_LIST || e->data.list.count != 3 || e->data.list.tail) continue;
+    if (!is_named(e->data.list.elements[0], "define")) continue;
+    if (!sexp_is_symbol(e->data.list.elements[1], &name)) continue;
+    const s_expression_t *lambda = e->data.list.elements[2];
+    if (!lambda_params_ok(lambda) || lookup_special_form(name)) continue;
+    const name_use_t *u = find_use(em, name);
+    if (!u || u->defines != 1 || u->sets != 0 || u->macro) continue;
+
+    aot_fn_t fn = { .name = name,
+                    .lambda = lambda,
+                    .form = i,
+                    .arity = lambda->data.list.elements[1]->data.list.count };
+    if (!all_compilable(em, lambda->data.list.elements + 2, lambda->data.list.count - 2, &fn))
+      continue;
+    em->fns = grow(em->fns, &em->fn_capacity, em->fn_count, sizeof(*em->fns));
+    em->fns[em->fn_count++] = fn;
+  }
+}
+
+// ---- C output ----
+
+static void put_c_string(FILE *f, const char *s, size_t len) {
+  fputc('"', f);
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)s[i];
+    if (c == '"' || c == '\\') {
+      fprintf(f, "\\%c", c);
+    } else if (c == '\n') {
+      fputs("\\n", f);
+    } else if (c < 0x20 || c >= 0x7f) {
+      fprintf(f, "\\%03o", c);
+    } else {
+      fputc(c, f);
+    }
+  }
+  fputc('"', f);
+}
+
+static void put_double(FILE *f, double x) {
+  if (isnan(x)) {
+    fputs("NAN", f);
+  } else if (isinf(x)) {
+    fputs(x < 0 ? "-INFINITY" : "INFINITY", f);
+  } else {
+    fprintf(f, "%a", x);
+  }
+}
+
+static void put_int(FILE *f, int64_t x) {
+  if (x == INT64_MIN) {
+    fputs("INT64_MIN", f);
+  } else {
+    fprintf(f, "INT64_C(%" PRId64 ")", x);
+  }
+}
+
+static void put_bignum(FILE *f, const bignum_t *b) {
+  char *digits = bignum_to_string(b);
+  fprintf(f, "\"%s\"", digits);
+  free(digits);
+}
+
+static void put_ast(emitter_t *em, FILE *f, const s_expression_t *e) {
+  if (e->type == NODE_ATOM) {
+    const atom_t *a = &e->data.atom;
+    switch (a->type) {
+    case ATOM_SYMBOL:
+      fprintf(f, "sym_node(sym[%zu])", name_ref(&em->syms, a->value.symbol));
+      break;
+    case ATOM_NUMBER:
+      fputs("num_node(", f);
+      put_double(f, a->value.number);
+      fputc(')', f);
+      break;
+    case ATOM_INTEGER:
+      fputs("int_node(", f);
+      put_int(f, a->value.integer);
+      fputc(')', f);
+      break;
+    case ATOM_BIGNUM:
+      fputs("big_node(", f);
+      put_bignum(f, a->value.bignum);
+      fputc(')', f);
+      break;
+    case ATOM_STRING:
+      fputs("str_node(", f);
+      put_c_string(f, a->value.string, strlen(a->value.string));
+      fputc(')', f);
+      break;
+    case ATOM_BOOLEAN:
+      fprintf(f, "bool_node(%s)", a->value.boolean ? "true" : "false");
+      break;
+    case ATOM_ARGUMENT: // made by fold.c, never in a parsed program
+    case ATOM_UNBOXED:
+    case ATOM_DISPATCH:
+      break;
+    }
+    return;
+  }
+  fputs("list_node(", f);
+  if (e->data.list.tail) {
+    put_ast(em, f, e->data.list.tail);
+  } else {
+    fputs("NULL", f);
+  }
+  fprintf(f, ", %zu", e->data.list.count);
+  for (size_t i = 0; i < e->data.list.count; i++) {
+    fputs(", ", f);
+    put_ast(em, f, e->data.list.elements[i]);
+  }
+  fputc(')', f);
+}
+
+// Adds a syntax tree for `e`, built by init(), and returns its index.
+static size_t ast_ref(emitter_t *em, const s_expression_t *e) {
+  fprintf(em->asts.f, "  ast[%zu] = ", em->ast_count);
+  put_ast(em, em->asts.f, e);
+  fputs(";\n", em->asts.f);
+  return em->ast_count++;
+}
+
+static void line(frame_t *fr, const char *fmt, ...) {
+  fprintf(fr->out, "%*s", fr->indent * 2, "");
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(fr->out, fmt, ap);
+  va_end(ap);
+  fputc('\n', fr->out);
+}
+
+static size_t slots_new(frame_t *fr, size_t n) {
+  size_t base = fr->slot;
+  fr->slot += n;
+  if (fr->slot > fr->max_slot) fr->max_slot = fr->slot;
+  return base;
+}
+
+// Fails the function with `message`, which may use sym[sym_index] as its
+// one %s argument (pass -1 for none).
+static void emit_raise(frame_t *fr, const char *message, long sym_index) {
+  if (sym_index < 0) {
+    line(fr, "r = eval_errf(\"%s\");", message);
+  } else {
+    line(fr, "r = eval_errf(\"%s\", sym[%ld]);", message, sym_index);
+  }
+  line(fr, "goto out;");
+  fr->jumps = true;
+}
+
+static void raise_if(frame_t *fr, const char *cond, size_t slot, const char *message,
+                     long sym_index) {
+  fprintf(fr->out, "%*sif (", fr->indent * 2, "");
+  fprintf(fr->out, cond, slot);
+  fputs(") {\n", fr->out);
+  fr->indent++;
+  emit_raise(fr, message, sym_index);
+  fr->indent--;
+  line(fr, "}");
+}
+
+// Fails the function if t[slot] is NULL, the value of the unbound sym[sym_index].
+static void raise_unbound(frame_t *fr, size_t slot, size_t sym_index) {
+  line(fr, "if (!t[%zu]) {", slot);
+  fr->indent++;
+  line(fr, "r = eval_err(EVAL_ERR_UNBOUND, sym[%zu], NULL);", sym_index);
+  line(fr, "goto out;");
+  fr->jumps = true;
+  fr->indent--;
+  line(fr, "}");
+}
+
+static void check_result(frame_t *fr, size_t d) {
+  line(fr, "if (r.status != EVAL_OK) goto out;");
+  line(fr, "t[%zu] = r.result;", d);
+  fr->jumps = true;
+}
+
+static void emit_expr(emitter_t *em, frame_t *fr, const s_expression_t *e, size_t d);
+
+static void emit_atom(frame_t *fr, const atom_t *a, size_t d) {
+  fprintf(fr->out, "%*st[%zu] = ", fr->indent * 2, "", d);
+  switch (a->type) {
+  case ATOM_NUMBER:
+    fputs("lval_num(", fr->out);
+    put_double(fr->out, a->value.number);
+    fputs(");\n", fr->out);
+    break;
+  case ATOM_INTEGER:
+    fputs("lval_int(", fr->out);
+    put_int(fr->out, a->value.integer);
+    fputs(");\n", fr->out);
+    break;
+  case ATOM_BIGNUM:
+    fputs("lval_bignum(bignum_from_string(", fr->out);
+    put_bignum(fr->out, a->value.bignum);
+    fputs("));\n", fr->out);
+    break;
+  case ATOM_STRING: {
+    size_t len = strlen(a->value.string);
+    fputs("lval_string_copy(", fr->out);
+    put_c_string(fr->out, a->value.string, len);
+    fprintf(fr->out, ", %zu);\n", len);
+    break;
+  }
+  case ATOM_BOOLEAN:
+    fprintf(fr->out, "lval_bool(%s);\n", a->value.boolean ? "true" : "false");
+    break;
+  case ATOM_SYMBOL:
+    fputs("lval_nil();\n", fr->out); // symbols are handled by the callers
+    break;
+  case ATOM_ARGUMENT: // made by fold.c, never in a parsed program
+  case ATOM_UNBOXED:
+  case ATOM_DISPATCH:
+    fputs("lval_nil();\n", fr->out);
+    break;
+  }
+}
+
+static void emit_quote(emitter_t *em, frame_t *fr, const s_expression_t *e, size_t d) {
+  const s_expression_t *datum = e->data.list.elements[1];
+  if (datum->type == NODE_ATOM) {
+    if (datum->data.atom.type == ATOM_SYMBOL) {
+      line(fr, "t[%zu] = lval_symbol(sym[%zu]);", d,
+           name_ref(&em->syms, datum->data.atom.value.symbol));
+    } else {
+      emit_atom(fr, &datum->data.atom, d);
+    }
+  } else if (datum->data.list.count == 0 && !datum->data.list.tail) {
+    line(fr, "t[%zu] = lval_nil();", d);
+  } else {
+    line(fr, "r = evaluate_single(ast[%zu], global);", ast_ref(em, e));
+    check_result(fr, d);
+  }
+}
+
+static void emit_cond(emitter_t *em, frame_t *fr, s_expression_t **pairs, size_t n, size_t d) {
+  if (n == 0) {
+    line(fr, "t[%zu] = lval_nil();", d);
+    return;
+  }
+  emit_expr(em, fr, pairs[0], d);
+  raise_if(fr, "t[%zu]->type != L_BOOL", d, "cond: nonboolean condition encountered", -1);
+  line(fr, "if (t[%zu]->as.boolean) {", d);
+  fr->indent++;
+  emit_expr(em, fr, pairs[1], d);
+  fr->indent--;
+  line(fr, "} else {");
+  fr->indent++;
+  emit_cond(em, fr, pairs + 2, n - 2, d);
+  fr->indent--;
+  line(fr, "}");
+}
+
+// Leaves the deciding argument of an and or an or in t[d].
+static void emit_logic(emitter_t *em, frame_t *fr, const char *head, s_expression_t **args,
+                       size_t n, size_t d) {
+  bool is_and = strcmp(head, "and") == 0;
+  emit_expr(em, fr, args[0], d);
+  raise_if(fr, "t[%zu]->type != L_BOOL", d,
+           is_and ? "and: expected boolean arguments" : "or: expected boolean arguments", -1);
+  if (n == 1) return;
+  if (is_and) {
+    line(fr, "if (t[%zu]->as.boolean) {", d);
+  } else {
+    line(fr, "if (!t[%zu]->as.boolean) {", d);
+  }
+  fr->indent++;
+  emit_logic(em, fr, head, args + 1, n - 1, d);
+  fr->indent--;
+  line(fr, "}");
+}
+
+static void emit_special(emitter_t *em, frame_t *fr, const char *head, const s_expression_t *e,
+                         size_t d) {
+  s_expression_t **el = e->data.list.elements;
+  size_t n = e->data.list.count;
+  if (strcmp(head, "quote") == 0) {
+    emit_quote(em, fr, e, d);
+  } else if (strcmp(head, "if") == 0) {
+    emit_expr(em, fr, el[1], d);
+    raise_if(fr, "t[%zu]->type != L_BOOL", d, "if: condition did not evaluate to a boolean", -1);
+    line(fr, "if (t[%zu]->as.boolean) {", d);
+    fr->indent++;
+    emit_expr(em, fr, el[2], d);
+    fr->indent--;
+    line(fr, "} else {");
+    fr->indent++;
+    if (n == 4) {
+      emit_expr(em, fr, el[3], d);
+    } else {
+      line(fr, "t[%zu] = lval_nil();", d);
+    }
+    fr->indent--;
+    line(fr, "}");
+  } else if (strcmp(head, "cond") == 0) {
+    emit_cond(em, fr, el[1]->data.list.elements, el[1]->data.list.count, d);
+  } else if (strcmp(head, "and") == 0 || strcmp(head, "or") == 0) {
+    emit_logic(em, fr, head, el + 1, n - 1, d);
+  } else if (strcmp(head, "begin") == 0) {
+    if (n == 1) line(fr, "t[%zu] = lval_nil();", d);
+    for (size_t i = 1; i < n; i++) emit_expr(em, fr, el[i], d);
+  } else { // set
+    const char *name = el[1]->data.atom.value.symbol;
+    emit_expr(em, fr, el[2], d);
+    long p = param_index(fr->fn, name);
+    if (p >= 0) {
+      line(fr, "t[%ld] = t[%zu];", p, d);
+    } else {
+      size_t k = name_ref(&em->syms, name);
+      line(fr, "if (!env_set_symbol(global, sym[%zu], t[%zu])) {", k, d);
+      fr->indent++;
+      emit_raise(fr, "set: variable '%s' not defined", (long)k);
+      fr->indent--;
+      line(fr, "}");
+    }
+  }
+}
+
+static void emit_args(emitter_t *em, frame_t *fr, const s_expression_t *e, size_t base) {
+  for (size_t i = 1; i < e->data.list.count; i++) {
+    emit_expr(em, fr, e->data.list.elements[i], base + i - 1);
+  }
+}
+
+static void emit_call(emitter_t *em, frame_t *fr, const s_expression_t *e, size_t d) {
+  size_t argc = e->data.list.count - 1;
+  size_t saved = fr->slot;
+  const s_expression_t *head = e->data.list.elements[0];
+  const char *name = NULL;
+  bool is_symbol = sexp_is_symbol(head, &name);
+  long p = is_symbol ? param_index(fr->fn, name) : -1;
+
+  if (is_symbol && p < 0 && !em->dynamic) {
+    const aot_fn_t *fn = find_fn(em, name);
+    // At top level the function only exists once its define has run.
+    if (fn && fn->arity == argc && (fr->fn || fr->form > fn->form)) {
+      size_t base = slots_new(fr, argc);
+      emit_args(em, fr, e, base);
+      line(fr, "r = fn_%zu(&t[%zu]);", (size_t)(fn - em->fns), base);
+      check_result(fr, d);
+      fr->slot = saved;
+      return;
+    }
+    if (!find_use(em, name) && lookup_builtin(name)) {
+      size_t base = slots_new(fr, argc);
+      emit_args(em, fr, e, base);
+      line(fr, "r = bi[%zu](%zu, &t[%zu], global);", name_ref(&em->builtins, name), argc, base);
+      check_result(fr, d);
+      fr->slot = saved;
+      return;
+    }
+  }
+
+  // Slot `callee` keeps the function alive while the arguments run, as in
+  // evaluate_single.
+  size_t callee = slots_new(fr, argc + 1);
+  size_t k = 0;
+  if (p >= 0) {
+    line(fr, "t[%zu] = t[%ld];", callee, p);
+  } else if (is_symbol) {
+    k = name_ref(&em->syms, name);
+    line(fr, "t[%zu] = env_get_symbol(global, sym[%zu]);", callee, k);
+  }
+  emit_args(em, fr, e, callee + 1);
+  if (!is_symbol) {
+    emit_expr(em, fr, head, callee);
+  } else if (p < 0) {
+    raise_unbound(fr, callee, k);
+  }
+  line(fr, "r = evaluate_call(t[%zu], %zu, &t[%zu], global);", callee, argc, callee + 1);
+  check_result(fr, d);
+  fr->slot = saved;
+}
+
+// Compiles `e` so that its value ends up in t[d].
+static void emit_expr(emitter_t *em, frame_t *fr, const s_expression_t *e, size_t d) {
+  if (e->type == NODE_ATOM) {
+    const atom_t *a = &e->data.atom;
+    if (a->type != ATOM_SYMBOL) {
+      emit_atom(fr, a, d);
+      return;
+    }
+    long p = param_index(fr->fn, a->value.symbol);
+    if (p >= 0) {
+      line(fr, "t[%zu] = t[%ld];", d, p);
+      return;
+    }
+    size_t k = name_ref(&em->syms, a->value.symbol);
+    line(fr, "t[%zu] = env_get_symbol(global, sym[%zu]);", d, k);
+    raise_unbound(fr, d, k);
+    return;
+  }
+  if (e->data.list.count == 0) {
+    line(fr, "t[%zu] = lval_nil();", d);
+    return;
+  }
+  const char *head = NULL;
+  if (sexp_is_symbol(e->data.list.elements[0], &head) && lookup_special_form(head)) {
+    emit_special(em, fr, head, e, d);
+  } else {
+    emit_call(em, fr, e, d);
+  }
+}
+
+// Writes the function's frame setup and teardown around the body in `body`.
+static bool finish_function(frame_t *fr, buffer_t *body, FILE *out) {
+  size_t slots = fr->max_slot ? fr->max_slot : 1;
+  fprintf(out, "  lval_t **t = gc_stack_reserve(%zu);\n", slots);
+  fputs("  eval_result_t r;\n", out);
+  if (!buffer_flush(body, out)) return false;
+  if (fr->jumps) fputs("out:\n", out);
+  fprintf(out, "  gc_stack_pop(%zu);\n", slots);
+  fputs("  return r;\n}\n\n", out);
+  return true;
+}
+
+static bool emit_function(emitter_t *em, size_t index, FILE *out) {
+  const aot_fn_t *fn = &em->fns[index];
+  buffer_t body;
+  if (!buffer_open(&body)) return false;
+  frame_t fr = { .out = body.f, .indent = 1, .fn = fn };
+  slots_new(&fr, fn->arity);
+  for (size_t i = 0; i < fn->arity; i++) line(&fr, "t[%zu] = args[%zu];", i, i);
+  line(&fr, "gc_maybe_collect(NULL);");
+  size_t value = slots_new(&fr, 1);
+  for (size_t i = 2; i < fn->lambda->data.list.count; i++) {
+    emit_expr(em, &fr, fn->lambda->data.list.elements[i], value);
+  }
+  line(&fr, "r = eval_ok(t[%zu]);", value);
+
+  fprintf(out, "static eval_result_t fn_%zu(lval_t **args) {\n", index);
+  if (fn->arity == 0) fputs("  (void)args;\n", out);
+  if (!finish_function(&fr, &body, out)) return false;
+
+  fprintf(out, "static eval_result_t native_%zu(size_t argc, lval_t **argv, env_t *env) {\n",
+          index);
+  fputs("  (void)env;\n", out);
+  fprintf(out, "  if (argc != %zu) {\n", fn->arity);
+  fprintf(out, "    return eval_err_arity(\"Function expects %zu arguments\", argc, NULL);\n",
+          fn->arity);
+  fputs("  }\n", out);
+  fprintf(out, "  return fn_%zu(argv);\n}\n\n", index);
+  return true;
+}
+
+static void emit_toplevel(emitter_t *em, frame_t *fr, const s_expression_t *e) {
+  const char *name = NULL;
+  if (e->type == NODE_LIST && e->data.list.count == 3 && !e->data.list.tail &&
+      is_named(e->data.list.elements[0], "define") &&
+      sexp_is_symbol(e->data.list.elements[1], &name)) {
+    const s_expression_t *value = e->data.list.elements[2];
+    const aot_fn_t *fn = find_fn(em, name);
+    bool compiled = fn && fn->lambda == value;
+    if (compiled || compilable(em, value, NULL)) {
+      size_t k = name_ref(&em->syms, name);
+      size_t v = slots_new(fr, 1);
+      if (compiled) {
+        line(fr, "t[%zu] = lval_native((void *)native_%zu, sym[%zu]);", v, (size_t)(fn - em->fns),
+             k);
+      } else {
+        emit_expr(em, fr, value, v);
+      }
+      line(fr, "if (!env_define_symbol(global, sym[%zu], t[%zu])) {", k, v);
+      fr->indent++;
+      emit_raise(fr, "define: failed to define variable '%s'", (long)k);
+      fr->indent--;
+      line(fr, "}");
+      line(fr, "t[0] = lval_symbol(sym[%zu]);", k);
+      fr->slot = v;
+      return;
+    }
+  }
+  if (compilable(em, e, NULL)) {
+    emit_expr(em, fr, e, 0);
+    return;
+  }
+  line(fr, "r = evaluate_single(ast[%zu], global);", ast_ref(em, e));
+  check_result(fr, 0);
+}
+
+static bool emit_run(emitter_t *em, s_expression_t **forms, size_t count, FILE *out) {
+  buffer_t body;
+  if (!buffer_open(&body)) return false;
+  frame_t fr = { .out = body.f, .indent = 1 };
+  slots_new(&fr, 1); // t[0] holds the value of the last form
+  line(&fr, "t[0] = lval_nil();");
+  for (size_t i = 0; i < count; i++) {
+    fr.form = i;
+    emit_toplevel(em, &fr, forms[i]);
+    line(&fr, "gc_maybe_collect(NULL);");
+  }
+  line(&fr, "r = eval_ok(t[0]);");
+  fputs("static eval_result_t run(void) {\n", out);
+  return finish_function(&fr, &body, out);
+}
+
+static const char k_preamble[] =
+    "#include \"bignum.h\"\n"
+    "#include \"builtin.h\"\n"
+    "#include \"env.h\"\n"
+    "#include \"evaluator.h\"\n"
+    "#include \"gc.h\"\n"
+    "#include \"lval.h\"\n"
+    "#include \"parser.h\"\n"
+    "#include \"symbol.h\"\n"
+    "#include <math.h>\n"
+    "#include <stdarg.h>\n"
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "static env_t *global;\n"
+    "\n"
+    "// Syntax trees for the forms that are interpreted, built once by init().\n"
+    "static inline s_expression_t *new_node(node_type_t type) {\n"
+    "  s_expression_t *n = calloc(1, sizeof(*n));\n"
+    "  if (!n) {\n"
+    "    perror(\"calloc\");\n"
+    "    exit(EXIT_FAILURE);\n"
+    "  }\n"
+    "  n->type = type;\n"
+    "  return n;\n"
+    "}\n"
+    "\n"
+    "static inline s_expression_t *atom_node(atom_type_t type) {\n"
+    "  s_expression_t *n = new_node(NODE_ATOM);\n"
+    "  n->data.atom.type = type;\n"
+    "  return n;\n"
+    "}\n"
+    "\n"
+    "static inline s_expression_t *sym_node(const char *interned) {\n"
+    "  s_expression_t *n = atom_node(ATOM_SYMBOL);\n"
+    "  n->data.atom.value.symbol = interned;\n"
+    "  return n;\n"
+    "}\n"
+    "\n"
+    "static inline s_expression_t *int_node(int64_t x) {\n"
+    "  s_expression_t *n = atom_node(ATOM_INTEGER);\n"
+    "  n->data.atom.value.integer = x;\n"
+    "  return n;\n"
+    "}\n"
+    "\n"
+    "static inline s_expression_t *num_node(double x) {\n"
+    "  s_expression_t *n = atom_node(ATOM_NUMBER);\n"
+    "  n->data.atom.value.number = x;\n"
+    "  return n;\n"
+    "}\n"
+    "\n"
+    "static inline s_expression_t *big_node(const char *digits) {\n"
+    "  s_expression_t *n = atom_node(ATOM_BIGNUM);\n"
+    "  n->data.atom.value.bignum = bignum_from_string(digits);\n"
+    "  return n;\n"
+    "}\n"
+    "\n"
+    "static inline s_expression_t *str_node(const char *s) {\n"
+    "  s_expression_t *n = atom_node(ATOM_STRING);\n"
+    "  n->data.atom.value.string = strdup(s);\n"
+    "  return n;\n"
+    "}\n"
+    "\n"
+    "static inline s_expression_t *bool_node(bool b) {\n"
+    "  s_expression_t *n = atom_node(ATOM_BOOLEAN);\n"
+    "  n->data.atom.value.boolean = b;\n"
+    "  return n;\n"
+    "}\n"
+    "\n"
+    "static inline s_expression_t *list_node(s_expression_t *tail, size_t count, ...) {\n"
+    "  s_expression_t *n = new_node(NODE_LIST);\n"
+    "  n->data.list.elements = calloc(count ? count : 1, sizeof(s_expression_t *));\n"
+    "  if (!n->data.list.elements) {\n"
+    "    perror(\"calloc\");\n"
+    "    exit(EXIT_FAILURE);\n"
+    "  }\n"
+    "  va_list ap;\n"
+    "  va_start(ap, count);\n"
+    "  for (size_t i = 0; i < count; i++) {\n"
+    "    n->data.list.elements[i] = va_arg(ap, s_expression_t *);\n"
+    "  }\n"
+    "  va_end(ap);\n"
+    "  n->data.list.count = count;\n"
+    "  n->data.list.tail = tail;\n"
+    "  return n;\n"
+    "}\n"
+    "\n";
+
+static const char k_main[] =
+    "int main(void) {\n"
+    "  env_t env = { 0 };\n"
+    "  symbol_intern_init();\n"
+    "  if (!env_init(&env, NULL)) {\n"
+    "    fprintf(stderr, \"Failed to initialize environment\\n\");\n"
+    "    return 1;\n"
+    "  }\n"
+    "  env_add_builtins(&env);\n"
+    "  gc_init(&env);\n"
+    "  global = &env;\n"
+    "  init();\n"
+    "\n"
+    "  int status = 0;\n"
+    "  eval_result_t r = run();\n"
+    "  if (r.status != EVAL_OK) {\n"
+    "    fprintf(stderr, \"Evaluation error: %s\\n\", eval_error_message(&r));\n"
+    "    evaluator_result_free(&r);\n"
+    "    status = 1;\n"
+    "  } else {\n"
+    "    lval_print(r.result);\n"
+    "    printf(\"\\n\");\n"
+    "  }\n"
+    "  gc_collect(NULL);\n"
+    "  env_destroy(&env);\n"
+    "  symbol_intern_free_all();\n"
+    "  return status;\n"
+    "}\n";
+
+static void emit_table_init(FILE *out, const char *table, const char *lookup,
+                            const name_table_t *names) {
+  for (size_t i = 0; i < names->count; i++) {
+    fprintf(out, "  %s[%zu] = %s(", table, i, lookup);
+    put_c_string(out, names->items[i], strlen(names->items[i]));
+    fputs(");\n", out);
+  }
+}
+
+bool emit_c_program(s_expression_t **forms, size_t count, FILE *out) {
+  emitter_t em = { 0 };
+  buffer_t code;
+  if (!buffer_open(&em.asts)) return false;
+  if (!buffer_open(&code)) {
+    fclose(em.asts.f);
+    free(em.asts.buf);
+    return false;
+  }
+  bool ok = true;
+
+  for (size_t i = 0; i < count; i++) scan_names(&em, forms[i]);
+  collect_fns(&em, forms, count);
+
+  for (size_t i = 0; i < em.fn_count; i++) {
+    fprintf(code.f, "static eval_result_t fn_%zu(lval_t **args);\n", i);
+  }
+  if (em.fn_count) fputc('\n', code.f);
+  for (size_t i = 0; i < em.fn_count && ok; i++) ok = emit_function(&em, i, code.f);
+  if (ok) ok = emit_run(&em, forms, count, code.f);
+
+  fputs(k_preamble, out);
+  if (em.syms.count) fprintf(out, "static const char *sym[%zu];\n", em.syms.count);
+  if (em.builtins.count) fprintf(out, "static builtin_fn bi[%zu];\n", em.builtins.count);
+  if (em.ast_count) fprintf(out, "static s_expression_t *ast[%zu];\n", em.ast_count);
+  fputc('\n', out);
+  fputs("static void init(void) {\n", out);
+  emit_table_init(out, "sym", "symbol_intern", &em.syms);
+  emit_table_init(out, "bi", "lookup_builtin", &em.builtins);
+  ok = buffer_flush(&em.asts, out) && ok;
+  fputs("}\n\n", out);
+  ok = buffer_flush(&code, out) && ok;
+  fputs(k_main, out);
+
+  free(em.uses);
+  free(em.fns);
+  free(em.syms.items);
+  free(em.builtins.items);
+  return ok && !ferror(out);
+}
@@ -1,9 +1,37 @@
 #include "env.h"
 #include "hashtable.h"
+#include "symbol.h"
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+// Symbols that have never been bound in a non-root environment cannot be
+// shadowed, so their lookups skip the frame walk and go straight to the
+// root: a single load from the global cell, or the call-site cache for
+// other roots.
+static size_t global_version = 1;
+static size_t fold_version = 1;
+static env_t *global_env = NULL;
+
+size_t env_global_version(void) {
+  return global_version;
+}
+
+size_t env_fold_version(void) {
+  return fold_version;
+}
+
+bool env_is_global(const env_t *env) {
+  return env && env == global_env;
+}
+
+static void env_attach_root(env_t *env, env_t *parent) {
+  env->root = parent ? parent->root : env;
+  if (parent) return;
+  global_version++;
+  if (!global_env) global_env = env;
+}
+
 void env_release(env_t *env) {
   if (!env || !env->managed) return;
   if (--env->refcount == 0) {
@@ -28,6 +56,8 @@ env_t *env_new(env_t *parent) {
   env->parent = parent;
   env->refcount = 1;
   env->managed = true;
+  env->gc_epoch = 0;
+  env_attach_root(env, parent);
   env->store = malloc(sizeof *env->store);
   if (!env->store) {
     perror("malloc");
@@ -52,6 +82,8 @@ bool env_init(env_t *env, env_t *parent) {
   env->parent = parent;
   env->refcount = 0;
   env->managed = false;
+  env->gc_epoch = 0;
+  env_attach_root(env, parent);
 
   env->store = malloc(sizeof *env->store);
   if (!env->store) {
@@ -73,29 +105,63 @@ bool env_init(env_t *env, env_t *parent) {
 
 void env_destroy(env_t *env) {
   if (!env || !env->store) return;
+  if (!env->parent) {
+    global_version++;
+    fold_version++;
+  }
+  if (env == global_env) {
+    for (size_t id = 0; id < symbol_count(); id++) {
+      symbol_at(id)->global = NULL;
+    }
+    global_env = NULL;
+  }
   ht_destroy(env->store);
   free(env->store);
   env->store = NULL;
 }
 
-bool env_define(env_t *env, const char *key, lval_t *value) {
-  if (!env || !env->store || !key || !value) return false;
+bool env_define_symbol(env_t *env, const char *sym, lval_t *value) {
+  if (!env || !env->store || !sym || !value) return false;
+  symbol_t *s = symbol_of(sym);
+  if (env->parent) {
+    if (!s->local && (s->builtin || s->folded || s->inline_read)) fold_version++;
+    s->local = true;
+  } else {
+    global_version++;
+    if (s->builtin || s->folded) fold_version++;
+    if (env == global_env) {
+      s->global = value;
+      return true;
+    }
+  }
   ht_error err = { 0 };
-  if (!ht_set(env->store, key, value, &err)) {
-    fprintf(stderr, "Error defining key '%s': %s\n", key, err.error_message);
+  if (!ht_set_hashed(env->store, sym, s->hash, value, &err)) {
+    fprintf(stderr, "Error defining key '%s': %s\n", sym, err.error_message);
     exit(EXIT_FAILURE);
   }
   return true;
 }
 
-bool env_set(env_t *env, const char *key, lval_t *value) {
-  if (!env || !key) return false;
+bool env_set_symbol(env_t *env, const char *sym, lval_t *value) {
+  if (!env || !sym) return false;
+  symbol_t *s = symbol_of(sym);
   for (env_t *e = env; e; e = e->parent) {
+    if (e == global_env) {
+      if (!s->global) return false;
+      s->global = value;
+      global_version++;
+      if (s->builtin || s->folded) fold_version++;
+      return true;
+    }
     void *tmp = NULL;
-    if (ht_get(e->store, key, &tmp)) {
+    if (ht_get_hashed(e->store, sym, s->hash, &tmp)) {
+      if (!e->parent) {
+        global_version++;
+        if (s->builtin || s->folded) fold_version++;
+      }
       ht_error err = { 0 };
-      if (!ht_set(e->store, key, value, &err)) {
-        fprintf(stderr, "Error setting key '%s': %s\n", key, err.error_message);
+      if (!ht_set_hashed(e->store, sym, s->hash, value, &err)) {
+        fprintf(stderr, "Error setting key '%s': %s\n", sym, err.error_message);
         exit(EXIT_FAILURE);
       }
       return true;
@@ -104,30 +170,73 @@ bool env_set(env_t *env, const char *key, lval_t *value) {
   return false;
 }
 
-lval_t *env_get(env_t *env, const char *key) {
-  if (!env || !key) return NULL;
+lval_t *env_get_symbol(env_t *env, const char *sym) {
+  if (!env || !sym) return NULL;
+  symbol_t *s = symbol_of(sym);
+  if (!s->local && env->root == global_env) return s->global;
   for (env_t *e = env; e; e = e->parent) {
+    if (e == global_env) return s->global;
     void *value = NULL;
-    if (ht_get(e->store, key, &value)) {
-      return value;
+    if (ht_get_hashed(e->store, sym, s->hash, &value)) {
+      return (lval_t *)value;
     }
   }
   return NULL;
 }
 
+lval_t *env_get_cached(env_t *env, const char *sym, call_cache_t *cache) {
+  if (!env || !sym) return NULL;
+  symbol_t *s = symbol_of(sym);
+  if (s->local) return env_get_symbol(env, sym);
+  env_t *root = env->root;
+  if (root == global_env) return s->global;
+  if (cache->version == global_version && cache->root == root) return cache->value;
+
+  void *value = NULL;
+  if (!ht_get_hashed(root->store, sym, s->hash, &value)) return NULL;
+  cache->root = root;
+  cache->value = value;
+  cache->version = global_version;
+  return value;
+}
+
+bool env_define(env_t *env, const char *key, lval_t *value) {
+  if (!key) return false;
+  return env_define_symbol(env, symbol_intern(key), value);
+}
+
+bool env_set(env_t *env, const char *key, lval_t *value) {
+  if (!key) return false;
+  return env_set_symbol(env, symbol_intern(key), value);
+}
+
+lval_t *env_get(env_t *env, const char *key) {
+  if (!key) return NULL;
+  return env_get_symbol(env, symbol_intern(key));
+}
+
 lval_t *env_get_ref(env_t *env, const char *key) {
-  if (!env || !key) return NULL;
-  for (env_t *e = env; e; e = e->parent) {
-    void *value = NULL;
-    if (ht_get(e->store, key, &value)) {
-      return (lval_t *)value;
-    }
-  }
-  return NULL;
+  return env_get(env, key);
+}
+
+static size_t mark_epoch = 0;
+
+// Starts a marking pass. Each frame is then scanned at most once per pass,
+// however many closures and active calls share it.
+void env_gc_begin(void) {
+  mark_epoch++;
 }
 
 void env_gc_mark_all(env_t *env, env_mark_fn mark) {
-  for (env_t *e = env; e; e = e->parent) {
+  for (env_t *e = env; e && e->gc_epoch != mark_epoch; e = e->parent) {
+    e->gc_epoch = mark_epoch;
+    if (e == global_env) {
+      for (size_t id = 0; id < symbol_count(); id++) {
+        lval_t *val = symbol_at(id)->global;
+        if (val) mark(val);
+      }
+      continue;
+    }
     ht_iter it;
     ht_iter_begin(e->store, &it);
 #if HT_STRING_KEYS
@@ -1,10 +1,18 @@
 #include "evaluator.h"
+#include "bignum.h"
 #include "builtin.h"
+#include "dispatch.h"
 #include "env.h"
+#include "fold.h"
 #include "gc.h"
+#include "jit.h"
 #include "lval.h"
 #include "parser.h"
+#include "profile.h"
 #include "special.h"
+#include "symbol.h"
+#include "unbox.h"
+#include <limits.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -23,7 +31,7 @@ static s_expression_t *make_atom_symbol(const char *name) {
   if (!a) return NULL;
   a->type = NODE_ATOM;
   a->data.atom.type = ATOM_SYMBOL;
-  a->data.atom.value.symbol = strdup(name);
+  a->data.atom.value.symbol = symbol_intern(name);
   return a;
 }
 static s_expression_t *make_atom_string(const char *s) {
@@ -42,6 +50,22 @@ static s_expression_t *make_atom_number(double x) {
   a->data.atom.value.number = x;
   return a;
 }
+static s_expression_t *make_atom_integer(int64_t x) {
+  s_expression_t *a = malloc(sizeof *a);
+  if (!a) return NULL;
+  a->type = NODE_ATOM;
+  a->data.atom.type = ATOM_INTEGER;
+  a->data.atom.value.integer = x;
+  return a;
+}
+static s_expression_t *make_atom_bignum(const bignum_t *b) {
+  s_expression_t *a = malloc(sizeof *a);
+  if (!a) return NULL;
+  a->type = NODE_ATOM;
+  a->data.atom.type = ATOM_BIGNUM;
+  a->data.atom.value.bignum = bignum_copy(b);
+  return a;
+}
 static s_expression_t *make_atom_boolean(bool b) {
   s_expression_t *a = malloc(sizeof *a);
   if (!a) return NULL;
@@ -57,6 +81,9 @@ static s_expression_t *make_list_nodes(s_expression_t **elems, size_t n, s_expre
   l->data.list.elements = elems;
   l->data.list.count = n;
   l->data.list.tail = tail;
+  l->data.list.line = 0;
+  l->data.list.cache = (call_cache_t){ 0 };
+  l->data.list.fold = (fold_info_t){ 0 };
   return l;
 }
 
@@ -65,6 +92,10 @@ static s_expression_t *sexp_from_lval(const lval_t *v) {
   switch (v->type) {
   case L_NUM:
     return make_atom_number(v->as.number);
+  case L_INT:
+    return make_atom_integer(v->as.integer);
+  case L_BIGNUM:
+    return make_atom_bignum(v->as.bignum);
   case L_BOOL:
     return make_atom_boolean(v->as.boolean);
   case L_STRING:
@@ -116,12 +147,12 @@ static void sexp_free_owned(s_expression_t *n) {
   if (!n) return;
   switch (n->type) {
   case NODE_ATOM:
-    if (n->data.atom.type == ATOM_SYMBOL && n->data.atom.value.symbol)
-      free(n->data.atom.value.symbol);
     if (n->data.atom.type == ATOM_STRING && n->data.atom.value.string)
       free(n->data.atom.value.string);
+    if (n->data.atom.type == ATOM_BIGNUM) bignum_free(n->data.atom.value.bignum);
     break;
   case NODE_LIST:
+    fold_release(n);
     for (size_t i = 0; i < n->data.list.count; ++i)
       sexp_free_owned(n->data.list.elements[i]);
     free(n->data.list.elements);
@@ -137,12 +168,16 @@ static eval_result_t datum_from_sexp(const s_expression_t *e) {
     switch (a->type) {
     case ATOM_NUMBER:
       return eval_ok(lval_num(a->value.number));
+    case ATOM_INTEGER:
+      return eval_ok(lval_int(a->value.integer));
+    case ATOM_BIGNUM:
+      return eval_ok(lval_bignum(bignum_copy(a->value.bignum)));
     case ATOM_BOOLEAN:
       return eval_ok(lval_bool(a->value.boolean));
     case ATOM_STRING:
       return eval_ok(lval_string_copy(a->value.string, strlen(a->value.string)));
     case ATOM_SYMBOL:
-      return eval_ok(lval_intern(a->value.symbol));
+      return eval_ok(lval_symbol(a->value.symbol));
     default:
       return eval_errf("datum_from_sexp: bad atom");
     }
@@ -174,6 +209,7 @@ eval_result_t eval_ok(lval_t *result) {
 }
 
 eval_result_t eval_errf(const char *fmt, ...) {
+  if (!strchr(fmt, '%')) return eval_err(EVAL_ERR_MESSAGE, fmt, NULL);
   va_list ap;
   va_start(ap, fmt);
   char tmp[256];
@@ -194,32 +230,99 @@ eval_result_t eval_errf(const char *fmt, ...) {
   va_end(ap);
   eval_result_t r = { 0 };
   r.status = EVAL_ERR;
+  r.error_code = EVAL_ERR_MESSAGE;
+  r.error_owned = true;
   r.error_message = msg;
   r.result = NULL;
   return r;
 }
 
+eval_result_t eval_err(eval_error_code_t code, const char *what, lval_t *value) {
+  eval_result_t r = { 0 };
+  r.status = EVAL_ERR;
+  r.error_code = (unsigned char)code;
+  r.error_message = (char *)what;
+  r.result = value;
+  return r;
+}
+
+eval_result_t eval_err_arity(const char *what, size_t argc, lval_t *fn) {
+  if (argc > USHRT_MAX) {
+    // Too many to record unformatted.
+    if (fn) return eval_errf("%s %zu arguments, got %zu", what, fn->as.function.param_count, argc);
+    return eval_errf("%s, got %zu", what, argc);
+  }
+  eval_result_t r = eval_err(EVAL_ERR_ARITY, what, fn);
+  r.error_arg = (unsigned short)argc;
+  return r;
+}
+
+eval_result_t eval_err_at(eval_error_code_t code, const char *what, size_t arg, lval_t *value) {
+  eval_result_t r = eval_err(code, what, value);
+  r.error_arg = arg > USHRT_MAX ? 0 : (unsigned short)arg;
+  return r;
+}
+
+const char *eval_error_message(eval_result_t *r) {
+  if (r->status != EVAL_ERR) return NULL;
+  if (r->error_owned || r->error_code == EVAL_ERR_MESSAGE) return r->error_message;
+  char *text = NULL;
+  size_t len = 0;
+  FILE *f = open_memstream(&text, &len);
+  if (!f) {
+    perror("open_memstream");
+    exit(EXIT_FAILURE);
+  }
+  const lval_t *v = r->result;
+  switch ((eval_error_code_t)r->error_code) {
+  case EVAL_ERR_TYPE:
+    fputs(r->error_message, f);
+    if (r->error_arg) fprintf(f, " at arg %u", (unsigned)r->error_arg);
+    fprintf(f, ", got %s", v ? lval_type_name(v) : "nothing");
+    break;
+  case EVAL_ERR_VALUE:
+    fprintf(f, "%s: ", r->error_message);
+    if (v) lval_fprint(f, v);
+    break;
+  case EVAL_ERR_UNBOUND:
+    fprintf(f, "Unbound symbol: %s", r->error_message);
+    break;
+  case EVAL_ERR_ARITY:
+    fputs(r->error_message, f);
+    if (v) fprintf(f, " %zu arguments", v->as.function.param_count);
+    fprintf(f, ", got %u", (unsigned)r->error_arg);
+    break;
+  case EVAL_ERR_USER:
+    fputs("error: ", f);
+    if (v && v->type == L_STRING) {
+      fwrite(v->as.string.ptr, 1, v->as.string.len, f);
+    } else if (v) {
+      lval_fprint(f, v);
+    }
+    break;
+  case EVAL_ERR_MESSAGE:
+    break;
+  }
+  fclose(f);
+  r->error_message = text;
+  r->error_owned = true;
+  return text;
+}
+
 static eval_result_t expand_macro_and_eval(lval_t *macro_fn, s_expression_t *call, env_t *env) {
   size_t argc = call->data.list.count - 1;
-  lval_t **argv = NULL;
-  if (argc) {
-    argv = calloc(argc, sizeof(lval_t *));
-    if (!argv) return eval_errf("Memory allocation failed for macro arguments array.");
-    for (size_t i = 0; i < argc; i++) {
-      eval_result_t res = datum_from_sexp(call->data.list.elements[i + 1]);
-      if (res.status != EVAL_OK) {
-        free(argv);
-        return res;
-      }
-      argv[i] = res.result;
+  lval_t **argv = gc_stack_reserve(argc);
+  for (size_t i = 0; i < argc; i++) {
+    eval_result_t res = datum_from_sexp(call->data.list.elements[i + 1]);
+    if (res.status != EVAL_OK) {
+      gc_stack_pop(argc);
+      return res;
     }
+    argv[i] = res.result;
   }
 
   eval_result_t res = evaluate_call(macro_fn, argc, argv, env);
-  for (size_t i = 0; i < argc; i++) {
-    (void)argv[i];
-  }
-  free(argv);
+  gc_stack_pop(argc);
   if (res.status != EVAL_OK) return res;
   s_expression_t *expanded = sexp_from_lval(res.result);
   if (!expanded) return eval_errf("macro: expansion is not compilable");
@@ -228,27 +331,10 @@ static eval_result_t expand_macro_and_eval(lval_t *macro_fn, s_expression_t *cal
   return out;
 }
 
-eval_result_t evaluate_call(lval_t *fn, size_t argc, lval_t **argv, env_t *env) {
-  if (!fn) return eval_errf("Unknown function");
-  if (fn->type == L_SYMBOL) {
-    const char *name = fn->as.symbol.name;
-    lval_t *binding = env_get_ref(env, name);
-    if (!binding) return eval_errf("Unknown function: %s", name);
-    fn = binding;
-  }
-
-  if (fn->type != L_FUNCTION && fn->type != L_NATIVE) {
-    return eval_errf("Expected a function, got: %s", lval_type_name(fn));
-  }
-
-  if (fn->type == L_NATIVE) {
-    builtin_fn bf = (builtin_fn)fn->as.native.fn;
-    if (!bf) return eval_errf("internal: null builtin");
-    return bf(argc, argv, env);
-  }
-
-  if (argc != fn->as.function.param_count) {
-    return eval_errf("Function expects %zu arguments, got %zu", fn->as.function.param_count, argc);
+static eval_result_t call_function(lval_t *fn, size_t argc, lval_t **argv) {
+  lval_t *native_result = NULL;
+  if (jit_enabled() && jit_try_call(fn, argc, argv, &native_result)) {
+    return eval_ok(native_result);
   }
 
   env_t *parent = fn->as.function.closure;
@@ -257,7 +343,7 @@ eval_result_t evaluate_call(lval_t *fn, size_t argc, lval_t **argv, env_t *env)
   }
   env_t *call_env = env_new(parent);
   for (size_t i = 0; i < argc; i++) {
-    if (!env_define(call_env, fn->as.function.params[i], argv[i])) {
+    if (!env_define_symbol(call_env, fn->as.function.params[i], argv[i])) {
       env_release(call_env);
       return eval_errf("Failed to set parameter '%s' in function environment",
                        fn->as.function.params[i]);
@@ -269,18 +355,80 @@ eval_result_t evaluate_call(lval_t *fn, size_t argc, lval_t **argv, env_t *env)
     env_release(call_env);
     return result;
   }
+  gc_push_frame(call_env);
   for (size_t i = 0; i < fn->as.function.body_count; i++) {
     result = evaluate_single(fn->as.function.body[i], call_env);
-    if (result.status != EVAL_OK) {
-      env_release(call_env);
-      return result;
-    }
+    if (result.status != EVAL_OK) break;
   }
-
+  gc_pop_frame();
   env_release(call_env);
   return result;
 }
 
+eval_result_t evaluate_call(lval_t *fn, size_t argc, lval_t **argv, env_t *env) {
+  if (!fn) return eval_errf("Unknown function");
+  if (fn->type == L_SYMBOL) {
+    const char *name = fn->as.symbol.name;
+    lval_t *binding = env_get_symbol(env, name);
+    if (!binding) return eval_err(EVAL_ERR_UNBOUND, name, NULL);
+    fn = binding;
+  }
+
+  if (fn->type != L_FUNCTION && fn->type != L_NATIVE) {
+    return eval_err(EVAL_ERR_TYPE, "Expected a function", fn);
+  }
+
+  if (fn->type == L_NATIVE) {
+    builtin_fn bf = (builtin_fn)fn->as.native.fn;
+    if (!bf) return eval_errf("internal: null builtin");
+    return bf(argc, argv, env);
+  }
+
+  if (argc != fn->as.function.param_count) {
+    return eval_err_arity("Function expects", argc, fn);
+  }
+
+  if (!profile_active) return call_function(fn, argc, argv);
+  profile_enter(fn);
+  eval_result_t result = call_function(fn, argc, argv);
+  profile_leave();
+  return result;
+}
+
+// Argument slots of the innermost inlined call being evaluated, read by
+// ATOM_ARGUMENT nodes in its body (see fold.h).
+static lval_t **inline_args = NULL;
+
+static eval_result_t evaluate_inline(s_expression_t *call, env_t *env) {
+  size_t argc = call->data.list.count - 1;
+  lval_t **args = gc_stack_reserve(argc);
+  fold_hold();
+  for (size_t i = 0; i < argc; i++) {
+    eval_result_t r = evaluate_single(call->data.list.elements[i], env);
+    if (r.status != EVAL_OK) {
+      fold_unhold();
+      gc_stack_pop(argc);
+      return r;
+    }
+    args[i] = r.result;
+  }
+  lval_t **saved = inline_args;
+  inline_args = args;
+  eval_result_t r = evaluate_single(call->data.list.elements[argc], env);
+  inline_args = saved;
+  fold_unhold();
+  gc_stack_pop(argc);
+  if (r.status == EVAL_OK) gc_maybe_collect(r.result);
+  return r;
+}
+
+// The name a profiler reports a call to `callee` under.
+static const char *callee_name(const lval_t *callee, const char *head_name) {
+  if (callee->type == L_NATIVE && callee->as.native.name) return callee->as.native.name;
+  if (callee->type == L_FUNCTION && callee->as.function.name) return callee->as.function.name;
+  return head_name ? head_name : "<lambda>";
+}
+
 eval_result_t evaluate_single(s_expression_t *expr, env_t *env) {
   if (!expr) return eval_errf("Cannot evaluate a NULL expression.");
 
@@ -290,34 +438,55 @@ eval_result_t evaluate_single(s_expression_t *expr, env_t *env) {
     switch (a->type) {
     case ATOM_NUMBER: {
       eval_result_t r = eval_ok(lval_num(a->value.number));
-      gc_maybe_collect();
+      gc_maybe_collect(r.result);
+      return r;
+    }
+    case ATOM_INTEGER: {
+      eval_result_t r = eval_ok(lval_int(a->value.integer));
+      gc_maybe_collect(r.result);
+      return r;
+    }
+    case ATOM_BIGNUM: {
+      eval_result_t r = eval_ok(lval_bignum(bignum_copy(a->value.bignum)));
+      gc_maybe_collect(r.result);
       return r;
     }
     case ATOM_BOOLEAN: {
       eval_result_t r = eval_ok(lval_bool(a->value.boolean));
-      gc_maybe_collect();
+      gc_maybe_collect(r.result);
       return r;
     }
     case ATOM_STRING: {
       const char *str = a->value.string;
       eval_result_t r = eval_ok(lval_string_copy(a->value.string, strlen(str)));
-      gc_maybe_collect();
+      gc_maybe_collect(r.result);
       return r;
     }
     case ATOM_SYMBOL: {
       const char *name = a->value.symbol;
-      lval_t *found = env_get_ref(env, name);
+      lval_t *found = env_get_symbol(env, name);
       if (found) return eval_ok(found);
-      return eval_errf("Unbound symbol: %s", name);
+      return eval_err(EVAL_ERR_UNBOUND, name, NULL);
     }
+    case ATOM_ARGUMENT:
+      return eval_ok(inline_args[a->value.argument]);
+    case ATOM_UNBOXED:
+      return unbox_eval(a->value.unboxed, env);
+    case ATOM_DISPATCH:
+      return dispatch_eval(a->value.dispatch, env);
     default:
       return eval_errf("Unknown atom type: %d", a->type);
     }
   }
-  case NODE_LIST:
+  case NODE_LIST: {
+    s_expression_t *folded = fold_replacement(expr, env);
+    if (folded) {
+      if (expr->data.list.fold.inlined) return evaluate_inline(folded, env);
+      return evaluate_single(folded, env);
+    }
     if (expr->data.list.count == 0 && expr->data.list.tail == NULL) {
       eval_result_t r = eval_ok(lval_nil());
-      gc_maybe_collect();
+      gc_maybe_collect(r.result);
       return r;
     }
 
@@ -327,56 +496,60 @@ eval_result_t evaluate_single(s_expression_t *expr, env_t *env) {
 
     s_expression_t *head = expr->data.list.elements[0];
     const char *head_name = NULL;
+    lval_t *callee = NULL;
     if (sexp_is_symbol(head, &head_name)) {
       special_form_fn sf = lookup_special_form(head_name);
       if (sf) {
         return sf(expr, env);
       }
-      lval_t *binding = env_get_ref(env, head_name);
-      if (binding && binding->type == L_FUNCTION && binding->as.function.is_macro) {
-        return expand_macro_and_eval(binding, expr, env);
+      callee = env_get_cached(env, head_name, &expr->data.list.cache);
+      if (callee && callee->type == L_FUNCTION && callee->as.function.is_macro) {
+        return expand_macro_and_eval(callee, expr, env);
       }
     }
+    // Slot 0 keeps the callee alive while the arguments are evaluated.
     size_t argc = expr->data.list.count - 1;
-    lval_t **argv = malloc(argc * sizeof(lval_t *));
-    if (!argv) {
-      return eval_errf("Memory allocation failed for arguments array.");
-    }
+    lval_t **slots = gc_stack_reserve(argc + 1);
+    lval_t **argv = slots + 1;
+    slots[0] = callee;
     for (size_t i = 0; i < argc; i++) {
       eval_result_t res = evaluate_single(expr->data.list.elements[i + 1], env);
       if (res.status != EVAL_OK) {
-        free(argv);
+        gc_stack_pop(argc + 1);
         return res;
       }
       argv[i] = res.result;
     }
-    lval_t *callee = NULL;
-    bool temp_sym = false;
 
-    if (sexp_is_symbol(head, &head_name)) {
-      callee = lval_intern(head_name);
-      temp_sym = true;
+    if (head_name) {
+      if (!callee) {
+        gc_stack_pop(argc + 1);
+        return eval_err(EVAL_ERR_UNBOUND, head_name, NULL);
+      }
     } else {
       eval_result_t res = evaluate_single(head, env);
       if (res.status != EVAL_OK) {
-        free(argv);
+        gc_stack_pop(argc + 1);
         return res;
       }
-      callee = res.result;
-    }
-    for (size_t i = 0; i < argc; i++) {
-      gc_root(&argv[i]);
+      callee = slots[0] = res.result;
     }
-    eval_result_t r = evaluate_call(callee, argc, argv, env);
-    for (size_t i = 0; i < argc; i++) {
-      gc_unroot(&argv[i]);
+    eval_result_t r;
+    if (!profile_active) {
+      r = evaluate_call(callee, argc, argv, env);
+    } else {
+      profile_call_t saved = profile_call;
+      profile_call.callee = callee_name(callee, head_name);
+      profile_call.line = expr->data.list.line;
+      r = evaluate_call(callee, argc, argv, env);
+      profile_call = saved;
     }
-    (void)temp_sym;
-    free(argv);
+    gc_stack_pop(argc + 1);
     if (r.status == EVAL_OK) {
-      gc_maybe_collect();
+      gc_maybe_collect(r.result);
     }
     return r;
+  }
   default:
     return eval_errf("Unknown expression type: %d", expr->type);
   }
@@ -387,6 +560,7 @@ eval_result_t evaluate_many(s_expression_t **exprs, size_t count, env_t *env) {
   eval_result_t last = { 0 };
 
   for (size_t i = 0; i < count; i++) {
+    fold_expression(exprs[i], env);
     eval_result_t r = evaluate_single(exprs[i], env);
     if (r.status != EVAL_OK) return r;
     last = r;
@@ -398,10 +572,9 @@ eval_result_t evaluate_many(s_expression_t **exprs, size_t count, env_t *env) {
 void evaluator_result_free(eval_result_t *r) {
   if (!r) return;
 
-  if (r->error_message != NULL) {
-    free(r->error_message);
-    r->error_message = NULL;
-  }
+  if (r->error_owned) free(r->error_message);
+  r->error_message = NULL;
+  r->error_owned = false;
 
   r->result = NULL;
   r->status = EVAL_OK;
@@ -0,0 +1,355 @@
+#include "f64vec.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define F64_X86_64 1
+#include <immintrin.h>
+#else
+#define F64_X86_64 0
+#endif
+
+#define F64_ALIGN 32
+// Partial results kept by the reductions: 4 AVX2 registers or 8 SSE2 ones.
+#define LANES 16
+
+// One version of the kernels. The reductions cover whole blocks of LANES
+// elements, leaving the tail to the callers below; element i goes to
+// partial i % LANES.
+typedef struct {
+  const char *name;
+  void (*add)(double *out, const double *a, const double *b, size_t n);
+  void (*mul)(double *out, const double *a, const double *b, size_t n);
+  void (*scale)(double *out, const double *a, double k, size_t n);
+  void (*fill)(double *out, double x, size_t n);
+  void (*sum)(double *partial, const double *a, size_t n);
+  void (*dot)(double *partial, const double *a, const double *b, size_t n);
+  // Partials start at a[0], and keep x when x < partial (x > partial for
+  // max), like MINPD and MAXPD with the new element first.
+  void (*min)(double *partial, const double *a, size_t n);
+  void (*max)(double *partial, const double *a, size_t n);
+} f64_ops_t;
+
+double *f64_alloc(size_t n) {
+  if (n == 0 || n > (SIZE_MAX - F64_ALIGN) / sizeof(double)) return NULL;
+  size_t bytes = (n * sizeof(double) + F64_ALIGN - 1) / F64_ALIGN * F64_ALIGN;
+  return aligned_alloc(F64_ALIGN, bytes);
+}
+
+static void scalar_add(double *out, const double *a, const double *b, size_t n) {
+  for (size_t i = 0; i < n; i++) out[i] = a[i] + b[i];
+}
+
+static void scalar_mul(double *out, const double *a, const double *b, size_t n) {
+  for (size_t i = 0; i < n; i++) out[i] = a[i] * b[i];
+}
+
+static void scalar_scale(double *out, const double *a, double k, size_t n) {
+  for (size_t i = 0; i < n; i++) out[i] = a[i] * k;
+}
+
+static void scalar_fill(double *out, double x, size_t n) {
+  for (size_t i = 0; i < n; i++) out[i] = x;
+}
+
+static void scalar_sum(double *partial, const double *a, size_t n) {
+  for (size_t j = 0; j < LANES; j++) partial[j] = 0.0;
+  for (size_t i = 0; i < n; i += LANES) {
+    for (size_t j = 0; j < LANES; j++) partial[j] += a[i + j];
+  }
+}
+
+static void scalar_dot(double *partial, const double *a, const double *b, size_t n) {
+  for (size_t j = 0; j < LANES; j++) partial[j] = 0.0;
+  for (size_t i = 0; i < n; i += LANES) {
+    for (size_t j = 0; j < LANES; j++) partial[j] += a[i + j] * b[i + j];
+  }
+}
+
+static void scalar_min(double *partial, const double *a, size_t n) {
+  for (size_t j = 0; j < LANES; j++) partial[j] = a[0];
+  for (size_t i = 0; i < n; i += LANES) {
+    for (size_t j = 0; j < LANES; j++) {
+      if (a[i + j] < partial[j]) partial[j] = a[i + j];
+    }
+  }
+}
+
+static void scalar_max(double *partial, const double *a, size_t n) {
+  for (size_t j = 0; j < LANES; j++) partial[j] = a[0];
+  for (size_t i = 0; i < n; i += LANES) {
+    for (size_t j = 0; j < LANES; j++) {
+      if (a[i + j] > partial[j]) partial[j] = a[i + j];
+    }
+  }
+}
+
+static const f64_ops_t k_scalar = { "scalar",   scalar_add, scalar_mul, scalar_scale, scalar_fill,
+                                    scalar_sum, scalar_dot, scalar_min, scalar_max };
+
+#if F64_X86_64
+
+// SSE2 is part of x86-64, so these need no check.
+static void sse2_add(double *out, const double *a, const double *b, size_t n) {
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+  }
+  scalar_add(out + i, a + i, b + i, n - i);
+}
+
+static void sse2_mul(double *out, const double *a, const double *b, size_t n) {
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+  }
+  scalar_mul(out + i, a + i, b + i, n - i);
+}
+
+static void sse2_scale(double *out, const double *a, double k, size_t n) {
+  __m128d kk = _mm_set1_pd(k);
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), kk));
+  scalar_scale(out + i, a + i, k, n - i);
+}
+
+static void sse2_fill(double *out, double x, size_t n) {
+  __m128d xx = _mm_set1_pd(x);
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) _mm_storeu_pd(out + i, xx);
+  scalar_fill(out + i, x, n - i);
+}
+
+// Applies `op` to 8 registers of partials and the next 16 elements.
+#define SSE2_REDUCE(partial, init, a, n, op)                                                       \
+  do {                                                                                             \
+    __m128d acc[8];                                                                                \
+    for (size_t j = 0; j < 8; j++) acc[j] = (init);                                                \
+    for (size_t i = 0; i < (n); i += LANES) {                                                      \
+      for (size_t j = 0; j < 8; j++) acc[j] = op(_mm_loadu_pd((a) + i + 2 * j), acc[j]);           \
+    }                                                                                              \
+    for (size_t j = 0; j < 8; j++) _mm_storeu_pd((partial) + 2 * j, acc[j]);                       \
+  } while (0)
+
+static void sse2_sum(double *partial, const double *a, size_t n) {
+  SSE2_REDUCE(partial, _mm_setzero_pd(), a, n, _mm_add_pd);
+}
+
+static void sse2_dot(double *partial, const double *a, const double *b, size_t n) {
+  __m128d acc[8];
+  for (size_t j = 0; j < 8; j++) acc[j] = _mm_setzero_pd();
+  for (size_t i = 0; i < n; i += LANES) {
+    for (size_t j = 0; j < 8; j++) {
+      __m128d x = _mm_mul_pd(_mm_loadu_pd(a + i + 2 * j), _mm_loadu_pd(b + i + 2 * j));
+      acc[j] = _mm_add_pd(x, acc[j]);
+    }
+  }
+  for (size_t j = 0; j < 8; j++) _mm_storeu_pd(partial + 2 * j, acc[j]);
+}
+
+static void sse2_min(double *partial, const double *a, size_t n) {
+  SSE2_REDUCE(partial, _mm_set1_pd(a[0]), a, n, _mm_min_pd);
+}
+
+static void sse2_max(double *partial, const double *a, size_t n) {
+  SSE2_REDUCE(partial, _mm_set1_pd(a[0]), a, n, _mm_max_pd);
+}
+
+static const f64_ops_t k_sse2 = { "sse2",   sse2_add, sse2_mul, sse2_scale, sse2_fill,
+                                  sse2_sum, sse2_dot, sse2_min, sse2_max };
+
+// Built for AVX2 whatever the compiler's target, and only called when the
+// CPU has it. dot multiplies and adds separately rather than with FMA, whose
+// single rounding would make its results differ from the other versions.
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static void avx2_add(double *out, const double *a, const double *b, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+  }
+  scalar_add(out + i, a + i, b + i, n - i);
+}
+
+AVX2 static void avx2_mul(double *out, const double *a, const double *b, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+  }
+  scalar_mul(out + i, a + i, b + i, n - i);
+}
+
+AVX2 static void avx2_scale(double *out, const double *a, double k, size_t n) {
+  __m256d kk = _mm256_set1_pd(k);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), kk));
+  scalar_scale(out + i, a + i, k, n - i);
+}
+
+AVX2 static void avx2_fill(double *out, double x, size_t n) {
+  __m256d xx = _mm256_set1_pd(x);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) _mm256_storeu_pd(out + i, xx);
+  scalar_fill(out + i, x, n - i);
+}
+
+#define AVX2_REDUCE(partial, init, a, n, op)                                                       \
+  do {                                                                                             \
+    __m256d acc0 = (init), acc1 = acc0, acc2 = acc0, acc3 = acc0;                                  \
+    for (size_t i = 0; i < (n); i += LANES) {                                                      \
+      acc0 = op(_mm256_loadu_pd((a) + i), acc0);                                                   \
+      acc1 = op(_mm256_loadu_pd((a) + i + 4), acc1);                                               \
+      acc2 = op(_mm256_loadu_pd((a) + i + 8), acc2);                                               \
+      acc3 = op(_mm256_loadu_pd((a) + i + 12), acc3);                                              \
+    }                                                                                              \
+    _mm256_storeu_pd((partial), acc0);                                                             \
+    _mm256_storeu_pd((partial) + 4, acc1);                                                         \
+    _mm256_storeu_pd((partial) + 8, acc2);                                                         \
+    _mm256_storeu_pd((partial) + 12, acc3);                                                        \
+  } while (0)
+
+AVX2 static void avx2_sum(double *partial, const double *a, size_t n) {
+  AVX2_REDUCE(partial, _mm256_setzero_pd(), a, n, _mm256_add_pd);
+}
+
+AVX2 static void avx2_dot(double *partial, const double *a, const double *b, size_t n) {
+  __m256d acc[4];
+  for (size_t j = 0; j < 4; j++) acc[j] = _mm256_setzero_pd();
+  for (size_t i = 0; i < n; i += LANES) {
+    for (size_t j = 0; j < 4; j++) {
+      __m256d x = _mm256_mul_pd(_mm256_loadu_pd(a + i + 4 * j), _mm256_loadu_pd(b + i + 4 * j));
+      acc[j] = _mm256_add_pd(x, acc[j]);
+    }
+  }
+  for (size_t j = 0; j < 4; j++) _mm256_storeu_pd(partial + 4 * j, acc[j]);
+}
+
+AVX2 static void avx2_min(double *partial, const double *a, size_t n) {
+  AVX2_REDUCE(partial, _mm256_set1_pd(a[0]), a, n, _mm256_min_pd);
+}
+
+AVX2 static void avx2_max(double *partial, const double *a, size_t n) {
+  AVX2_REDUCE(partial, _mm256_set1_pd(a[0]), a, n, _mm256_max_pd);
+}
+
+static const f64_ops_t k_avx2 = { "avx2",   avx2_add, avx2_mul, avx2_scale, avx2_fill,
+                                  avx2_sum, avx2_dot, avx2_min, avx2_max };
+
+#endif
+
+static const f64_ops_t *G_ops = NULL;
+
+static const f64_ops_t *best_ops(void) {
+#if F64_X86_64
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return &k_avx2;
+  return &k_sse2;
+#else
+  return &k_scalar;
+#endif
+}
+
+static const f64_ops_t *ops(void) {
+  if (!G_ops) G_ops = best_ops();
+  return G_ops;
+}
+
+const char *f64_kernels(void) {
+  return ops()->name;
+}
+
+bool f64_use_kernels(const char *name) {
+  const f64_ops_t *all[] = {
+#if F64_X86_64
+    &k_avx2,
+    &k_sse2,
+#endif
+    &k_scalar,
+  };
+  bool supported = false; // kernels up to the best one are
+  const f64_ops_t *best = best_ops();
+  for (size_t i = 0; i < sizeof all / sizeof all[0]; i++) {
+    supported = supported || all[i] == best;
+    if (supported && strcmp(all[i]->name, name) == 0) {
+      G_ops = all[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+void f64_add(double *out, const double *a, const double *b, size_t n) {
+  ops()->add(out, a, b, n);
+}
+
+void f64_mul(double *out, const double *a, const double *b, size_t n) {
+  ops()->mul(out, a, b, n);
+}
+
+void f64_scale(double *out, const double *a, double k, size_t n) {
+  ops()->scale(out, a, k, n);
+}
+
+void f64_fill(double *out, double x, size_t n) {
+  ops()->fill(out, x, n);
+}
+
+// Halves the partials until one is left: partial j takes in partial j + w,
+// for w = 8, 4, 2, 1.
+#define COMBINE(partial, combine)                                                                  \
+  do {                                                                                             \
+    for (size_t w = LANES / 2; w > 0; w /= 2) {                                                    \
+      for (size_t j = 0; j < w; j++) combine((partial)[j], (partial)[j + w]);                      \
+    }                                                                                              \
+  } while (0)
+
+#define ADD_INTO(acc, x) ((acc) += (x))
+#define MIN_INTO(acc, x) ((acc) = (x) < (acc) ? (x) : (acc))
+#define MAX_INTO(acc, x) ((acc) = (x) > (acc) ? (x) : (acc))
+
+double f64_sum(const double *a, size_t n) {
+  double partial[LANES] = { 0 };
+  size_t body = n - n % LANES;
+  if (body) ops()->sum(partial, a, body);
+  COMBINE(partial, ADD_INTO);
+  double s = partial[0];
+  for (size_t i = body; i < n; i++) s += a[i];
+  return s;
+}
+
+double f64_dot(const double *a, const double *b, size_t n) {
+  double partial[LANES] = { 0 };
+  size_t body = n - n % LANES;
+  if (body) ops()->dot(partial, a, b, body);
+  COMBINE(partial, ADD_INTO);
+  double s = partial[0];
+  for (size_t i = body; i < n; i++) s += a[i] * b[i];
+  return s;
+}
+
+double f64_min(const double *a, size_t n) {
+  double partial[LANES];
+  size_t body = n - n % LANES;
+  partial[0] = a[0];
+  if (body) {
+    ops()->min(partial, a, body);
+    COMBINE(partial, MIN_INTO);
+  }
+  double m = partial[0];
+  for (size_t i = body; i < n; i++) MIN_INTO(m, a[i]);
+  return m;
+}
+
+double f64_max(const double *a, size_t n) {
+  double partial[LANES];
+  size_t body = n - n % LANES;
+  partial[0] = a[0];
+  if (body) {
+    ops()->max(partial, a, body);
+    COMBINE(partial, MAX_INTO);
+  }
+  double m = partial[0];
+  for (size_t i = body; i < n; i++) MAX_INTO(m, a[i]);
+  return m;
+}
@@ -0,0 +1,583 @@
+#include "fold.h"
+#include "bignum.h"
+#include "builtin.h"
+#include "dispatch.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "jit.h"
+#include "profile.h"
+#include "special.h"
+#include "symbol.h"
+#include "unbox.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Builtins without side effects whose result only depends on their
+// arguments.
+static const char *const k_pure_builtins[] = {
+  "+", "-", "*", "/", "mod", "abs", "min", "max", "floor", "ceil", "round", "trunc", "sqrt",
+  "exp", "log", "=", "<", ">", "<=", ">=", "not", "number?", "string?",
+  "string-length", "string-append", "number->string", "string->number",
+};
+
+// Bodies with more nodes than this are not inlined.
+#define INLINE_MAX_NODES 32
+
+static bool is_pure_builtin(const char *name) {
+  for (size_t i = 0; i < sizeof k_pure_builtins / sizeof k_pure_builtins[0]; i++) {
+    if (strcmp(name, k_pure_builtins[i]) == 0) return true;
+  }
+  return false;
+}
+
+// Frees a tree built by the pass: literals, empty lists, inlined bodies,
+// unboxed regions and case tables.
+static void free_copy(s_expression_t *e) {
+  if (e->type == NODE_ATOM) {
+    if (e->data.atom.type == ATOM_STRING) free(e->data.atom.value.string);
+    if (e->data.atom.type == ATOM_BIGNUM) bignum_free(e->data.atom.value.bignum);
+    if (e->data.atom.type == ATOM_UNBOXED) unbox_free(e->data.atom.value.unboxed);
+    if (e->data.atom.type == ATOM_DISPATCH) dispatch_free(e->data.atom.value.dispatch);
+  } else {
+    for (size_t i = 0; i < e->data.list.count; i++) free_copy(e->data.list.elements[i]);
+    free(e->data.list.elements);
+    if (e->data.list.tail) free_copy(e->data.list.tail);
+  }
+  free(e);
+}
+
+static void free_inlined(s_expression_t *call) {
+  // The arguments are borrowed from the call site; only the body is ours.
+  free_copy(call->data.list.elements[call->data.list.count - 1]);
+  free(call->data.list.elements);
+  free(call);
+}
+
+static void free_replacement(s_expression_t *e, bool inlined) {
+  if (inlined) {
+    free_inlined(e);
+  } else {
+    free_copy(e);
+  }
+}
+
+// Replacements released while an inlined call, an unboxed region or a case
+// key is being evaluated may still be on the C stack (a recursive call can refold
+// the site it came from), so they are freed once the outermost one
+// returns.
+typedef struct {
+  s_expression_t *expr;
+  bool inlined;
+} retired_t;
+
+static size_t hold_depth = 0;
+static retired_t *retired = NULL;
+static size_t retired_count = 0;
+static size_t retired_capacity = 0;
+
+void fold_hold(void) {
+  hold_depth++;
+}
+
+void fold_unhold(void) {
+  if (--hold_depth > 0) return;
+  for (size_t i = 0; i < retired_count; i++) {
+    free_replacement(retired[i].expr, retired[i].inlined);
+  }
+  retired_count = 0;
+}
+
+static void retire(s_expression_t *e, bool inlined) {
+  if (hold_depth == 0) {
+    free_replacement(e, inlined);
+    return;
+  }
+  if (retired_count == retired_capacity) {
+    size_t new_cap = retired_capacity ? retired_capacity * 2 : 16;
+    retired_t *p = realloc(retired, new_cap * sizeof(*p));
+    if (!p) {
+      perror("realloc");
+      exit(EXIT_FAILURE);
+    }
+    retired = p;
+    retired_capacity = new_cap;
+  }
+  retired[retired_count++] = (retired_t){ e, inlined };
+}
+
+void fold_release(s_expression_t *list) {
+  fold_info_t *f = &list->data.list.fold;
+  s_expression_t *e = f->expr;
+  if (e && (f->inlined || f->owned)) retire(e, f->inlined);
+  f->expr = NULL;
+  f->owned = false;
+  f->inlined = false;
+}
+
+static bool fold_valid(const fold_info_t *f) {
+  return f->expr && f->version == env_fold_version();
+}
+
+// Whether `e` is an unboxed region or a case table, which hold pointers
+// into the tree they were made from.
+static bool is_compiled(const s_expression_t *e) {
+  return e->type == NODE_ATOM &&
+         (e->data.atom.type == ATOM_UNBOXED || e->data.atom.type == ATOM_DISPATCH);
+}
+
+// The literal `e` evaluates to under the current folds, or NULL.
+static const s_expression_t *constant_of(const s_expression_t *e) {
+  while (e->type == NODE_LIST) {
+    const fold_info_t *f = &e->data.list.fold;
+    if (!fold_valid(f) || f->inlined) return NULL;
+    e = f->expr;
+  }
+  return e->data.atom.type == ATOM_SYMBOL || is_compiled(e) ? NULL : e;
+}
+
+static s_expression_t *atom_from_lval(const lval_t *v) {
+  s_expression_t *e = malloc(sizeof *e);
+  if (!e) return NULL;
+  e->type = NODE_ATOM;
+  atom_t *a = &e->data.atom;
+  switch (v->type) {
+  case L_INT:
+    a->type = ATOM_INTEGER;
+    a->value.integer = v->as.integer;
+    return e;
+  case L_NUM:
+    a->type = ATOM_NUMBER;
+    a->value.number = v->as.number;
+    return e;
+  case L_BIGNUM:
+    a->type = ATOM_BIGNUM;
+    a->value.bignum = bignum_copy(v->as.bignum);
+    return e;
+  case L_BOOL:
+    a->type = ATOM_BOOLEAN;
+    a->value.boolean = v->as.boolean;
+    return e;
+  case L_STRING: {
+    // String atoms are NUL-terminated.
+    size_t len = v->as.string.len;
+    if (memchr(v->as.string.ptr, '\0', len)) break;
+    a->type = ATOM_STRING;
+    a->value.string = malloc(len + 1);
+    if (!a->value.string) break;
+    memcpy(a->value.string, v->as.string.ptr, len);
+    a->value.string[len] = '\0';
+    return e;
+  }
+  default:
+    break;
+  }
+  free(e);
+  return NULL;
+}
+
+static s_expression_t *empty_list(void) {
+  s_expression_t *e = calloc(1, sizeof *e);
+  if (!e) return NULL;
+  e->type = NODE_LIST;
+  return e;
+}
+
+static bool is_named_quote(const s_expression_t *e) {
+  return sexp_is_symbol_name(e, "quote");
+}
+
+static void set_replacement(s_expression_t *list, s_expression_t *expr, bool owned) {
+  list->data.list.fold.expr = expr;
+  list->data.list.fold.owned = owned && expr;
+}
+
+// Runs a pure builtin on constant arguments, returning the result as a
+// literal. Calls that fail are left for the evaluator to report.
+static s_expression_t *fold_call(s_expression_t *list, env_t *env) {
+  s_expression_t **el = list->data.list.elements;
+  size_t argc = list->data.list.count - 1;
+  const char *name = NULL;
+  if (!sexp_is_symbol(el[0], &name) || !is_pure_builtin(name)) return NULL;
+  builtin_fn fn = lookup_builtin(name);
+  if (!fn || symbol_of(name)->local) return NULL;
+  lval_t *bound = env_get_symbol(env, name);
+  if (!bound || bound->type != L_NATIVE || bound->as.native.fn != (void *)fn) return NULL;
+  for (size_t i = 0; i < argc; i++) {
+    if (!constant_of(el[i + 1])) return NULL;
+  }
+
+  s_expression_t *out = NULL;
+  lval_t **argv = gc_stack_reserve(argc);
+  for (size_t i = 0; i < argc; i++) {
+    eval_result_t r = evaluate_single((s_expression_t *)constant_of(el[i + 1]), env);
+    if (r.status != EVAL_OK) {
+      evaluator_result_free(&r);
+      goto done;
+    }
+    argv[i] = r.result;
+  }
+  eval_result_t r = fn(argc, argv, env);
+  if (r.status == EVAL_OK) {
+    out = atom_from_lval(r.result);
+  } else {
+    evaluator_result_free(&r);
+  }
+done:
+  gc_stack_pop(argc);
+  return out;
+}
+
+static void prune_if(s_expression_t *list) {
+  s_expression_t **el = list->data.list.elements;
+  size_t n = list->data.list.count;
+  if (n < 3 || n > 4) return;
+  const s_expression_t *c = constant_of(el[1]);
+  if (!c || c->data.atom.type != ATOM_BOOLEAN) return;
+  if (c->data.atom.value.boolean) {
+    set_replacement(list, el[2], false);
+  } else if (n == 4) {
+    set_replacement(list, el[3], false);
+  } else {
+    set_replacement(list, empty_list(), true);
+  }
+}
+
+// Replaces an and (`stop_on` false) or an or (`stop_on` true) with its
+// first argument that is constantly `stop_on`, or with its last one if all
+// of them are constant and none is.
+static void prune_logic(s_expression_t *list, bool stop_on) {
+  s_expression_t **el = list->data.list.elements;
+  size_t n = list->data.list.count;
+  for (size_t i = 1; i < n; i++) {
+    const s_expression_t *c = constant_of(el[i]);
+    if (!c || c->data.atom.type != ATOM_BOOLEAN) return;
+    if (c->data.atom.value.boolean == stop_on || i + 1 == n) {
+      set_replacement(list, el[i], false);
+      return;
+    }
+  }
+}
+
+// Prunes a cond whose first clause that is not constantly false is
+// constantly true (or that has none left).
+static void prune_cond(s_expression_t *list, s_expression_t *clauses) {
+  s_expression_t **el = clauses->data.list.elements;
+  for (size_t i = 0; i + 1 < clauses->data.list.count; i += 2) {
+    const s_expression_t *c = constant_of(el[i]);
+    if (!c || c->data.atom.type != ATOM_BOOLEAN) return;
+    if (c->data.atom.value.boolean) {
+      set_replacement(list, el[i + 1], false);
+      return;
+    }
+  }
+  set_replacement(list, empty_list(), true);
+}
+
+static bool is_param(const lval_t *fn, const char *name, size_t *index) {
+  for (size_t i = 0; i < fn->as.function.param_count; i++) {
+    if (fn->as.function.params[i] == name) {
+      if (index) *index = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether the body `e` of `fn` (bound to `name`) can be evaluated in the
+// caller's environment with its parameters read from the argument slots:
+// it must be small, must not call `name` itself, must not bind or capture
+// anything, and none of its free names may be shadowed by a call frame.
+static bool inlinable(const s_expression_t *e, const lval_t *fn, const char *name, env_t *env,
+                      size_t *budget) {
+  if ((*budget)-- == 0) return false;
+  if (e->type == NODE_ATOM) {
+    const char *sym = NULL;
+    if (!sexp_is_symbol(e, &sym) || is_param(fn, sym, NULL)) return true;
+    return sym != name && !symbol_of(sym)->local;
+  }
+  if (e->data.list.tail) return false;
+  size_t n = e->data.list.count;
+  if (n == 0) return true;
+  s_expression_t **el = e->data.list.elements;
+  const char *head = NULL;
+  if (sexp_is_symbol(el[0], &head) && lookup_special_form(head)) {
+    if (strcmp(head, "quote") == 0) return true;
+    if (strcmp(head, "cond") == 0) {
+      if (n != 2 || el[1]->type != NODE_LIST || el[1]->data.list.tail) return false;
+      for (size_t i = 0; i < el[1]->data.list.count; i++) {
+        if (!inlinable(el[1]->data.list.elements[i], fn, name, env, budget)) return false;
+      }
+      return true;
+    }
+    if (strcmp(head, "if") != 0 && strcmp(head, "begin") != 0 && strcmp(head, "and") != 0 &&
+        strcmp(head, "or") != 0)
+      return false;
+    for (size_t i = 1; i < n; i++) {
+      if (!inlinable(el[i], fn, name, env, budget)) return false;
+    }
+    return true;
+  }
+  if (head && !is_param(fn, head, NULL)) {
+    // Macro calls would see the argument slots as data.
+    lval_t *callee = env_get_symbol(env, head);
+    if (callee && callee->type == L_FUNCTION && callee->as.function.is_macro) return false;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (!inlinable(el[i], fn, name, env, budget)) return false;
+  }
+  return true;
+}
+
+static s_expression_t *copy_atom(const atom_t *a) {
+  s_expression_t *c = malloc(sizeof *c);
+  if (!c) return NULL;
+  c->type = NODE_ATOM;
+  c->data.atom = *a;
+  if (a->type == ATOM_BIGNUM) c->data.atom.value.bignum = bignum_copy(a->value.bignum);
+  if (a->type == ATOM_STRING) {
+    c->data.atom.value.string = strdup(a->value.string);
+    if (!c->data.atom.value.string) {
+      free(c);
+      return NULL;
+    }
+  }
+  return c;
+}
+
+// Copies the body `e` of `fn`, replacing parameter references with
+// ATOM_ARGUMENT atoms and nodes the pass already folded with their
+// replacement. Quoted data is copied as is. The copy reads free variables
+// at run time, so they are only marked inline_read, which invalidates it if
+// a call frame comes to shadow them. The heads of its calls are marked
+// folded: rebinding one may make it a macro or change its own inlining.
+static s_expression_t *copy_body(const s_expression_t *e, const lval_t *fn, bool quoted) {
+  if (e->type == NODE_ATOM) {
+    const char *sym = NULL;
+    size_t index = 0;
+    if (!quoted && sexp_is_symbol(e, &sym)) {
+      if (is_param(fn, sym, &index)) {
+        s_expression_t *arg = malloc(sizeof *arg);
+        if (!arg) return NULL;
+        arg->type = NODE_ATOM;
+        arg->data.atom.type = ATOM_ARGUMENT;
+        arg->data.atom.value.argument = index;
+        return arg;
+      }
+      symbol_of(sym)->inline_read = true;
+    }
+    return copy_atom(&e->data.atom);
+  }
+  const fold_info_t *f = &e->data.list.fold;
+  if (!quoted && fold_valid(f) && !f->inlined && !is_compiled(f->expr)) {
+    return copy_body(f->expr, fn, false);
+  }
+
+  size_t n = e->data.list.count;
+  s_expression_t *c = empty_list();
+  if (!c) return NULL;
+  c->data.list.elements = calloc(n ? n : 1, sizeof(s_expression_t *));
+  if (!c->data.list.elements) {
+    free(c);
+    return NULL;
+  }
+  quoted = quoted || (n == 2 && is_named_quote(e->data.list.elements[0]));
+  for (size_t i = 0; i < n; i++) {
+    s_expression_t *item = copy_body(e->data.list.elements[i], fn, quoted);
+    if (!item) {
+      free_copy(c);
+      return NULL;
+    }
+    const char *head = NULL;
+    if (i == 0 && !quoted && sexp_is_symbol(item, &head)) symbol_of(head)->folded = true;
+    c->data.list.elements[i] = item;
+    c->data.list.count++;
+  }
+  if (e->data.list.tail) {
+    c->data.list.tail = copy_body(e->data.list.tail, fn, quoted);
+    if (!c->data.list.tail) {
+      free_copy(c);
+      return NULL;
+    }
+  }
+  return c;
+}
+
+// Replaces a call to a small global lambda by its body. The result is a
+// list of the call's argument expressions followed by the copied body;
+// evaluate_single evaluates the arguments into slots and then the body in
+// the caller's environment, without a call frame.
+static s_expression_t *inline_call(s_expression_t *list, env_t *env) {
+  s_expression_t **el = list->data.list.elements;
+  size_t argc = list->data.list.count - 1;
+  const char *name = NULL;
+  // Compiled code only calls functions directly, so the JIT gets them whole.
+  if (jit_enabled()) return NULL;
+  // The profiler sees calls, not inlined bodies.
+  if (profile_active) return NULL;
+  if (!sexp_is_symbol(el[0], &name) || symbol_of(name)->local) return NULL;
+  const lval_t *fn = env_get_symbol(env, name);
+  if (!fn || fn->type != L_FUNCTION || fn->as.function.is_macro) return NULL;
+  if (fn->as.function.closure != env->root || fn->as.function.body_count != 1) return NULL;
+  if (fn->as.function.param_count != argc) return NULL;
+  for (size_t i = 0; i < argc; i++) {
+    // The body was folded on the assumption that its parameters shadow no
+    // builtin, which only holds once a call frame has bound them.
+    if (symbol_of(fn->as.function.params[i])->builtin) return NULL;
+  }
+  size_t budget = INLINE_MAX_NODES;
+  if (!inlinable(fn->as.function.body[0], fn, name, env, &budget)) return NULL;
+
+  s_expression_t *call = empty_list();
+  if (!call) return NULL;
+  call->data.list.elements = malloc((argc + 1) * sizeof(s_expression_t *));
+  s_expression_t *body = call->data.list.elements ? copy_body(fn->as.function.body[0], fn, false)
+                                                  : NULL;
+  if (!body) {
+    free(call->data.list.elements);
+    free(call);
+    return NULL;
+  }
+  for (size_t i = 0; i < argc; i++) call->data.list.elements[i] = el[i + 1];
+  call->data.list.elements[argc] = body;
+  call->data.list.count = argc + 1;
+  symbol_of(name)->folded = true;
+  return call;
+}
+
+// Wraps the unboxed region rooted at `list`, if any, in an atom.
+static s_expression_t *unboxed_call(s_expression_t *list, env_t *env) {
+  unboxed_t *code = unbox_compile(list, env);
+  if (!code) return NULL;
+  s_expression_t *e = malloc(sizeof *e);
+  if (!e) {
+    unbox_free(code);
+    return NULL;
+  }
+  e->type = NODE_ATOM;
+  e->data.atom.type = ATOM_UNBOXED;
+  e->data.atom.value.unboxed = code;
+  return e;
+}
+
+static void fold_list(s_expression_t *list, env_t *env, size_t version);
+
+static void fold_node(s_expression_t *e, env_t *env, size_t version) {
+  if (e->type == NODE_LIST && e->data.list.fold.version != version) fold_list(e, env, version);
+}
+
+// Wraps the dispatch table of a well-formed case form in an atom.
+static s_expression_t *case_table(s_expression_t *list) {
+  dispatch_t *table = dispatch_compile(list);
+  if (!table) return NULL;
+  s_expression_t *e = malloc(sizeof *e);
+  if (!e) {
+    dispatch_free(table);
+    return NULL;
+  }
+  e->type = NODE_ATOM;
+  e->data.atom.type = ATOM_DISPATCH;
+  e->data.atom.value.dispatch = table;
+  return e;
+}
+
+// Folds the expressions of a let, let* or do form, leaving the binding
+// lists and do's (test result...) clause themselves alone.
+static void fold_binding_form(s_expression_t *list, const char *head, env_t *env,
+                              size_t version) {
+  s_expression_t **el = list->data.list.elements;
+  size_t n = list->data.list.count;
+  size_t at = n > 2 && sexp_is_symbol(el[1], NULL) ? 2 : 1; // named let
+  for (size_t clause = 0; at < n && clause < (strcmp(head, "do") == 0 ? 2 : 1); clause++, at++) {
+    s_expression_t *e = el[at];
+    if (e->type != NODE_LIST) continue;
+    for (size_t i = 0; i < e->data.list.count; i++) {
+      s_expression_t *b = e->data.list.elements[i];
+      if (clause == 1) {
+        fold_node(b, env, version);
+      } else if (b->type == NODE_LIST) {
+        for (size_t j = 1; j < b->data.list.count; j++) {
+          fold_node(b->data.list.elements[j], env, version);
+        }
+      }
+    }
+  }
+  for (; at < n; at++) fold_node(el[at], env, version);
+}
+
+static void fold_list(s_expression_t *list, env_t *env, size_t version) {
+  fold_release(list);
+  list->data.list.fold.version = version;
+  size_t n = list->data.list.count;
+  if (n == 0 || list->data.list.tail) return;
+  s_expression_t **el = list->data.list.elements;
+
+  const char *head = NULL;
+  if (sexp_is_symbol(el[0], &head) && lookup_special_form(head)) {
+    if (strcmp(head, "lambda") == 0) {
+      for (size_t i = 2; i < n; i++) fold_node(el[i], env, version);
+    } else if (strcmp(head, "cond") == 0) {
+      s_expression_t *clauses = n == 2 ? el[1] : NULL;
+      if (!clauses || clauses->type != NODE_LIST || clauses->data.list.tail ||
+          clauses->data.list.count % 2 != 0)
+        return;
+      for (size_t i = 0; i < clauses->data.list.count; i++) {
+        fold_node(clauses->data.list.elements[i], env, version);
+      }
+      prune_cond(list, clauses);
+    } else if (strcmp(head, "let") == 0 || strcmp(head, "let*") == 0 ||
+               strcmp(head, "do") == 0) {
+      fold_binding_form(list, head, env, version);
+    } else if (strcmp(head, "case") == 0) {
+      // The datum lists are left alone.
+      if (n > 1) fold_node(el[1], env, version);
+      for (size_t i = 2; i < n; i++) {
+        s_expression_t *c = el[i];
+        if (c->type != NODE_LIST) continue;
+        for (size_t j = 1; j < c->data.list.count; j++) {
+          fold_node(c->data.list.elements[j], env, version);
+        }
+      }
+      set_replacement(list, case_table(list), true);
+    } else if (strcmp(head, "try") == 0) {
+      // The catch clause is not a call.
+      for (size_t i = 1; i < n; i++) {
+        s_expression_t *c = el[i];
+        bool handler = i == n - 1 && c->type == NODE_LIST;
+        if (!handler) {
+          fold_node(c, env, version);
+          continue;
+        }
+        for (size_t j = 2; j < c->data.list.count; j++) {
+          fold_node(c->data.list.elements[j], env, version);
+        }
+      }
+    } else if (strcmp(head, "quote") == 0 || strcmp(head, "quasiquote") == 0 ||
+               strcmp(head, "defmacro") == 0) {
+      // Quoted data and macro bodies are left alone.
+    } else {
+      for (size_t i = 1; i < n; i++) fold_node(el[i], env, version);
+      if (strcmp(head, "if") == 0) prune_if(list);
+      if (strcmp(head, "and") == 0 || strcmp(head, "or") == 0) prune_logic(list, *head == 'o');
+    }
+    return;
+  }
+
+  for (size_t i = 0; i < n; i++) fold_node(el[i], env, version);
+  s_expression_t *constant = fold_call(list, env);
+  if (constant) {
+    set_replacement(list, constant, true);
+    return;
+  }
+  s_expression_t *inlined = inline_call(list, env);
+  if (inlined) {
+    set_replacement(list, inlined, true);
+    list->data.list.fold.inlined = true;
+    return;
+  }
+  set_replacement(list, unboxed_call(list, env), true);
+}
+
+void fold_expression(s_expression_t *expr, env_t *env) {
+  fold_node(expr, env, env_fold_version());
+}
@@ -1,6 +1,8 @@
 #include "gc.h"
+#include "bignum.h"
 #include "env.h"
 #include "lval.h"
+#include "profile.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,6 +12,8 @@ typedef struct {
   struct env *global_env;
   size_t count;
   size_t trigger;
+  size_t collections; // since gc_init
+  size_t allocations;
 } gc_heap_t;
 
 static gc_heap_t G = { 0 };
@@ -22,11 +26,29 @@ typedef struct gc_root_entry {
 static gc_root_entry_t *G_root_top = NULL;
 static size_t G_root_count = 0;
 
+#define GC_STACK_SEGMENT_SLOTS 4096
+
+typedef struct gc_stack_segment {
+  struct gc_stack_segment *prev;
+  size_t top;
+  size_t capacity;
+  lval_t *slots[];
+} gc_stack_segment_t;
+
+static gc_stack_segment_t *G_stack = NULL;
+static gc_stack_segment_t *G_stack_spare = NULL;
+
+static struct env **G_frames = NULL;
+static size_t G_frame_count = 0;
+static size_t G_frame_capacity = 0;
+
 void gc_init(struct env *global_env) {
   G.global_env = global_env;
   G.objects = NULL;
   G.count = 0;
   G.trigger = 100;
+  G.collections = 0;
+  G.allocations = 0;
   G_root_top = NULL;
   G_root_count = 0;
 }
@@ -46,37 +68,56 @@ struct lval *gc_alloc_lval() {
   v->gc_next = G.objects;
   G.objects = v;
   G.count++;
+  G.allocations++;
+  if (profile_alloc_active && --profile_alloc_countdown == 0) profile_alloc_sample(v);
   return v;
 }
 
-static void gc_mark(lval_t *v);
-
-static void gc_mark_cons(lval_t *v) {
-  if (v->type != L_CONS) {
-    fprintf(stderr, "gc_mark_cons: not a cons cell\n");
-    return;
-  }
-  if (v->as.cons.car) gc_mark(v->as.cons.car);
-  if (v->as.cons.cdr) gc_mark(v->as.cons.cdr);
-}
-
+// Marks `v` and everything it reaches. The last child of each object is
+// followed by the loop rather than by a recursive call, so that long lists
+// and memoized streams, which chain cons cells and promises, take no C
+// stack.
 static void gc_mark(lval_t *v) {
-  if (!v || v->mark) return;
-  v->mark = 1;
+  while (v && !v->mark) {
+    v->mark = 1;
+    lval_t *next = NULL;
 
-  switch (v->type) {
-  case L_CONS:
-    gc_mark_cons(v);
-    break;
-  case L_FUNCTION:
-    if (v->as.function.closure) {
-      env_gc_mark_all(v->as.function.closure, gc_mark);
+    switch (v->type) {
+    case L_CONS:
+      gc_mark(v->as.cons.car);
+      next = v->as.cons.cdr;
+      break;
+    case L_FUNCTION:
+      if (v->as.function.closure) {
+        env_gc_mark_all(v->as.function.closure, gc_mark);
+      }
+      break;
+    case L_PROMISE:
+      gc_mark(v->as.promise.args[0]);
+      gc_mark(v->as.promise.args[1]);
+      if (v->as.promise.env) env_gc_mark_all(v->as.promise.env, gc_mark);
+      next = v->as.promise.value;
+      break;
+    case L_ERROR:
+      next = v->as.error.value;
+      break;
+    case L_VECTOR:
+      for (size_t i = 0; i < v->as.vector.count; i++) gc_mark(v->as.vector.items[i]);
+      break;
+    case L_HASHTABLE: {
+      ht_iter it;
+      ht_iter_begin(v->as.hash.table, &it);
+      const char *key;
+      void *pair;
+      while (ht_iter_next(&it, &key, &pair)) gc_mark(pair);
+      break;
     }
-    break;
-  case L_STRING:
-    break;
-  default:
-    break;
+    case L_STRING:
+      break;
+    default:
+      break;
+    }
+    v = next;
   }
 }
 
@@ -85,17 +126,30 @@ static void gc_free_shallow(lval_t *v) {
   case L_STRING:
     free(v->as.string.ptr);
     break;
+  case L_BIGNUM:
+    bignum_free(v->as.bignum);
+    break;
   case L_FUNCTION:
-    if (v->as.function.params) {
-      for (size_t i = 0; i < v->as.function.param_count; i++) {
-        free(v->as.function.params[i]);
-      }
-      free(v->as.function.params);
-    }
+    free(v->as.function.params);
     if (v->as.function.closure) {
       env_release(v->as.function.closure);
     }
     break;
+  case L_PROMISE:
+    if (v->as.promise.env) env_release(v->as.promise.env);
+    break;
+  case L_ERROR:
+    if (v->as.error.owned) free(v->as.error.message);
+    break;
+  case L_VECTOR:
+    free(v->as.vector.items);
+    break;
+  case L_HASHTABLE:
+    lval_hash_table_free(v->as.hash.table);
+    break;
+  case L_F64VECTOR:
+    free(v->as.f64vector.items);
+    break;
   default:
     break;
   }
@@ -124,6 +178,8 @@ static void gc_sweep(void) {
 }
 
 void gc_collect(lval_t *extra_root) {
+  G.collections++;
+  env_gc_begin();
   if (G.global_env) env_gc_mark_all(G.global_env, gc_mark);
   if (extra_root) gc_mark(extra_root);
   for (gc_root_entry_t *entry = G_root_top; entry; entry = entry->next) {
@@ -131,15 +187,76 @@ void gc_collect(lval_t *extra_root) {
       gc_mark(*entry->slot);
     }
   }
+  for (gc_stack_segment_t *seg = G_stack; seg; seg = seg->prev) {
+    for (size_t i = 0; i < seg->top; i++) {
+      if (seg->slots[i]) gc_mark(seg->slots[i]);
+    }
+  }
+  for (size_t i = 0; i < G_frame_count; i++) {
+    env_gc_mark_all(G_frames[i], gc_mark);
+  }
+  if (profile_alloc_active) profile_alloc_collect();
   gc_sweep();
 }
 
-void gc_maybe_collect() {
+void gc_maybe_collect(lval_t *extra_root) {
   if (G.count >= G.trigger) {
-    gc_collect(NULL);
+    gc_collect(extra_root);
+  }
+}
+
+lval_t **gc_stack_reserve(size_t n) {
+  if (!G_stack || G_stack->capacity - G_stack->top < n) {
+    gc_stack_segment_t *seg = G_stack_spare;
+    if (seg && seg->capacity >= n) {
+      G_stack_spare = NULL;
+    } else {
+      size_t capacity = n > GC_STACK_SEGMENT_SLOTS ? n : GC_STACK_SEGMENT_SLOTS;
+      seg = malloc(sizeof *seg + capacity * sizeof(lval_t *));
+      if (!seg) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+      }
+      seg->capacity = capacity;
+    }
+    seg->top = 0;
+    seg->prev = G_stack;
+    G_stack = seg;
+  }
+  lval_t **base = &G_stack->slots[G_stack->top];
+  memset(base, 0, n * sizeof *base);
+  G_stack->top += n;
+  return base;
+}
+
+void gc_stack_pop(size_t n) {
+  G_stack->top -= n;
+  if (G_stack->top == 0 && G_stack->prev) {
+    gc_stack_segment_t *seg = G_stack;
+    G_stack = seg->prev;
+    free(G_stack_spare);
+    G_stack_spare = seg;
   }
 }
 
+void gc_push_frame(struct env *env) {
+  if (G_frame_count == G_frame_capacity) {
+    size_t capacity = G_frame_capacity ? G_frame_capacity * 2 : 64;
+    struct env **frames = realloc(G_frames, capacity * sizeof *frames);
+    if (!frames) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    G_frames = frames;
+    G_frame_capacity = capacity;
+  }
+  G_frames[G_frame_count++] = env;
+}
+
+void gc_pop_frame(void) {
+  G_frame_count--;
+}
+
 void gc_root(lval_t **slot) {
   gc_root_entry_t *e = malloc(sizeof(gc_root_entry_t));
   if (!e) {
@@ -170,6 +287,14 @@ size_t gc_object_count(void) {
   return G.count;
 }
 
+size_t gc_collection_count(void) {
+  return G.collections;
+}
+
+size_t gc_allocation_count(void) {
+  return G.allocations;
+}
+
 void gc_set_trigger(size_t threshold) {
   G.trigger = threshold ? threshold : (size_t)-1;
 }
@@ -187,6 +312,18 @@ void gc_reset(void) {
     G_root_top = next;
   }
 
+  while (G_stack) {
+    gc_stack_segment_t *prev = G_stack->prev;
+    free(G_stack);
+    G_stack = prev;
+  }
+  free(G_stack_spare);
+  G_stack_spare = NULL;
+
+  free(G_frames);
+  G_frames = NULL;
+  G_frame_count = G_frame_capacity = 0;
+
   G.objects = NULL;
   G.count = 0;
   G.trigger = 100;
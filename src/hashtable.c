@@ -10,11 +10,6 @@
 #define HT_MAX_LOAD_DEN 100
 #endif
 
-// Sentinel for tombstones: unique non-NULL pointer unlikely to collide with
-// real keys
-static const void *const HT_TOMBSTONE =
-    (const void *)(uintptr_t)(~(uintptr_t)0ULL - 1ULL);
-
 // SplitMix64 for pointer hashing or 64-bit mix
 static uint64_t splitmix64(uint64_t x) {
   x += 0x9e3779b97f4a7c15ULL;
@@ -44,7 +39,7 @@ static uint64_t hash_ptr(const void *p) {
 // Key equality and duplication
 #if HT_STRING_KEYS
 static inline bool keys_equal(const char *a, const char *b) {
-  return strcmp(a, b) == 0;
+  return a == b || strcmp(a, b) == 0;
 }
 #ifdef HT_DUP_KEYS
 static inline const char *dup_key(const char *k) {
@@ -88,7 +83,7 @@ bool ht_init(hashtable *table, size_t initial_capacity, ht_error *err) {
   }
   table->capacity = cap;
   table->size = 0;
-  table->tombstones = 0;
+  table->resizes = 0;
   return true;
 }
 
@@ -97,41 +92,33 @@ void ht_destroy(hashtable *table) {
     return;
 #if HT_STRING_KEYS && defined(HT_DUP_KEYS)
   for (size_t i = 0; i < table->capacity; ++i) {
-    const void *k = table->entries[i].key;
-    if (k && k != HT_TOMBSTONE) {
+    if (table->entries[i].key)
       free((void *)table->entries[i].key);
-    }
   }
 #endif
   free(table->entries);
   table->entries = NULL;
-  table->capacity = table->size = table->tombstones = 0;
+  table->capacity = table->size = table->resizes = 0;
 }
 
 static inline bool should_grow(const hashtable *t) {
-  size_t used = t->size + t->tombstones;
-  // grow when (used / capacity) > load factor
-  return (used * HT_MAX_LOAD_DEN) > (t->capacity * HT_MAX_LOAD_NUM);
+  // grow when (size / capacity) > load factor
+  return (t->size * HT_MAX_LOAD_DEN) > (t->capacity * HT_MAX_LOAD_NUM);
 }
 
-bool ht_set(hashtable *table,
 #if HT_STRING_KEYS
-            const char *key,
+static bool ht_set_with_hash(hashtable *table, const char *key, uint64_t h,
+                             void *value, ht_error *err) {
 #else
-            const void *key,
+static bool ht_set_with_hash(hashtable *table, const void *key, uint64_t h,
+                             void *value, ht_error *err) {
 #endif
-            void *value, ht_error *err) {
   assert(table && table->entries);
   if (should_grow(table)) {
     if (!ht_resize(table, table->capacity * 2, err))
       return false;
   }
 
-#if HT_STRING_KEYS
-  uint64_t h = hash_cstr(key);
-#else
-  uint64_t h = hash_ptr(key);
-#endif
   size_t mask = table->capacity - 1;
   size_t index = (size_t)(h & mask);
 
@@ -160,12 +147,6 @@ bool ht_set(hashtable *table,
       table->size += 1;
       return true;
     }
-    if (slot->key == HT_TOMBSTONE) {
-      *slot = entry;
-      table->size += 1;
-      table->tombstones -= 1;
-      return true;
-    }
     if (slot->hash == entry.hash && keys_equal(slot->key,
 #if HT_STRING_KEYS
                                                key
@@ -191,19 +172,14 @@ bool ht_set(hashtable *table,
   }
 }
 
-bool ht_get(const hashtable *table,
 #if HT_STRING_KEYS
-            const char *key,
+static bool ht_get_with_hash(const hashtable *table, const char *key, uint64_t h,
+                             void **out_value) {
 #else
-            const void *key,
+static bool ht_get_with_hash(const hashtable *table, const void *key, uint64_t h,
+                             void **out_value) {
 #endif
-            void **out_value) {
   assert(table && table->entries);
-#if HT_STRING_KEYS
-  uint64_t h = hash_cstr(key);
-#else
-  uint64_t h = hash_ptr(key);
-#endif
   size_t mask = table->capacity - 1;
   size_t index = (size_t)(h & mask);
   uint32_t dib = 1;
@@ -212,33 +188,68 @@ bool ht_get(const hashtable *table,
     const ht_entry *slot = &table->entries[index];
     if (slot->key == NULL)
       return false; // not found
-    if (slot->key != HT_TOMBSTONE) {
-      if (slot->hash == h && keys_equal(slot->key, key)) {
-        if (out_value)
-          *out_value = slot->value;
-        return true;
-      }
-      if (slot->dib < dib)
-        return false; // early exit
+    if (slot->hash == h && keys_equal(slot->key, key)) {
+      if (out_value)
+        *out_value = slot->value;
+      return true;
     }
+    if (slot->dib < dib)
+      return false; // early exit
     index = (index + 1) & mask;
     dib += 1;
   }
 }
 
-bool ht_erase(hashtable *table,
+bool ht_set(hashtable *table,
 #if HT_STRING_KEYS
-              const char *key,
+            const char *key,
 #else
-              const void *key,
+            const void *key,
 #endif
-              void **out_old_value) {
-  assert(table && table->entries);
+            void *value, ht_error *err) {
+#if HT_STRING_KEYS
+  return ht_set_with_hash(table, key, hash_cstr(key), value, err);
+#else
+  return ht_set_with_hash(table, key, hash_ptr(key), value, err);
+#endif
+}
+
+bool ht_get(const hashtable *table,
+#if HT_STRING_KEYS
+            const char *key,
+#else
+            const void *key,
+#endif
+            void **out_value) {
 #if HT_STRING_KEYS
-  uint64_t h = hash_cstr(key);
+  return ht_get_with_hash(table, key, hash_cstr(key), out_value);
 #else
-  uint64_t h = hash_ptr(key);
+  return ht_get_with_hash(table, key, hash_ptr(key), out_value);
 #endif
+}
+
+#if HT_STRING_KEYS
+uint64_t ht_hash_key(const char *key) { return hash_cstr(key); }
+
+bool ht_set_hashed(hashtable *table, const char *key, uint64_t hash,
+                   void *value, ht_error *err) {
+  return ht_set_with_hash(table, key, hash, value, err);
+}
+
+bool ht_get_hashed(const hashtable *table, const char *key, uint64_t hash,
+                   void **out_value) {
+  return ht_get_with_hash(table, key, hash, out_value);
+}
+#endif
+
+#if HT_STRING_KEYS
+static bool ht_erase_with_hash(hashtable *table, const char *key, uint64_t h,
+                               const char **out_key, void **out_old_value) {
+#else
+static bool ht_erase_with_hash(hashtable *table, const void *key, uint64_t h,
+                               const void **out_key, void **out_old_value) {
+#endif
+  assert(table && table->entries);
   size_t mask = table->capacity - 1;
   size_t index = (size_t)(h & mask);
   uint32_t dib = 1;
@@ -247,29 +258,56 @@ bool ht_erase(hashtable *table,
     ht_entry *slot = &table->entries[index];
     if (slot->key == NULL)
       return false;
-    if (slot->key != HT_TOMBSTONE) {
-      if (slot->hash == h && keys_equal(slot->key, key)) {
-        if (out_old_value)
-          *out_old_value = slot->value;
+    if (slot->hash == h && keys_equal(slot->key, key)) {
+      if (out_key)
+        *out_key = slot->key;
+      if (out_old_value)
+        *out_old_value = slot->value;
 #if HT_STRING_KEYS && defined(HT_DUP_KEYS)
-        free((void *)slot->key);
+      free((void *)slot->key);
 #endif
-        slot->key = HT_TOMBSTONE;
-        slot->value = NULL;
-        slot->hash = 0;
-        slot->dib = 0;
-        table->size -= 1;
-        table->tombstones += 1;
-        return true;
+      // Backward-shift deletion: move the displaced entries that follow back
+      // one slot, so no tombstone is left and lookups can still stop at the
+      // first entry closer to its home than the probe.
+      size_t next = (index + 1) & mask;
+      while (table->entries[next].key && table->entries[next].dib > 1) {
+        table->entries[index] = table->entries[next];
+        table->entries[index].dib -= 1;
+        index = next;
+        next = (next + 1) & mask;
       }
-      if (slot->dib < dib)
-        return false;
+      table->entries[index] = (ht_entry){0};
+      table->size -= 1;
+      return true;
     }
+    if (slot->dib < dib)
+      return false;
     index = (index + 1) & mask;
     dib += 1;
   }
 }
 
+bool ht_erase(hashtable *table,
+#if HT_STRING_KEYS
+              const char *key,
+#else
+              const void *key,
+#endif
+              void **out_old_value) {
+#if HT_STRING_KEYS
+  return ht_erase_with_hash(table, key, hash_cstr(key), NULL, out_old_value);
+#else
+  return ht_erase_with_hash(table, key, hash_ptr(key), NULL, out_old_value);
+#endif
+}
+
+#if HT_STRING_KEYS && !defined(HT_DUP_KEYS)
+bool ht_remove(hashtable *table, const char *key, const char **out_key,
+               void **out_old_value) {
+  return ht_erase_with_hash(table, key, hash_cstr(key), out_key, out_old_value);
+}
+#endif
+
 static bool ht_resize(hashtable *table, size_t new_capacity, ht_error *err) {
   new_capacity = next_power_of_two(new_capacity);
   ht_entry *old_entries = table->entries;
@@ -284,13 +322,13 @@ static bool ht_resize(hashtable *table, size_t new_capacity, ht_error *err) {
 
   table->entries = new_entries;
   table->capacity = new_capacity;
+  table->resizes += 1;
   table->size = 0;
-  table->tombstones = 0;
 
   size_t mask = new_capacity - 1;
   for (size_t i = 0; i < old_capacity; ++i) {
     ht_entry e = old_entries[i];
-    if (!e.key || e.key == HT_TOMBSTONE)
+    if (!e.key)
       continue;
 
     size_t index = (size_t)(e.hash & mask);
@@ -316,6 +354,27 @@ static bool ht_resize(hashtable *table, size_t new_capacity, ht_error *err) {
   return true;
 }
 
+void ht_stats(const hashtable *table, ht_probe_stats *out) {
+  *out = (ht_probe_stats){
+      .size = table->size,
+      .capacity = table->capacity,
+      .resizes = table->resizes,
+  };
+  uint64_t total_dib = 0;
+  for (size_t i = 0; i < table->capacity; ++i) {
+    const ht_entry *slot = &table->entries[i];
+    if (!slot->key)
+      continue;
+    total_dib += slot->dib;
+    if (slot->dib > out->max_dib)
+      out->max_dib = slot->dib;
+  }
+  if (table->size)
+    out->mean_dib = (double)total_dib / table->size;
+  if (table->capacity)
+    out->load_factor = (double)table->size / table->capacity;
+}
+
 void ht_iter_begin(const hashtable *table, ht_iter *it) {
   it->table = table;
   it->index = 0;
@@ -330,7 +389,7 @@ bool ht_iter_next(ht_iter *it,
                   void **out_value) {
   while (it->index < it->table->capacity) {
     const ht_entry *slot = &it->table->entries[it->index++];
-    if (slot->key && slot->key != HT_TOMBSTONE) {
+    if (slot->key) {
       if (out_key)
         *out_key = slot->key;
       if (out_value)
@@ -0,0 +1,735 @@
+#include "jit.h"
+#include "builtin.h"
+#include "env.h"
+#include "special.h"
+#include "symbol.h"
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_X86_64 1
+#include <sys/mman.h>
+#else
+#define JIT_X86_64 0
+#endif
+
+static bool enabled = false;
+
+bool jit_available(void) {
+  return JIT_X86_64;
+}
+
+void jit_set_enabled(bool on) {
+  enabled = on && JIT_X86_64;
+}
+
+bool jit_enabled(void) {
+  return enabled;
+}
+
+#if JIT_X86_64
+
+// Compiled functions take their arguments as an array of 8-byte slots and
+// are specialized on the argument types (integer or double) of the call that
+// made them hot. While an expression is evaluated, integers live in rax,
+// doubles in xmm0 and booleans in eax; intermediate values are spilled to
+// the native stack. Registers:
+//   rbx  argument array of the current frame (callee saved by each body)
+//   r12  remaining native recursion depth, bails out when it reaches zero
+//   r13  stack pointer of the entry stub, restored on bail out
+// Integer overflow also bails out, so the interpreter can redo the call with
+// its double fallback.
+#define JIT_MAX_PARAMS 8
+#define JIT_MAX_DEPTH 16384
+#define JIT_REJECTED UINT_MAX
+
+typedef struct {
+  symbol_t *sym;
+  lval_t *value;
+} jit_guard_t;
+
+typedef union {
+  int64_t integer;
+  double number;
+} jit_slot_t;
+
+typedef enum {
+  JT_FAIL,
+  JT_INT,
+  JT_FLT,
+  JT_BOOL,
+} jit_type_t;
+
+typedef struct jit_code {
+  struct jit_code *next;
+  int (*enter)(const jit_slot_t *args, jit_slot_t *out);
+  void *mem;
+  size_t size;
+  void *body;
+  jit_type_t result;
+  jit_type_t params[JIT_MAX_PARAMS];
+  size_t version; // env_global_version() at which the guards last held
+  jit_guard_t *guards;
+  size_t guard_count;
+} jit_code_t;
+
+typedef enum {
+  OP_ADD,
+  OP_SUB,
+  OP_MUL,
+  OP_DIV,
+  OP_MOD,
+  OP_LT,
+  OP_GT,
+  OP_LE,
+  OP_GE,
+  OP_EQ,
+  OP_NOT,
+  OP_AND,
+  OP_OR,
+} jit_op_t;
+
+static const struct {
+  const char *name;
+  jit_op_t op;
+} k_ops[] = {
+  { "+", OP_ADD },  { "-", OP_SUB },   { "*", OP_MUL },   { "/", OP_DIV },  { "mod", OP_MOD },
+  { "<", OP_LT },   { ">", OP_GT },    { "<=", OP_LE },   { ">=", OP_GE },  { "=", OP_EQ },
+  { "not", OP_NOT }, { "and", OP_AND }, { "or", OP_OR },
+};
+
+typedef struct {
+  unsigned char *buf;
+  size_t len;
+  size_t cap;
+  lval_t *fn;
+  const jit_type_t *params; // parameter types the code is specialized on
+  jit_type_t self_type;     // assumed result type of recursive calls
+  size_t body;              // offset of the function body
+  size_t bail;              // offset of the bail out path in the entry stub
+  jit_guard_t *guards;
+  size_t guard_count;
+  size_t guard_cap;
+} jit_emitter_t;
+
+static jit_code_t *compiled = NULL;
+static size_t compiled_count = 0;
+
+static void emit(jit_emitter_t *e, const void *bytes, size_t n) {
+  if (e->len + n > e->cap) {
+    size_t cap = e->cap ? e->cap * 2 : 256;
+    while (cap < e->len + n)
+      cap *= 2;
+    unsigned char *buf = realloc(e->buf, cap);
+    if (!buf) {
+      perror("realloc");
+      exit(EXIT_FAILURE);
+    }
+    e->buf = buf;
+    e->cap = cap;
+  }
+  memcpy(e->buf + e->len, bytes, n);
+  e->len += n;
+}
+
+#define EMIT(e, ...)                                                                               \
+  do {                                                                                             \
+    static const unsigned char bytes_[] = { __VA_ARGS__ };                                         \
+    emit((e), bytes_, sizeof bytes_);                                                              \
+  } while (0)
+
+static void emit_u32(jit_emitter_t *e, uint32_t v) {
+  emit(e, &v, sizeof v);
+}
+
+// Emits a rel32 placeholder and returns its offset for patch_rel32.
+static size_t emit_rel32(jit_emitter_t *e) {
+  size_t at = e->len;
+  emit_u32(e, 0);
+  return at;
+}
+
+static void patch_rel32(jit_emitter_t *e, size_t at, size_t target) {
+  int32_t rel = (int32_t)((int64_t)target - (int64_t)(at + 4));
+  memcpy(e->buf + at, &rel, sizeof rel);
+}
+
+static void emit_jump_to(jit_emitter_t *e, size_t target) {
+  patch_rel32(e, emit_rel32(e), target);
+}
+
+static void add_guard(jit_emitter_t *e, symbol_t *sym, lval_t *value) {
+  for (size_t i = 0; i < e->guard_count; i++) {
+    if (e->guards[i].sym == sym) return;
+  }
+  if (e->guard_count == e->guard_cap) {
+    size_t cap = e->guard_cap ? e->guard_cap * 2 : 8;
+    jit_guard_t *guards = realloc(e->guards, cap * sizeof *guards);
+    if (!guards) {
+      perror("realloc");
+      exit(EXIT_FAILURE);
+    }
+    e->guards = guards;
+    e->guard_cap = cap;
+  }
+  e->guards[e->guard_count++] = (jit_guard_t){ sym, value };
+}
+
+static bool guards_hold(jit_code_t *code) {
+  for (size_t i = 0; i < code->guard_count; i++) {
+    if (code->guards[i].sym->global != code->guards[i].value) return false;
+  }
+  code->version = env_global_version();
+  return true;
+}
+
+static bool param_index(const lval_t *fn, const char *name, size_t *out) {
+  for (size_t i = 0; i < fn->as.function.param_count; i++) {
+    if (fn->as.function.params[i] == name) {
+      *out = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+static jit_type_t compile_expr(jit_emitter_t *e, const s_expression_t *expr);
+
+static bool is_numeric(jit_type_t t) {
+  return t == JT_INT || t == JT_FLT;
+}
+
+static void emit_int(jit_emitter_t *e, int64_t v) {
+  EMIT(e, 0x48, 0xB8); // mov rax, imm64
+  emit(e, &v, sizeof v);
+}
+
+static void emit_flt(jit_emitter_t *e, double v) {
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof bits);
+  EMIT(e, 0x48, 0xB8); // mov rax, imm64
+  emit(e, &bits, sizeof bits);
+  EMIT(e, 0x66, 0x48, 0x0F, 0x6E, 0xC0); // movq xmm0, rax
+}
+
+static void emit_bail_if_overflow(jit_emitter_t *e) {
+  EMIT(e, 0x0F, 0x80); // jo bail
+  emit_jump_to(e, e->bail);
+}
+
+// Pushes the current value of type `cur`, evaluates `expr` and leaves the
+// pushed value in rax/xmm0 and the new one in rcx/xmm1. Returns the type of
+// the new value.
+static jit_type_t compile_operand(jit_emitter_t *e, jit_type_t cur, const s_expression_t *expr) {
+  if (cur == JT_FLT) {
+    EMIT(e, 0x48, 0x83, 0xEC, 0x08);       // sub rsp, 8
+    EMIT(e, 0xF2, 0x0F, 0x11, 0x04, 0x24); // movsd [rsp], xmm0
+  } else {
+    EMIT(e, 0x50); // push rax
+  }
+  jit_type_t type = compile_expr(e, expr);
+  if (!is_numeric(type)) return JT_FAIL;
+  if (type == JT_FLT)
+    EMIT(e, 0x66, 0x0F, 0x28, 0xC8); // movapd xmm1, xmm0
+  else
+    EMIT(e, 0x48, 0x89, 0xC1); // mov rcx, rax
+  if (cur == JT_FLT) {
+    EMIT(e, 0xF2, 0x0F, 0x10, 0x04, 0x24); // movsd xmm0, [rsp]
+    EMIT(e, 0x48, 0x83, 0xC4, 0x08);       // add rsp, 8
+  } else {
+    EMIT(e, 0x58); // pop rax
+  }
+  return type;
+}
+
+// Converts whichever of the two operands left by compile_operand are
+// integers to doubles.
+static void emit_widen(jit_emitter_t *e, jit_type_t cur, jit_type_t next) {
+  if (cur == JT_INT) EMIT(e, 0xF2, 0x48, 0x0F, 0x2A, 0xC0); // cvtsi2sd xmm0, rax
+  if (next == JT_INT) EMIT(e, 0xF2, 0x48, 0x0F, 0x2A, 0xC9); // cvtsi2sd xmm1, rcx
+}
+
+static jit_type_t compile_arith(jit_emitter_t *e, jit_op_t op, s_expression_t **args, size_t n) {
+  if (n == 0) {
+    // Same results as the builtins: (*) is 1, (/) is 0.0, the others are 0.
+    if (op == OP_DIV) {
+      emit_flt(e, 0.0);
+      return JT_FLT;
+    }
+    emit_int(e, op == OP_MUL ? 1 : 0);
+    return JT_INT;
+  }
+  jit_type_t cur = compile_expr(e, args[0]);
+  if (!is_numeric(cur)) return JT_FAIL;
+  if (op == OP_DIV && cur == JT_INT) {
+    EMIT(e, 0xF2, 0x48, 0x0F, 0x2A, 0xC0); // cvtsi2sd xmm0, rax
+    cur = JT_FLT;
+  }
+  for (size_t i = 1; i < n; i++) {
+    jit_type_t next = compile_operand(e, cur, args[i]);
+    if (next == JT_FAIL) return JT_FAIL;
+    if (cur == JT_INT && next == JT_INT) {
+      switch (op) {
+      case OP_ADD:
+        EMIT(e, 0x48, 0x01, 0xC8); // add rax, rcx
+        break;
+      case OP_SUB:
+        EMIT(e, 0x48, 0x29, 0xC8); // sub rax, rcx
+        break;
+      default:
+        EMIT(e, 0x48, 0x0F, 0xAF, 0xC1); // imul rax, rcx
+        break;
+      }
+      emit_bail_if_overflow(e);
+      continue;
+    }
+    emit_widen(e, cur, next);
+    cur = JT_FLT;
+    switch (op) {
+    case OP_ADD:
+      EMIT(e, 0xF2, 0x0F, 0x58, 0xC1); // addsd xmm0, xmm1
+      break;
+    case OP_SUB:
+      EMIT(e, 0xF2, 0x0F, 0x5C, 0xC1); // subsd xmm0, xmm1
+      break;
+    case OP_MUL:
+      EMIT(e, 0xF2, 0x0F, 0x59, 0xC1); // mulsd xmm0, xmm1
+      break;
+    default:
+      EMIT(e, 0xF2, 0x0F, 0x5E, 0xC1); // divsd xmm0, xmm1
+      break;
+    }
+  }
+  return cur;
+}
+
+// Only the integer remainder is compiled; fmod stays in the interpreter.
+static jit_type_t compile_mod(jit_emitter_t *e, s_expression_t **args, size_t n) {
+  if (n != 2 || compile_expr(e, args[0]) != JT_INT) return JT_FAIL;
+  if (compile_operand(e, JT_INT, args[1]) != JT_INT) return JT_FAIL;
+  EMIT(e, 0x48, 0x85, 0xC9); // test rcx, rcx
+  EMIT(e, 0x0F, 0x84);       // jz bail (the builtin reports the error)
+  emit_jump_to(e, e->bail);
+  EMIT(e, 0x48, 0x83, 0xF9, 0xFF); // cmp rcx, -1
+  EMIT(e, 0x75, 0x04);             // jne divide
+  EMIT(e, 0x31, 0xC0);             // xor eax, eax
+  EMIT(e, 0xEB, 0x08);             // jmp done
+  EMIT(e, 0x48, 0x99);             // divide: cqo
+  EMIT(e, 0x48, 0xF7, 0xF9);       // idiv rcx
+  EMIT(e, 0x48, 0x89, 0xD0);       // mov rax, rdx
+  return JT_INT;                   // done:
+}
+
+static jit_type_t compile_compare(jit_emitter_t *e, jit_op_t op, s_expression_t **args, size_t n) {
+  if (n != 2) return JT_FAIL;
+  jit_type_t cur = compile_expr(e, args[0]);
+  if (!is_numeric(cur)) return JT_FAIL;
+  jit_type_t next = compile_operand(e, cur, args[1]);
+  if (next == JT_FAIL) return JT_FAIL;
+  if (cur == JT_INT && next == JT_INT) {
+    EMIT(e, 0x48, 0x39, 0xC8); // cmp rax, rcx
+    switch (op) {
+    case OP_LT:
+      EMIT(e, 0x0F, 0x9C, 0xC0); // setl al
+      break;
+    case OP_GT:
+      EMIT(e, 0x0F, 0x9F, 0xC0); // setg al
+      break;
+    case OP_LE:
+      EMIT(e, 0x0F, 0x9E, 0xC0); // setle al
+      break;
+    case OP_GE:
+      EMIT(e, 0x0F, 0x9D, 0xC0); // setge al
+      break;
+    default:
+      EMIT(e, 0x0F, 0x94, 0xC0); // sete al
+      break;
+    }
+    EMIT(e, 0x0F, 0xB6, 0xC0); // movzx eax, al
+    return JT_BOOL;
+  }
+  emit_widen(e, cur, next);
+  // ucomisd reports unordered operands as "below or equal", so seta/setae
+  // give the same false results for NaN as the C comparisons in builtin.c.
+  switch (op) {
+  case OP_LT:
+    EMIT(e, 0x66, 0x0F, 0x2E, 0xC8, 0x0F, 0x97, 0xC0); // ucomisd xmm1, xmm0; seta al
+    break;
+  case OP_GT:
+    EMIT(e, 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x97, 0xC0); // ucomisd xmm0, xmm1; seta al
+    break;
+  case OP_LE:
+    EMIT(e, 0x66, 0x0F, 0x2E, 0xC8, 0x0F, 0x93, 0xC0); // ucomisd xmm1, xmm0; setae al
+    break;
+  case OP_GE:
+    EMIT(e, 0x66, 0x0F, 0x2E, 0xC1, 0x0F, 0x93, 0xC0); // ucomisd xmm0, xmm1; setae al
+    break;
+  default:
+    EMIT(e, 0x66, 0x0F, 0x2E, 0xC1); // ucomisd xmm0, xmm1
+    EMIT(e, 0x0F, 0x94, 0xC0);       // sete al
+    EMIT(e, 0x0F, 0x9B, 0xC1);       // setnp cl
+    EMIT(e, 0x20, 0xC8);             // and al, cl
+    break;
+  }
+  EMIT(e, 0x0F, 0xB6, 0xC0); // movzx eax, al
+  return JT_BOOL;
+}
+
+static jit_type_t compile_logic(jit_emitter_t *e, jit_op_t op, s_expression_t **args, size_t n) {
+  if (op == OP_NOT) {
+    if (n != 1 || compile_expr(e, args[0]) != JT_BOOL) return JT_FAIL;
+    EMIT(e, 0x83, 0xF0, 0x01); // xor eax, 1
+    return JT_BOOL;
+  }
+  if (n == 0) return JT_FAIL;
+  // The and and or special forms stop at the deciding argument. Compiled
+  // operands are pure, so calls to the builtins short-circuit as well.
+  size_t *exits = malloc(n * sizeof *exits);
+  if (!exits) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  jit_type_t type = JT_BOOL;
+  for (size_t i = 0; i < n; i++) {
+    if (compile_expr(e, args[i]) != JT_BOOL) {
+      type = JT_FAIL;
+      break;
+    }
+    EMIT(e, 0x85, 0xC0); // test eax, eax
+    if (op == OP_AND)
+      EMIT(e, 0x0F, 0x84); // jz exit
+    else
+      EMIT(e, 0x0F, 0x85); // jnz exit
+    exits[i] = emit_rel32(e);
+  }
+  if (type == JT_BOOL) {
+    for (size_t i = 0; i < n; i++)
+      patch_rel32(e, exits[i], e->len);
+  }
+  free(exits);
+  return type;
+}
+
+static jit_type_t compile_if(jit_emitter_t *e, s_expression_t **args, size_t n) {
+  if (n != 3) return JT_FAIL;
+  if (compile_expr(e, args[0]) != JT_BOOL) return JT_FAIL;
+  EMIT(e, 0x85, 0xC0, 0x0F, 0x84); // test eax, eax; jz else
+  size_t to_else = emit_rel32(e);
+  jit_type_t then_type = compile_expr(e, args[1]);
+  if (then_type == JT_FAIL) return JT_FAIL;
+  EMIT(e, 0xE9); // jmp end
+  size_t to_end = emit_rel32(e);
+  patch_rel32(e, to_else, e->len);
+  if (compile_expr(e, args[2]) != then_type) return JT_FAIL;
+  patch_rel32(e, to_end, e->len);
+  return then_type;
+}
+
+// Calls the body of `target`, or this function's own body when it is NULL.
+// Bodies of other compiled functions share the register conventions and the
+// entry stub layout, so their bail out path unwinds this call as well.
+static jit_type_t compile_direct_call(jit_emitter_t *e, const jit_code_t *target,
+                                      s_expression_t **args, size_t n) {
+  const jit_type_t *params = target ? target->params : e->params;
+  uint32_t frame = (uint32_t)(n * sizeof(jit_slot_t));
+  if (frame) {
+    EMIT(e, 0x48, 0x81, 0xEC); // sub rsp, frame
+    emit_u32(e, frame);
+  }
+  for (size_t i = 0; i < n; i++) {
+    // The callee is specialized on its parameter types, so the arguments
+    // must have exactly those types.
+    if (compile_expr(e, args[i]) != params[i]) return JT_FAIL;
+    if (params[i] == JT_FLT)
+      EMIT(e, 0xF2, 0x0F, 0x11, 0x84, 0x24); // movsd [rsp + 8i], xmm0
+    else
+      EMIT(e, 0x48, 0x89, 0x84, 0x24); // mov [rsp + 8i], rax
+    emit_u32(e, (uint32_t)(i * sizeof(jit_slot_t)));
+  }
+  EMIT(e, 0x48, 0x89, 0xE7); // mov rdi, rsp
+  if (target) {
+    uint64_t body = (uint64_t)(uintptr_t)target->body;
+    EMIT(e, 0x48, 0xB8); // mov rax, imm64
+    emit(e, &body, sizeof body);
+    EMIT(e, 0xFF, 0xD0); // call rax
+  } else {
+    EMIT(e, 0xE8); // call body
+    emit_jump_to(e, e->body);
+  }
+  if (frame) {
+    EMIT(e, 0x48, 0x81, 0xC4); // add rsp, frame
+    emit_u32(e, frame);
+  }
+  return target ? target->result : e->self_type;
+}
+
+static jit_type_t compile_call(jit_emitter_t *e, const s_expression_t *expr) {
+  size_t count = expr->data.list.count;
+  if (count == 0 || expr->data.list.tail) return JT_FAIL;
+  const char *name = NULL;
+  if (!sexp_is_symbol(expr->data.list.elements[0], &name)) return JT_FAIL;
+  size_t index;
+  if (param_index(e->fn, name, &index)) return JT_FAIL;
+
+  s_expression_t **args = expr->data.list.elements + 1;
+  size_t n = count - 1;
+  if (lookup_special_form(name)) {
+    if (name == symbol_intern("if")) return compile_if(e, args, n);
+    if (name == symbol_intern("and")) return compile_logic(e, OP_AND, args, n);
+    if (name == symbol_intern("or")) return compile_logic(e, OP_OR, args, n);
+    return JT_FAIL;
+  }
+
+  // The function is defined at top level, so any other name resolves to a
+  // global. Its current value is recorded as a guard.
+  symbol_t *sym = symbol_of(name);
+  lval_t *callee = sym->global;
+  if (!callee) return JT_FAIL;
+  if (callee == e->fn) {
+    if (n != callee->as.function.param_count) return JT_FAIL;
+    add_guard(e, sym, callee);
+    return compile_direct_call(e, NULL, args, n);
+  }
+  if (callee->type == L_FUNCTION) {
+    // Other functions are called directly once they are compiled themselves;
+    // their guards are inherited so rebinding anything they use is caught.
+    jit_code_t *code = callee->as.function.jit;
+    if (!code || n != callee->as.function.param_count || !guards_hold(code)) return JT_FAIL;
+    add_guard(e, sym, callee);
+    for (size_t i = 0; i < code->guard_count; i++)
+      add_guard(e, code->guards[i].sym, code->guards[i].value);
+    return compile_direct_call(e, code, args, n);
+  }
+  if (callee->type != L_NATIVE) return JT_FAIL;
+  for (size_t i = 0; i < sizeof k_ops / sizeof k_ops[0]; i++) {
+    if (callee->as.native.fn != (void *)lookup_builtin(k_ops[i].name)) continue;
+    add_guard(e, sym, callee);
+    jit_op_t op = k_ops[i].op;
+    if (op <= OP_DIV) return compile_arith(e, op, args, n);
+    if (op == OP_MOD) return compile_mod(e, args, n);
+    if (op <= OP_EQ) return compile_compare(e, op, args, n);
+    return compile_logic(e, op, args, n);
+  }
+  return JT_FAIL;
+}
+
+static jit_type_t compile_expr(jit_emitter_t *e, const s_expression_t *expr) {
+  if (expr->type == NODE_LIST) return compile_call(e, expr);
+  const atom_t *a = &expr->data.atom;
+  switch (a->type) {
+  case ATOM_INTEGER:
+    emit_int(e, a->value.integer);
+    return JT_INT;
+  case ATOM_NUMBER:
+    emit_flt(e, a->value.number);
+    return JT_FLT;
+  case ATOM_BOOLEAN:
+    EMIT(e, 0xB8); // mov eax, imm32
+    emit_u32(e, a->value.boolean ? 1 : 0);
+    return JT_BOOL;
+  case ATOM_SYMBOL: {
+    size_t index;
+    if (!param_index(e->fn, a->value.symbol, &index)) return JT_FAIL;
+    if (e->params[index] == JT_FLT)
+      EMIT(e, 0xF2, 0x0F, 0x10, 0x83); // movsd xmm0, [rbx + 8i]
+    else
+      EMIT(e, 0x48, 0x8B, 0x83); // mov rax, [rbx + 8i]
+    emit_u32(e, (uint32_t)(index * sizeof(jit_slot_t)));
+    return e->params[index];
+  }
+  default:
+    return JT_FAIL;
+  }
+}
+
+// Emits the entry stub followed by the body, assuming recursive calls
+// return `self_type`. Fails unless the body has that type too.
+static bool compile_function(jit_emitter_t *e) {
+  // int enter(const jit_slot_t *args /* rdi */, jit_slot_t *out /* rsi */)
+  EMIT(e, 0x53, 0x41, 0x54, 0x41, 0x55); // push rbx; push r12; push r13
+  EMIT(e, 0x56);                         // push rsi
+  EMIT(e, 0x49, 0x89, 0xE5);             // mov r13, rsp
+  EMIT(e, 0x49, 0xC7, 0xC4);             // mov r12, JIT_MAX_DEPTH
+  emit_u32(e, JIT_MAX_DEPTH);
+  EMIT(e, 0xE8); // call body
+  size_t to_body = emit_rel32(e);
+  EMIT(e, 0x5E); // pop rsi
+  if (e->self_type == JT_FLT)
+    EMIT(e, 0xF2, 0x0F, 0x11, 0x06); // movsd [rsi], xmm0
+  else
+    EMIT(e, 0x48, 0x89, 0x06); // mov [rsi], rax
+  EMIT(e, 0xB8, 0x01, 0x00, 0x00, 0x00);   // mov eax, 1
+  EMIT(e, 0x41, 0x5D, 0x41, 0x5C, 0x5B);   // pop r13; pop r12; pop rbx
+  EMIT(e, 0xC3);                           // ret
+  e->bail = e->len;
+  EMIT(e, 0x4C, 0x89, 0xEC);             // mov rsp, r13
+  EMIT(e, 0x5E);                         // pop rsi
+  EMIT(e, 0x31, 0xC0);                   // xor eax, eax
+  EMIT(e, 0x41, 0x5D, 0x41, 0x5C, 0x5B); // pop r13; pop r12; pop rbx
+  EMIT(e, 0xC3);                         // ret
+
+  e->body = e->len;
+  patch_rel32(e, to_body, e->body);
+  EMIT(e, 0x53);             // push rbx
+  EMIT(e, 0x48, 0x89, 0xFB); // mov rbx, rdi
+  EMIT(e, 0x49, 0xFF, 0xCC); // dec r12
+  EMIT(e, 0x0F, 0x84);       // jz bail
+  emit_jump_to(e, e->bail);
+  if (compile_expr(e, e->fn->as.function.body[0]) != e->self_type) return false;
+  EMIT(e, 0x49, 0xFF, 0xC4); // inc r12
+  EMIT(e, 0x5B, 0xC3);       // pop rbx; ret
+  return true;
+}
+
+static jit_code_t *jit_compile(lval_t *fn, const jit_type_t *params) {
+  if (fn->as.function.is_macro || fn->as.function.body_count != 1) return NULL;
+  if (!env_is_global(fn->as.function.closure)) return NULL;
+
+  static const jit_type_t k_attempts[] = { JT_INT, JT_FLT, JT_BOOL };
+  jit_emitter_t e = { 0 };
+  bool ok = false;
+  for (size_t i = 0; i < sizeof k_attempts / sizeof k_attempts[0] && !ok; i++) {
+    e.len = 0;
+    e.guard_count = 0;
+    e.fn = fn;
+    e.params = params;
+    e.self_type = k_attempts[i];
+    ok = compile_function(&e);
+  }
+  if (!ok) {
+    free(e.buf);
+    free(e.guards);
+    return NULL;
+  }
+
+  size_t page = 4096;
+  size_t size = (e.len + page - 1) / page * page;
+  void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    free(e.buf);
+    free(e.guards);
+    return NULL;
+  }
+  memcpy(mem, e.buf, e.len);
+  free(e.buf);
+  if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(mem, size);
+    free(e.guards);
+    return NULL;
+  }
+
+  jit_code_t *code = malloc(sizeof *code);
+  if (!code) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  code->enter = (int (*)(const jit_slot_t *, jit_slot_t *))mem;
+  code->mem = mem;
+  code->size = size;
+  code->body = (unsigned char *)mem + e.body;
+  code->result = e.self_type;
+  memcpy(code->params, params, fn->as.function.param_count * sizeof *params);
+  code->version = env_global_version();
+  code->guards = e.guards;
+  code->guard_count = e.guard_count;
+  code->next = compiled;
+  compiled = code;
+  compiled_count++;
+  return code;
+}
+
+// Records the slot type of each argument; fails for non-numeric arguments.
+static bool arg_types(size_t argc, lval_t **argv, jit_type_t *types) {
+  for (size_t i = 0; i < argc; i++) {
+    if (argv[i]->type == L_INT)
+      types[i] = JT_INT;
+    else if (argv[i]->type == L_NUM)
+      types[i] = JT_FLT;
+    else
+      return false;
+  }
+  return true;
+}
+
+bool jit_try_call(lval_t *fn, size_t argc, lval_t **argv, lval_t **out) {
+  if (!enabled || fn->type != L_FUNCTION || argc > JIT_MAX_PARAMS) return false;
+  jit_type_t types[JIT_MAX_PARAMS];
+  if (!arg_types(argc, argv, types)) return false;
+  jit_code_t *code = fn->as.function.jit;
+  if (!code) {
+    unsigned *calls = &fn->as.function.calls;
+    if (*calls == JIT_REJECTED || ++*calls <= JIT_HOT_CALLS) return false;
+    code = jit_compile(fn, types);
+    if (!code) {
+      *calls = JIT_REJECTED;
+      return false;
+    }
+    fn->as.function.jit = code;
+  }
+  if (code->version != env_global_version() && !guards_hold(code)) {
+    // A global the code depends on was rebound; start counting again.
+    fn->as.function.jit = NULL;
+    fn->as.function.calls = 0;
+    return false;
+  }
+
+  jit_slot_t args[JIT_MAX_PARAMS];
+  for (size_t i = 0; i < argc; i++) {
+    if (types[i] != code->params[i]) return false;
+    if (types[i] == JT_INT)
+      args[i].integer = argv[i]->as.integer;
+    else
+      args[i].number = argv[i]->as.number;
+  }
+  jit_slot_t result;
+  if (!code->enter(args, &result)) return false;
+  switch (code->result) {
+  case JT_INT:
+    *out = lval_int(result.integer);
+    break;
+  case JT_FLT:
+    *out = lval_num(result.number);
+    break;
+  default:
+    *out = lval_bool(result.integer != 0);
+    break;
+  }
+  return true;
+}
+
+size_t jit_compiled_count(void) {
+  return compiled_count;
+}
+
+void jit_reset(void) {
+  while (compiled) {
+    jit_code_t *next = compiled->next;
+    munmap(compiled->mem, compiled->size);
+    free(compiled->guards);
+    free(compiled);
+    compiled = next;
+  }
+  compiled_count = 0;
+}
+
+#else
+
+bool jit_try_call(lval_t *fn, size_t argc, lval_t **argv, lval_t **out) {
+  (void)fn;
+  (void)argc;
+  (void)argv;
+  (void)out;
+  return false;
+}
+
+size_t jit_compiled_count(void) {
+  return 0;
+}
+
+void jit_reset(void) {
+}
+
+#endif
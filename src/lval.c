@@ -1,7 +1,10 @@
 #include "lval.h"
+#include "bignum.h"
 #include "env.h"
+#include "f64vec.h"
 #include "gc.h"
 #include "symbol.h"
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,6 +18,30 @@ lval_t *lval_num(double x) {
   return v;
 }
 
+lval_t *lval_int(int64_t x) {
+  lval_t *v = gc_alloc_lval();
+  if (!v) return NULL;
+  v->type = L_INT;
+  v->as.integer = x;
+  return v;
+}
+
+lval_t *lval_bignum(bignum_t *b) {
+  int64_t small;
+  if (bignum_to_i64(b, &small)) {
+    bignum_free(b);
+    return lval_int(small);
+  }
+  lval_t *v = gc_alloc_lval();
+  if (!v) {
+    bignum_free(b);
+    return NULL;
+  }
+  v->type = L_BIGNUM;
+  v->as.bignum = b;
+  return v;
+}
+
 lval_t *lval_bool(bool b) {
   lval_t *v = gc_alloc_lval();
   if (!v) return NULL;
@@ -43,6 +70,10 @@ lval_t *lval_string_copy(const char *s, size_t len) {
 lval_t *lval_intern(const char *name) {
   const char *interned = symbol_intern(name);
   if (!interned) return NULL;
+  return lval_symbol(interned);
+}
+
+lval_t *lval_symbol(const char *interned) {
   lval_t *v = gc_alloc_lval();
   if (!v) return NULL;
   v->type = L_SYMBOL;
@@ -82,6 +113,10 @@ lval_t *lval_function(char **params,
   v->as.function.body_count = body_count;
   v->as.function.closure = closure;
   v->as.function.is_macro = is_macro;
+  v->as.function.name = NULL;
+  v->as.function.line = 0;
+  v->as.function.calls = 0;
+  v->as.function.jit = NULL;
   if (closure) env_retain(closure);
 
   return v;
@@ -96,10 +131,129 @@ lval_t *lval_native(void *fn, const char *name) {
   return v;
 }
 
+lval_t *lval_promise(s_expression_t *expr, struct env *env) {
+  lval_t *v = gc_alloc_lval();
+  if (!v) return NULL;
+  v->type = L_PROMISE;
+  v->as.promise.expr = expr;
+  v->as.promise.env = env;
+  env_retain(env);
+  return v;
+}
+
+lval_t *lval_error(unsigned char code, bool owned, unsigned short arg, char *message,
+                   lval_t *value) {
+  lval_t *v = gc_alloc_lval();
+  if (!v) return NULL;
+  v->type = L_ERROR;
+  v->as.error.code = code;
+  v->as.error.owned = owned;
+  v->as.error.arg = arg;
+  v->as.error.message = message;
+  v->as.error.value = value;
+  return v;
+}
+
+lval_t *lval_vector(size_t count, lval_t *fill) {
+  lval_t **items = NULL;
+  if (count) {
+    if (count > SIZE_MAX / sizeof *items) return NULL;
+    items = malloc(count * sizeof *items);
+    if (!items) return NULL;
+    for (size_t i = 0; i < count; i++) items[i] = fill;
+  }
+  lval_t *v = gc_alloc_lval();
+  if (!v) {
+    free(items);
+    return NULL;
+  }
+  v->type = L_VECTOR;
+  v->as.vector.items = items;
+  v->as.vector.count = count;
+  return v;
+}
+
+lval_t *lval_hash_table(bool equal) {
+  hashtable *table = malloc(sizeof *table);
+  ht_error err = { 0 };
+  if (!table || !ht_init(table, 8, &err)) {
+    fprintf(stderr, "lval_hash_table: %s\n",
+            err.error_message ? err.error_message : "out of memory");
+    exit(EXIT_FAILURE);
+  }
+  lval_t *v = gc_alloc_lval();
+  if (!v) {
+    lval_hash_table_free(table);
+    return NULL;
+  }
+  v->type = L_HASHTABLE;
+  v->as.hash.table = table;
+  v->as.hash.equal = equal;
+  return v;
+}
+
+void lval_hash_table_free(hashtable *table) {
+  ht_iter it;
+  ht_iter_begin(table, &it);
+  const char *key;
+  void *pair;
+  while (ht_iter_next(&it, &key, &pair)) {
+    if (key[0] == LVAL_HASH_OWNED_KEY) free((char *)key);
+  }
+  ht_destroy(table);
+  free(table);
+}
+
+lval_t *lval_f64vector(size_t count) {
+  double *items = f64_alloc(count);
+  if (count && !items) return NULL;
+  lval_t *v = gc_alloc_lval();
+  if (!v) {
+    free(items);
+    return NULL;
+  }
+  v->type = L_F64VECTOR;
+  v->as.f64vector.items = items;
+  v->as.f64vector.count = count;
+  return v;
+}
+
+lval_t *lval_promise_call(void *fn, lval_t *arg0, lval_t *arg1) {
+  lval_t *v = gc_alloc_lval();
+  if (!v) return NULL;
+  v->type = L_PROMISE;
+  v->as.promise.fn = fn;
+  v->as.promise.args[0] = arg0;
+  v->as.promise.args[1] = arg1;
+  return v;
+}
+
+bool lval_is_number(const lval_t *v) {
+  return v->type == L_NUM || lval_is_integer(v);
+}
+
+bool lval_is_integer(const lval_t *v) {
+  return v->type == L_INT || v->type == L_BIGNUM;
+}
+
+double lval_to_double(const lval_t *v) {
+  switch (v->type) {
+  case L_INT:
+    return (double)v->as.integer;
+  case L_BIGNUM:
+    return bignum_to_double(v->as.bignum);
+  default:
+    return v->as.number;
+  }
+}
+
 const char *lval_type_name(const lval_t *v) {
   switch (v->type) {
   case L_NUM:
     return "number";
+  case L_INT:
+  case L_BIGNUM:
+    return "integer";
   case L_STRING:
     return "string";
   case L_BOOL:
@@ -114,57 +268,104 @@ const char *lval_type_name(const lval_t *v) {
     return "function";
   case L_NATIVE:
     return "builtin";
+  case L_PROMISE:
+    return "promise";
+  case L_ERROR:
+    return "error";
+  case L_VECTOR:
+    return "vector";
+  case L_HASHTABLE:
+    return "hash-table";
+  case L_F64VECTOR:
+    return "f64vector";
   default:
     return "unknown";
   }
 }
 
-void lval_print(const lval_t *v) {
+void lval_fprint(FILE *f, const lval_t *v) {
   switch (v->type) {
   case L_NUM:
-    printf("%g", v->as.number);
+    fprintf(f, "%g", v->as.number);
+    break;
+  case L_INT:
+    fprintf(f, "%" PRId64, v->as.integer);
     break;
+  case L_BIGNUM: {
+    char *digits = bignum_to_string(v->as.bignum);
+    fputs(digits, f);
+    free(digits);
+  } break;
   case L_STRING:
-    printf("\"%.*s\"", (int)v->as.string.len, v->as.string.ptr);
+    fprintf(f, "\"%.*s\"", (int)v->as.string.len, v->as.string.ptr);
     break;
   case L_BOOL:
-    printf(v->as.boolean ? "true" : "false");
+    fprintf(f, v->as.boolean ? "true" : "false");
     break;
   case L_SYMBOL:
-    printf("%s", v->as.symbol.name);
+    fprintf(f, "%s", v->as.symbol.name);
     break;
   case L_NIL:
-    printf("nil");
+    fprintf(f, "nil");
     break;
   case L_CONS:
-    printf("(");
+    fprintf(f, "(");
     if (v->as.cons.car) {
-      lval_print(v->as.cons.car);
+      lval_fprint(f, v->as.cons.car);
     } else {
-      printf("nil");
+      fprintf(f, "nil");
     }
     if (v->as.cons.cdr) {
-      printf(" . ");
-      lval_print(v->as.cons.cdr);
+      fprintf(f, " . ");
+      lval_fprint(f, v->as.cons.cdr);
     }
-    printf(")");
+    fprintf(f, ")");
     break;
   case L_FUNCTION:
-    printf("<function>");
+    fprintf(f, "<function>");
     break;
   case L_NATIVE:
     if (v->as.native.name) {
-      printf("<builtin:%s>", v->as.native.name);
+      fprintf(f, "<builtin:%s>", v->as.native.name);
     } else {
-      printf("<builtin>");
+      fprintf(f, "<builtin>");
+    }
+    break;
+  case L_PROMISE:
+    fprintf(f, "<promise>");
+    break;
+  case L_ERROR:
+    fprintf(f, "<error>");
+    break;
+  case L_VECTOR:
+    fprintf(f, "#(");
+    for (size_t i = 0; i < v->as.vector.count; i++) {
+      if (i) fputc(' ', f);
+      lval_fprint(f, v->as.vector.items[i]);
+    }
+    fprintf(f, ")");
+    break;
+  case L_HASHTABLE:
+    fprintf(f, "<hash-table>");
+    break;
+  case L_F64VECTOR:
+    fprintf(f, "#f64(");
+    for (size_t i = 0; i < v->as.f64vector.count; i++) {
+      if (i) fputc(' ', f);
+      fprintf(f, "%g", v->as.f64vector.items[i]);
     }
+    fprintf(f, ")");
     break;
   default:
-    printf("<unknown>");
+    fprintf(f, "<unknown>");
     break;
   }
 }
 
+void lval_print(const lval_t *v) {
+  lval_fprint(stdout, v);
+}
+
 lval_t *lval_copy(const lval_t *v) {
   if (!v) return NULL;
   switch (v->type) {
@@ -174,6 +375,18 @@ lval_t *lval_copy(const lval_t *v) {
     o->as.number = v->as.number;
     return o;
   }
+  case L_INT: {
+    lval_t *o = gc_alloc_lval();
+    o->type = L_INT;
+    o->as.integer = v->as.integer;
+    return o;
+  }
+  case L_BIGNUM: {
+    lval_t *o = gc_alloc_lval();
+    o->type = L_BIGNUM;
+    o->as.bignum = bignum_copy(v->as.bignum);
+    return o;
+  }
   case L_BOOL: {
     lval_t *o = gc_alloc_lval();
     o->type = L_BOOL;
@@ -223,13 +436,9 @@ lval_t *lval_copy(const lval_t *v) {
         perror("malloc");
         exit(EXIT_FAILURE);
       }
-      for (size_t i = 0; i < v->as.function.param_count; i++) {
-        o->as.function.params[i] = strdup(v->as.function.params[i]);
-        if (!o->as.function.params[i]) {
-          perror("strdup");
-          exit(EXIT_FAILURE);
-        }
-      }
+      memcpy(o->as.function.params,
+             v->as.function.params,
+             v->as.function.param_count * sizeof(char *));
     } else {
       o->as.function.params = NULL;
     }
@@ -249,6 +458,10 @@ lval_t *lval_copy(const lval_t *v) {
     o->as.function.closure = v->as.function.closure;
     if (o->as.function.closure) env_retain(o->as.function.closure);
     o->as.function.is_macro = v->as.function.is_macro;
+    o->as.function.name = v->as.function.name;
+    o->as.function.line = v->as.function.line;
+    o->as.function.calls = 0;
+    o->as.function.jit = NULL;
     return o;
   }
   case L_NATIVE: {
@@ -258,6 +471,29 @@ lval_t *lval_copy(const lval_t *v) {
     o->as.native.name = v->as.native.name;
     return o;
   }
+  case L_PROMISE: {
+    lval_t *o = gc_alloc_lval();
+    o->type = L_PROMISE;
+    o->as.promise = v->as.promise;
+    if (o->as.promise.env) env_retain(o->as.promise.env);
+    return o;
+  }
+  case L_ERROR: {
+    char *message = v->as.error.message;
+    if (v->as.error.owned) {
+      message = strdup(message);
+      if (!message) {
+        perror("strdup");
+        exit(EXIT_FAILURE);
+      }
+    }
+    return lval_error(v->as.error.code, v->as.error.owned, v->as.error.arg, message,
+                      v->as.error.value);
+  }
+  case L_VECTOR:
+  case L_HASHTABLE:
+  case L_F64VECTOR:
+    return (lval_t *)v;
   default:
     fprintf(stderr, "lval_copy: unsupported type %d\n", (int)v->type);
     exit(EXIT_FAILURE);
@@ -270,21 +506,38 @@ void lval_free(lval_t *v) {
   case L_STRING:
     free(v->as.string.ptr);
     break;
+  case L_BIGNUM:
+    bignum_free(v->as.bignum);
+    break;
   case L_CONS:
     lval_free(v->as.cons.car);
     lval_free(v->as.cons.cdr);
     break;
   case L_FUNCTION:
-    for (size_t i = 0; i < v->as.function.param_count; i++) {
-      free(v->as.function.params[i]);
-    }
     free(v->as.function.params);
     free(v->as.function.body);
     if (v->as.function.closure) env_release(v->as.function.closure);
     break;
+  case L_PROMISE:
+    if (v->as.promise.env) env_release(v->as.promise.env);
+    break;
+  case L_ERROR:
+    if (v->as.error.owned) free(v->as.error.message);
+    break;
+  case L_VECTOR:
+    // Slots may share values, which the collector owns.
+    free(v->as.vector.items);
+    break;
+  case L_HASHTABLE:
+    lval_hash_table_free(v->as.hash.table);
+    break;
+  case L_F64VECTOR:
+    free(v->as.f64vector.items);
+    break;
   case L_SYMBOL:
   case L_NIL:
   case L_NUM:
+  case L_INT:
   case L_BOOL:
   case L_NATIVE:
   default:
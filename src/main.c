@@ -1,9 +1,12 @@
 #include "builtin.h"
+#include "emit_c.h"
 #include "env.h"
 #include "evaluator.h"
 #include "gc.h"
+#include "jit.h"
 #include "lexer.h"
 #include "parser.h"
+#include "profile.h"
 #include "symbol.h"
 #include <errno.h>
 #include <fcntl.h>
@@ -12,11 +15,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 int read_file(const char *path, char **script_contents);
 void repl(env_t *env);
 static volatile sig_atomic_t should_exit = 0;
 
+// Functions listed in the --profile report.
+#define PROFILE_REPORT_TOP 20
+#define PROFILE_DEFAULT_PATH "shrew.folded"
+// Objects per allocation sample for --profile-alloc.
+#define PROFILE_ALLOC_DEFAULT_EVERY 16
+
 static void signal_handler(int sig) {
   (void)sig;
   should_exit = 1;
@@ -29,12 +39,34 @@ static void print_usage(const char *progname) {
   fprintf(stderr, "  [PATH]             Path to script file to execute\n");
   fprintf(stderr, "Options:\n");
   fprintf(stderr, "  -i, --interactive  Start in after executing script interactive mode (REPL)\n");
+  fprintf(stderr, "  --jit              Compile hot numeric functions to native code (x86-64 Linux)\n");
+  fprintf(stderr, "  --emit-c           Print the script compiled to C instead of running it\n");
+  fprintf(stderr, "  --profile[=FILE]   Sample the script's Shrew call stacks; write them folded to\n");
+  fprintf(stderr, "                     FILE (default " PROFILE_DEFAULT_PATH ") and report the top functions\n");
+  fprintf(stderr, "  --profile-alloc[=N] Sample every Nth allocation (default %d) and report the\n",
+          PROFILE_ALLOC_DEFAULT_EVERY);
+  fprintf(stderr, "                     top allocation sites and types\n");
+  fprintf(stderr, "  --stats            Print collector counts to stderr after the script runs\n");
   fprintf(stderr, "  -h, --help         Show this help message and exit\n");
 }
 
+static void finish_profile(const char *path) {
+  FILE *folded = fopen(path, "w");
+  if (!folded) perror(path);
+  profile_stop(folded, stderr, PROFILE_REPORT_TOP);
+  if (folded) {
+    fclose(folded);
+    fprintf(stderr, "Folded stacks written to %s\n", path);
+  }
+}
+
 int main(int argc, char *argv[]) {
   int opt;
   bool interactive = false;
+  bool emit_c = false;
+  const char *profile_path = NULL;
+  size_t alloc_every = 0;
+  bool stats = false;
   char *script_path = NULL;
   char *script_contents = NULL;
   env_t env = { 0 };
@@ -53,6 +85,11 @@ int main(int argc, char *argv[]) {
   // clang-format off
   static struct option long_options[] = {
     {"interactive", no_argument, 0, 'i'},
+    {"jit", no_argument, 0, 'J'},
+    {"emit-c", no_argument, 0, 'C'},
+    {"profile", optional_argument, 0, 'P'},
+    {"profile-alloc", optional_argument, 0, 'A'},
+    {"stats", no_argument, 0, 'S'},
     {"help", no_argument, 0, 'h'},
     {0, 0, 0, 0}
   };
@@ -64,6 +101,28 @@ int main(int argc, char *argv[]) {
       interactive = true;
       script_path = optarg;
       break;
+    case 'J':
+      if (!jit_available()) {
+        fprintf(stderr, "Warning: --jit is not supported on this platform, ignoring\n");
+      }
+      jit_set_enabled(true);
+      break;
+    case 'C':
+      emit_c = true;
+      break;
+    case 'P':
+      profile_path = optarg ? optarg : PROFILE_DEFAULT_PATH;
+      break;
+    case 'A':
+      alloc_every = optarg ? strtoul(optarg, NULL, 10) : PROFILE_ALLOC_DEFAULT_EVERY;
+      if (alloc_every == 0) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'S':
+      stats = true;
+      break;
     case 'h':
       print_usage(argv[0]);
       return 0;
@@ -74,6 +133,12 @@ int main(int argc, char *argv[]) {
   }
 
   script_path = script_path ? script_path : argv[optind];
+  if ((emit_c || profile_path || alloc_every || stats) && (!script_path || interactive)) {
+    print_usage(argv[0]);
+    env_destroy(&env);
+    symbol_intern_free_all();
+    return 1;
+  }
 
   if (script_path) {
     if (read_file(script_path, &script_contents) != 0) {
@@ -107,10 +172,32 @@ int main(int argc, char *argv[]) {
       return 1;
     }
 
+    if (emit_c) {
+      bool ok = emit_c_program(parse_result.expressions, parse_result.count, stdout);
+      if (!ok) fprintf(stderr, "Failed to write C output\n");
+      parser_free(&parser);
+      free(script_contents);
+      env_destroy(&env);
+      symbol_intern_free_all();
+      return ok ? 0 : 1;
+    }
+
     gc_collect(NULL);
+    if (profile_path && !profile_start(script_path)) {
+      fprintf(stderr, "Warning: could not start the profiler\n");
+      profile_path = NULL;
+    }
+    if (alloc_every) profile_alloc_start(script_path, alloc_every);
     eval_result_t eval_result = evaluate_many(parse_result.expressions, parse_result.count, &env);
+    if (profile_path) finish_profile(profile_path);
+    profile_alloc_stop(stderr, PROFILE_REPORT_TOP);
+    if (stats) {
+      // One line in a fixed format, read by bench/run.c.
+      fprintf(stderr, "shrew-stats: collections=%zu allocations=%zu\n", gc_collection_count(),
+              gc_allocation_count());
+    }
     if (eval_result.status != EVAL_OK) {
-      fprintf(stderr, "Evaluation error: %s\n", eval_result.error_message);
+      fprintf(stderr, "Evaluation error: %s\n", eval_error_message(&eval_result));
       evaluator_result_free(&eval_result);
       parser_free(&parser);
       free(script_contents);
@@ -131,6 +218,7 @@ int main(int argc, char *argv[]) {
   }
   gc_collect(NULL);
   env_destroy(&env);
+  jit_reset();
   symbol_intern_free_all();
 
   return 0;
@@ -179,7 +267,7 @@ void repl(env_t *env) {
     }
     eval_result_t eval_result = evaluate_single(parse_result.expressions[0], env);
     if (eval_result.status != EVAL_OK) {
-      fprintf(stderr, "Evaluation error: %s\n", eval_result.error_message);
+      fprintf(stderr, "Evaluation error: %s\n", eval_error_message(&eval_result));
       evaluator_result_free(&eval_result);
       parser_free(&parser);
       continue;
@@ -1,6 +1,9 @@
 #include "parser.h"
+#include "bignum.h"
+#include "fold.h"
 #include "lexer.h"
 #include "string.h"
+#include "symbol.h"
 #include "token.h"
 #include <errno.h>
 #include <stdarg.h>
@@ -103,6 +106,7 @@ s_expression_t *parser_parse_list(parser_t *parser) {
                      parser->current_token.literal);
     return NULL;
   }
+  size_t line = parser->current_token.line;
   parser_next(parser);
 
   size_t capacity = DEFAULT_EXPRESSION_COUNT;
@@ -184,6 +188,9 @@ s_expression_t *parser_parse_list(parser_t *parser) {
   list_sexp->data.list.elements = elements;
   list_sexp->data.list.count = count;
   list_sexp->data.list.tail = dotted_tail;
+  list_sexp->data.list.line = line;
+  list_sexp->data.list.cache = (call_cache_t){ 0 };
+  list_sexp->data.list.fold = (fold_info_t){ 0 };
   return list_sexp;
 
 fail:
@@ -202,7 +209,8 @@ s_expression_t *parser_parse_atom(parser_t *parser) {
   switch (parser->current_token.type) {
   case TOKEN_SYMBOL:
     atom.type = ATOM_SYMBOL;
-    atom.value.symbol = literal;
+    atom.value.symbol = symbol_intern(literal);
+    free(literal);
     parser->current_token.literal = NULL;
     break;
   case TOKEN_STRING:
@@ -211,6 +219,28 @@ s_expression_t *parser_parse_atom(parser_t *parser) {
     parser->current_token.literal = NULL;
     break;
   case TOKEN_NUMBER:
+    // Literals without a dot are exact integers, and bignums when they
+    // overflow int64.
+    if (!strchr(literal, '.')) {
+      char *int_end;
+      errno = 0;
+      long long n = strtoll(literal, &int_end, 10);
+      if (int_end != literal && *int_end == '\0' && errno != ERANGE) {
+        atom.type = ATOM_INTEGER;
+        atom.value.integer = (int64_t)n;
+        free(literal);
+        parser->current_token.literal = NULL;
+        break;
+      }
+      bignum_t *big = bignum_from_string(literal);
+      if (big) {
+        atom.type = ATOM_BIGNUM;
+        atom.value.bignum = big;
+        free(literal);
+        parser->current_token.literal = NULL;
+        break;
+      }
+    }
     atom.type = ATOM_NUMBER;
     char *endptr;
     errno = 0;
@@ -269,6 +299,7 @@ s_expression_t *parser_parse_atom(parser_t *parser) {
 
 s_expression_t *parser_parse_quote_family(parser_t *parser) {
   int token_type = parser->current_token.type;
+  size_t line = parser->current_token.line;
   if (token_type == TOKEN_QUASIQUOTE) {
     parser->qq_depth++;
   }
@@ -287,24 +318,24 @@ s_expression_t *parser_parse_quote_family(parser_t *parser) {
   quote_atom.type = ATOM_SYMBOL;
   switch (token_type) {
   case TOKEN_QUOTE:
-    quote_atom.value.symbol = "quote";
+    quote_atom.value.symbol = symbol_intern("quote");
     break;
   case TOKEN_UNQUOTE:
-    quote_atom.value.symbol = "unquote";
+    quote_atom.value.symbol = symbol_intern("unquote");
     if (parser->qq_depth == 0) {
       parser_add_error(parser, "unquote outside quasiquote");
       return NULL;
     }
     break;
   case TOKEN_UNQUOTE_SPLICING:
-    quote_atom.value.symbol = "unquote-splicing";
+    quote_atom.value.symbol = symbol_intern("unquote-splicing");
     if (parser->qq_depth == 0) {
       parser_add_error(parser, "unquote-splicing outside quasiquote");
       return NULL;
     }
     break;
   case TOKEN_QUASIQUOTE:
-    quote_atom.value.symbol = "quasiquote";
+    quote_atom.value.symbol = symbol_intern("quasiquote");
     break;
   default:
     parser_add_error(parser, "internal: unexpected token type %d in quote family", token_type);
@@ -334,6 +365,9 @@ s_expression_t *parser_parse_quote_family(parser_t *parser) {
   list_sexp->data.list.elements = elements;
   list_sexp->data.list.count = 2;
   list_sexp->data.list.tail = NULL;
+  list_sexp->data.list.line = line;
+  list_sexp->data.list.cache = (call_cache_t){ 0 };
+  list_sexp->data.list.fold = (fold_info_t){ 0 };
   if (token_type == TOKEN_QUASIQUOTE) {
     parser->qq_depth--;
   }
@@ -424,8 +458,10 @@ void sexp_free(s_expression_t *n) {
 
   switch (n->type) {
   case NODE_ATOM:
+    if (n->data.atom.type == ATOM_BIGNUM) bignum_free(n->data.atom.value.bignum);
     break;
   case NODE_LIST:
+    fold_release(n);
     for (size_t i = 0; i < n->data.list.count; i++) {
       sexp_free(n->data.list.elements[i]);
     }
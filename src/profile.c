@@ -0,0 +1,498 @@
+#include "profile.h"
+#include "bignum.h"
+#include "hashtable.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+// Samples are stored as a header frame (name NULL, line = number of frames)
+// followed by the frames, outermost first.
+#define SAMPLE_BUFFER_FRAMES (1 << 16)
+#define TYPE_COUNT (L_F64VECTOR + 1)
+
+bool profile_active = false;
+profile_frame_t profile_stack[PROFILE_MAX_DEPTH];
+volatile sig_atomic_t profile_depth = 0;
+profile_call_t profile_call = { NULL, 0 };
+volatile sig_atomic_t profile_pending = 0;
+bool profile_alloc_active = false;
+size_t profile_alloc_countdown = 0;
+
+static profile_frame_t samples[SAMPLE_BUFFER_FRAMES];
+static volatile size_t sample_fill = 0;
+static volatile size_t samples_dropped = 0;
+
+// A function, or for allocations a call made by a function and the type of
+// the objects it allocated.
+typedef struct {
+  profile_frame_t frame;
+  profile_call_t call;
+  int type; // ltype_t, -1 for functions
+} site_key_t;
+
+typedef struct {
+  site_key_t key;
+  char *label;
+  size_t label_len;
+  size_t self; // CPU samples
+  size_t total;
+  size_t stamp; // last CPU sample counted in `total`
+  size_t objects; // allocation samples
+  size_t bytes;
+  size_t collected; // objects that have been through a collection
+  size_t survived;
+} site_t;
+
+typedef struct {
+  site_t **slots; // open addressing on the key
+  size_t capacity;
+  size_t count;
+} site_table_t;
+
+// A sampled object, waiting for the next collection.
+typedef struct {
+  lval_t *v;
+  profile_frame_t frame;
+  profile_call_t call;
+} pending_t;
+
+typedef struct {
+  char *source;
+  unsigned users; // profilers running
+
+  struct sigaction old_action;
+  double cpu_start; // seconds
+  site_table_t functions;
+  hashtable stacks; // folded stack -> size_t count
+  char *key;        // scratch for building folded stacks
+  size_t key_cap;
+  size_t sample_count;
+
+  size_t every;
+  size_t alloc_count; // sampled objects
+  site_table_t alloc_sites;
+  site_t types[TYPE_COUNT];
+  const char *type_names[TYPE_COUNT];
+  pending_t *pending;
+  size_t pending_count;
+  size_t pending_cap;
+} profiler_t;
+
+static profiler_t P = { 0 };
+
+static const char *const k_toplevel = "<toplevel>";
+
+static void on_sigprof(int sig) {
+  (void)sig;
+  size_t depth = (size_t)profile_depth;
+  size_t n = depth < PROFILE_MAX_DEPTH ? depth : PROFILE_MAX_DEPTH;
+  size_t fill = sample_fill;
+  if (fill + n + 1 > SAMPLE_BUFFER_FRAMES) {
+    samples_dropped = samples_dropped + 1;
+    profile_pending = 1;
+    return;
+  }
+  samples[fill] = (profile_frame_t){ NULL, n };
+  for (size_t i = 0; i < n; i++) samples[fill + 1 + i] = profile_stack[i];
+  sample_fill = fill + n + 1;
+  if (sample_fill > SAMPLE_BUFFER_FRAMES / 2) profile_pending = 1;
+}
+
+static void *xmalloc(size_t n) {
+  void *p = malloc(n);
+  if (!p) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+static void track_begin(const char *source) {
+  if (P.users++) return;
+  P.source = strdup(source ? source : "?");
+  if (!P.source) {
+    perror("strdup");
+    exit(EXIT_FAILURE);
+  }
+  profile_depth = 0;
+  profile_call = (profile_call_t){ NULL, 0 };
+  profile_active = true;
+}
+
+static void track_end(void) {
+  if (--P.users) return;
+  profile_active = false;
+  profile_depth = 0;
+  free(P.source);
+  P.source = NULL;
+}
+
+static void write_frame(FILE *out, profile_frame_t f) {
+  fputs(f.name ? f.name : "<lambda>", out);
+  if (f.line) fprintf(out, " (%s:%zu)", P.source, f.line);
+}
+
+static site_t *site_new(site_key_t key, const char *type_name) {
+  site_t *s = calloc(1, sizeof *s);
+  if (!s) {
+    perror("calloc");
+    exit(EXIT_FAILURE);
+  }
+  s->key = key;
+  s->stamp = SIZE_MAX;
+  FILE *out = open_memstream(&s->label, &s->label_len);
+  if (!out) {
+    perror("open_memstream");
+    exit(EXIT_FAILURE);
+  }
+  if (key.type >= 0) {
+    fputs(type_name, out);
+    if (key.call.callee) fprintf(out, " from %s (%s:%zu)", key.call.callee, P.source, key.call.line);
+    fputs(" in ", out);
+  }
+  write_frame(out, key.frame);
+  fclose(out);
+  return s;
+}
+
+static size_t key_hash(const site_key_t *k) {
+  uint64_t h = (uintptr_t)k->frame.name ^ k->frame.line * 0x9E3779B97F4A7C15ull;
+  h = (h ^ (uintptr_t)k->call.callee) * 0xBF58476D1CE4E5B9ull;
+  h = (h ^ k->call.line ^ ((uint64_t)(k->type + 1) << 56)) * 0x94D049BB133111EBull;
+  return (size_t)(h ^ (h >> 31));
+}
+
+static bool key_eq(const site_key_t *a, const site_key_t *b) {
+  return a->frame.name == b->frame.name && a->frame.line == b->frame.line &&
+         a->call.callee == b->call.callee && a->call.line == b->call.line && a->type == b->type;
+}
+
+static site_t *site_of(site_table_t *t, site_key_t key, const char *type_name) {
+  if ((t->count + 1) * 4 > t->capacity * 3) {
+    size_t cap = t->capacity ? t->capacity * 2 : 64;
+    site_t **slots = calloc(cap, sizeof *slots);
+    if (!slots) {
+      perror("calloc");
+      exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < t->capacity; i++) {
+      site_t *s = t->slots[i];
+      if (!s) continue;
+      size_t at = key_hash(&s->key) & (cap - 1);
+      while (slots[at]) at = (at + 1) & (cap - 1);
+      slots[at] = s;
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->capacity = cap;
+  }
+  size_t mask = t->capacity - 1;
+  for (size_t at = key_hash(&key) & mask;; at = (at + 1) & mask) {
+    site_t *s = t->slots[at];
+    if (!s) {
+      s = t->slots[at] = site_new(key, type_name);
+      t->count++;
+      return s;
+    }
+    if (key_eq(&s->key, &key)) return s;
+  }
+}
+
+// The sites of `t`, sorted by `cmp`, in an array the caller frees.
+static site_t **sorted_sites(const site_table_t *t, int (*cmp)(const void *, const void *)) {
+  site_t **sorted = xmalloc((t->count ? t->count : 1) * sizeof *sorted);
+  size_t n = 0;
+  for (size_t i = 0; i < t->capacity; i++) {
+    if (t->slots[i]) sorted[n++] = t->slots[i];
+  }
+  qsort(sorted, n, sizeof *sorted, cmp);
+  return sorted;
+}
+
+static void site_table_free(site_table_t *t) {
+  for (size_t i = 0; i < t->capacity; i++) {
+    if (!t->slots[i]) continue;
+    free(t->slots[i]->label);
+    free(t->slots[i]);
+  }
+  free(t->slots);
+  *t = (site_table_t){ 0 };
+}
+
+static site_t *function_site(profile_frame_t f) {
+  return site_of(&P.functions, (site_key_t){ f, { NULL, 0 }, -1 }, NULL);
+}
+
+static void key_append(size_t *len, const char *text, size_t n) {
+  if (*len + n + 2 > P.key_cap) {
+    size_t cap = P.key_cap ? P.key_cap : 256;
+    while (*len + n + 2 > cap) cap *= 2;
+    char *key = realloc(P.key, cap);
+    if (!key) {
+      perror("realloc");
+      exit(EXIT_FAILURE);
+    }
+    P.key = key;
+    P.key_cap = cap;
+  }
+  if (*len) P.key[(*len)++] = ';';
+  memcpy(P.key + *len, text, n);
+  *len += n;
+  P.key[*len] = '\0';
+}
+
+static void count_sample(const profile_frame_t *frames, size_t n) {
+  size_t id = P.sample_count++;
+  size_t len = 0;
+  if (n == 0) {
+    site_t *s = function_site((profile_frame_t){ k_toplevel, 0 });
+    s->self++;
+    s->total++;
+    key_append(&len, s->label, s->label_len);
+  }
+  for (size_t i = 0; i < n; i++) {
+    site_t *s = function_site(frames[i]);
+    if (s->stamp != id) {
+      s->stamp = id;
+      s->total++;
+    }
+    if (i + 1 == n) s->self++;
+    key_append(&len, s->label, s->label_len);
+  }
+
+  void *count = NULL;
+  if (ht_get(&P.stacks, P.key, &count)) {
+    ++*(size_t *)count;
+    return;
+  }
+  size_t *fresh = xmalloc(sizeof *fresh);
+  *fresh = 1;
+  char *key = xmalloc(len + 1);
+  memcpy(key, P.key, len + 1);
+  ht_error err = { 0 };
+  if (!ht_set(&P.stacks, key, fresh, &err)) {
+    fprintf(stderr, "profile: %s\n", err.error_message);
+    exit(EXIT_FAILURE);
+  }
+}
+
+void profile_drain(void) {
+  sigset_t block, old;
+  sigemptyset(&block);
+  sigaddset(&block, SIGPROF);
+  sigprocmask(SIG_BLOCK, &block, &old);
+  for (size_t at = 0; at < sample_fill;) {
+    size_t n = samples[at].line;
+    count_sample(&samples[at + 1], n);
+    at += n + 1;
+  }
+  sample_fill = 0;
+  profile_pending = 0;
+  sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+static double cpu_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+bool profile_start(const char *source) {
+  if (P.stacks.entries) return false;
+  ht_error err = { 0 };
+  if (!ht_init(&P.stacks, 64, &err)) return false;
+  profile_pending = 0;
+  sample_fill = 0;
+  samples_dropped = 0;
+  P.sample_count = 0;
+
+  struct sigaction sa = { 0 };
+  sa.sa_handler = on_sigprof;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGPROF, &sa, &P.old_action) != 0) {
+    perror("sigaction");
+    ht_destroy(&P.stacks);
+    return false;
+  }
+  track_begin(source);
+  P.cpu_start = cpu_seconds();
+  struct itimerval timer = { { 0, 1000000 / PROFILE_HZ }, { 0, 1000000 / PROFILE_HZ } };
+  if (setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+    perror("setitimer");
+    track_end();
+    sigaction(SIGPROF, &P.old_action, NULL);
+    ht_destroy(&P.stacks);
+    return false;
+  }
+  return true;
+}
+
+static int by_self(const void *a, const void *b) {
+  const site_t *x = *(site_t *const *)a, *y = *(site_t *const *)b;
+  if (x->self != y->self) return x->self < y->self ? 1 : -1;
+  if (x->total != y->total) return x->total < y->total ? 1 : -1;
+  return strcmp(x->label, y->label);
+}
+
+static void write_cpu_report(FILE *out, size_t top, double cpu) {
+  site_t **sorted = sorted_sites(&P.functions, by_self);
+  // The timer may tick less often than asked, at the kernel's tick rate.
+  fprintf(out, "%zu samples over %.0f ms of CPU time", P.sample_count, cpu * 1000.0);
+  if (samples_dropped) fprintf(out, " (%zu dropped)", (size_t)samples_dropped);
+  fprintf(out, "\n%8s %8s %8s  %s\n", "self", "total", "samples", "function");
+  double scale = P.sample_count ? 100.0 / (double)P.sample_count : 0;
+  for (size_t i = 0; i < P.functions.count && i < top; i++) {
+    fprintf(out, "%7.1f%% %7.1f%% %8zu  %s\n", (double)sorted[i]->self * scale,
+            (double)sorted[i]->total * scale, sorted[i]->self, sorted[i]->label);
+  }
+  free(sorted);
+}
+
+void profile_stop(FILE *folded, FILE *report, size_t top) {
+  if (!P.stacks.entries) return;
+  struct itimerval off = { { 0, 0 }, { 0, 0 } };
+  setitimer(ITIMER_PROF, &off, NULL);
+  double cpu = cpu_seconds() - P.cpu_start;
+  sigaction(SIGPROF, &P.old_action, NULL);
+  profile_drain();
+
+  ht_iter it;
+  const char *key = NULL;
+  void *count = NULL;
+  ht_iter_begin(&P.stacks, &it);
+  while (ht_iter_next(&it, &key, &count)) {
+    if (folded) fprintf(folded, "%s %zu\n", key, *(size_t *)count);
+    free((void *)key);
+    free(count);
+  }
+  ht_destroy(&P.stacks);
+  if (report) write_cpu_report(report, top, cpu);
+
+  site_table_free(&P.functions);
+  free(P.key);
+  P.key = NULL;
+  P.key_cap = 0;
+  track_end();
+}
+
+bool profile_alloc_start(const char *source, size_t every) {
+  if (profile_alloc_active || every == 0) return false;
+  track_begin(source);
+  P.every = every;
+  P.alloc_count = 0;
+  memset(P.types, 0, sizeof P.types);
+  profile_alloc_countdown = every;
+  profile_alloc_active = true;
+  return true;
+}
+
+void profile_alloc_sample(lval_t *v) {
+  profile_alloc_countdown = P.every;
+  if (P.pending_count == P.pending_cap) {
+    size_t cap = P.pending_cap ? P.pending_cap * 2 : 256;
+    pending_t *pending = realloc(P.pending, cap * sizeof *pending);
+    if (!pending) {
+      perror("realloc");
+      exit(EXIT_FAILURE);
+    }
+    P.pending = pending;
+    P.pending_cap = cap;
+  }
+  size_t depth = (size_t)profile_depth;
+  profile_frame_t frame = { k_toplevel, 0 };
+  if (depth) frame = profile_stack[(depth < PROFILE_MAX_DEPTH ? depth : PROFILE_MAX_DEPTH) - 1];
+  P.pending[P.pending_count++] = (pending_t){ v, frame, profile_call };
+}
+
+// Heap bytes held by `v` itself; what it points to is counted separately.
+static size_t footprint(const lval_t *v) {
+  size_t n = sizeof *v;
+  switch (v->type) {
+  case L_STRING:
+    return n + (v->as.string.ptr ? v->as.string.len + 1 : 0);
+  case L_BIGNUM:
+    return n + sizeof(bignum_t) + v->as.bignum->len * sizeof(uint32_t);
+  case L_FUNCTION:
+    return n + v->as.function.param_count * sizeof(char *) +
+           v->as.function.body_count * sizeof(s_expression_t *);
+  case L_VECTOR:
+    return n + v->as.vector.count * sizeof(lval_t *);
+  case L_HASHTABLE:
+    return n + sizeof(hashtable) + v->as.hash.table->capacity * sizeof(ht_entry);
+  case L_F64VECTOR:
+    return n + v->as.f64vector.count * sizeof(double);
+  default:
+    return n;
+  }
+}
+
+static void resolve(const pending_t *p, bool collected) {
+  const lval_t *v = p->v;
+  site_key_t key = { p->frame, p->call, (int)v->type };
+  P.type_names[v->type] = lval_type_name(v);
+  site_t *sites[2] = { site_of(&P.alloc_sites, key, P.type_names[v->type]), &P.types[v->type] };
+  size_t bytes = footprint(v);
+  for (size_t i = 0; i < 2; i++) {
+    sites[i]->objects++;
+    sites[i]->bytes += bytes;
+    if (collected) {
+      sites[i]->collected++;
+      if (v->mark) sites[i]->survived++;
+    }
+  }
+  P.alloc_count++;
+}
+
+void profile_alloc_collect(void) {
+  for (size_t i = 0; i < P.pending_count; i++) resolve(&P.pending[i], true);
+  P.pending_count = 0;
+}
+
+static int by_bytes(const void *a, const void *b) {
+  const site_t *x = *(site_t *const *)a, *y = *(site_t *const *)b;
+  if (x->bytes != y->bytes) return x->bytes < y->bytes ? 1 : -1;
+  if (x->objects != y->objects) return x->objects < y->objects ? 1 : -1;
+  return strcmp(x->label, y->label);
+}
+
+static void write_alloc_row(FILE *out, const site_t *s, const char *label) {
+  fprintf(out, "%10zu %12zu ", s->objects * P.every, s->bytes * P.every);
+  if (s->collected) {
+    fprintf(out, "%8.1f%%", 100.0 * (double)s->survived / (double)s->collected);
+  } else {
+    fprintf(out, "%9s", "-");
+  }
+  fprintf(out, "  %s\n", label);
+}
+
+static void write_alloc_report(FILE *out, size_t top) {
+  fprintf(out, "%zu allocations sampled, 1 in %zu; counts below are scaled by %zu\n",
+          P.alloc_count, P.every, P.every);
+  fprintf(out, "%10s %12s %9s  %s\n", "objects", "bytes", "survived", "site");
+  site_t **sorted = sorted_sites(&P.alloc_sites, by_bytes);
+  for (size_t i = 0; i < P.alloc_sites.count && i < top; i++) {
+    write_alloc_row(out, sorted[i], sorted[i]->label);
+  }
+  free(sorted);
+  fprintf(out, "%10s %12s %9s  %s\n", "objects", "bytes", "survived", "type");
+  for (int t = 0; t < TYPE_COUNT; t++) {
+    if (!P.types[t].objects) continue;
+    write_alloc_row(out, &P.types[t], P.type_names[t]);
+  }
+}
+
+void profile_alloc_stop(FILE *report, size_t top) {
+  if (!profile_alloc_active) return;
+  profile_alloc_active = false;
+  // Objects made since the last collection are still alive.
+  for (size_t i = 0; i < P.pending_count; i++) resolve(&P.pending[i], false);
+  free(P.pending);
+  P.pending = NULL;
+  P.pending_count = P.pending_cap = 0;
+  if (report) write_alloc_report(report, top);
+  site_table_free(&P.alloc_sites);
+  track_end();
+}
@@ -1,12 +1,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "bignum.h"
+#include "dispatch.h"
 #include "env.h"
 #include "evaluator.h"
+#include "fold.h"
+#include "gc.h"
 #include "lval.h"
 #include "parser.h"
 #include "special.h"
+#include "symbol.h"
 
 static eval_result_t ast_to_quoted_lval(const s_expression_t *e, env_t *env);
 static eval_result_t ast_list_to_quoted_cons(const s_expression_t *list, env_t *env);
@@ -15,6 +21,10 @@ static eval_result_t ast_atom_to_quoted_lval(const atom_t *a) {
   switch (a->type) {
   case ATOM_NUMBER:
     return eval_ok(lval_num(a->value.number));
+  case ATOM_INTEGER:
+    return eval_ok(lval_int(a->value.integer));
+  case ATOM_BIGNUM:
+    return eval_ok(lval_bignum(bignum_copy(a->value.bignum)));
   case ATOM_BOOLEAN:
     return eval_ok(lval_bool(a->value.boolean));
   case ATOM_STRING: {
@@ -22,7 +32,7 @@ static eval_result_t ast_atom_to_quoted_lval(const atom_t *a) {
     return eval_ok(lval_string_copy(s, strlen(s)));
   }
   case ATOM_SYMBOL:
-    return eval_ok(lval_intern(a->value.symbol));
+    return eval_ok(lval_symbol(a->value.symbol));
   default:
     return eval_errf("quote: unknown atom type %d", a->type);
   }
@@ -102,27 +112,29 @@ static lval_t *make_simple_list(const char *sym, lval_t *v) {
 // forward declaration
 static eval_result_t qq_expand_any(const s_expression_t *e, env_t *env, int depth);
 
-static eval_result_t qq_expand_list(const s_expression_t *list, env_t *env, int depth) {
-  lval_t *tail = NULL;
+// Builds the list back to front in *tail, which lives in a value stack slot
+// so the partial result survives collections triggered by unquoted code.
+static eval_result_t qq_build_list(const s_expression_t *list, env_t *env, int depth,
+                                   lval_t **tail) {
   if (list->data.list.tail) {
     const s_expression_t *arg = NULL;
     if (is_simple_form(list->data.list.tail, "unquote", &arg) && depth == 1) {
       eval_result_t r = evaluate_single((s_expression_t *)arg, env);
       if (r.status != EVAL_OK) return r;
-      tail = r.result;
+      *tail = r.result;
     } else if (is_simple_form(list->data.list.tail, "unquote-splicing", &arg) && depth == 1) {
       return eval_errf("unquote-splicing not allowed in dotted tail");
     } else if (is_simple_form(list->data.list.tail, "quasiquote", &arg)) {
       eval_result_t inner = qq_expand_any(arg, env, depth + 1);
       if (inner.status != EVAL_OK) return inner;
-      tail = make_simple_list("quasiquote", inner.result);
+      *tail = make_simple_list("quasiquote", inner.result);
     } else {
       eval_result_t r = qq_expand_any(list->data.list.tail, env, depth);
       if (r.status != EVAL_OK) return r;
-      tail = r.result;
+      *tail = r.result;
     }
   } else {
-    tail = lval_nil();
+    *tail = lval_nil();
   }
 
   for (ssize_t i = (ssize_t)list->data.list.count - 1; i >= 0; --i) {
@@ -134,14 +146,14 @@ static eval_result_t qq_expand_list(const s_expression_t *list, env_t *env, int
         if (r.status != EVAL_OK) {
           return r;
         }
-        tail = lval_cons(r.result, tail);
+        *tail = lval_cons(r.result, *tail);
       } else {
         eval_result_t inner = qq_expand_any(arg, env, depth - 1);
         if (inner.status != EVAL_OK) {
           return inner;
         }
         lval_t *form = make_simple_list("unquote", inner.result);
-        tail = lval_cons(form, tail);
+        *tail = lval_cons(form, *tail);
       }
       continue;
     }
@@ -173,7 +185,7 @@ static eval_result_t qq_expand_list(const s_expression_t *list, env_t *env, int
           for (lval_t *x = r.result; x->type == L_CONS; x = x->as.cons.cdr)
             elems[k++] = x->as.cons.car;
           for (ssize_t j = (ssize_t)n - 1; j >= 0; --j)
-            tail = lval_cons(lval_copy(elems[j]), tail);
+            *tail = lval_cons(lval_copy(elems[j]), *tail);
           free(elems);
         }
       } else {
@@ -182,7 +194,7 @@ static eval_result_t qq_expand_list(const s_expression_t *list, env_t *env, int
           return inner;
         }
         lval_t *form = make_simple_list("unquote-splicing", inner.result);
-        tail = lval_cons(form, tail);
+        *tail = lval_cons(form, *tail);
       }
       continue;
     }
@@ -193,7 +205,7 @@ static eval_result_t qq_expand_list(const s_expression_t *list, env_t *env, int
         return inner;
       }
       lval_t *form = make_simple_list("quasiquote", inner.result);
-      tail = lval_cons(form, tail);
+      *tail = lval_cons(form, *tail);
       continue;
     }
 
@@ -201,9 +213,16 @@ static eval_result_t qq_expand_list(const s_expression_t *list, env_t *env, int
     if (v.status != EVAL_OK) {
       return v;
     }
-    tail = lval_cons(v.result, tail);
+    *tail = lval_cons(v.result, *tail);
   }
-  return eval_ok(tail);
+  return eval_ok(*tail);
+}
+
+static eval_result_t qq_expand_list(const s_expression_t *list, env_t *env, int depth) {
+  lval_t **tail = gc_stack_reserve(1);
+  eval_result_t r = qq_build_list(list, env, depth, tail);
+  gc_stack_pop(1);
+  return r;
 }
 
 static eval_result_t qq_expand_any(const s_expression_t *e, env_t *env, int depth) {
@@ -252,10 +271,12 @@ static eval_result_t sf_define(s_expression_t *list, env_t *env) {
     return value_res;
   }
 
-  if (!env_define(env, name, value_res.result)) {
+  if (!env_define_symbol(env, name, value_res.result)) {
     return eval_errf("define: failed to define variable '%s'", name);
   }
-  return eval_ok(lval_intern(name));
+  lval_t *fn = value_res.result;
+  if (fn->type == L_FUNCTION && !fn->as.function.name) fn->as.function.name = name;
+  return eval_ok(lval_symbol(name));
 }
 
 static eval_result_t sf_set(s_expression_t *list, env_t *env) {
@@ -275,7 +296,7 @@ static eval_result_t sf_set(s_expression_t *list, env_t *env) {
     return value_res;
   }
 
-  if (!env_set(env, name, value_res.result)) {
+  if (!env_set_symbol(env, name, value_res.result)) {
     return eval_errf("set: variable '%s' not defined", name);
   }
   return eval_ok(value_res.result);
@@ -303,32 +324,21 @@ static eval_result_t sf_lambda(s_expression_t *list, env_t *env) {
     for (size_t i = 0; i < param_count; ++i) {
       const s_expression_t *param = params_node->data.list.elements[i];
       if (param->type != NODE_ATOM || param->data.atom.type != ATOM_SYMBOL) {
-        for (size_t j = 0; j < i; ++j) {
-          free(params[j]);
-        }
         free(params);
         return eval_errf("lambda: parameter %zu is not a symbol", i + 1);
       }
-      const char *param_name = param->data.atom.value.symbol;
-      params[i] = strdup(param_name);
-      if (!params[i]) {
-        for (size_t j = 0; j < i; ++j) {
-          free(params[j]);
-        }
-        free(params);
-        return eval_errf("lambda: memory allocation failed for parameter '%s'", param_name);
-      }
+      params[i] = (char *)param->data.atom.value.symbol;
     }
   }
 
   size_t body_count = list->data.list.count - 2;
+  for (size_t i = 0; i < body_count; ++i) {
+    fold_expression(list->data.list.elements[i + 2], env);
+  }
   s_expression_t **body = NULL;
   if (body_count > 0) {
     body = malloc(body_count * sizeof(s_expression_t *));
     if (!body) {
-      for (size_t i = 0; i < param_count; i++) {
-        free(params[i]);
-      }
       free(params);
       return eval_errf("lambda: memory allocation failed for body");
     }
@@ -339,13 +349,11 @@ static eval_result_t sf_lambda(s_expression_t *list, env_t *env) {
 
   lval_t *fn = lval_function(params, param_count, body, body_count, env, false);
   if (!fn) {
-    for (size_t i = 0; i < param_count; i++) {
-      free(params[i]);
-    }
     free(params);
     free(body);
     return eval_errf("lambda: failed to create function");
   }
+  fn->as.function.line = list->data.list.line;
 
   return eval_ok(fn);
 }
@@ -403,6 +411,472 @@ static eval_result_t sf_begin(s_expression_t *list, env_t *env) {
   return evaluate_many(&list->data.list.elements[1], n - 1, env);
 }
 
+// (and e...) and (or e...): evaluate their arguments left to right and
+// stop at the first one that decides the result, which is returned.
+static eval_result_t logic(s_expression_t *list, env_t *env, const char *form, bool stop_on) {
+  if (list->data.list.tail != NULL) return eval_errf("%s: cannot have dotted arguments", form);
+  size_t n = list->data.list.count;
+  if (n < 2) return eval_errf("%s: expected at least 1 argument, got %zu", form, n - 1);
+  eval_result_t r = eval_ok(NULL);
+  for (size_t i = 1; i < n; i++) {
+    r = evaluate_single(list->data.list.elements[i], env);
+    if (r.status != EVAL_OK) return r;
+    if (r.result->type != L_BOOL) return eval_errf("%s: expected boolean arguments", form);
+    if (r.result->as.boolean == stop_on) break;
+  }
+  return r;
+}
+
+static eval_result_t sf_and(s_expression_t *list, env_t *env) {
+  return logic(list, env, "and", false);
+}
+
+static eval_result_t sf_or(s_expression_t *list, env_t *env) {
+  return logic(list, env, "or", true);
+}
+
+// (delay expr): a promise to evaluate `expr` in the current environment,
+// the first time it is forced.
+static eval_result_t sf_delay(s_expression_t *list, env_t *env) {
+  if (list->data.list.tail != NULL) return eval_errf("delay: cannot have dotted arguments");
+  if (list->data.list.count != 2) return eval_errf("delay requires exactly one argument");
+  return eval_ok(lval_promise(list->data.list.elements[1], env));
+}
+
+// (stream-cons a b): the pair of `a` and a promise of `b`.
+static eval_result_t sf_stream_cons(s_expression_t *list, env_t *env) {
+  if (list->data.list.tail != NULL) return eval_errf("stream-cons: cannot have dotted arguments");
+  if (list->data.list.count != 3) return eval_errf("stream-cons requires exactly two arguments");
+  eval_result_t r = evaluate_single(list->data.list.elements[1], env);
+  if (r.status != EVAL_OK) return r;
+  return eval_ok(lval_cons(r.result, lval_promise(list->data.list.elements[2], env)));
+}
+
+static eval_result_t sf_case(s_expression_t *list, env_t *env) {
+  return case_eval(list, NULL, env);
+}
+
+// Checks that `node` is a list of (name expr) bindings, or (name init
+// [step]) ones when `steps` is set.
+static eval_result_t check_bindings(const char *form, const s_expression_t *node, bool steps) {
+  if (node->type != NODE_LIST || node->data.list.tail) {
+    return eval_errf("%s: bindings must be a list", form);
+  }
+  for (size_t i = 0; i < node->data.list.count; i++) {
+    const s_expression_t *b = node->data.list.elements[i];
+    size_t n = b->type == NODE_LIST && !b->data.list.tail ? b->data.list.count : 0;
+    if (n < 2 || n > (steps ? 3 : 2) || !sexp_is_symbol(b->data.list.elements[0], NULL)) {
+      return eval_errf("%s: binding %zu must be (name %s)", form, i + 1,
+                       steps ? "init [step]" : "value");
+    }
+  }
+  return eval_ok(NULL);
+}
+
+static const char *binding_name(const s_expression_t *bindings, size_t i) {
+  return bindings->data.list.elements[i]->data.list.elements[0]->data.atom.value.symbol;
+}
+
+static s_expression_t *binding_expr(const s_expression_t *bindings, size_t i, size_t which) {
+  const s_expression_t *b = bindings->data.list.elements[i];
+  return which < b->data.list.count ? b->data.list.elements[which] : NULL;
+}
+
+// Evaluates each binding's init expression in `env` into `vals`.
+static eval_result_t eval_inits(const s_expression_t *bindings, env_t *env, lval_t **vals) {
+  for (size_t i = 0; i < bindings->data.list.count; i++) {
+    eval_result_t r = evaluate_single(binding_expr(bindings, i, 1), env);
+    if (r.status != EVAL_OK) return r;
+    vals[i] = r.result;
+  }
+  return eval_ok(NULL);
+}
+
+static env_t *bind_frame(env_t *parent, const s_expression_t *bindings, lval_t **vals) {
+  env_t *frame = env_new(parent);
+  for (size_t i = 0; i < bindings->data.list.count; i++) {
+    env_define_symbol(frame, binding_name(bindings, i), vals[i]);
+  }
+  return frame;
+}
+
+// Loops update their variables in place, which is only invisible while
+// nothing has captured the frame and it holds just the `bound` names the
+// loop binds. A closure made by the body keeps the frame alive, and a
+// define in the body adds a name that must not outlive the iteration; the
+// next iteration then gets a frame of its own.
+static env_t *next_frame(env_t *frame, size_t bound) {
+  if (frame->refcount == 1 && ht_count(frame->store) == bound) return frame;
+  env_t *fresh = env_new(frame->parent);
+  gc_pop_frame();
+  env_release(frame);
+  gc_push_frame(fresh);
+  return fresh;
+}
+
+// Binds the variables of a (let ...) form, or of a (let* ...) form when
+// `sequential` is set, in a new frame pushed for the collector. close_frame
+// releases it.
+static eval_result_t open_let(const char *form, bool sequential, s_expression_t *bindings,
+                              env_t *env, env_t **out) {
+  eval_result_t r = check_bindings(form, bindings, false);
+  if (r.status != EVAL_OK) return r;
+  size_t n = bindings->data.list.count;
+  if (sequential) {
+    // Each expression sees the variables bound before it.
+    env_t *frame = env_new(env);
+    gc_push_frame(frame);
+    for (size_t i = 0; i < n; i++) {
+      r = evaluate_single(binding_expr(bindings, i, 1), frame);
+      if (r.status != EVAL_OK) {
+        gc_pop_frame();
+        env_release(frame);
+        return r;
+      }
+      env_define_symbol(frame, binding_name(bindings, i), r.result);
+    }
+    *out = frame;
+    return eval_ok(NULL);
+  }
+  lval_t **vals = gc_stack_reserve(n);
+  r = eval_inits(bindings, env, vals);
+  if (r.status == EVAL_OK) {
+    *out = bind_frame(env, bindings, vals);
+    gc_push_frame(*out);
+  }
+  gc_stack_pop(n);
+  return r;
+}
+
+static void close_frame(env_t *frame) {
+  gc_pop_frame();
+  env_release(frame);
+}
+
+static eval_result_t eval_body(s_expression_t **body, size_t n, env_t *env) {
+  eval_result_t r = eval_ok(lval_nil());
+  for (size_t i = 0; i < n; i++) {
+    r = evaluate_single(body[i], env);
+    if (r.status != EVAL_OK) break;
+  }
+  return r;
+}
+
+typedef struct {
+  const char *name; // the loop's name, bound to `fn` in the frame's parent
+  lval_t *fn;
+  size_t argc;
+  lval_t **args; // arguments of the pending tail call
+} named_loop_t;
+
+static eval_result_t sf_let(s_expression_t *list, env_t *env);
+static eval_result_t sf_let_star(s_expression_t *list, env_t *env);
+
+// Evaluates `e` in tail position of a named let's body. A call to the loop
+// itself is not made: its arguments are left in `loop->args` and *again is
+// set so the caller can run the body once more in the same frame. The tail
+// of a let or let* in the body is evaluated in the let's frame, and the
+// arguments of a loop call made there go to the loop's frame all the same.
+// So are the last argument of and/or and the chosen branch of a case.
+static eval_result_t eval_tail(const named_loop_t *loop, s_expression_t *e, env_t *env,
+                               bool *again) {
+  for (;;) {
+    if (e->type != NODE_LIST || e->data.list.tail || e->data.list.count == 0) {
+      return evaluate_single(e, env);
+    }
+    s_expression_t *folded = fold_replacement(e, env);
+    const dispatch_t *table = NULL;
+    if (folded && folded->type == NODE_ATOM && folded->data.atom.type == ATOM_DISPATCH) {
+      table = folded->data.atom.value.dispatch;
+    } else if (folded && !e->data.list.fold.inlined) {
+      e = folded;
+      continue;
+    }
+    s_expression_t **el = e->data.list.elements;
+    size_t n = e->data.list.count;
+    const char *head = NULL;
+    if ((folded && !table) || !sexp_is_symbol(el[0], &head)) return evaluate_single(e, env);
+    special_form_fn sf = lookup_special_form(head);
+    if (sf == sf_if && n >= 3 && n <= 4) {
+      eval_result_t c = evaluate_single(el[1], env);
+      if (c.status != EVAL_OK) return c;
+      if (c.result->type != L_BOOL) return eval_errf("if: condition did not evaluate to a boolean");
+      if (!c.result->as.boolean && n == 3) return eval_ok(lval_nil());
+      e = c.result->as.boolean ? el[2] : el[3];
+    } else if (sf == sf_begin && n >= 2) {
+      eval_result_t r = eval_body(el + 1, n - 2, env);
+      if (r.status != EVAL_OK) return r;
+      e = el[n - 1];
+    } else if (sf == sf_cond && n == 2 && el[1]->type == NODE_LIST && !el[1]->data.list.tail &&
+               el[1]->data.list.count % 2 == 0) {
+      s_expression_t **clauses = el[1]->data.list.elements;
+      size_t i = 0;
+      for (; i < el[1]->data.list.count; i += 2) {
+        eval_result_t c = evaluate_single(clauses[i], env);
+        if (c.status != EVAL_OK) return c;
+        if (c.result->type != L_BOOL) return eval_errf("cond: nonboolean condition encountered");
+        if (c.result->as.boolean) break;
+      }
+      if (i == el[1]->data.list.count) return eval_ok(lval_nil());
+      e = clauses[i + 1];
+    } else if (sf == sf_case) {
+      s_expression_t **body;
+      size_t count;
+      eval_result_t r = case_select(e, table, env, &body, &count);
+      if (r.status != EVAL_OK || count == 0) return r;
+      r = eval_body(body, count - 1, env);
+      if (r.status != EVAL_OK) return r;
+      e = body[count - 1];
+    } else if ((sf == sf_and || sf == sf_or) && n >= 2) {
+      // The last argument is in tail position. A value it returns must still
+      // be a boolean, like the others.
+      bool stop_on = sf == sf_or;
+      for (size_t i = 1; i < n - 1; i++) {
+        eval_result_t r = evaluate_single(el[i], env);
+        if (r.status != EVAL_OK) return r;
+        if (r.result->type != L_BOOL) return eval_errf("%s: expected boolean arguments", head);
+        if (r.result->as.boolean == stop_on) return r;
+      }
+      eval_result_t r = eval_tail(loop, el[n - 1], env, again);
+      if (r.status == EVAL_OK && !*again && r.result->type != L_BOOL) {
+        return eval_errf("%s: expected boolean arguments", head);
+      }
+      return r;
+    } else if ((sf == sf_let || sf == sf_let_star) && n >= 3 && !sexp_is_symbol(el[1], NULL)) {
+      env_t *frame = NULL;
+      eval_result_t r = open_let(head, sf == sf_let_star, el[1], env, &frame);
+      if (r.status != EVAL_OK) return r;
+      r = eval_body(el + 2, n - 3, frame);
+      if (r.status == EVAL_OK) r = eval_tail(loop, el[n - 1], frame, again);
+      close_frame(frame);
+      return r;
+    } else if (!sf && head == loop->name && n - 1 == loop->argc &&
+               env_get_symbol(env, head) == loop->fn) {
+      for (size_t i = 0; i < loop->argc; i++) {
+        eval_result_t r = evaluate_single(el[i + 1], env);
+        if (r.status != EVAL_OK) return r;
+        loop->args[i] = r.result;
+      }
+      *again = true;
+      return eval_ok(NULL);
+    } else {
+      return evaluate_single(e, env);
+    }
+  }
+}
+
+// (let name ((var init) ...) body...): `name` is bound to a function of the
+// variables whose body is the let's body. Calls to it in tail position
+// rebind the variables and rerun the body in the same frame; any other call
+// is an ordinary call.
+static eval_result_t named_let(s_expression_t *list, env_t *env) {
+  s_expression_t **el = list->data.list.elements;
+  const char *name = el[1]->data.atom.value.symbol;
+  s_expression_t *bindings = el[2];
+  eval_result_t r = check_bindings("let", bindings, false);
+  if (r.status != EVAL_OK) return r;
+  size_t argc = bindings->data.list.count;
+  size_t body_count = list->data.list.count - 3;
+
+  char **params = argc ? malloc(argc * sizeof(char *)) : NULL;
+  s_expression_t **body = body_count ? malloc(body_count * sizeof(s_expression_t *)) : NULL;
+  if ((argc && !params) || (body_count && !body)) {
+    free(params);
+    free(body);
+    return eval_errf("let: memory allocation failed");
+  }
+  for (size_t i = 0; i < argc; i++) params[i] = (char *)binding_name(bindings, i);
+  for (size_t i = 0; i < body_count; i++) body[i] = el[i + 3];
+
+  lval_t **args = gc_stack_reserve(argc + 1);
+  r = eval_inits(bindings, env, args);
+  if (r.status != EVAL_OK) {
+    gc_stack_pop(argc + 1);
+    free(params);
+    free(body);
+    return r;
+  }
+  env_t *scope = env_new(env);
+  lval_t *fn = lval_function(params, argc, body, body_count, scope, false);
+  fn->as.function.name = name;
+  fn->as.function.line = list->data.list.line;
+  args[argc] = fn;
+  env_define_symbol(scope, name, fn);
+  named_loop_t loop = { name, fn, argc, args };
+
+  env_t *frame = bind_frame(scope, bindings, args);
+  size_t bound = ht_count(frame->store);
+  gc_push_frame(frame);
+  for (;;) {
+    bool again = false;
+    r = eval_body(body, body_count - 1, frame);
+    if (r.status != EVAL_OK) break;
+    r = eval_tail(&loop, body[body_count - 1], frame, &again);
+    if (r.status != EVAL_OK || !again) break;
+    frame = next_frame(frame, bound);
+    for (size_t i = 0; i < argc; i++) env_define_symbol(frame, params[i], args[i]);
+  }
+  gc_pop_frame();
+  env_release(frame);
+  env_release(scope);
+  gc_stack_pop(argc + 1);
+  return r;
+}
+
+// (let ((var expr) ...) body...) and (let name ...), see named_let.
+static eval_result_t sf_let(s_expression_t *list, env_t *env) {
+  if (list->data.list.tail != NULL) return eval_errf("let: cannot have dotted arguments");
+  if (list->data.list.count < 3) {
+    return eval_errf("let requires at least two arguments, got %zu", list->data.list.count - 1);
+  }
+  s_expression_t **el = list->data.list.elements;
+  if (sexp_is_symbol(el[1], NULL)) {
+    if (list->data.list.count < 4) return eval_errf("let: named let requires bindings and a body");
+    return named_let(list, env);
+  }
+  env_t *frame = NULL;
+  eval_result_t r = open_let("let", false, el[1], env, &frame);
+  if (r.status != EVAL_OK) return r;
+  r = eval_body(el + 2, list->data.list.count - 2, frame);
+  close_frame(frame);
+  return r;
+}
+
+// (let* ((var expr) ...) body...): each expression sees the variables
+// bound before it. All of them share one frame.
+static eval_result_t sf_let_star(s_expression_t *list, env_t *env) {
+  if (list->data.list.tail != NULL) return eval_errf("let*: cannot have dotted arguments");
+  if (list->data.list.count < 3) {
+    return eval_errf("let* requires at least two arguments, got %zu", list->data.list.count - 1);
+  }
+  s_expression_t **el = list->data.list.elements;
+  env_t *frame = NULL;
+  eval_result_t r = open_let("let*", true, el[1], env, &frame);
+  if (r.status != EVAL_OK) return r;
+  r = eval_body(el + 2, list->data.list.count - 2, frame);
+  close_frame(frame);
+  return r;
+}
+
+// (do ((var init [step]) ...) (test result...) body...): runs the body until
+// `test` holds, then evaluates the results. The steps are evaluated before
+// any variable is updated.
+static eval_result_t sf_do(s_expression_t *list, env_t *env) {
+  if (list->data.list.tail != NULL) return eval_errf("do: cannot have dotted arguments");
+  if (list->data.list.count < 3) {
+    return eval_errf("do requires at least two arguments, got %zu", list->data.list.count - 1);
+  }
+  s_expression_t **el = list->data.list.elements;
+  s_expression_t *bindings = el[1];
+  s_expression_t *exit = el[2];
+  eval_result_t r = check_bindings("do", bindings, true);
+  if (r.status != EVAL_OK) return r;
+  if (exit->type != NODE_LIST || exit->data.list.tail || exit->data.list.count == 0) {
+    return eval_errf("do: second argument must be (test result...)");
+  }
+
+  size_t n = bindings->data.list.count;
+  lval_t **vals = gc_stack_reserve(n);
+  r = eval_inits(bindings, env, vals);
+  if (r.status != EVAL_OK) {
+    gc_stack_pop(n);
+    return r;
+  }
+  env_t *frame = bind_frame(env, bindings, vals);
+  size_t bound = ht_count(frame->store);
+  gc_push_frame(frame);
+  for (;;) {
+    r = evaluate_single(exit->data.list.elements[0], frame);
+    if (r.status != EVAL_OK) break;
+    if (r.result->type != L_BOOL) {
+      r = eval_errf("do: test did not evaluate to a boolean");
+      break;
+    }
+    if (r.result->as.boolean) {
+      r = eval_body(exit->data.list.elements + 1, exit->data.list.count - 1, frame);
+      break;
+    }
+    r = eval_body(el + 3, list->data.list.count - 3, frame);
+    if (r.status != EVAL_OK) break;
+    for (size_t i = 0; i < n && r.status == EVAL_OK; i++) {
+      s_expression_t *step = binding_expr(bindings, i, 2);
+      if (step) r = evaluate_single(step, frame);
+      vals[i] = step ? r.result : env_get_symbol(frame, binding_name(bindings, i));
+    }
+    if (r.status != EVAL_OK) break;
+    frame = next_frame(frame, bound);
+    for (size_t i = 0; i < n; i++) env_define_symbol(frame, binding_name(bindings, i), vals[i]);
+  }
+  gc_pop_frame();
+  env_release(frame);
+  gc_stack_pop(n);
+  return r;
+}
+
+// (while test body...): runs the body in the current environment while
+// `test` holds. Returns nil.
+static eval_result_t sf_while(s_expression_t *list, env_t *env) {
+  if (list->data.list.tail != NULL) return eval_errf("while: cannot have dotted arguments");
+  if (list->data.list.count < 2) return eval_errf("while requires a test");
+  s_expression_t **el = list->data.list.elements;
+  for (;;) {
+    eval_result_t r = evaluate_single(el[1], env);
+    if (r.status != EVAL_OK) return r;
+    if (r.result->type != L_BOOL) return eval_errf("while: test did not evaluate to a boolean");
+    if (!r.result->as.boolean) return eval_ok(lval_nil());
+    r = eval_body(el + 2, list->data.list.count - 2, env);
+    if (r.status != EVAL_OK) return r;
+  }
+}
+
+// (try body... (catch var handler...)): evaluates the body and, if it
+// fails, the handler with `var` bound to the error. Errors carry their
+// kind and offending value unformatted, so catching one builds no message.
+static eval_result_t sf_try(s_expression_t *list, env_t *env) {
+  if (list->data.list.tail != NULL) return eval_errf("try: cannot have dotted arguments");
+  size_t n = list->data.list.count;
+  s_expression_t **el = list->data.list.elements;
+  const s_expression_t *clause = n >= 3 ? el[n - 1] : NULL;
+  if (!clause || clause->type != NODE_LIST || clause->data.list.tail ||
+      clause->data.list.count < 2 || !sexp_is_symbol_name(clause->data.list.elements[0], "catch") ||
+      !sexp_is_symbol(clause->data.list.elements[1], NULL)) {
+    return eval_errf("try: expected a body and a (catch var handler...) clause");
+  }
+  eval_result_t r = eval_body(el + 1, n - 2, env);
+  if (r.status == EVAL_OK) return r;
+
+  lval_t *error = lval_error(r.error_code, r.error_owned, r.error_arg, r.error_message, r.result);
+  env_t *frame = env_new(env);
+  env_define_symbol(frame, clause->data.list.elements[1]->data.atom.value.symbol, error);
+  gc_push_frame(frame);
+  r = eval_body(clause->data.list.elements + 2, clause->data.list.count - 2, frame);
+  gc_pop_frame();
+  env_release(frame);
+  return r;
+}
+
+static double monotonic_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// (time body...): evaluates the body and prints the elapsed time, the
+// objects it allocated and the collections it ran. Returns the body's
+// value.
+static eval_result_t sf_time(s_expression_t *list, env_t *env) {
+  if (list->data.list.tail != NULL) return eval_errf("time: cannot have dotted arguments");
+  if (list->data.list.count < 2) return eval_errf("time: expected an expression");
+  size_t allocations = gc_allocation_count();
+  size_t collections = gc_collection_count();
+  double start = monotonic_ms();
+  eval_result_t r = eval_body(list->data.list.elements + 1, list->data.list.count - 1, env);
+  double elapsed = monotonic_ms() - start;
+  printf("time: %.3f ms, %zu allocations, %zu collections\n", elapsed,
+         gc_allocation_count() - allocations, gc_collection_count() - collections);
+  return r;
+}
+
 static eval_result_t sf_defmacro(s_expression_t *list, env_t *env) {
   if (list->data.list.tail != NULL) return eval_errf("defmacro: cannot have dotted arguments");
   if (list->data.list.count < 3) {
@@ -432,21 +906,10 @@ static eval_result_t sf_defmacro(s_expression_t *list, env_t *env) {
     for (size_t i = 0; i < param_count; ++i) {
       const s_expression_t *p = params_node->data.list.elements[i];
       if (p->type != NODE_ATOM || p->data.atom.type != ATOM_SYMBOL) {
-        for (size_t j = 0; j < i; ++j) {
-          free(params[j]);
-        }
         free(params);
         return eval_errf("defmacro: parameter %zu is not a symbol", i + 1);
       }
-      params[i] = strdup(p->data.atom.value.symbol);
-      if (!params[i]) {
-        for (size_t j = 0; j < i; ++j) {
-          free(params[j]);
-        }
-        free(params);
-        return eval_errf("defmacro: memory allocation failed for parameter '%s'",
-                         p->data.atom.value.symbol);
-      }
+      params[i] = (char *)p->data.atom.value.symbol;
     }
   }
 
@@ -455,9 +918,6 @@ static eval_result_t sf_defmacro(s_expression_t *list, env_t *env) {
   if (body_count) {
     body = calloc(body_count, sizeof(s_expression_t *));
     if (!body) {
-      for (size_t i = 0; i < param_count; i++) {
-        free(params[i]);
-      }
       free(params);
       return eval_errf("defmacro: memory allocation failed for body");
     }
@@ -468,19 +928,18 @@ static eval_result_t sf_defmacro(s_expression_t *list, env_t *env) {
 
   lval_t *fn = lval_function(params, param_count, body, body_count, env, true);
   if (!fn) {
-    for (size_t i = 0; i < param_count; i++) {
-      free(params[i]);
-    }
     free(params);
     free(body);
     return eval_errf("defmacro: failed to create macro");
   }
+  fn->as.function.name = name;
+  fn->as.function.line = list->data.list.line;
 
-  if (!env_define(env, name, fn)) {
+  if (!env_define_symbol(env, name, fn)) {
     return eval_errf("defmacro: failed to define macro '%s'", name);
   }
 
-  return eval_ok(lval_intern(name));
+  return eval_ok(lval_symbol(name));
 }
 
 typedef struct {
@@ -500,14 +959,33 @@ static const special_entry_t k_specials[] = {
   { "if",     sf_if },
   { "cond", sf_cond },
   { "begin",  sf_begin },
-  { "defmacro", sf_defmacro }
+  { "and", sf_and },
+  { "or", sf_or },
+  { "case", sf_case },
+  { "delay", sf_delay },
+  { "stream-cons", sf_stream_cons },
+  { "defmacro", sf_defmacro },
+  { "let", sf_let },
+  { "let*", sf_let_star },
+  { "do", sf_do },
+  { "while", sf_while },
+  { "try", sf_try },
+  { "time", sf_time }
 
 };
 // clang-format on
 
-special_form_fn lookup_special_form(const char *name) {
+static size_t k_specials_generation = 0;
+
+static void register_special_symbols(void) {
   for (size_t i = 0; i < sizeof k_specials / sizeof k_specials[0]; i++) {
-    if (strcmp(name, k_specials[i].name) == 0) return k_specials[i].fn;
+    symbol_of(symbol_intern(k_specials[i].name))->special = (void *)k_specials[i].fn;
   }
-  return NULL;
+  k_specials_generation = symbol_table_generation();
+}
+
+// `name` must be an interned symbol; parser output always is.
+special_form_fn lookup_special_form(const char *name) {
+  if (k_specials_generation != symbol_table_generation()) register_special_symbols();
+  return (special_form_fn)symbol_of(name)->special;
 }
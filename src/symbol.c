@@ -1,3 +1,4 @@
+#include "symbol.h"
 #include "hashtable.h"
 #include <stdbool.h>
 #include <stdio.h>
@@ -5,40 +6,90 @@
 #include <string.h>
 
 static hashtable symbol_table;
+static size_t generation = 0;
+static size_t next_id = 0;
+static symbol_t **by_id = NULL;
+static size_t by_id_capacity = 0;
 
 void symbol_intern_init(void) {
+  if (symbol_table.entries) return;
   ht_error err = { 0 };
   ht_init(&symbol_table, 128, &err);
+  generation++;
+  next_id = 0;
 }
 
 const char *symbol_intern(const char *name) {
   if (!name) return NULL;
+  if (!symbol_table.entries) symbol_intern_init();
 
+  uint64_t hash = ht_hash_key(name);
   void *out = NULL;
-  if (ht_get(&symbol_table, name, &out)) {
-    return (const char *)out;
+  if (ht_get_hashed(&symbol_table, name, hash, &out)) {
+    return ((symbol_t *)out)->name;
   }
 
   size_t len = strlen(name);
-  char *interned_name = malloc(len + 1);
-  if (!interned_name) {
+  symbol_t *sym = calloc(1, sizeof(symbol_t) + len + 1);
+  if (!sym) {
     fprintf(stderr, "symbol_intern: out of memory copying '%s'\n", name);
     return NULL;
   }
-  strcpy(interned_name, name);
+  memcpy(sym->name, name, len + 1);
+  sym->hash = hash;
+  sym->id = next_id;
+
+  if (next_id == by_id_capacity) {
+    size_t capacity = by_id_capacity ? by_id_capacity * 2 : 128;
+    symbol_t **grown = realloc(by_id, capacity * sizeof *grown);
+    if (!grown) {
+      fprintf(stderr, "symbol_intern: out of memory growing symbol index\n");
+      free(sym);
+      return NULL;
+    }
+    by_id = grown;
+    by_id_capacity = capacity;
+  }
 
   ht_error err = { 0 };
-  if (!ht_set(&symbol_table, interned_name, interned_name, &err)) {
+  if (!ht_set_hashed(&symbol_table, sym->name, hash, sym, &err)) {
     fprintf(stderr,
             "symbol_intern: hashtable insert failed: %s\n",
             err.error_message ? err.error_message : "(unknown)");
-    free(interned_name);
+    free(sym);
     return NULL;
   }
-  return interned_name;
+  by_id[next_id++] = sym;
+  return sym->name;
 }
 
 void symbol_intern_free_all(void) {
+  if (symbol_table.entries) {
+    ht_iter it;
+    ht_iter_begin(&symbol_table, &it);
+    void *sym = NULL;
+    while (ht_iter_next(&it, NULL, &sym)) {
+      free(sym);
+    }
+  }
   ht_destroy(&symbol_table);
   symbol_table = (hashtable){ 0 };
+  free(by_id);
+  by_id = NULL;
+  by_id_capacity = 0;
+  next_id = 0;
+}
+
+// Bumped every time the table is (re)created, so modules that tag symbols
+// can tell when their tags were lost.
+size_t symbol_table_generation(void) {
+  return generation;
+}
+
+size_t symbol_count(void) {
+  return symbol_table.entries ? next_id : 0;
+}
+
+symbol_t *symbol_at(size_t id) {
+  return id < symbol_count() ? by_id[id] : NULL;
 }
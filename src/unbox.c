@@ -0,0 +1,338 @@
+#include "unbox.h"
+#include "builtin.h"
+#include "fold.h"
+#include "gc.h"
+#include "lval.h"
+#include "symbol.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Calls with more arguments than this are left to the builtins.
+#define UNBOX_MAX_ARGS 8
+
+typedef enum { OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_EQ, OP_LT, OP_GT, OP_LE, OP_GE } unbox_op_t;
+
+static const struct {
+  const char *name;
+  unbox_op_t op;
+} k_ops[] = {
+  { "+", OP_ADD }, { "-", OP_SUB }, { "*", OP_MUL }, { "/", OP_DIV }, { "=", OP_EQ },
+  { "<", OP_LT },  { ">", OP_GT },  { "<=", OP_LE }, { ">=", OP_GE },
+};
+
+static bool is_comparison(unbox_op_t op) {
+  return op >= OP_EQ;
+}
+
+typedef enum { U_INT, U_DOUBLE, U_VAR, U_EXPR, U_OP } unode_kind_t;
+
+struct unboxed {
+  unode_kind_t kind;
+  union {
+    int64_t integer;
+    double number;
+    const char *name;     // U_VAR
+    s_expression_t *expr; // U_EXPR, evaluated by evaluate_single; borrowed from the tree
+    struct {
+      unbox_op_t op;
+      builtin_fn fn;
+      bool pure; // no U_EXPR below, so nothing can collect or rebind while it runs
+      size_t argc;
+      struct unboxed **args;
+    } call;
+  } as;
+};
+
+// A value inside a region. Booleans only come out of a comparison at the
+// root; anything that is not an int or a double stays boxed.
+typedef struct {
+  enum { V_INT, V_DOUBLE, V_BOOL, V_BOXED } kind;
+  union {
+    int64_t integer;
+    double number;
+    bool boolean;
+    lval_t *boxed;
+  } as;
+} value_t;
+
+// The operator of `e` if it is a call to one of the builtins above that the
+// region may assume.
+static bool op_of(const s_expression_t *e, env_t *env, unbox_op_t *op, builtin_fn *fn) {
+  if (e->type != NODE_LIST || e->data.list.tail || e->data.list.count < 2) return false;
+  size_t argc = e->data.list.count - 1;
+  const char *name = NULL;
+  if (!sexp_is_symbol(e->data.list.elements[0], &name) || argc > UNBOX_MAX_ARGS) return false;
+  size_t i = 0;
+  while (i < sizeof k_ops / sizeof k_ops[0] && strcmp(k_ops[i].name, name) != 0)
+    i++;
+  if (i == sizeof k_ops / sizeof k_ops[0]) return false;
+  if (is_comparison(k_ops[i].op) && argc < 2) return false;
+  builtin_fn builtin = lookup_builtin(name);
+  if (!builtin || symbol_of(name)->local) return false;
+  lval_t *bound = env_get_symbol(env, name);
+  if (!bound || bound->type != L_NATIVE || bound->as.native.fn != (void *)builtin) return false;
+  *op = k_ops[i].op;
+  *fn = builtin;
+  return true;
+}
+
+static unboxed_t *compile_node(const s_expression_t *e, env_t *env, bool root) {
+  unbox_op_t op;
+  builtin_fn fn;
+  bool is_op = op_of(e, env, &op, &fn) && (root || !is_comparison(op));
+  if (root && !is_op) return NULL;
+
+  unboxed_t *n = calloc(1, sizeof *n);
+  if (!n) return NULL;
+  if (e->type == NODE_ATOM && e->data.atom.type == ATOM_INTEGER) {
+    n->kind = U_INT;
+    n->as.integer = e->data.atom.value.integer;
+  } else if (e->type == NODE_ATOM && e->data.atom.type == ATOM_NUMBER) {
+    n->kind = U_DOUBLE;
+    n->as.number = e->data.atom.value.number;
+  } else if (e->type == NODE_ATOM && e->data.atom.type == ATOM_SYMBOL) {
+    n->kind = U_VAR;
+    n->as.name = e->data.atom.value.symbol;
+  } else if (!is_op) {
+    n->kind = U_EXPR;
+    n->as.expr = (s_expression_t *)e;
+  } else {
+    size_t argc = e->data.list.count - 1;
+    n->kind = U_OP;
+    n->as.call.op = op;
+    n->as.call.fn = fn;
+    n->as.call.pure = true;
+    n->as.call.args = calloc(argc, sizeof(unboxed_t *));
+    if (!n->as.call.args) {
+      free(n);
+      return NULL;
+    }
+    for (size_t i = 0; i < argc; i++) {
+      unboxed_t *arg = compile_node(e->data.list.elements[i + 1], env, false);
+      if (!arg) {
+        unbox_free(n);
+        return NULL;
+      }
+      n->as.call.args[n->as.call.argc++] = arg;
+      if (arg->kind == U_EXPR || (arg->kind == U_OP && !arg->as.call.pure)) {
+        n->as.call.pure = false;
+      }
+    }
+  }
+  return n;
+}
+
+unboxed_t *unbox_compile(const s_expression_t *call, env_t *env) {
+  unboxed_t *code = compile_node(call, env, true);
+  if (!code || code->as.call.pure) return code;
+  // A region that calls out costs more than the boxed call unless it saves
+  // boxing some intermediate result.
+  for (size_t i = 0; i < code->as.call.argc; i++) {
+    if (code->as.call.args[i]->kind == U_OP) return code;
+  }
+  unbox_free(code);
+  return NULL;
+}
+
+void unbox_free(unboxed_t *code) {
+  if (code->kind == U_OP) {
+    for (size_t i = 0; i < code->as.call.argc; i++) unbox_free(code->as.call.args[i]);
+    free(code->as.call.args);
+  }
+  free(code);
+}
+
+static void unbox_value(lval_t *v, value_t *out) {
+  if (v->type == L_INT) {
+    out->kind = V_INT;
+    out->as.integer = v->as.integer;
+  } else if (v->type == L_NUM) {
+    out->kind = V_DOUBLE;
+    out->as.number = v->as.number;
+  } else {
+    out->kind = V_BOXED;
+    out->as.boxed = v;
+  }
+}
+
+static lval_t *box_value(const value_t *v) {
+  switch (v->kind) {
+  case V_INT:
+    return lval_int(v->as.integer);
+  case V_DOUBLE:
+    return lval_num(v->as.number);
+  case V_BOOL:
+    return lval_bool(v->as.boolean);
+  case V_BOXED:
+    break;
+  }
+  return v->as.boxed;
+}
+
+static double as_double(const value_t *v) {
+  return v->kind == V_INT ? (double)v->as.integer : v->as.number;
+}
+
+// Same results as num_eq, num_lt and num_le in builtin.c.
+static bool num_less(const value_t *a, const value_t *b, bool or_equal) {
+  if (a->kind == V_INT && b->kind == V_INT) {
+    return or_equal ? a->as.integer <= b->as.integer : a->as.integer < b->as.integer;
+  }
+  return or_equal ? as_double(a) <= as_double(b) : as_double(a) < as_double(b);
+}
+
+static bool num_equal(const value_t *a, const value_t *b) {
+  if (a->kind == V_INT && b->kind == V_INT) return a->as.integer == b->as.integer;
+  return as_double(a) == as_double(b);
+}
+
+static bool compare(unbox_op_t op, size_t argc, const value_t *v) {
+  for (size_t i = 0; i + 1 < argc; i++) {
+    bool holds = false;
+    switch (op) {
+    case OP_EQ:
+      holds = num_equal(&v[i + 1], &v[0]);
+      break;
+    case OP_LT:
+      holds = num_less(&v[i], &v[i + 1], false);
+      break;
+    case OP_GT:
+      holds = num_less(&v[i + 1], &v[i], false);
+      break;
+    case OP_LE:
+      holds = num_less(&v[i], &v[i + 1], true);
+      break;
+    case OP_GE:
+      holds = num_less(&v[i + 1], &v[i], true);
+      break;
+    default:
+      break;
+    }
+    if (!holds) return false;
+  }
+  return true;
+}
+
+// Mirrors the int64 and double paths of the arithmetic builtins. Returns
+// false when an int64 result overflows, which the builtin promotes to a
+// bignum.
+static bool arith(unbox_op_t op, size_t argc, const value_t *v, value_t *out) {
+  bool integers = op != OP_DIV;
+  for (size_t i = 0; i < argc && integers; i++) integers = v[i].kind == V_INT;
+  if (integers) {
+    int64_t n = op == OP_MUL ? 1 : 0;
+    for (size_t i = 0; i < argc; i++) {
+      int64_t x = v[i].as.integer;
+      bool overflow = false;
+      if (op == OP_ADD) {
+        overflow = __builtin_add_overflow(n, x, &n);
+      } else if (op == OP_MUL) {
+        overflow = __builtin_mul_overflow(n, x, &n);
+      } else if (i == 0) {
+        n = x;
+      } else {
+        overflow = __builtin_sub_overflow(n, x, &n);
+      }
+      if (overflow) return false;
+    }
+    out->kind = V_INT;
+    out->as.integer = n;
+    return true;
+  }
+  double s = op == OP_MUL ? 1.0 : 0.0;
+  for (size_t i = 0; i < argc; i++) {
+    double x = as_double(&v[i]);
+    if (op == OP_ADD) {
+      s += x;
+    } else if (op == OP_MUL) {
+      s *= x;
+    } else if (i == 0) {
+      s = x;
+    } else if (op == OP_SUB) {
+      s -= x;
+    } else {
+      s /= x;
+    }
+  }
+  out->kind = V_DOUBLE;
+  out->as.number = s;
+  return true;
+}
+
+// Runs the builtin on boxed operands, for the cases the region does not
+// handle itself.
+static eval_result_t call_builtin(const unboxed_t *n, value_t *v, env_t *env, value_t *out) {
+  size_t argc = n->as.call.argc;
+  lval_t **argv = gc_stack_reserve(argc);
+  for (size_t i = 0; i < argc; i++) argv[i] = box_value(&v[i]);
+  eval_result_t r = n->as.call.fn(argc, argv, env);
+  gc_stack_pop(argc);
+  if (r.status == EVAL_OK) unbox_value(r.result, out);
+  return r;
+}
+
+static eval_result_t eval_node(const unboxed_t *n, env_t *env, value_t *out) {
+  switch (n->kind) {
+  case U_INT:
+    out->kind = V_INT;
+    out->as.integer = n->as.integer;
+    return eval_ok(NULL);
+  case U_DOUBLE:
+    out->kind = V_DOUBLE;
+    out->as.number = n->as.number;
+    return eval_ok(NULL);
+  case U_VAR: {
+    lval_t *found = env_get_symbol(env, n->as.name);
+    if (!found) return eval_err(EVAL_ERR_UNBOUND, n->as.name, NULL);
+    unbox_value(found, out);
+    return eval_ok(NULL);
+  }
+  case U_EXPR: {
+    eval_result_t r = evaluate_single(n->as.expr, env);
+    if (r.status == EVAL_OK) unbox_value(r.result, out);
+    return r;
+  }
+  case U_OP:
+    break;
+  }
+
+  size_t argc = n->as.call.argc;
+  value_t v[UNBOX_MAX_ARGS];
+  // Boxed operands must survive the collections the other operands may
+  // trigger.
+  lval_t **roots = n->as.call.pure ? NULL : gc_stack_reserve(argc);
+  bool unboxed = true;
+  for (size_t i = 0; i < argc; i++) {
+    eval_result_t r = eval_node(n->as.call.args[i], env, &v[i]);
+    if (r.status != EVAL_OK) {
+      if (roots) gc_stack_pop(argc);
+      return r;
+    }
+    if (v[i].kind == V_BOXED) {
+      unboxed = false;
+      if (roots) roots[i] = v[i].as.boxed;
+    }
+  }
+  eval_result_t r = eval_ok(NULL);
+  if (unboxed && is_comparison(n->as.call.op)) {
+    out->kind = V_BOOL;
+    out->as.boolean = compare(n->as.call.op, argc, v);
+  } else if (!unboxed || !arith(n->as.call.op, argc, v, out)) {
+    r = call_builtin(n, v, env, out);
+  }
+  if (roots) gc_stack_pop(argc);
+  return r;
+}
+
+eval_result_t unbox_eval(const unboxed_t *code, env_t *env) {
+  // Other expressions in the region may refold the node it replaces.
+  bool hold = !code->as.call.pure;
+  if (hold) fold_hold();
+  value_t v;
+  eval_result_t r = eval_node(code, env, &v);
+  if (hold) fold_unhold();
+  if (r.status != EVAL_OK) return r;
+  lval_t *result = box_value(&v);
+  gc_maybe_collect(result);
+  return eval_ok(result);
+}
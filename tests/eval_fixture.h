@@ -0,0 +1,45 @@
+#ifndef EVAL_FIXTURE_H
+#define EVAL_FIXTURE_H
+
+#include "builtin.h"
+#include "env.h"
+#include "evaluator.h"
+#include "gc.h"
+#include "lexer.h"
+#include "parser.h"
+#include "symbol.h"
+#include <criterion/criterion.h>
+
+// A global environment with the builtins, and the parse of the last source
+// given to run, for the tests of one file. Pass eval_setup and eval_teardown
+// as a test's .init and .fini.
+static env_t env;
+static parser_t parser;
+static parse_result_t pr;
+
+static inline void eval_setup(void) {
+  symbol_intern_init();
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+}
+
+static inline void eval_teardown(void) {
+  parse_result_free(&pr);
+  parser_free(&parser);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+// Evaluates every expression in `src` and returns the last result.
+static inline eval_result_t run(const char *src) {
+  lexer_t lexer = lexer_new(src);
+  parser = parser_new(&lexer);
+  pr = parser_parse(&parser);
+  cr_assert_eq(parser.error_count, 0, "Parser should have no errors");
+  return evaluate_many(pr.expressions, pr.count, &env);
+}
+
+#endif
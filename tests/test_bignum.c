@@ -0,0 +1,150 @@
+#include "bignum.h"
+#include <criterion/criterion.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void assert_digits(const bignum_t *b, const char *expected) {
+  char *s = bignum_to_string(b);
+  cr_assert_str_eq(s, expected);
+  free(s);
+}
+
+// Returns 10^n - 1 as a run of nines.
+static bignum_t *nines(size_t n) {
+  char *s = malloc(n + 1);
+  memset(s, '9', n);
+  s[n] = '\0';
+  bignum_t *b = bignum_from_string(s);
+  free(s);
+  return b;
+}
+
+Test(bignum_tests, it_round_trips_decimal_strings) {
+  const char *inputs[] = { "0", "1", "-1", "4294967296", "-9223372036854775809",
+                           "123456789012345678901234567890" };
+  for (size_t i = 0; i < sizeof inputs / sizeof inputs[0]; i++) {
+    bignum_t *b = bignum_from_string(inputs[i]);
+    cr_assert_not_null(b);
+    assert_digits(b, inputs[i]);
+    bignum_free(b);
+  }
+  cr_assert_null(bignum_from_string("12a"));
+  cr_assert_null(bignum_from_string("-"));
+}
+
+Test(bignum_tests, it_converts_to_and_from_int64) {
+  int64_t out = 0;
+  bignum_t *min = bignum_from_i64(INT64_MIN);
+  assert_digits(min, "-9223372036854775808");
+  cr_assert(bignum_to_i64(min, &out));
+  cr_assert_eq(out, INT64_MIN);
+
+  bignum_t *one = bignum_from_i64(1);
+  bignum_t *below = bignum_sub(min, one);
+  cr_assert_not(bignum_to_i64(below, &out));
+
+  bignum_free(min);
+  bignum_free(one);
+  bignum_free(below);
+}
+
+Test(bignum_tests, it_adds_and_subtracts_with_signs) {
+  bignum_t *a = bignum_from_string("18446744073709551615");
+  bignum_t *b = bignum_from_string("-18446744073709551616");
+  bignum_t *sum = bignum_add(a, b);
+  bignum_t *diff = bignum_sub(a, b);
+  bignum_t *zero = bignum_sub(a, a);
+  assert_digits(sum, "-1");
+  assert_digits(diff, "36893488147419103231");
+  cr_assert_eq(zero->len, 0);
+  cr_assert_not(zero->negative);
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(sum);
+  bignum_free(diff);
+  bignum_free(zero);
+}
+
+Test(bignum_tests, karatsuba_matches_the_closed_form) {
+  // (10^n - 1)^2 = 9...9 8 0...0 1 with n - 1 nines and n - 1 zeros. n = 1200
+  // is about 125 limbs, well above the Karatsuba threshold.
+  size_t n = 1200;
+  bignum_t *x = nines(n);
+  bignum_t *sq = bignum_mul(x, x);
+  char *expected = malloc(2 * n + 1);
+  memset(expected, '9', n - 1);
+  expected[n - 1] = '8';
+  memset(expected + n, '0', n - 1);
+  expected[2 * n - 1] = '1';
+  expected[2 * n] = '\0';
+  assert_digits(sq, expected);
+  free(expected);
+  bignum_free(x);
+  bignum_free(sq);
+}
+
+Test(bignum_tests, lopsided_products_match_a_shift_and_subtract) {
+  bignum_t *big = nines(2000);
+  bignum_t *small = bignum_from_string("123456789123456789123456789123456789123456789123456789"
+                                       "123456789123456789123456789123456789123456789123456789"
+                                       "123456789123456789123456789123456789123456789123456789"
+                                       "123456789123456789123456789123456789123456789123456789"
+                                       "123456789123456789123456789123456789123456789123456789"
+                                       "1234567891234567891234567891234567891");
+  bignum_t *one = bignum_from_i64(1);
+  bignum_t *big_plus_one = bignum_add(big, one);
+  // small · (10^2000 - 1) = small · 10^2000 - small
+  bignum_t *product = bignum_mul(big, small);
+  bignum_t *shifted = bignum_mul(small, big_plus_one);
+  bignum_t *expected = bignum_sub(shifted, small);
+  cr_assert_eq(bignum_cmp(product, expected), 0);
+  bignum_free(big);
+  bignum_free(small);
+  bignum_free(one);
+  bignum_free(big_plus_one);
+  bignum_free(product);
+  bignum_free(shifted);
+  bignum_free(expected);
+}
+
+Test(bignum_tests, mod_takes_the_sign_of_the_dividend) {
+  bignum_t *a = bignum_from_string("-100000000000000000000000000007");
+  bignum_t *b = bignum_from_string("10000000000000000000");
+  bignum_t *r = bignum_mod(a, b);
+  assert_digits(r, "-7");
+  bignum_t *small = bignum_mod(b, a);
+  assert_digits(small, "10000000000000000000");
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(r);
+  bignum_free(small);
+}
+
+Test(bignum_tests, mod_by_multi_limb_divisor) {
+  // Checks a = q·b + r with 0 <= r < b.
+  bignum_t *a = nines(60);
+  bignum_t *b = bignum_from_string("1000000000000000000000000000001");
+  bignum_t *r = bignum_mod(a, b);
+  bignum_t *diff = bignum_sub(a, r);
+  bignum_t *check = bignum_mod(diff, b);
+  cr_assert_eq(check->len, 0, "a - r must be a multiple of b");
+  cr_assert_lt(bignum_cmp(r, b), 0);
+  bignum_free(a);
+  bignum_free(b);
+  bignum_free(r);
+  bignum_free(diff);
+  bignum_free(check);
+}
+
+Test(bignum_tests, it_compares_by_sign_then_magnitude) {
+  bignum_t *neg = bignum_from_string("-99999999999999999999");
+  bignum_t *small = bignum_from_i64(-1);
+  bignum_t *pos = bignum_from_string("99999999999999999999");
+  cr_assert_lt(bignum_cmp(neg, small), 0);
+  cr_assert_lt(bignum_cmp(small, pos), 0);
+  cr_assert_eq(bignum_cmp(pos, pos), 0);
+  cr_assert_float_eq(bignum_to_double(pos), 1e20, 1e5);
+  bignum_free(neg);
+  bignum_free(small);
+  bignum_free(pos);
+}
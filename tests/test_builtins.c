@@ -1,6 +1,8 @@
+#include "bignum.h"
 #include "builtin.h"
 #include "env.h"
 #include "evaluator.h"
+#include "fold.h"
 #include "gc.h"
 #include "lval.h"
 #include "parser.h"
@@ -29,7 +31,27 @@ static char *tmp_write(const char *content) {
 }
 
 static bool is_num(const lval_t *v, double x) {
-  return v && v->type == L_NUM && fabs(v->as.number - x) < 1e-9;
+  return v && lval_is_number(v) && fabs(lval_to_double(v) - x) < 1e-9;
+}
+
+// Sets up a fresh environment and evaluates all of `src` in it. Pair with
+// end_program.
+static eval_result_t run_program(const char *src, env_t *env, parser_t *p, parse_result_t *pr) {
+  symbol_intern_init();
+  cr_assert(env_init(env, NULL));
+  env_add_builtins(env);
+  gc_init(env);
+  *pr = setup_input(src, p);
+  return evaluate_many(pr->expressions, pr->count, env);
+}
+
+static void end_program(env_t *env, parser_t *p, parse_result_t *pr) {
+  parse_result_free(pr);
+  parser_free(p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(env);
+  symbol_intern_free_all();
 }
 
 Test(add_tests, it_add_two_numbers) {
@@ -103,6 +125,74 @@ Test(add_tests, add_zero_args_returns_zero) {
   symbol_intern_free_all();
 }
 
+Test(add_tests, add_integers_stay_exact) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+
+  parser_t p = { 0 };
+  parse_result_t pr = setup_input("(+ 9007199254740992 1)", &p);
+  eval_result_t r = evaluate_single(pr.expressions[0], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert_eq(r.result->type, L_INT);
+  cr_assert_eq(r.result->as.integer, 9007199254740993LL);
+  evaluator_result_free(&r);
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(add_tests, add_overflow_promotes_to_bignum) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+
+  parser_t p = { 0 };
+  parse_result_t pr = setup_input("(+ 9223372036854775807 1)", &p);
+  eval_result_t r = evaluate_single(pr.expressions[0], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert_eq(r.result->type, L_BIGNUM);
+  char *digits = bignum_to_string(r.result->as.bignum);
+  cr_assert_str_eq(digits, "9223372036854775808");
+  free(digits);
+  evaluator_result_free(&r);
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(add_tests, add_mixed_integer_and_double) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+
+  parser_t p = { 0 };
+  parse_result_t pr = setup_input("(+ 1 2.5)", &p);
+  eval_result_t r = evaluate_single(pr.expressions[0], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert_eq(r.result->type, L_NUM);
+  cr_assert(is_num(r.result, 3.5));
+  evaluator_result_free(&r);
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
 Test(add_tests, add_non_number_errors) {
   symbol_intern_init();
   env_t env;
@@ -115,7 +205,7 @@ Test(add_tests, add_non_number_errors) {
 
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_ERR);
-  cr_assert_not_null(r.error_message);
+  cr_assert_str_eq(eval_error_message(&r), "+: expected number at arg 2, got boolean");
 
   evaluator_result_free(&r);
   parse_result_free(&pr);
@@ -241,6 +331,30 @@ Test(sub_tests, subtract_non_number_errors) {
   symbol_intern_free_all();
 }
 
+Test(mul_tests, multiply_overflow_promotes_to_bignum) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+
+  parser_t p = { 0 };
+  parse_result_t pr = setup_input("(* 4294967296 4294967296)", &p);
+  eval_result_t r = evaluate_single(pr.expressions[0], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert_eq(r.result->type, L_BIGNUM);
+  char *digits = bignum_to_string(r.result->as.bignum);
+  cr_assert_str_eq(digits, "18446744073709551616");
+  free(digits);
+  evaluator_result_free(&r);
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
 Test(mul_tests, multiply_two_numbers) {
   symbol_intern_init();
   env_t env;
@@ -469,6 +583,85 @@ Test(mod_tests, mod_two_numbers) {
   symbol_intern_free_all();
 }
 
+Test(mod_tests, mod_integers_keep_sign_of_dividend) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+
+  parser_t p = { 0 };
+  parse_result_t pr = setup_input("(mod -7 3)", &p);
+  eval_result_t r = evaluate_single(pr.expressions[0], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert_eq(r.result->type, L_INT);
+  cr_assert_eq(r.result->as.integer, -1);
+  evaluator_result_free(&r);
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(mod_tests, mod_most_negative_by_minus_one) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+
+  parser_t p = { 0 };
+  parse_result_t pr = setup_input("(mod -9223372036854775808 -1)", &p);
+  eval_result_t r = evaluate_single(pr.expressions[0], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert_eq(r.result->type, L_INT);
+  cr_assert_eq(r.result->as.integer, 0);
+  evaluator_result_free(&r);
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(mul_tests, factorial_stays_exact) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+
+  parser_t p = { 0 };
+  parse_result_t pr = setup_input("(define fact (lambda (n) (if (= n 0) 1 (* n (fact (- n 1))))))"
+                                  " (list (number->string (fact 30))"
+                                  "       (mod (fact 30) 1000000007)"
+                                  "       (= (/ (fact 30) 1) (fact 30))"
+                                  "       (- (fact 21) (fact 21)))",
+                                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *l = r.result;
+  cr_assert_str_eq(l->as.cons.car->as.string.ptr, "265252859812191058636308480000000");
+  l = l->as.cons.cdr;
+  cr_assert_eq(l->as.cons.car->type, L_INT);
+  cr_assert_eq(l->as.cons.car->as.integer, 109361473);
+  l = l->as.cons.cdr;
+  cr_assert(l->as.cons.car->as.boolean, "a double within rounding compares equal");
+  l = l->as.cons.cdr;
+  cr_assert_eq(l->as.cons.car->type, L_INT, "results that fit are demoted to integers");
+  cr_assert_eq(l->as.cons.car->as.integer, 0);
+  evaluator_result_free(&r);
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
 Test(mod_tests, mod_zero_divisor_errors) {
   symbol_intern_init();
   env_t env;
@@ -652,8 +845,8 @@ Test(min_max_tests, min_single_number) {
   parse_result_t pr = setup_input("(min 5)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 5.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 5.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -673,8 +866,8 @@ Test(min_max_tests, min_multiple_numbers) {
   parse_result_t pr = setup_input("(min 5 2 8 1 9)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 1.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 1.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -694,8 +887,8 @@ Test(min_max_tests, min_negative_numbers) {
   parse_result_t pr = setup_input("(min -5 -2 -8)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, -8.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), -8.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -755,8 +948,8 @@ Test(min_max_tests, max_single_number) {
   parse_result_t pr = setup_input("(max 5)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 5.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 5.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -776,8 +969,8 @@ Test(min_max_tests, max_multiple_numbers) {
   parse_result_t pr = setup_input("(max 5 2 8 1 9)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 9.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 9.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -797,8 +990,8 @@ Test(min_max_tests, max_negative_numbers) {
   parse_result_t pr = setup_input("(max -5 -2 -8)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, -2.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), -2.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -818,8 +1011,8 @@ Test(rounding_tests, floor_positive_decimal) {
   parse_result_t pr = setup_input("(floor 3.7)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 3.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 3.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -839,8 +1032,8 @@ Test(rounding_tests, floor_negative_decimal) {
   parse_result_t pr = setup_input("(floor -3.7)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, -4.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), -4.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -860,8 +1053,8 @@ Test(rounding_tests, floor_whole_number) {
   parse_result_t pr = setup_input("(floor 5)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 5.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 5.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -921,8 +1114,8 @@ Test(rounding_tests, ceil_positive_decimal) {
   parse_result_t pr = setup_input("(ceil 3.2)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 4.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 4.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -942,8 +1135,8 @@ Test(rounding_tests, ceil_negative_decimal) {
   parse_result_t pr = setup_input("(ceil -3.2)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, -3.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), -3.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -983,8 +1176,8 @@ Test(rounding_tests, round_positive_half_up) {
   parse_result_t pr = setup_input("(round 3.5)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 4.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 4.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1004,8 +1197,8 @@ Test(rounding_tests, round_negative_half_down) {
   parse_result_t pr = setup_input("(round -3.5)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, -4.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), -4.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1025,8 +1218,8 @@ Test(rounding_tests, round_low_decimal) {
   parse_result_t pr = setup_input("(round 3.2)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 3.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 3.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1046,8 +1239,8 @@ Test(rounding_tests, trunc_positive_decimal) {
   parse_result_t pr = setup_input("(trunc 3.9)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 3.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 3.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1067,8 +1260,8 @@ Test(rounding_tests, trunc_negative_decimal) {
   parse_result_t pr = setup_input("(trunc -3.9)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, -3.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), -3.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1108,8 +1301,8 @@ Test(math_tests, exp_zero) {
   parse_result_t pr = setup_input("(exp 0)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 1.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 1.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1129,8 +1322,8 @@ Test(math_tests, exp_one) {
   parse_result_t pr = setup_input("(exp 1)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 2.718281828, 1e-6);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 2.718281828, 1e-6);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1150,8 +1343,8 @@ Test(math_tests, exp_negative) {
   parse_result_t pr = setup_input("(exp -1)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 0.367879441, 1e-6);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 0.367879441, 1e-6);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1211,8 +1404,8 @@ Test(math_tests, log_one) {
   parse_result_t pr = setup_input("(log 1)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 0.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 0.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1232,8 +1425,8 @@ Test(math_tests, log_e) {
   parse_result_t pr = setup_input("(log 2.718281828)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 1.0, 1e-6);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 1.0, 1e-6);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1253,8 +1446,8 @@ Test(math_tests, log_ten) {
   parse_result_t pr = setup_input("(log 10)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 2.302585093, 1e-6);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 2.302585093, 1e-6);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1334,8 +1527,8 @@ Test(math_tests, sqrt_perfect_squares) {
   parse_result_t pr = setup_input("(sqrt 16)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 4.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 4.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1355,8 +1548,8 @@ Test(math_tests, sqrt_zero) {
   parse_result_t pr = setup_input("(sqrt 0)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 0.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 0.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1376,8 +1569,8 @@ Test(math_tests, sqrt_decimal) {
   parse_result_t pr = setup_input("(sqrt 2)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 1.414213562, 1e-6);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 1.414213562, 1e-6);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1448,6 +1641,33 @@ Test(comparison_tests, eq_two_equal_numbers) {
   symbol_intern_free_all();
 }
 
+Test(comparison_tests, integers_compare_exactly) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+
+  parser_t p = { 0 };
+  parse_result_t pr = setup_input("(list (= 9007199254740993 9007199254740992)"
+                                  "      (< 9007199254740992 9007199254740993)"
+                                  "      (= 2 2.0))",
+                                  &p);
+  eval_result_t r = evaluate_single(pr.expressions[0], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *l = r.result;
+  cr_assert_not(l->as.cons.car->as.boolean, "doubles would round both to 2^53");
+  cr_assert(l->as.cons.cdr->as.cons.car->as.boolean);
+  cr_assert(l->as.cons.cdr->as.cons.cdr->as.cons.car->as.boolean);
+  evaluator_result_free(&r);
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
 Test(comparison_tests, eq_two_unequal_numbers) {
   symbol_intern_init();
   env_t env;
@@ -1541,7 +1761,7 @@ Test(comparison_tests, eq_non_number_error) {
   parse_result_t pr = setup_input("(= 5 #t)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_ERR);
-  cr_assert_not_null(r.error_message);
+  cr_assert_str_eq(eval_error_message(&r), "=: expected number at arg 2, got boolean");
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -2745,8 +2965,8 @@ Test(list_tests, car_gets_first_element) {
   parse_result_t pr = setup_input("(car '(1 2 3))", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 1.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 1.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -2885,8 +3105,8 @@ Test(list_tests, length_counts_elements) {
   parse_result_t pr = setup_input("(length '(1 2 3 4))", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 4.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 4.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -2906,8 +3126,8 @@ Test(list_tests, length_empty_list) {
   parse_result_t pr = setup_input("(length '())", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 0.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 0.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -3865,8 +4085,8 @@ Test(functional_builtins, apply_basic) {
     cr_log_error("Apply failed: %s", r.error_message);
   }
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 6.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 6.0, 1e-10);
   evaluator_result_free(&r);
 
   parse_result_free(&pr);
@@ -3889,8 +4109,8 @@ Test(functional_builtins, apply_with_fixed_args) {
 
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 16.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 16.0, 1e-10);
   evaluator_result_free(&r);
 
   parse_result_free(&pr);
@@ -3920,14 +4140,14 @@ Test(functional_builtins, apply_lambda_and_define) {
 
   eval_result_t r2 = evaluate_single(pr.expressions[1], &env);
   cr_assert_eq(r2.status, EVAL_OK);
-  cr_assert_eq(r2.result->type, L_NUM);
-  cr_assert_float_eq(r2.result->as.number, 42.0, 1e-10);
+  cr_assert(lval_is_number(r2.result));
+  cr_assert_float_eq(lval_to_double(r2.result), 42.0, 1e-10);
   evaluator_result_free(&r2);
 
   eval_result_t r3 = evaluate_single(pr.expressions[2], &env);
   cr_assert_eq(r3.status, EVAL_OK);
-  cr_assert_eq(r3.result->type, L_NUM);
-  cr_assert_float_eq(r3.result->as.number, 14.0, 1e-10);
+  cr_assert(lval_is_number(r3.result));
+  cr_assert_float_eq(lval_to_double(r3.result), 14.0, 1e-10);
   evaluator_result_free(&r3);
 
   parse_result_free(&pr);
@@ -4105,8 +4325,8 @@ Test(functional_builtins, apply_mixed_fixed_and_list) {
   parse_result_t pr = setup_input("(apply + 10 '(1 2 3))", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 16.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 16.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -4126,8 +4346,8 @@ Test(functional_builtins, reduce_sum_no_init) {
   parse_result_t pr = setup_input("(reduce + '(1 2 3 4))", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 10.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 10.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -4147,8 +4367,8 @@ Test(functional_builtins, reduce_sum_with_init) {
   parse_result_t pr = setup_input("(reduce + 10 '(1 2 3))", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 16.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 16.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -4168,8 +4388,8 @@ Test(functional_builtins, reduce_empty_with_init_returns_init) {
   parse_result_t pr = setup_input("(reduce * 2 '())", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 2.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 2.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -4189,8 +4409,8 @@ Test(functional_builtins, reduce_single_element_no_init) {
   parse_result_t pr = setup_input("(reduce + '(42))", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 42.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 42.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -4237,10 +4457,10 @@ Test(functional_builtins, foldl_vs_foldr_subtraction) {
   cr_assert_eq(r.result->type, L_CONS);
   lval_t *a = r.result->as.cons.car;
   lval_t *b = r.result->as.cons.cdr->as.cons.car;
-  cr_assert_eq(a->type, L_NUM);
-  cr_assert_eq(b->type, L_NUM);
-  cr_assert_float_eq(a->as.number, -6.0, 1e-10);
-  cr_assert_float_eq(b->as.number, 2.0, 1e-10);
+  cr_assert(lval_is_number(a));
+  cr_assert(lval_is_number(b));
+  cr_assert_float_eq(lval_to_double(a), -6.0, 1e-10);
+  cr_assert_float_eq(lval_to_double(b), 2.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -4438,7 +4658,7 @@ Test(functional_builtins, builtin_error_correctly_formats) {
   parse_result_t pr = setup_input("(error \"manually thrown error\n\")", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_ERR);
-  cr_assert_str_eq(r.error_message, "error: manually thrown error\n");
+  cr_assert_str_eq(eval_error_message(&r), "error: manually thrown error\n");
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -4596,12 +4816,12 @@ Test(misc_builtins, eval_simple_forms) {
   lval_t *a = r.result->as.cons.car;
   lval_t *b = r.result->as.cons.cdr->as.cons.car;
   lval_t *c = r.result->as.cons.cdr->as.cons.cdr->as.cons.car;
-  cr_assert_eq(a->type, L_NUM);
-  cr_assert_float_eq(a->as.number, 41.0, 1e-10);
-  cr_assert_eq(b->type, L_NUM);
-  cr_assert_float_eq(b->as.number, 6.0, 1e-10);
-  cr_assert_eq(c->type, L_NUM);
-  cr_assert_float_eq(c->as.number, 49.0, 1e-10);
+  cr_assert(lval_is_number(a));
+  cr_assert_float_eq(lval_to_double(a), 41.0, 1e-10);
+  cr_assert(lval_is_number(b));
+  cr_assert_float_eq(lval_to_double(b), 6.0, 1e-10);
+  cr_assert(lval_is_number(c));
+  cr_assert_float_eq(lval_to_double(c), 49.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -4640,8 +4860,8 @@ Test(evaluator_api, evaluate_multiple_runs_and_returns_last) {
   parse_result_t pr = setup_input("(define x 5) (+ x 3)", &p);
   eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 8.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 8.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -4680,8 +4900,8 @@ Test(misc_builtins, load_defines_and_returns_last) {
   parse_result_t pr = setup_input(form, &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 144.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 144.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -4737,3 +4957,437 @@ Test(misc_builtins, load_parse_error_propagates) {
   free(path);
   symbol_intern_free_all();
 }
+
+Test(stream_builtins, pipelines_force_only_what_they_use) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+
+  parser_t p = { 0 };
+  parse_result_t pr =
+      setup_input("(define forced 0)"
+                  "(define ints (lambda (a)"
+                  "  (set forced a)"
+                  "  (stream-cons a (ints (+ a 1)))))"
+                  "(define s (stream-take 3 (stream-filter (lambda (x) (= (mod x 2) 0))"
+                  "                                        (stream-map (lambda (x) (* x x)) (ints 1)))))"
+                  "(list (stream->list s) forced (stream-car (stream-cdr s))"
+                  "      (stream->list (stream-map (lambda (x) (+ x 1)) '(1 2)) 1))",
+                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *squares = r.result->as.cons.car;
+  cr_assert(is_num(squares->as.cons.car, 4.0));
+  cr_assert(is_num(squares->as.cons.cdr->as.cons.car, 16.0));
+  cr_assert(is_num(squares->as.cons.cdr->as.cons.cdr->as.cons.car, 36.0));
+  lval_t *rest = r.result->as.cons.cdr;
+  cr_assert(is_num(rest->as.cons.car, 6.0), "the source is forced up to the last element taken");
+  cr_assert(is_num(rest->as.cons.cdr->as.cons.car, 16.0));
+  lval_t *mapped = rest->as.cons.cdr->as.cons.cdr->as.cons.car;
+  cr_assert(is_num(mapped->as.cons.car, 2.0), "plain lists are streams");
+  cr_assert_eq(mapped->as.cons.cdr->type, L_NIL);
+
+  evaluator_result_free(&r);
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(stream_builtins, stream_fold_runs_in_constant_memory) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+
+  parser_t p = { 0 };
+  parse_result_t pr = setup_input("(define ints (lambda (a b)"
+                                  "  (if (> a b) '() (stream-cons a (ints (+ a 1) b)))))"
+                                  "(stream-fold (lambda (acc x) (+ acc x)) 0"
+                                  "  (stream-map (lambda (x) (* 2 x)) (ints 1 100000)))",
+                                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count - 1, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  // Each element takes a handful of objects; a materialized stream would
+  // keep them all.
+  gc_set_trigger(2000);
+  fold_expression(pr.expressions[pr.count - 1], &env);
+  r = evaluate_single(pr.expressions[pr.count - 1], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert(is_num(r.result, 10000100000.0));
+  cr_assert_lt(gc_object_count(), 20000);
+
+  evaluator_result_free(&r);
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(stream_builtins, held_streams_survive_collection) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+
+  // Marking a forced stream of this length must not recurse per element.
+  parser_t p = { 0 };
+  parse_result_t pr = setup_input("(define nat (lambda (n) (stream-cons n (nat (+ n 1)))))"
+                                  "(define s (nat 0))"
+                                  "(stream-fold (lambda (a x) (+ a 1)) 0 (stream-take 300000 s))"
+                                  "(length (stream->list (stream-take 200000 (nat 0))))"
+                                  "(stream-car (stream-cdr s))",
+                                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, 3, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert(is_num(r.result, 300000.0));
+  gc_collect(NULL);
+  r = evaluate_single(pr.expressions[3], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert(is_num(r.result, 200000.0));
+  r = evaluate_single(pr.expressions[4], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert(is_num(r.result, 1.0));
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(stream_builtins, stream_errors) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+
+  const char *const sources[] = {
+    "(stream-car '())",
+    "(stream-map car 5)",
+    "(stream-filter (lambda (x) 1) '(1))",
+    "(stream-take 1.5 '(1))",
+  };
+  for (size_t i = 0; i < sizeof sources / sizeof sources[0]; i++) {
+    parser_t p = { 0 };
+    parse_result_t pr = setup_input(sources[i], &p);
+    eval_result_t r = evaluate_single(pr.expressions[0], &env);
+    cr_assert_eq(r.status, EVAL_ERR, "%s", sources[i]);
+    evaluator_result_free(&r);
+    parse_result_free(&pr);
+    parser_free(&p);
+  }
+
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(bench_builtin, bench_reports_ordered_times_and_allocations) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr = setup_input("(bench (lambda () (cons 1 2)) 25)", &p);
+  eval_result_t r = evaluate_single(pr.expressions[0], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  const char *keys[] = { "min", "median", "p99", "allocations" };
+  double values[4];
+  lval_t *v = r.result;
+  for (size_t i = 0; i < 4; i++) {
+    cr_assert_eq(v->type, L_CONS);
+    cr_assert_eq(v->as.cons.car->type, L_SYMBOL);
+    cr_assert_str_eq(v->as.cons.car->as.symbol.name, keys[i]);
+    v = v->as.cons.cdr;
+    cr_assert(v->type == L_CONS && lval_is_number(v->as.cons.car));
+    values[i] = lval_to_double(v->as.cons.car);
+    v = v->as.cons.cdr;
+  }
+  cr_assert_eq(v->type, L_NIL);
+  cr_assert(0 <= values[0] && values[0] <= values[1] && values[1] <= values[2]);
+  cr_assert(values[3] >= 1, "each call allocates at least the pair");
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  pr = setup_input("(bench (lambda () (car 5)) 3)", &p);
+  r = evaluate_single(pr.expressions[0], &env);
+  cr_assert_eq(r.status, EVAL_ERR);
+  evaluator_result_free(&r);
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(vector_builtins, vectors_index_and_update_in_place) {
+  env_t env;
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr;
+  eval_result_t r = run_program("(define v (make-vector 3 0))"
+                                "(define alias (car (list v)))"
+                                "(vector-set! alias 1 'x)"
+                                "(vector-set! v 2 (vector 5))"
+                                "(list (vector-length v) (vector-ref v 0) (vector-ref v 1)"
+                                "      (vector-ref (vector-ref v 2) 0) (vector? v) (vector? '(1)))",
+                                &env, &p, &pr);
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *v = r.result;
+  cr_assert(is_num(v->as.cons.car, 3));
+  v = v->as.cons.cdr;
+  cr_assert(is_num(v->as.cons.car, 0));
+  v = v->as.cons.cdr;
+  cr_assert_eq(v->as.cons.car->type, L_SYMBOL);
+  cr_assert_str_eq(v->as.cons.car->as.symbol.name, "x", "lists share vectors, not copies");
+  v = v->as.cons.cdr;
+  cr_assert(is_num(v->as.cons.car, 5));
+  v = v->as.cons.cdr;
+  cr_assert(v->as.cons.car->as.boolean);
+  cr_assert_not(v->as.cons.cdr->as.cons.car->as.boolean);
+  end_program(&env, &p, &pr);
+}
+
+Test(vector_builtins, vectors_convert_map_fill_and_compare) {
+  env_t env;
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr;
+  eval_result_t r = run_program("(define v (list->vector '(1 2 3)))"
+                                "(define squares (vector-map (lambda (x) (* x x)) v))"
+                                "(list (vector->list squares)"
+                                "      (equal squares (vector 1 4 9)) (equal v squares)"
+                                "      (eq v v) (eq v (vector 1 2 3))"
+                                "      (vector->list (vector-fill! (make-vector 2) 'z)))",
+                                &env, &p, &pr);
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *v = r.result;
+  lval_t *list = v->as.cons.car;
+  for (int i = 1; i <= 3; i++, list = list->as.cons.cdr) cr_assert(is_num(list->as.cons.car, i * i));
+  cr_assert_eq(list->type, L_NIL);
+  bool expected[] = { true, false, true, false };
+  for (size_t i = 0; i < 4; i++) {
+    v = v->as.cons.cdr;
+    cr_assert_eq(v->as.cons.car->as.boolean, expected[i], "comparison %zu", i);
+  }
+  lval_t *filled = v->as.cons.cdr->as.cons.car;
+  cr_assert_str_eq(filled->as.cons.car->as.symbol.name, "z");
+  cr_assert_str_eq(filled->as.cons.cdr->as.cons.car->as.symbol.name, "z");
+  end_program(&env, &p, &pr);
+}
+
+Test(vector_builtins, vector_errors_name_the_offending_value) {
+  env_t env;
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr;
+  eval_result_t r = run_program("(define v (vector 1 2))"
+                                "(list (try (vector-ref v 2) (catch e (error-message e)))"
+                                "      (try (vector-set! '(1) 0 0) (catch e (error-message e)))"
+                                "      (try (make-vector -1) (catch e (error-kind e)))"
+                                "      (try (make-vector 2305843009213693952)"
+                                "           (catch e (error-message e))))",
+                                &env, &p, &pr);
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *v = r.result;
+  cr_assert_str_eq(v->as.cons.car->as.string.ptr, "vector-ref: index out of range: 2");
+  v = v->as.cons.cdr;
+  cr_assert_str_eq(v->as.cons.car->as.string.ptr, "vector-set!: expected a vector, got cons");
+  v = v->as.cons.cdr;
+  cr_assert_str_eq(v->as.cons.car->as.symbol.name, "value");
+  cr_assert_str_eq(v->as.cons.cdr->as.cons.car->as.string.ptr,
+                   "make-vector: cannot allocate a vector of size: 2305843009213693952",
+                   "a size whose bytes overflow is refused");
+  end_program(&env, &p, &pr);
+}
+
+Test(hash_table_builtins, equal_tables_match_keys_by_structure) {
+  env_t env;
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr;
+  eval_result_t r = run_program("(define t (make-hash-table))"
+                                "(hash-set! t 'a 1)"
+                                "(hash-set! t \"key\" 2)"
+                                "(hash-set! t '(1 (2 . 3)) 3)"
+                                "(hash-set! t (vector 1.5 'x) 4)"
+                                "(hash-set! t 'a 5)"
+                                "(hash-remove! t 'missing)"
+                                "(list (hash-ref t 'a) (hash-ref t (string-append \"k\" \"ey\"))"
+                                "      (hash-ref t (list 1 (cons 2 3)))"
+                                "      (hash-ref t (vector 1.5 'x))"
+                                "      (hash-ref t 1 'none) (hash-count t) (hash-table? t))",
+                                &env, &p, &pr);
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *v = r.result;
+  int expected[] = { 5, 2, 3, 4 };
+  for (size_t i = 0; i < 4; i++, v = v->as.cons.cdr) {
+    cr_assert(is_num(v->as.cons.car, expected[i]), "lookup %zu", i);
+  }
+  cr_assert_str_eq(v->as.cons.car->as.symbol.name, "none");
+  v = v->as.cons.cdr;
+  cr_assert(is_num(v->as.cons.car, 4));
+  cr_assert(v->as.cons.cdr->as.cons.car->as.boolean);
+  end_program(&env, &p, &pr);
+}
+
+Test(hash_table_builtins, eq_tables_match_strings_by_identity) {
+  env_t env;
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr;
+  eval_result_t r = run_program("(define t (make-hash-table 'eq))"
+                                "(define s (vector \"key\"))"
+                                "(hash-set! t (vector-ref s 0) 1)"
+                                "(hash-set! t 2 'two)"
+                                "(list (hash-ref t (vector-ref s 0) 'none)"
+                                "      (hash-ref t \"key\" 'none)"
+                                "      (hash-ref t 2) (hash-count (hash-remove! t 2)))",
+                                &env, &p, &pr);
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *v = r.result;
+  cr_assert(is_num(v->as.cons.car, 1));
+  v = v->as.cons.cdr;
+  cr_assert_str_eq(v->as.cons.car->as.symbol.name, "none");
+  v = v->as.cons.cdr;
+  cr_assert_str_eq(v->as.cons.car->as.symbol.name, "two");
+  cr_assert(is_num(v->as.cons.cdr->as.cons.car, 1));
+  end_program(&env, &p, &pr);
+}
+
+Test(hash_table_builtins, tables_survive_collection_and_iterate) {
+  env_t env;
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr;
+  eval_result_t r = run_program("(define t (make-hash-table))"
+                                "(define fill (lambda (i)"
+                                "  (if (< i 500)"
+                                "      (begin (hash-set! t (list i) (number->string i))"
+                                "             (fill (+ i 1))))))"
+                                "(fill 0)"
+                                "(define sum 0)"
+                                "(hash-for-each t (lambda (k v) (set sum (+ sum (car k)))))"
+                                "(list sum (hash-ref t '(499)) (length (hash-keys t))"
+                                "      (try (hash-ref t '(500)) (catch e (error-message e))))",
+                                &env, &p, &pr);
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *v = r.result;
+  cr_assert(is_num(v->as.cons.car, 499 * 500 / 2));
+  v = v->as.cons.cdr;
+  cr_assert_str_eq(v->as.cons.car->as.string.ptr, "499");
+  v = v->as.cons.cdr;
+  cr_assert(is_num(v->as.cons.car, 500));
+  cr_assert_str_eq(v->as.cons.cdr->as.cons.car->as.string.ptr,
+                   "hash-ref: key not found: (500 . nil)");
+  cr_assert_gt(gc_collection_count(), 0, "the table was traced by a collection");
+  end_program(&env, &p, &pr);
+}
+
+Test(hash_table_builtins, for_each_names_its_function_argument) {
+  env_t env;
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr;
+  eval_result_t r = run_program("(list (try (hash-for-each (make-hash-table) 5)"
+                                "           (catch e (error-message e)))"
+                                "      (try (vector-map 5 (vector 1)) (catch e (error-message e))))",
+                                &env, &p, &pr);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert_str_eq(r.result->as.cons.car->as.string.ptr,
+                   "hash-for-each: second argument must be a function or symbol");
+  cr_assert_str_eq(r.result->as.cons.cdr->as.cons.car->as.string.ptr,
+                   "vector-map: first argument must be a function or symbol");
+  end_program(&env, &p, &pr);
+}
+
+Test(hash_table_builtins, removed_keys_stay_removed_under_churn) {
+  env_t env;
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr;
+  // Counts the removes after which hash-ref still finds the key.
+  eval_result_t r =
+      run_program("(define churn (lambda (h)"
+                  "  (let loop ((i 0) (seed 1) (bad 0))"
+                  "    (if (= i 200000)"
+                  "        bad"
+                  "        (let* ((s (mod (+ (* seed 48271) 11) 2147483647)) (k (mod s 97)))"
+                  "          (if (< (mod s 5) 2)"
+                  "              (begin (hash-set! h k i) (loop (+ i 1) s bad))"
+                  "              (begin (hash-remove! h k)"
+                  "                     (loop (+ i 1) s"
+                  "                           (if (= (hash-ref h k -1) -1) bad (+ bad 1))))))))))"
+                  "(list (churn (make-hash-table)) (churn (make-hash-table 'eq)))",
+                  &env, &p, &pr);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert(is_num(r.result->as.cons.car, 0));
+  cr_assert(is_num(r.result->as.cons.cdr->as.cons.car, 0), "eq table");
+  end_program(&env, &p, &pr);
+}
+
+Test(f64vector_builtins, f64vectors_compute_and_convert) {
+  env_t env;
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr;
+  eval_result_t r = run_program("(define a (list->f64vector '(1 2 3 4)))"
+                                "(define b (vector->f64vector (vector 0.5 1 1.5 2)))"
+                                "(f64vector-set! a 3 -4)"
+                                "(list (f64vector-sum a) (f64vector-dot a b) (f64vector-min a)"
+                                "      (f64vector-max (f64vector-add a b))"
+                                "      (f64vector->list (f64vector-scale (f64vector-mul a b) 2))"
+                                "      (f64vector-ref (f64vector-map (lambda (x) (* x 10)) a) 1)"
+                                "      (equal a (f64vector 1 2 3 -4)) (f64vector-length b))",
+                                &env, &p, &pr);
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *v = r.result;
+  double expected[] = { 2, 0.5 + 2 + 4.5 - 8, -4, 4.5 };
+  for (size_t i = 0; i < 4; i++, v = v->as.cons.cdr) {
+    cr_assert(is_num(v->as.cons.car, expected[i]), "result %zu", i);
+  }
+  lval_t *list = v->as.cons.car;
+  double products[] = { 1, 4, 9, -16 };
+  for (size_t i = 0; i < 4; i++, list = list->as.cons.cdr) {
+    cr_assert(is_num(list->as.cons.car, products[i]), "product %zu", i);
+  }
+  v = v->as.cons.cdr;
+  cr_assert(is_num(v->as.cons.car, 20));
+  v = v->as.cons.cdr;
+  cr_assert(v->as.cons.car->as.boolean);
+  cr_assert(is_num(v->as.cons.cdr->as.cons.car, 4));
+  end_program(&env, &p, &pr);
+}
+
+Test(f64vector_builtins, f64vector_errors_name_the_offending_value) {
+  env_t env;
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr;
+  eval_result_t r = run_program("(define a (make-f64vector 2 1))"
+                                "(list (try (f64vector-ref a 2) (catch e (error-message e)))"
+                                "      (try (list->f64vector '(1 x)) (catch e (error-message e)))"
+                                "      (try (f64vector-dot a (f64vector 1))"
+                                "        (catch e (error-message e)))"
+                                "      (try (f64vector-min (f64vector))"
+                                "        (catch e (error-message e)))"
+                                "      (try (make-f64vector 2305843009213693952)"
+                                "        (catch e (error-message e))))",
+                                &env, &p, &pr);
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *v = r.result;
+  const char *expected[] = { "f64vector-ref: index out of range: 2",
+                             "list->f64vector: expected numbers, got symbol",
+                             "f64vector-dot: lengths differ: 2 and 1",
+                             "f64vector-min: empty f64vector",
+                             "make-f64vector: cannot allocate a vector of size: "
+                             "2305843009213693952" };
+  for (size_t i = 0; i < 5; i++, v = v->as.cons.cdr) {
+    cr_assert_str_eq(v->as.cons.car->as.string.ptr, expected[i]);
+  }
+  end_program(&env, &p, &pr);
+}
@@ -0,0 +1,66 @@
+#include "eval_fixture.h"
+#include "emit_c.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Returns the C program emitted for `src`; the caller frees it.
+static char *emit(const char *src) {
+  lexer_t lexer = lexer_new(src);
+  parser = parser_new(&lexer);
+  pr = parser_parse(&parser);
+  cr_assert_eq(parser.error_count, 0, "Parser should have no errors");
+
+  char *buf = NULL;
+  size_t len = 0;
+  FILE *out = open_memstream(&buf, &len);
+  cr_assert_not_null(out);
+  cr_assert(emit_c_program(pr.expressions, pr.count, out));
+  fclose(out);
+  return buf;
+}
+
+Test(emit_c_tests, known_functions_are_called_directly, .init = eval_setup, .fini = eval_teardown) {
+  char *c = emit("(define fib (lambda (n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))"
+                 "(fib 20)");
+  cr_assert_not_null(strstr(c, "static eval_result_t fn_0(lval_t **args)"));
+  cr_assert_not_null(strstr(c, "r = fn_0(&t["), "recursive calls should be direct");
+  cr_assert_not_null(strstr(c, "lval_native((void *)native_0, sym["));
+  cr_assert_not_null(strstr(c, "lookup_builtin(\"<\")"), "builtins should be bound at startup");
+  cr_assert_null(strstr(c, "evaluate_call"));
+  cr_assert_null(strstr(c, "evaluate_single"), "nothing should be left to interpret");
+  free(c);
+}
+
+Test(emit_c_tests, rebound_names_are_looked_up_at_run_time, .init = eval_setup,
+     .fini = eval_teardown) {
+  char *c = emit("(define f (lambda (x) (+ x 1)))"
+                 "(define + -)"
+                 "(set f (lambda (x) x))"
+                 "(f 1)");
+  cr_assert_null(strstr(c, "fn_0"), "a function that is set must not be compiled");
+  cr_assert_null(strstr(c, "lookup_builtin(\"+\")"), "+ is redefined by the program");
+  cr_assert_not_null(strstr(c, "evaluate_call"));
+  free(c);
+}
+
+Test(emit_c_tests, eval_makes_every_call_dynamic, .init = eval_setup, .fini = eval_teardown) {
+  char *c = emit("(define f (lambda (x) (+ x 1)))"
+                 "(eval '(f 1))");
+  cr_assert_not_null(strstr(c, "static eval_result_t fn_0"));
+  cr_assert_null(strstr(c, "r = fn_0(&t["));
+  cr_assert_null(strstr(c, "lookup_builtin"));
+  free(c);
+}
+
+Test(emit_c_tests, unsupported_forms_are_rebuilt_and_interpreted, .init = eval_setup,
+     .fini = eval_teardown) {
+  char *c = emit("(defmacro unless (c a b) `(if (not ,c) ,a ,b))"
+                 "(define adder (lambda (k) (lambda (x) (+ x k))))"
+                 "(unless #f 1 2)");
+  cr_assert_not_null(strstr(c, "ast[0] = list_node(NULL, 4, sym_node(sym["));
+  cr_assert_not_null(strstr(c, "r = evaluate_single(ast[2], global);"));
+  cr_assert_null(strstr(c, "fn_0"), "nested lambdas are not compiled");
+  cr_assert_null(strstr(c, "parser_parse"), "the program must not be parsed at startup");
+  free(c);
+}
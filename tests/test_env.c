@@ -1,5 +1,6 @@
 #include "env.h"
 #include "lval.h"
+#include "symbol.h"
 #include <criterion/criterion.h>
 
 Test(env_tests, initializes_env) {
@@ -97,3 +98,73 @@ Test(env_tests, set_fails_when_unbound_anywhere) {
   env_destroy(&env);
   lval_free(v);
 }
+
+Test(env_tests, symbol_and_string_keys_agree) {
+  env_t parent, child;
+  cr_assert(env_init(&parent, NULL));
+  cr_assert(env_init(&child, &parent));
+  lval_t *v = lval_num(5);
+  lval_t *w = lval_num(6);
+
+  const char *sym = symbol_intern("k");
+  cr_assert(env_define_symbol(&parent, sym, v));
+  cr_assert(env_get(&child, "k") == v, "string lookup should see symbol definitions");
+  cr_assert(env_set(&child, "k", w));
+  cr_assert(env_get_symbol(&child, sym) == w, "symbol lookup should see string updates");
+
+  env_destroy(&child);
+  env_destroy(&parent);
+  lval_free(v);
+  lval_free(w);
+  symbol_intern_free_all();
+}
+
+Test(env_tests, cached_lookup_follows_global_redefinition) {
+  env_t global, frame;
+  cr_assert(env_init(&global, NULL));
+  cr_assert(env_init(&frame, &global));
+  lval_t *v = lval_num(1);
+  lval_t *w = lval_num(2);
+  call_cache_t cache = { 0 };
+
+  const char *sym = symbol_intern("g");
+  cr_assert(env_define_symbol(&global, sym, v));
+  cr_assert(env_get_cached(&frame, sym, &cache) == v);
+  cr_assert(env_get_cached(&frame, sym, &cache) == v, "a hit should return the cached binding");
+  cr_assert(env_set(&global, "g", w));
+  cr_assert(env_get_cached(&frame, sym, &cache) == w, "set should invalidate the cache");
+
+  cr_assert(env_define_symbol(&frame, sym, v));
+  cr_assert(env_get_cached(&frame, sym, &cache) == v, "a local binding should shadow the cache");
+
+  env_destroy(&frame);
+  env_destroy(&global);
+  lval_free(v);
+  lval_free(w);
+  symbol_intern_free_all();
+}
+
+Test(env_tests, first_root_env_binds_through_symbol_cells) {
+  env_t global, other;
+  cr_assert(env_init(&global, NULL));
+  cr_assert(env_init(&other, NULL));
+  cr_assert(env_is_global(&global));
+  cr_assert_not(env_is_global(&other));
+  lval_t *v = lval_num(1);
+  lval_t *w = lval_num(2);
+
+  const char *sym = symbol_intern("cell");
+  cr_assert(env_define_symbol(&global, sym, v));
+  cr_assert(env_define_symbol(&other, sym, w));
+  cr_assert(symbol_of(sym)->global == v, "global definitions should land in the symbol cell");
+  cr_assert(env_get_symbol(&other, sym) == w, "other roots should keep their own bindings");
+  cr_assert(env_set_symbol(&global, sym, w));
+  cr_assert(env_get(&global, "cell") == w);
+
+  env_destroy(&global);
+  cr_assert_null(symbol_of(sym)->global, "destroying the global env should clear its cells");
+  env_destroy(&other);
+  lval_free(v);
+  lval_free(w);
+  symbol_intern_free_all();
+}
@@ -33,8 +33,8 @@ Test(evaluator_tests, evaluate_number_atom) {
 
   cr_assert_eq(res.status, EVAL_OK);
   cr_assert_not_null(res.result);
-  cr_assert_eq(res.result->type, L_NUM);
-  cr_assert(fabs(res.result->as.number - 42.0) < 1e-9);
+  cr_assert(lval_is_number(res.result));
+  cr_assert(fabs(lval_to_double(res.result) - 42.0) < 1e-9);
 
   evaluator_result_free(&res);
   parse_result_free(&pr);
@@ -123,8 +123,8 @@ Test(evaluator_tests, evaluate_predefined_symbol) {
 
   cr_assert_eq(res.status, EVAL_OK);
   cr_assert_not_null(res.result);
-  cr_assert_eq(res.result->type, L_NUM);
-  cr_assert(fabs(res.result->as.number - 42.0) < 1e-9);
+  cr_assert(lval_is_number(res.result));
+  cr_assert(fabs(lval_to_double(res.result) - 42.0) < 1e-9);
 
   evaluator_result_free(&res);
   parse_result_free(&pr);
@@ -175,8 +175,8 @@ Test(evaluator_tests, evaluate_symbol_env_chain_and_shadowing) {
     parse_result_t pr = setup_input("x", &p);
     eval_result_t r = evaluate_single(pr.expressions[0], &child);
     cr_assert_eq(r.status, EVAL_OK);
-    cr_assert_eq(r.result->type, L_NUM);
-    cr_assert(fabs(r.result->as.number - 1.0) < 1e-9);
+    cr_assert(lval_is_number(r.result));
+    cr_assert(fabs(lval_to_double(r.result) - 1.0) < 1e-9);
     evaluator_result_free(&r);
     parse_result_free(&pr);
     parser_free(&p);
@@ -190,8 +190,8 @@ Test(evaluator_tests, evaluate_symbol_env_chain_and_shadowing) {
     parse_result_t pr = setup_input("x", &p);
     eval_result_t r = evaluate_single(pr.expressions[0], &child);
     cr_assert_eq(r.status, EVAL_OK);
-    cr_assert_eq(r.result->type, L_NUM);
-    cr_assert(fabs(r.result->as.number - 2.0) < 1e-9);
+    cr_assert(lval_is_number(r.result));
+    cr_assert(fabs(lval_to_double(r.result) - 2.0) < 1e-9);
     evaluator_result_free(&r);
     parse_result_free(&pr);
     parser_free(&p);
@@ -220,10 +220,10 @@ Test(evaluator_tests, evaluate_literal_allocates_fresh_lval_each_time) {
   cr_assert_eq(r1.status, EVAL_OK);
   cr_assert_eq(r2.status, EVAL_OK);
   cr_assert_neq(r1.result, r2.result, "Expected distinct lval allocations per eval()");
-  cr_assert_eq(r1.result->type, L_NUM);
-  cr_assert_eq(r2.result->type, L_NUM);
-  cr_assert(fabs(r1.result->as.number - 7.0) < 1e-9);
-  cr_assert(fabs(r2.result->as.number - 7.0) < 1e-9);
+  cr_assert(lval_is_number(r1.result));
+  cr_assert(lval_is_number(r2.result));
+  cr_assert(fabs(lval_to_double(r1.result) - 7.0) < 1e-9);
+  cr_assert(fabs(lval_to_double(r2.result) - 7.0) < 1e-9);
 
   evaluator_result_free(&r1);
   evaluator_result_free(&r2);
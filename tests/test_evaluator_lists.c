@@ -25,7 +25,7 @@ static parse_result_t setup_input(const char *input, parser_t *out_parser) {
 }
 
 static bool is_num(const lval_t *v, double x) {
-  return v && v->type == L_NUM && fabs(v->as.number - x) < 1e-9;
+  return v && lval_is_number(v) && fabs(lval_to_double(v) - x) < 1e-9;
 }
 
 Test(evaluator_test, evaluate_empty_list) {
@@ -127,7 +127,7 @@ Test(evaluator_lists, head_is_list_errors) {
 
   cr_assert_eq(res.status, EVAL_ERR);
   cr_assert_not_null(res.error_message);
-  cr_assert(strstr(res.error_message, "Unknown function") != NULL);
+  cr_assert_str_eq(eval_error_message(&res), "Unbound symbol: meow-fn");
 
   evaluator_result_free(&res);
   parse_result_free(&pr);
@@ -371,3 +371,41 @@ Test(evaluator_lists, evaluates_user_defined_functions_three_level_closure) {
   env_destroy(&env);
   symbol_intern_free_all();
 }
+
+Test(evaluator_lists, recursion_survives_collection_on_every_allocation) {
+  symbol_intern_init();
+
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  gc_set_trigger(1);
+
+  parser_t parser = { 0 };
+  parse_result_t pr = setup_input("(define fib (lambda (n)"
+                                  "  (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))"
+                                  " (fib 12)"
+                                  " (foldr + 0 (map (lambda (x) (* x x)) (list 1 2 3 4)))",
+                                  &parser);
+
+  eval_result_t r0 = evaluate_single(pr.expressions[0], &env);
+  cr_assert_eq(r0.status, EVAL_OK);
+  evaluator_result_free(&r0);
+
+  eval_result_t r1 = evaluate_single(pr.expressions[1], &env);
+  cr_assert_eq(r1.status, EVAL_OK);
+  cr_assert(is_num(r1.result, 144.0));
+  evaluator_result_free(&r1);
+
+  eval_result_t r2 = evaluate_single(pr.expressions[2], &env);
+  cr_assert_eq(r2.status, EVAL_OK);
+  cr_assert(is_num(r2.result, 30.0));
+  evaluator_result_free(&r2);
+
+  parse_result_free(&pr);
+  parser_free(&parser);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
@@ -0,0 +1,106 @@
+#include "f64vec.h"
+#include <criterion/criterion.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *k_kernels[] = { "avx2", "sse2", "scalar" };
+
+// Values of mixed magnitude, so that summing them in another order would
+// change the last bits.
+static double *random_doubles(size_t n, uint64_t seed) {
+  double *a = f64_alloc(n);
+  for (size_t i = 0; i < n; i++) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    a[i] = (double)(seed % 2000001) / 1000.0 - 1000.0;
+    if (i % 7 == 0) a[i] *= 1e9;
+  }
+  return a;
+}
+
+Test(f64vec_tests, it_picks_kernels_the_cpu_supports) {
+  const char *best = f64_kernels();
+  cr_assert(f64_use_kernels(best));
+  cr_assert(f64_use_kernels("scalar"));
+  cr_assert_str_eq(f64_kernels(), "scalar");
+  cr_assert_not(f64_use_kernels("avx512"));
+  cr_assert(f64_use_kernels(best));
+}
+
+Test(f64vec_tests, reductions_agree_bit_for_bit_across_kernels) {
+  // Lengths around the 16-element blocks, with and without a tail.
+  size_t lengths[] = { 1, 3, 15, 16, 17, 33, 1000, 4099 };
+  const char *best = f64_kernels();
+  for (size_t l = 0; l < sizeof lengths / sizeof lengths[0]; l++) {
+    size_t n = lengths[l];
+    double *a = random_doubles(n, 0x9e3779b97f4a7c15ULL + n);
+    double *b = random_doubles(n, 0x2545f4914f6cdd1dULL + n);
+    double expected[4];
+    bool first = true;
+    for (size_t k = 0; k < sizeof k_kernels / sizeof k_kernels[0]; k++) {
+      if (!f64_use_kernels(k_kernels[k])) continue;
+      double got[4] = { f64_sum(a, n), f64_dot(a, b, n), f64_min(a, n), f64_max(a, n) };
+      if (first) memcpy(expected, got, sizeof got);
+      first = false;
+      cr_assert_eq(memcmp(expected, got, sizeof got), 0, "%s kernels, n = %zu", k_kernels[k], n);
+    }
+    double lo = a[0], hi = a[0];
+    for (size_t i = 1; i < n; i++) {
+      lo = fmin(lo, a[i]);
+      hi = fmax(hi, a[i]);
+    }
+    cr_assert_eq(expected[2], lo);
+    cr_assert_eq(expected[3], hi);
+    free(a);
+    free(b);
+  }
+  f64_use_kernels(best);
+}
+
+Test(f64vec_tests, elementwise_kernels_cover_the_tail) {
+  const char *best = f64_kernels();
+  size_t n = 23;
+  double *a = f64_alloc(n), *b = f64_alloc(n), *out = f64_alloc(n);
+  for (size_t i = 0; i < n; i++) {
+    a[i] = (double)i;
+    b[i] = 2.0 * i + 1;
+  }
+  for (size_t k = 0; k < sizeof k_kernels / sizeof k_kernels[0]; k++) {
+    if (!f64_use_kernels(k_kernels[k])) continue;
+    f64_add(out, a, b, n);
+    for (size_t i = 0; i < n; i++) cr_assert_eq(out[i], 3.0 * i + 1, "%s add", k_kernels[k]);
+    f64_mul(out, a, b, n);
+    for (size_t i = 0; i < n; i++) cr_assert_eq(out[i], a[i] * b[i], "%s mul", k_kernels[k]);
+    f64_scale(out, a, -0.5, n);
+    for (size_t i = 0; i < n; i++) cr_assert_eq(out[i], -0.5 * i, "%s scale", k_kernels[k]);
+    f64_fill(out, 7.0, n);
+    for (size_t i = 0; i < n; i++) cr_assert_eq(out[i], 7.0, "%s fill", k_kernels[k]);
+    cr_assert_eq(f64_sum(a, n), 253.0);
+  }
+  cr_assert_null(f64_alloc(0));
+  cr_assert_null(f64_alloc(SIZE_MAX / sizeof(double)), "the byte count would overflow");
+  free(a);
+  free(b);
+  free(out);
+  f64_use_kernels(best);
+}
+
+Test(f64vec_tests, min_and_max_skip_nans_after_the_first_element) {
+  const char *best = f64_kernels();
+  double a[40];
+  for (size_t i = 0; i < 40; i++) a[i] = (double)i;
+  a[5] = NAN;
+  a[39] = NAN;
+  for (size_t k = 0; k < sizeof k_kernels / sizeof k_kernels[0]; k++) {
+    if (!f64_use_kernels(k_kernels[k])) continue;
+    cr_assert_eq(f64_min(a, 40), 0.0, "%s", k_kernels[k]);
+    cr_assert_eq(f64_max(a, 40), 38.0, "%s", k_kernels[k]);
+    a[0] = NAN;
+    cr_assert(isnan(f64_min(a, 40)), "%s", k_kernels[k]);
+    a[0] = 0.0;
+  }
+  f64_use_kernels(best);
+}
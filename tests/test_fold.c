@@ -0,0 +1,144 @@
+#include "eval_fixture.h"
+#include "fold.h"
+#include "lval.h"
+#include <string.h>
+
+// The body of the lambda in the first expression, (define f (lambda ...)).
+static s_expression_t *lambda_body(size_t i) {
+  return pr.expressions[0]->data.list.elements[2]->data.list.elements[2 + i];
+}
+
+static void assert_int(eval_result_t r, int64_t expected) {
+  if (r.status != EVAL_OK) cr_log_error("%s", r.error_message);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert_eq(r.result->type, L_INT);
+  cr_assert_eq(r.result->as.integer, expected);
+}
+
+Test(fold_tests, it_folds_pure_builtin_calls_on_constants, .init = eval_setup,
+     .fini = eval_teardown) {
+  eval_result_t r = run("(define f (lambda () (string-append \"a\" \"b\") (* 60 60 (+ 20 4))))"
+                        "(f)");
+  assert_int(r, 86400);
+  s_expression_t *append = lambda_body(0)->data.list.fold.expr;
+  cr_assert_not_null(append);
+  cr_assert_eq(append->data.atom.type, ATOM_STRING);
+  cr_assert_str_eq(append->data.atom.value.string, "ab");
+  s_expression_t *seconds = lambda_body(1)->data.list.fold.expr;
+  cr_assert_not_null(seconds);
+  cr_assert_eq(seconds->data.atom.type, ATOM_INTEGER);
+  cr_assert_eq(seconds->data.atom.value.integer, 86400);
+}
+
+Test(fold_tests, it_prunes_dead_branches, .init = eval_setup, .fini = eval_teardown) {
+  eval_result_t r = run("(define f (lambda (x)"
+                        "  (if (< 1 2) x (car 5))"
+                        "  (cond (#f (car 5) (= 1 1) x))))"
+                        "(f 7)");
+  assert_int(r, 7);
+  s_expression_t *branch = lambda_body(0);
+  cr_assert_eq(branch->data.list.fold.expr, branch->data.list.elements[2]);
+  s_expression_t *cond = lambda_body(1);
+  cr_assert_eq(cond->data.list.fold.expr, cond->data.list.elements[1]->data.list.elements[3]);
+}
+
+Test(fold_tests, it_leaves_calls_with_variables_and_errors_alone, .init = eval_setup,
+     .fini = eval_teardown) {
+  eval_result_t r = run("(define f (lambda (x) (+ x 1) (mod 1 0)))"
+                        "(f 1)");
+  cr_assert_eq(r.status, EVAL_ERR);
+  s_expression_t *sum = lambda_body(0)->data.list.fold.expr;
+  cr_assert(sum && sum->data.atom.type == ATOM_UNBOXED, "(+ x 1) is only unboxed");
+  cr_assert_null(lambda_body(1)->data.list.fold.expr);
+  evaluator_result_free(&r);
+}
+
+Test(fold_tests, redefining_a_builtin_invalidates_folds, .init = eval_setup,
+     .fini = eval_teardown) {
+  assert_int(run("(define f (lambda () (+ 1 2)))"
+                 "(define a (f))"
+                 "(define + -)"
+                 "(- (f) a)"),
+             -4);
+}
+
+Test(fold_tests, parameters_shadow_folded_builtins, .init = eval_setup, .fini = eval_teardown) {
+  assert_int(run("(define f (lambda (+) (+ 3 2)))"
+                 "(f *)"),
+             6);
+}
+
+Test(fold_tests, it_inlines_small_global_lambdas, .init = eval_setup, .fini = eval_teardown) {
+  assert_int(run("(define sq (lambda (x) (* x x)))"
+                 "(define f (lambda (y) (sq (+ y 1))))"
+                 "(f 2)"),
+             9);
+  s_expression_t *call = pr.expressions[1]->data.list.elements[2]->data.list.elements[2];
+  cr_assert(call->data.list.fold.inlined);
+  s_expression_t *body = call->data.list.fold.expr->data.list.elements[1];
+  cr_assert_eq(body->data.list.elements[1]->data.atom.type, ATOM_ARGUMENT);
+}
+
+Test(fold_tests, redefining_an_inlined_lambda_invalidates_folds, .init = eval_setup,
+     .fini = eval_teardown) {
+  assert_int(run("(define k 10)"
+                 "(define g (lambda (x) (+ x k)))"
+                 "(define f (lambda (y) (g y)))"
+                 "(define a (f 1))"
+                 "(set k 20)"
+                 "(define b (f 1))"
+                 "(define g (lambda (x) (- x k)))"
+                 "(+ (* 100 a) (* 10 b) (f 1))"),
+             1100 + 210 - 19);
+}
+
+Test(fold_tests, setting_a_variable_an_inlined_body_reads_keeps_folds, .init = eval_setup,
+     .fini = eval_teardown) {
+  lexer_t lexer = lexer_new("(define total 0)"
+                            "(define scaled (lambda (x) (+ x total)))"
+                            "(define f (lambda (y) (* 60 60) (scaled y)))"
+                            "(f 1)"
+                            "(set total 10)"
+                            "(f 1)");
+  parser = parser_new(&lexer);
+  pr = parser_parse(&parser);
+  assert_int(evaluate_many(pr.expressions, 4, &env), 1);
+  s_expression_t *lambda = pr.expressions[2]->data.list.elements[2];
+  s_expression_t *constant = lambda->data.list.elements[2];
+  cr_assert(lambda->data.list.elements[3]->data.list.fold.inlined);
+  size_t version = env_fold_version();
+  assert_int(evaluate_many(pr.expressions + 4, 2, &env), 11);
+  cr_assert_eq(env_fold_version(), version, "the inlined body reads total at run time");
+  cr_assert_eq(constant->data.list.fold.version, version);
+}
+
+Test(fold_tests, it_does_not_inline_recursive_lambdas, .init = eval_setup, .fini = eval_teardown) {
+  assert_int(run("(define fact (lambda (n) (if (= n 0) 1 (* n (fact (- n 1))))))"
+                 "(fact 5)"),
+             120);
+  cr_assert_not(pr.expressions[1]->data.list.fold.inlined);
+}
+
+Test(fold_tests, inlined_bodies_ignore_the_callers_bindings, .init = eval_setup,
+     .fini = eval_teardown) {
+  assert_int(run("(define k 1)"
+                 "(define g (lambda (x) (+ x k)))"
+                 "(define f (lambda (k) (g k)))"
+                 "(f 5)"),
+             6);
+}
+
+Test(fold_tests, it_prunes_and_or_and_builds_case_tables, .init = eval_setup,
+     .fini = eval_teardown) {
+  assert_int(run("(define f (lambda (x)"
+                 "  (and #t (< 1 2) (> x 0))"
+                 "  (or #f (= 1 1) (car 5))"
+                 "  (case x ((1 2) 10) ((3) 20) (else 30))))"
+                 "(f 3)"),
+             20);
+  cr_assert_null(lambda_body(0)->data.list.fold.expr, "(> x 0) decides the and");
+  s_expression_t *logic = lambda_body(1);
+  cr_assert_eq(logic->data.list.fold.expr, logic->data.list.elements[2]);
+  s_expression_t *table = lambda_body(2)->data.list.fold.expr;
+  cr_assert(table && table->data.atom.type == ATOM_DISPATCH);
+}
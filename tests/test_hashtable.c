@@ -126,3 +126,65 @@ Test(hashtable, iteration_visits_all_pairs) {
 
   ht_destroy(&t);
 }
+
+Test(hashtable, stats_report_probe_lengths_and_resizes) {
+  const size_t N = 100;
+  hashtable t;
+  ht_error err = {0};
+  cr_assert(ht_init(&t, 8, &err));
+  char keys[100][8];
+  for (size_t i = 0; i < N; ++i) {
+    sprintf(keys[i], "s%zu", i);
+    cr_assert(ht_set(&t, keys[i], NULL, &err));
+  }
+  cr_assert(ht_erase(&t, keys[0], NULL));
+  cr_assert(ht_erase(&t, keys[1], NULL));
+
+  ht_probe_stats stats;
+  ht_stats(&t, &stats);
+  cr_assert_eq(stats.size, N - 2);
+  cr_assert_eq(stats.capacity, 128);
+  cr_assert_eq(stats.resizes, 4, "8 -> 16 -> 32 -> 64 -> 128");
+  cr_assert_float_eq(stats.load_factor, (N - 2) / 128.0, 1e-12);
+  cr_assert(stats.max_dib >= 1 && stats.mean_dib >= 1 && stats.mean_dib <= stats.max_dib);
+
+  ht_destroy(&t);
+}
+
+// Erasing in the middle of a probe sequence must not hide the keys after it,
+// even once the freed slots are reused.
+Test(hashtable, erase_and_reinsert_churn_keeps_every_key_reachable) {
+  enum { KEYS = 97 };
+  hashtable t;
+  ht_error err = {0};
+  cr_assert(ht_init(&t, 8, &err));
+  char keys[KEYS][8];
+  bool present[KEYS] = {false};
+  for (size_t i = 0; i < KEYS; ++i)
+    sprintf(keys[i], "k%zu", i);
+
+  uint64_t seed = 1;
+  for (size_t i = 0; i < 200000; ++i) {
+    seed = (seed * 48271 + 11) % 2147483647;
+    size_t k = seed % KEYS;
+    if (seed % 5 < 2) {
+      cr_assert(ht_set(&t, keys[k], keys[k], &err));
+      present[k] = true;
+    } else {
+      cr_assert_eq(ht_erase(&t, keys[k], NULL), present[k], "step %zu, key %zu", i, k);
+      present[k] = false;
+      cr_assert_not(ht_get(&t, keys[k], NULL), "step %zu: key %zu survived its erase", i, k);
+    }
+  }
+  size_t live = 0;
+  for (size_t k = 0; k < KEYS; ++k) {
+    void *v = NULL;
+    cr_assert_eq(ht_get(&t, keys[k], &v), present[k], "key %zu", k);
+    if (present[k])
+      cr_assert_eq(v, keys[k]);
+    live += present[k];
+  }
+  cr_assert_eq(ht_count(&t), live);
+
+  ht_destroy(&t);
+}
@@ -0,0 +1,132 @@
+#include "eval_fixture.h"
+#include "jit.h"
+#include "lval.h"
+#include <math.h>
+#include <stdbool.h>
+
+static bool is_num(const lval_t *v, double x) {
+  return v && lval_is_number(v) && fabs(lval_to_double(v) - x) < 1e-9;
+}
+
+// The shared fixture with the JIT on. Tests call these themselves, after
+// checking that the JIT is available.
+static void jit_setup(void) {
+  eval_setup();
+  jit_set_enabled(true);
+}
+
+static void jit_teardown(void) {
+  jit_reset();
+  jit_set_enabled(false);
+  eval_teardown();
+}
+
+// Evaluates every expression in `src` and returns the last value.
+static lval_t *run_value(const char *src) {
+  eval_result_t r = run(src);
+  if (r.status != EVAL_OK) cr_log_error("%s", eval_error_message(&r));
+  cr_assert_eq(r.status, EVAL_OK);
+  return r.result;
+}
+
+Test(jit, compiles_hot_recursive_function) {
+  if (!jit_available()) return;
+  jit_setup();
+  lval_t *v = run_value("(define fib (lambda (n)"
+                        "  (if (or (= n 0) (= n 1)) n (+ (fib (- n 1)) (fib (- n 2))))))"
+                        " (fib 20)");
+  cr_assert_eq(v->type, L_INT);
+  cr_assert_eq(v->as.integer, 6765);
+  cr_assert_eq(jit_compiled_count(), 1);
+  jit_teardown();
+}
+
+Test(jit, compiles_boolean_results) {
+  if (!jit_available()) return;
+  jit_setup();
+  lval_t *v = run_value("(define even (lambda (n) (if (= n 0) #t (not (even (- n 1))))))"
+                        " (define check (lambda (n) (and (even n) (>= n 0) (<= n 100))))"
+                        " (list (even 41) (check 40) (check 40) (check 40) (check 40)"
+                        "       (check 40) (check 40) (check 40) (check 40) (check 40)"
+                        "       (check 40) (check 40) (check 40) (check 40) (check 40)"
+                        "       (check 40) (check 40) (check 40) (check 102))");
+  cr_assert_eq(v->as.cons.car->type, L_BOOL);
+  cr_assert_not(v->as.cons.car->as.boolean);
+  lval_t *last = v;
+  while (last->as.cons.cdr->type == L_CONS)
+    last = last->as.cons.cdr;
+  cr_assert_not(last->as.cons.car->as.boolean);
+  cr_assert_eq(jit_compiled_count(), 2);
+  jit_teardown();
+}
+
+Test(jit, rebinding_a_builtin_invalidates_code) {
+  if (!jit_available()) return;
+  jit_setup();
+  lval_t *v = run_value("(define sq (lambda (x) (* x x)))"
+                        " (define loop (lambda (n acc) (if (= n 0) acc (loop (- n 1) (sq n)))))"
+                        " (loop 40 0)"
+                        " (define * +)"
+                        " (sq 5)");
+  cr_assert(is_num(v, 10.0));
+  jit_teardown();
+}
+
+Test(jit, leaves_unsupported_functions_to_the_interpreter) {
+  if (!jit_available()) return;
+  jit_setup();
+  lval_t *v = run_value("(define wrap (lambda (x) (car (list x))))"
+                        " (define loop (lambda (n)"
+                        "   (if (= n 0) (wrap 7) (begin (wrap n) (loop (- n 1))))))"
+                        " (loop 40)");
+  cr_assert(is_num(v, 7.0));
+  cr_assert_eq(jit_compiled_count(), 0);
+  jit_teardown();
+}
+
+Test(jit, non_numeric_arguments_fall_back) {
+  if (!jit_available()) return;
+  jit_setup();
+  lexer_t lexer = lexer_new("(define add1 (lambda (x) (+ x 1)))"
+                            " (define loop (lambda (n)"
+                            "   (if (= n 0) 0 (begin (add1 n) (loop (- n 1))))))"
+                            " (loop 40)"
+                            " (add1 \"x\")");
+  parser = parser_new(&lexer);
+  pr = parser_parse(&parser);
+  eval_result_t r = evaluate_many(pr.expressions, 3, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert_eq(jit_compiled_count(), 1);
+  r = evaluate_single(pr.expressions[3], &env);
+  cr_assert_eq(r.status, EVAL_ERR, "the interpreter should report the type error");
+  evaluator_result_free(&r);
+  jit_teardown();
+}
+
+Test(jit, integer_overflow_falls_back_to_the_interpreter) {
+  if (!jit_available()) return;
+  jit_setup();
+  lval_t *v = run_value("(define sq (lambda (x) (* x x)))"
+                        " (define loop (lambda (n)"
+                        "   (if (= n 0) (sq 3) (begin (sq n) (loop (- n 1))))))"
+                        " (loop 40)"
+                        " (sq 4294967296)");
+  cr_assert_eq(jit_compiled_count(), 1);
+  cr_assert_eq(v->type, L_BIGNUM, "the interpreter promotes the product to a bignum");
+  jit_teardown();
+}
+
+Test(jit, specializes_on_argument_types) {
+  if (!jit_available()) return;
+  jit_setup();
+  lval_t *v = run_value("(define half (lambda (x) (if (< x 1) x (/ x 2))))"
+                        " (define loop (lambda (n)"
+                        "   (if (= n 0) (half 7) (begin (half 1.5) (loop (- n 1))))))"
+                        " (loop 40)"
+                        " (list (half 7) (half 0.5) (half 0))");
+  cr_assert(is_num(v->as.cons.car, 3.5));
+  cr_assert(is_num(v->as.cons.cdr->as.cons.car, 0.5));
+  cr_assert_eq(v->as.cons.cdr->as.cons.cdr->as.cons.car->type, L_INT);
+  cr_assert_eq(jit_compiled_count(), 1);
+  jit_teardown();
+}
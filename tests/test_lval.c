@@ -268,3 +268,24 @@ Test(lval_tests, it_prints_lists, .init = redirect_stdout) {
 
   symbol_intern_free_all();
 }
+
+Test(lval_tests, it_prints_and_shares_vectors, .init = redirect_stdout) {
+  symbol_intern_init();
+
+  lval_t *zero = lval_int(0);
+  lval_t *empty = lval_vector(0, NULL);
+  lval_t *vec = lval_vector(3, zero);
+  vec->as.vector.items[1] = empty;
+  cr_assert_eq(lval_copy(vec), vec, "vectors are mutable, so copies share them");
+  cr_assert_str_eq(lval_type_name(vec), "vector");
+
+  lval_print(vec);
+  putchar('\n');
+  fflush(stdout);
+  cr_assert_stdout_eq_str("#(0 #() 0)\n");
+
+  lval_free(vec);
+  lval_free(empty);
+  lval_free(zero);
+  symbol_intern_free_all();
+}
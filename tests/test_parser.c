@@ -15,14 +15,30 @@ Test(parser_tests, it_parses_numbers) {
 
   cr_assert_not_null(sexp, "s_expression should not be NULL");
   cr_assert_eq(sexp[0]->type, NODE_ATOM, "first s_expression should be an atom");
-  cr_assert_eq(sexp[0]->data.atom.type, ATOM_NUMBER, "atom type should be ATOM_NUMBER");
-  cr_assert_eq(sexp[0]->data.atom.value.number, 123, "atom should be 123");
+  cr_assert_eq(sexp[0]->data.atom.type, ATOM_INTEGER, "atom type should be ATOM_INTEGER");
+  cr_assert_eq(sexp[0]->data.atom.value.integer, 123, "atom should be 123");
   cr_assert_eq(sexp[1]->type, NODE_ATOM, "second s_expression should be an atom");
   cr_assert_eq(sexp[1]->data.atom.type, ATOM_NUMBER, "atom type should be ATOM_NUMBER");
   cr_assert_float_eq(sexp[1]->data.atom.value.number, 0.134, 0.001, "atom should be 0.134");
   cleanup(&r, &parser);
 }
 
+Test(parser_tests, it_keeps_large_integers_exact) {
+  const char *input = "9007199254740993 -42 99999999999999999999";
+  lexer_t lexer = lexer_new(input);
+  parser_t parser = parser_new(&lexer);
+  parse_result_t r = parser_parse(&parser);
+  s_expression_t **sexp = r.expressions;
+
+  cr_assert_eq(parser.error_count, 0, "there should be no parsing errors");
+  cr_assert_eq(sexp[0]->data.atom.type, ATOM_INTEGER);
+  cr_assert_eq(sexp[0]->data.atom.value.integer, 9007199254740993LL);
+  cr_assert_eq(sexp[1]->data.atom.type, ATOM_INTEGER);
+  cr_assert_eq(sexp[1]->data.atom.value.integer, -42);
+  cr_assert_eq(sexp[2]->data.atom.type, ATOM_BIGNUM, "literals beyond int64 become bignums");
+  cleanup(&r, &parser);
+}
+
 Test(parser_tests, it_parses_symbols) {
   const char *input = "foo bar-baz ?qux!";
   lexer_t lexer = lexer_new(input);
@@ -92,31 +108,28 @@ Test(parser_tests, it_parses_lists) {
                NODE_ATOM,
                "first element of first list should be an atom");
   cr_assert_eq(sexp[0]->data.list.elements[0]->data.atom.type,
-               ATOM_NUMBER,
-               "first element of first list should be a number atom");
-  cr_assert_float_eq(sexp[0]->data.list.elements[0]->data.atom.value.number,
-                     1,
-                     0.001,
+               ATOM_INTEGER,
+               "first element of first list should be an integer atom");
+  cr_assert_eq(sexp[0]->data.list.elements[0]->data.atom.value.integer,
+               1,
                      "first element of first list should be 1");
   cr_assert_eq(sexp[0]->data.list.elements[1]->type,
                NODE_ATOM,
                "second element of first list should be an atom");
   cr_assert_eq(sexp[0]->data.list.elements[1]->data.atom.type,
-               ATOM_NUMBER,
-               "second element of first list should be a number atom");
-  cr_assert_float_eq(sexp[0]->data.list.elements[1]->data.atom.value.number,
-                     2,
-                     0.001,
+               ATOM_INTEGER,
+               "second element of first list should be an integer atom");
+  cr_assert_eq(sexp[0]->data.list.elements[1]->data.atom.value.integer,
+               2,
                      "second element of first list should be 2");
   cr_assert_eq(sexp[0]->data.list.elements[2]->type,
                NODE_ATOM,
                "third element of first list should be an atom");
   cr_assert_eq(sexp[0]->data.list.elements[2]->data.atom.type,
-               ATOM_NUMBER,
-               "third element of first list should be a number atom");
-  cr_assert_float_eq(sexp[0]->data.list.elements[2]->data.atom.value.number,
-                     3,
-                     0.001,
+               ATOM_INTEGER,
+               "third element of first list should be an integer atom");
+  cr_assert_eq(sexp[0]->data.list.elements[2]->data.atom.value.integer,
+               3,
                      "third element of first list should be 3");
   cr_assert_eq(sexp[1]->type, NODE_LIST, "second s_expression should be a list");
 
@@ -279,7 +292,7 @@ Test(parser_tests, it_parses_quoted_atoms) {
   cr_assert_eq(sexp[0]->type, NODE_LIST);
   cr_assert_eq(sexp[0]->data.list.count, 2);
   cr_assert_str_eq(sexp[0]->data.list.elements[0]->data.atom.value.symbol, "quote");
-  cr_assert_eq(sexp[0]->data.list.elements[1]->data.atom.value.number, 5);
+  cr_assert_eq(sexp[0]->data.list.elements[1]->data.atom.value.integer, 5);
 
   cr_assert_eq(sexp[1]->type, NODE_LIST);
   cr_assert_eq(sexp[1]->data.list.count, 2);
@@ -291,10 +304,10 @@ Test(parser_tests, it_parses_quoted_atoms) {
   cr_assert_str_eq(sexp[2]->data.list.elements[0]->data.atom.value.symbol, "quote");
   cr_assert_str_eq(sexp[2]->data.list.elements[1]->data.atom.value.string, "meow");
 
-  cr_assert_eq(sexp[2]->type, NODE_LIST);
-  cr_assert_eq(sexp[2]->data.list.count, 2);
-  cr_assert_str_eq(sexp[2]->data.list.elements[0]->data.atom.value.symbol, "quote");
-  cr_assert_eq(sexp[2]->data.list.elements[1]->data.atom.value.boolean, true);
+  cr_assert_eq(sexp[3]->type, NODE_LIST);
+  cr_assert_eq(sexp[3]->data.list.count, 2);
+  cr_assert_str_eq(sexp[3]->data.list.elements[0]->data.atom.value.symbol, "quote");
+  cr_assert_eq(sexp[3]->data.list.elements[1]->data.atom.value.boolean, true);
   cleanup(&r, &parser);
 }
 
@@ -0,0 +1,58 @@
+#include "eval_fixture.h"
+#include "lval.h"
+#include "profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Test(profile_tests, it_samples_named_call_stacks, .init = eval_setup, .fini = eval_teardown) {
+  char *folded = NULL, *report = NULL;
+  size_t folded_len = 0, report_len = 0;
+  FILE *f = open_memstream(&folded, &folded_len);
+  FILE *r = open_memstream(&report, &report_len);
+  cr_assert(profile_start("t.s"));
+  eval_result_t res = run("(define spin (lambda (n) (do ((i 0 (+ i 1))) ((= i n) i))))\n"
+                          "(define outer (lambda () ((lambda () (spin 1500000)))))\n"
+                          "(outer)");
+  cr_assert_eq(res.status, EVAL_OK);
+  profile_stop(f, r, 10);
+  fclose(f);
+  fclose(r);
+  cr_assert_not_null(strstr(folded, "outer (t.s:2);<lambda> (t.s:2);spin (t.s:1) "), "%s",
+                     folded);
+  cr_assert_not_null(strstr(report, "spin (t.s:1)"), "%s", report);
+  cr_assert_eq(profile_depth, 0);
+  free(folded);
+  free(report);
+}
+
+Test(profile_tests, errors_unwind_the_call_stack, .init = eval_setup, .fini = eval_teardown) {
+  cr_assert(profile_start("t.s"));
+  eval_result_t res = run("(define f (lambda (x) (g x)))"
+                          "(define g (lambda (x) (car x)))"
+                          "(f 5)");
+  cr_assert_eq(res.status, EVAL_ERR);
+  cr_assert_eq(profile_depth, 0);
+  profile_stop(NULL, NULL, 0);
+  cr_assert_not(profile_active);
+  evaluator_result_free(&res);
+}
+
+Test(profile_tests, it_attributes_allocations_to_call_sites, .init = eval_setup,
+     .fini = eval_teardown) {
+  char *report = NULL;
+  size_t report_len = 0;
+  FILE *r = open_memstream(&report, &report_len);
+  gc_set_trigger(1000);
+  cr_assert(profile_alloc_start("t.s", 1));
+  eval_result_t res = run("(define pair (lambda (n) (list n \"s\")))\n"
+                          "(do ((i 0 (+ i 1))) ((= i 2000) i)\n"
+                          "  (pair i))");
+  cr_assert_eq(res.status, EVAL_OK);
+  profile_alloc_stop(r, 50);
+  fclose(r);
+  cr_assert_not_null(strstr(report, "cons from list (t.s:1) in pair (t.s:1)"), "%s", report);
+  cr_assert_not_null(strstr(report, "string in pair (t.s:1)"), "%s", report);
+  cr_assert_not(profile_active);
+  free(report);
+}
@@ -7,8 +7,10 @@
 #include "parser.h"
 #include "symbol.h"
 #include <criterion/criterion.h>
+#include <criterion/redirect.h>
 #include <math.h>
 #include <stdbool.h>
+#include <string.h>
 
 static parse_result_t setup_input(const char *input, parser_t *out_parser) {
   lexer_t lexer = lexer_new(input);
@@ -25,7 +27,7 @@ static parse_result_t setup_input(const char *input, parser_t *out_parser) {
 }
 
 static bool is_num(const lval_t *v, double x) {
-  return v && v->type == L_NUM && fabs(v->as.number - x) < 1e-9;
+  return v && lval_is_number(v) && fabs(lval_to_double(v) - x) < 1e-9;
 }
 static lval_t *car(lval_t *c) {
   cr_assert_eq(c->type, L_CONS);
@@ -530,8 +532,8 @@ Test(special_forms, set_top_level_updates_and_returns_value) {
   parse_result_t pr = setup_input("(define x 1) (set x 2) x", &p);
   eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 2.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 2.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -556,8 +558,8 @@ Test(special_forms, set_mutates_outer_env_from_lambda) {
                                   &p);
   eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 3.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 3.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -600,8 +602,8 @@ Test(special_forms, set_can_rebind_builtin_in_global_env) {
                                   &p);
   eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 3.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 3.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -623,10 +625,10 @@ Test(special_forms, if_basic) {
   cr_assert_eq(r.status, EVAL_OK);
   lval_t *a = r.result->as.cons.car;
   lval_t *b = r.result->as.cons.cdr->as.cons.car;
-  cr_assert_eq(a->type, L_NUM);
-  cr_assert_float_eq(a->as.number, 1.0, 1e-10);
-  cr_assert_eq(b->type, L_NUM);
-  cr_assert_float_eq(b->as.number, 2.0, 1e-10);
+  cr_assert(lval_is_number(a));
+  cr_assert_float_eq(lval_to_double(a), 1.0, 1e-10);
+  cr_assert(lval_is_number(b));
+  cr_assert_float_eq(lval_to_double(b), 2.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -648,7 +650,7 @@ Test(special_forms, if_no_else_returns_nil) {
   cr_assert_eq(r.status, EVAL_OK);
   lval_t *a = r.result->as.cons.car;
   lval_t *b = r.result->as.cons.cdr->as.cons.car;
-  cr_assert_eq(a->type, L_NUM);
+  cr_assert(lval_is_number(a));
   cr_assert_eq(b->type, L_NIL);
   evaluator_result_free(&r);
   parse_result_free(&pr);
@@ -691,10 +693,10 @@ Test(special_forms, if_is_lazy) {
   cr_assert_eq(r.status, EVAL_OK);
   lval_t *a = r.result->as.cons.car;
   lval_t *b = r.result->as.cons.cdr->as.cons.car;
-  cr_assert_eq(a->type, L_NUM);
-  cr_assert_float_eq(a->as.number, 1.0, 1e-10);
-  cr_assert_eq(b->type, L_NUM);
-  cr_assert_float_eq(b->as.number, 2.0, 1e-10);
+  cr_assert(lval_is_number(a));
+  cr_assert_float_eq(lval_to_double(a), 1.0, 1e-10);
+  cr_assert(lval_is_number(b));
+  cr_assert_float_eq(lval_to_double(b), 2.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -853,8 +855,8 @@ Test(special_forms, begin_returns_last_and_evaluates_in_order) {
   parse_result_t pr = setup_input("(begin 1 2 3)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 3.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 3.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -874,8 +876,8 @@ Test(special_forms, begin_uses_current_env) {
   parse_result_t pr = setup_input("(begin (define x 1) (set x 2) x)", &p);
   eval_result_t r = evaluate_single(pr.expressions[0], &env);
   cr_assert_eq(r.status, EVAL_OK);
-  cr_assert_eq(r.result->type, L_NUM);
-  cr_assert_float_eq(r.result->as.number, 2.0, 1e-10);
+  cr_assert(lval_is_number(r.result));
+  cr_assert_float_eq(lval_to_double(r.result), 2.0, 1e-10);
   evaluator_result_free(&r);
   parse_result_free(&pr);
   parser_free(&p);
@@ -1174,3 +1176,491 @@ Test(macros, macro_unless) {
   env_destroy(&env);
   symbol_intern_free_all();
 }
+
+Test(loops, let_and_let_star_bind_in_one_frame) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr = setup_input("(define x 10)"
+                                  "(list (let ((x 1) (y x)) (+ x y))"
+                                  "      (let* ((x 1) (y (+ x 1)) (x (* y 3))) (+ x y))"
+                                  "      x)",
+                                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert(is_num(car(r.result), 11.0), "let inits see the outer x");
+  cr_assert(is_num(car(cdr(r.result)), 8.0));
+  cr_assert(is_num(car(cdr(cdr(r.result))), 10.0));
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(loops, named_let_iterates_without_recursing) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  // Far deeper than the C stack allows for recursive calls.
+  parse_result_t pr =
+      setup_input("(list (let loop ((i 0) (acc 0))"
+                  "        (cond ((= i 300000) acc"
+                  "               #t (loop (+ i 1) (+ acc i)))))"
+                  "      (let count ((n 3)) (if (= n 0) '() (cons n (count (- n 1))))))",
+                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert(is_num(car(r.result), 44999850000.0));
+  lval_t *counted = car(cdr(r.result));
+  cr_assert(is_num(car(counted), 3.0), "non-tail calls recurse as usual");
+  cr_assert(is_num(car(cdr(cdr(counted))), 1.0));
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(loops, loop_bodies_do_not_keep_their_definitions) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  // Each iteration sees the global x, as a recursive lambda would.
+  parse_result_t pr =
+      setup_input("(define x \"global\")"
+                  "(define out '())"
+                  "(let loop ((i 0))"
+                  "  (if (< i 3) (begin (set out (cons x out)) (define x i) (loop (+ i 1)))))"
+                  "(define named out)"
+                  "(set out '())"
+                  "(do ((i 0 (+ i 1))) ((= i 3) out) (set out (cons x out)) (define x i))",
+                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *lists[] = { env_get_symbol(&env, symbol_intern("named")), r.result };
+  for (size_t l = 0; l < 2; l++) {
+    lval_t *v = lists[l];
+    for (size_t i = 0; i < 3; i++, v = cdr(v)) {
+      cr_assert(car(v)->type == L_STRING && strcmp(car(v)->as.string.ptr, "global") == 0,
+                "loop %zu, element %zu", l, i);
+    }
+  }
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(loops, named_let_iterates_through_let_bodies) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr =
+      setup_input("(list (let loop ((i 0))"
+                  "        (let ((j (+ i 1))) (if (= j 1000000) j (loop j))))"
+                  "      (let loop ((i 0) (acc 0))"
+                  "        (let* ((j (+ i 1)) (acc (+ acc j)))"
+                  "          (if (= j 1000000) acc (loop j acc)))))",
+                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert(is_num(car(r.result), 1000000.0));
+  cr_assert(is_num(car(cdr(r.result)), 500000500000.0));
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(loops, named_let_iterates_through_and_or_and_case) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr =
+      setup_input("(define f (lambda (n)"
+                  "  (list (let loop ((i 0)) (or (= i n) (loop (+ i 1))))"
+                  "        (let loop ((i 0)) (and (< i n) (loop (+ i 1))))"
+                  "        (let loop ((i 0))"
+                  "          (if (= i n) i"
+                  "              (case (mod i 3) ((0 1) (loop (+ i 1))) (else (loop (+ i 1))))))"
+                  "        (try (let loop ((i 0)) (and #t 5)) (catch e (error-message e))))))"
+                  "(f 1000000)",
+                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert(car(r.result)->as.boolean);
+  cr_assert_not(car(cdr(r.result))->as.boolean);
+  cr_assert(is_num(car(cdr(cdr(r.result))), 1000000.0), "case branches are tail calls");
+  cr_assert_str_eq(car(cdr(cdr(cdr(r.result))))->as.string.ptr,
+                   "and: expected boolean arguments");
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(loops, do_steps_all_variables_before_updating) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr = setup_input("(do ((i 0 (+ i 1)) (a 0 b) (b 1 (+ a b)) (k 7))"
+                                  "    ((= i 10) (list a k)))",
+                                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert(is_num(car(r.result), 55.0));
+  cr_assert(is_num(car(cdr(r.result)), 7.0), "variables without a step keep their value");
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(loops, closures_keep_the_iteration_they_captured) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr = setup_input("(define fs (do ((i 0 (+ i 1)) (fs '() (cons (lambda () i) fs)))"
+                                  "               ((= i 3) fs)))"
+                                  "(map (lambda (f) (f)) fs)",
+                                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert(is_num(car(r.result), 2.0));
+  cr_assert(is_num(car(cdr(r.result)), 1.0));
+  cr_assert(is_num(car(cdr(cdr(r.result))), 0.0));
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(loops, while_runs_in_the_current_environment) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr = setup_input("(define n 0)"
+                                  "(define r (while (< n 5) (set n (+ n 1))))"
+                                  "(list n r (while 1))",
+                                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, 2, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  r = evaluate_many(pr.expressions + 2, 1, &env);
+  cr_assert_eq(r.status, EVAL_ERR, "the test must be a boolean");
+  cr_assert(is_num(env_get_symbol(&env, symbol_intern("n")), 5.0));
+  cr_assert_eq(env_get_symbol(&env, symbol_intern("r"))->type, L_NIL);
+
+  evaluator_result_free(&r);
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(logic, and_or_stop_at_the_deciding_argument) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr = setup_input("(define n 0)"
+                                  "(define step (lambda (k b) (set n k) b))"
+                                  "(list (and (step 1 #t) (step 2 #f) (step 3 #t)) n"
+                                  "      (or (step 4 #f) (step 5 #t) (car 5)) n"
+                                  "      (and #t #t) (or #f #f))",
+                                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *v = r.result;
+  cr_assert(car(v)->type == L_BOOL && !car(v)->as.boolean);
+  cr_assert(is_num(car(cdr(v)), 2.0), "and stops at the first false argument");
+  v = cdr(cdr(v));
+  cr_assert(car(v)->type == L_BOOL && car(v)->as.boolean);
+  cr_assert(is_num(car(cdr(v)), 5.0), "or stops at the first true argument");
+  v = cdr(cdr(v));
+  cr_assert(car(v)->as.boolean);
+  cr_assert_not(car(cdr(v))->as.boolean);
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(logic, case_dispatches_on_eqv_datums) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr = setup_input("(define kind (lambda (x)"
+                                  "  (case x ((a e i) 1) ((2 3) 2) ((2.5 #t) 3) (else 4))))"
+                                  "(define digit (lambda (x)"
+                                  "  (case x ((0) 0) ((1 3 5) 1) ((-2 2 4) 2))))"
+                                  "(list (kind 'e) (kind 3) (kind 2.5) (kind #t) (kind 3.0)"
+                                  "      (kind \"a\") (digit -2) (digit 5) (digit 6)"
+                                  "      (case 'b ((a) 1) ((b) 2 3)))",
+                                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  const double expected[] = { 1, 2, 3, 3, 4, 4, 2, 1, -1, 3 };
+  lval_t *v = r.result;
+  for (size_t i = 0; i < sizeof expected / sizeof expected[0]; i++, v = cdr(v)) {
+    if (expected[i] < 0) {
+      cr_assert_eq(car(v)->type, L_NIL, "no clause matches");
+    } else {
+      cr_assert(is_num(car(v), expected[i]), "result %zu", i);
+    }
+  }
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(logic, malformed_case_forms_are_errors) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  const char *const sources[] = {
+    "(case 1 ((\"a\") 1))",
+    "(case 1 (else 1) ((1) 2))",
+    "(case 1 ((1)))",
+    "(case)",
+  };
+  for (size_t i = 0; i < sizeof sources / sizeof sources[0]; i++) {
+    parser_t p = (parser_t){ 0 };
+    parse_result_t pr = setup_input(sources[i], &p);
+    eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+    cr_assert_eq(r.status, EVAL_ERR, "%s", sources[i]);
+    evaluator_result_free(&r);
+    parse_result_free(&pr);
+    parser_free(&p);
+  }
+
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(promises, delay_evaluates_once_when_forced) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr = setup_input("(define n 0)"
+                                  "(define make (lambda (k) (delay (begin (set n (+ n 1)) (* k 2)))))"
+                                  "(define p (make 21))"
+                                  "(define before n)"
+                                  "(list before (force p) (force p) n (promise? p) (force 7)"
+                                  "      (car (stream-cons 1 (car 5))))",
+                                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  const double expected[] = { 0, 42, 42, 1 };
+  lval_t *v = r.result;
+  for (size_t i = 0; i < 4; i++, v = cdr(v)) cr_assert(is_num(car(v), expected[i]), "item %zu", i);
+  cr_assert(car(v)->type == L_BOOL && car(v)->as.boolean);
+  cr_assert(is_num(car(cdr(v)), 7.0), "anything else forces to itself");
+  cr_assert(is_num(car(cdr(cdr(v))), 1.0), "stream-cons delays its second argument");
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(errors, call_errors_are_not_formatted_until_asked) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr = setup_input("(undefined-fn 1)"
+                                  "(5 1)"
+                                  "((lambda (x) x) 1 2)"
+                                  "(car)"
+                                  "(list (try (undefined-fn 1) (catch e (error-kind e)))"
+                                  "      (try ((lambda (x) x)) (catch e (error-kind e))))",
+                                  &p);
+  const char *messages[] = { "Unbound symbol: undefined-fn", "Expected a function, got integer",
+                             "Function expects 1 arguments, got 2",
+                             "car: expected exactly 1 argument, got 0" };
+  for (size_t i = 0; i < 4; i++) {
+    eval_result_t r = evaluate_single(pr.expressions[i], &env);
+    cr_assert_eq(r.status, EVAL_ERR);
+    cr_assert_not(r.error_owned, "error %zu was formatted before it was asked for", i);
+    cr_assert_str_eq(eval_error_message(&r), messages[i]);
+    evaluator_result_free(&r);
+  }
+  eval_result_t r = evaluate_single(pr.expressions[4], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert_str_eq(car(r.result)->as.symbol.name, "unbound");
+  cr_assert_str_eq(car(cdr(r.result))->as.symbol.name, "arity");
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(errors, try_binds_the_caught_error) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr =
+      setup_input("(define parse (lambda (s) (try (string->number s) (catch e (error-value e)))))"
+                  "(define kind (lambda (thunk) (try (thunk) (catch e (error-kind e)))))"
+                  "(list (parse \"12\") (parse \"abc\")"
+                  "      (kind (lambda () (+ 1 \"x\"))) (kind (lambda () (car 5)))"
+                  "      (kind (lambda () nope)) (kind (lambda () (error 7)))"
+                  "      (try (error \"boom\") (catch e (error-message e)))"
+                  "      (try (+ 1 \"x\") (catch e (error-message e)))"
+                  "      (try (error 'x) (catch e (error? e))) (try 5 (catch e 0)))",
+                  &p);
+  eval_result_t r = evaluate_many(pr.expressions, pr.count, &env);
+  if (r.status != EVAL_OK) cr_log_error("%s", eval_error_message(&r));
+  cr_assert_eq(r.status, EVAL_OK);
+  lval_t *v = r.result;
+  cr_assert(is_num(car(v), 12.0));
+  v = cdr(v);
+  cr_assert(car(v)->type == L_STRING && strcmp(car(v)->as.string.ptr, "abc") == 0);
+  const char *kinds[] = { "type", "type", "unbound", "user" };
+  for (size_t i = 0; i < 4; i++) {
+    v = cdr(v);
+    cr_assert(car(v)->type == L_SYMBOL && strcmp(car(v)->as.symbol.name, kinds[i]) == 0,
+              "kind %zu", i);
+  }
+  v = cdr(v);
+  cr_assert_str_eq(car(v)->as.string.ptr, "error: boom");
+  v = cdr(v);
+  cr_assert_str_eq(car(v)->as.string.ptr, "+: expected number at arg 2, got string");
+  v = cdr(v);
+  cr_assert(car(v)->type == L_BOOL && car(v)->as.boolean);
+  cr_assert(is_num(car(cdr(v)), 5.0), "try without an error returns the body");
+
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(errors, errors_propagate_through_try_without_a_catch_clause) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  const char *inputs[] = {
+    "(try (car 5))",
+    "(try (car 5) (catch))",
+    "(try (car 5) (catch e (car e)))",
+  };
+  for (size_t i = 0; i < sizeof inputs / sizeof inputs[0]; i++) {
+    parser_t p = (parser_t){ 0 };
+    parse_result_t pr = setup_input(inputs[i], &p);
+    eval_result_t r = evaluate_single(pr.expressions[0], &env);
+    cr_assert_eq(r.status, EVAL_ERR, "%s", inputs[i]);
+    cr_assert_not_null(eval_error_message(&r));
+    evaluator_result_free(&r);
+    parse_result_free(&pr);
+    parser_free(&p);
+  }
+
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
+
+Test(measurement, time_returns_the_value_of_its_body, .init = cr_redirect_stdout) {
+  symbol_intern_init();
+  env_t env;
+  cr_assert(env_init(&env, NULL));
+  env_add_builtins(&env);
+  gc_init(&env);
+  parser_t p = (parser_t){ 0 };
+  parse_result_t pr = setup_input("(time (define x 2) (list x 3))", &p);
+  eval_result_t r = evaluate_single(pr.expressions[0], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert(is_num(car(r.result), 2.0));
+  cr_assert(is_num(car(cdr(r.result)), 3.0));
+  fflush(stdout);
+  char report[128] = { 0 };
+  cr_assert_not_null(fgets(report, sizeof report, cr_get_redirected_stdout()));
+  cr_assert(strncmp(report, "time: ", 6) == 0 && strstr(report, " allocations, "), "%s", report);
+  parse_result_free(&pr);
+  parser_free(&p);
+  gc_collect(NULL);
+  gc_reset();
+  env_destroy(&env);
+  symbol_intern_free_all();
+}
@@ -50,3 +50,18 @@ Test(symbol_tests, free_all_does_not_crash) {
   cr_assert_not_null(sym, "Interning after free_all should still work");
   symbol_intern_free_all();
 }
+
+Test(symbol_tests, symbol_of_maps_name_back_to_symbol) {
+  symbol_intern_init();
+  const char *sym = symbol_intern("gamma");
+  cr_assert_eq(symbol_of(sym)->name, sym, "symbol_of should recover the interned symbol");
+  cr_assert_null(symbol_of(sym)->special, "fresh symbols should carry no special form tag");
+  symbol_intern_free_all();
+}
+
+Test(symbol_tests, intern_works_without_explicit_init) {
+  const char *sym = symbol_intern("lazy");
+  cr_assert_not_null(sym, "interning should lazily create the table");
+  cr_assert_eq(sym, symbol_intern("lazy"));
+  symbol_intern_free_all();
+}
@@ -0,0 +1,63 @@
+#include "eval_fixture.h"
+#include "fold.h"
+#include "lval.h"
+#include <string.h>
+
+static lval_t *nth(lval_t *list, size_t i) {
+  while (i--) list = list->as.cons.cdr;
+  return list->as.cons.car;
+}
+
+Test(unbox_tests, numeric_calls_become_unboxed_regions, .init = eval_setup, .fini = eval_teardown) {
+  eval_result_t r = run("(define inside (lambda (x y) (< (+ (* x x) (* y y)) 4)))"
+                        "(list (inside 1 1) (inside 2 1.5))");
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert(nth(r.result, 0)->as.boolean);
+  cr_assert_not(nth(r.result, 1)->as.boolean);
+  s_expression_t *body = pr.expressions[0]->data.list.elements[2]->data.list.elements[2];
+  s_expression_t *region = body->data.list.fold.expr;
+  cr_assert_not_null(region);
+  cr_assert_eq(region->data.atom.type, ATOM_UNBOXED);
+}
+
+Test(unbox_tests, results_match_the_builtins, .init = eval_setup, .fini = eval_teardown) {
+  eval_result_t r = run("(define f (lambda (a b) (list (+ (* a b) 1) (- (+ a b)) (/ (+ a 0) b)"
+                        "                               (- (* a 1.5) b) (= (+ a a) 2.0))))"
+                        "(f 1 2)");
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert_eq(nth(r.result, 0)->type, L_INT);
+  cr_assert_eq(nth(r.result, 0)->as.integer, 3);
+  cr_assert_eq(nth(r.result, 1)->type, L_INT, "(- x) is x, as with the builtin");
+  cr_assert_eq(nth(r.result, 1)->as.integer, 3);
+  cr_assert_eq(nth(r.result, 2)->type, L_NUM);
+  cr_assert_float_eq(nth(r.result, 2)->as.number, 0.5, 1e-12);
+  cr_assert_eq(nth(r.result, 3)->type, L_NUM);
+  cr_assert_float_eq(nth(r.result, 3)->as.number, -0.5, 1e-12);
+  cr_assert(nth(r.result, 4)->as.boolean);
+}
+
+Test(unbox_tests, overflow_and_bad_operands_fall_back_to_the_builtins, .init = eval_setup,
+     .fini = eval_teardown) {
+  eval_result_t r = run("(define sq1 (lambda (x) (+ (* x x) 1)))"
+                        "(define big (sq1 4294967296))"
+                        "(sq1 \"a\")");
+  cr_assert_eq(r.status, EVAL_ERR);
+  cr_assert_not_null(strstr(r.error_message, "expected number"));
+  evaluator_result_free(&r);
+  lval_t *big = env_get_symbol(&env, symbol_intern("big"));
+  cr_assert_eq(big->type, L_BIGNUM, "the product is promoted to a bignum");
+}
+
+Test(unbox_tests, only_the_result_is_allocated, .init = eval_setup, .fini = eval_teardown) {
+  gc_set_trigger(0);
+  lexer_t lexer = lexer_new("(define a 3) (define b 4.0) (- (+ (* a a) (* b b)) (* 2 a b))");
+  parser = parser_new(&lexer);
+  pr = parser_parse(&parser);
+  cr_assert_eq(evaluate_many(pr.expressions, 2, &env).status, EVAL_OK);
+  fold_expression(pr.expressions[2], &env);
+  size_t before = gc_object_count();
+  eval_result_t r = evaluate_single(pr.expressions[2], &env);
+  cr_assert_eq(r.status, EVAL_OK);
+  cr_assert_float_eq(r.result->as.number, 1.0, 1e-12);
+  cr_assert_eq(gc_object_count(), before + 1, "%zu objects", gc_object_count() - before);
+}